@@ -56,6 +56,8 @@ struct elf_dyn_info;
 
 #include <pthread.h>
 
+#include "retire.h"
+
 /* DWARF expression opcodes.  */
 
 typedef enum
@@ -260,15 +262,45 @@ typedef struct dwarf_reg_state
   {
     struct dwarf_reg_state *next;       /* for rs_stack */
     dwarf_save_loc_t reg[DWARF_NUM_PRESERVED_REGS + 2];
-    unw_word_t ip;                        /* ip this rs is for */
-    unw_word_t ret_addr_column;           /* indicates which column in the rule table represents return address */
-    unsigned short lru_chain;     /* used for least-recently-used chain */
+  }
+dwarf_reg_state_t;
+
+/* The register state of an IP as the rs cache keeps it: only the
+   registers that have a rule other than DWARF_WHERE_SAME are listed,
+   in increasing order, with their value on 32 bits.  Expression
+   addresses are relative to "expr_base", the CFA rule is kept apart.
+   Most frames only save a few registers, which makes the record a
+   fraction of the size of a dwarf_reg_state_t.  */
+typedef struct dwarf_compact_loc
+  {
+    uint8_t regnum;             /* the register (column) */
+    uint8_t where;              /* dwarf_where_t */
+    int32_t val;                /* where it's saved */
+  }
+dwarf_compact_loc_t;
+
+typedef struct dwarf_compact_rs
+  {
+    unw_word_t ip;              /* ip this rs is for */
+    unw_word_t expr_base;       /* base of expression addresses */
+    unsigned short lru_chain;   /* used for least-recently-used chain */
     unsigned short coll_chain;  /* used for hash collisions */
-    unsigned short hint;              /* hint for next rs to try (or -1) */
-    unsigned short valid : 1;         /* optional machine-dependent signal info */
+    unsigned short hint;        /* hint for next rs to try (or -1) */
+    unsigned short valid : 1;
     unsigned short signal_frame : 1;  /* optional machine-dependent signal info */
+    unsigned short cfa_is_sp : 1;     /* CFA is based on the unsaved SP */
+    unsigned short ret_addr_column : 8; /* restored into the cursor on a hit */
+    uint8_t cfa_where;          /* DWARF_WHERE_REG or DWARF_WHERE_EXPR */
+    int32_t cfa_val;            /* CFA base register or expression */
+    int32_t cfa_offset;         /* offset added to the base register */
+    unsigned short nlocs;       /* number of entries in "loc" */
+    dwarf_compact_loc_t loc[DWARF_NUM_PRESERVED_REGS];
   }
-dwarf_reg_state_t;
+dwarf_compact_rs_t;
+
+/* Size of the used part of compact record RS.  */
+#define DWARF_COMPACT_RS_SIZE(rs) \
+  (offsetof (dwarf_compact_rs_t, loc) + (rs)->nlocs * sizeof ((rs)->loc[0]))
 
 typedef struct dwarf_cie_info
   {
@@ -300,6 +332,13 @@ typedef struct dwarf_state_record
   }
 dwarf_state_record_t;
 
+/* Called by dwarf_reg_states_iterate() with the register state RS that
+   applies from START up to END.  */
+typedef int (*dwarf_reg_states_callback_t) (void *token,
+                                            const dwarf_reg_state_t *rs,
+                                            unw_word_t start,
+                                            unw_word_t end);
+
 typedef struct dwarf_cursor
   {
     void *as_arg;               /* argument to address-space callbacks */
@@ -325,13 +364,55 @@ typedef struct dwarf_cursor
   }
 dwarf_cursor_t;
 
-#define DWARF_LOG_UNW_CACHE_SIZE        7
+/* On x86_64, a dwarf_compact_rs_t is 176 bytes: the 256 records and
+   their 512-entry hash make struct dwarf_rs_cache 45 KiB, about what 128
+   full register states of 336 bytes used to take.  The decoded CFI programs are not
+   in there, but in the 38 KiB struct dwarf_cfi_arena allocated on first
+   use.  "bench-unwind local-step -S SITES", with UNW_EH_ELF=0, measures
+   the cost of a step as the call sites of the stack outnumber the
+   records.  */
+#define DWARF_LOG_UNW_CACHE_SIZE        8
 #define DWARF_UNW_CACHE_SIZE    (1 << DWARF_LOG_UNW_CACHE_SIZE)
 
 #define DWARF_LOG_UNW_HASH_SIZE (DWARF_LOG_UNW_CACHE_SIZE + 1)
 #define DWARF_UNW_HASH_SIZE     (1 << DWARF_LOG_UNW_HASH_SIZE)
 
-typedef unsigned char unw_hash_index_t;
+typedef unsigned short unw_hash_index_t;
+
+/* A CFI instruction, decoded once and for all: the many encodings of an
+   operation all come down to one of them, and operands are read,
+   factored and relocated.  */
+typedef struct dwarf_cfa_insn
+  {
+    uint8_t op;                 /* DW_CFA_* opcode, see decode_cfa() */
+    uint16_t regnum;            /* register operand, if any */
+    unw_word_t val;             /* other operand, if any */
+  }
+dwarf_cfa_insn_t;
+
+/* The decoded instructions of a CIE or FDE CFI program.  */
+struct dwarf_cfi_prog
+  {
+    unw_word_t addr;            /* start of the program */
+    unw_word_t end_addr;        /* and its end */
+    unsigned short start;       /* index of its first instruction */
+    unsigned short count;       /* number of instructions */
+    unsigned short coll_chain;  /* used for hash collisions */
+    unsigned short local : 1;   /* read from the local address space? */
+  };
+
+#define DWARF_LOG_CFI_HASH_SIZE 7
+#define DWARF_CFI_HASH_SIZE     (1 << DWARF_LOG_CFI_HASH_SIZE)
+#define DWARF_CFI_CACHE_PROGS   256
+#define DWARF_CFI_CACHE_INSNS   2048
+
+/* Where the decoded CFI programs go.  At 38 KiB on x86_64, it is only
+   allocated once an address space decodes its first program.  */
+struct dwarf_cfi_arena
+  {
+    struct dwarf_cfi_prog progs[DWARF_CFI_CACHE_PROGS];
+    dwarf_cfa_insn_t insns[DWARF_CFI_CACHE_INSNS];
+  };
 
 struct dwarf_rs_cache
   {
@@ -345,7 +426,108 @@ struct dwarf_rs_cache
     uint32_t generation;        /* generation number */
 
     /* rs cache: */
-    dwarf_reg_state_t buckets[DWARF_UNW_CACHE_SIZE];
+    dwarf_compact_rs_t buckets[DWARF_UNW_CACHE_SIZE];
+
+    /* decoded CFI programs, emptied whenever they fill up: */
+    unsigned short cfi_hash[DWARF_CFI_HASH_SIZE];
+    unsigned short cfi_nprogs;
+    unsigned short cfi_ninsns;
+    struct dwarf_cfi_arena *cfi; /* NULL until first used */
+  };
+
+/* A sorted index of the FDEs in a .debug_frame section.  An index is
+   never modified once published: indexing more of the section makes a
+   new one, which keeps the older ones until the section is flushed.  */
+
+struct unw_debug_frame_index
+  {
+    struct unw_debug_frame_index *prev;
+    size_t size;
+    struct table_entry *table;
+  };
+
+/* What we keep about the search table of an .eh_frame_hdr: a local copy
+   of a remote table, made once searching it in remote memory has cost
+   as much as copying it, and an index of large tables, local or not.
+   Flushed records are retired on the table_retire list of the address
+   space, as lookups may still be using them.  The records of the local
+   address space also go once objects were loaded or unloaded since they
+   were made, see get_local_table().  */
+
+struct unw_remote_table
+  {
+    struct unw_retired retired; /* must be first */
+    unw_word_t addr;            /* address of the table */
+    size_t size;                /* and its size, in bytes */
+    unw_word_t segbase;         /* base of the object it belongs to */
+    unsigned long long dl_generation;   /* dlpi_adds + dlpi_subs, or 0 */
+    unsigned long reads;        /* access_mem() calls spent searching it */
+    struct table_entry *table;  /* the copy, or NULL */
+    struct unw_table_index *index;      /* see Gfind_proc_info-lsb.c */
+    size_t map_size;            /* if mmap()ed along with the index */
+    struct unw_remote_table *next;
+  };
+
+/* The CIEs parsed in an address space, by address.  There are few of
+   them, each shared by many FDEs.  The records are carved out of a
+   single mapping, made on first use, which only the pages in use take
+   memory of; once it is full, CIEs are parsed every time.  The mapping
+   lives as long as the address space: records are tagged with the
+   cache generation they were parsed in, and unw_flush_cache() only
+   bumps the generation, so that the records are reused afterwards.  */
+
+#define DWARF_CIE_HASH_SIZE     256
+#define DWARF_CIE_CACHE_SIZE    2048
+
+struct dwarf_cie_record
+  {
+    volatile uint32_t generation;       /* set first when (re)written */
+    unw_word_t addr;            /* address of the CIE */
+    int is_debug_frame;
+    dwarf_cie_info_t dci;
+    struct dwarf_cie_record *next;
+  };
+
+struct unw_cie_cache
+  {
+    struct dwarf_cie_record *hash[DWARF_CIE_HASH_SIZE];
+    uint32_t generation;        /* of the records in the hash table */
+    unsigned int used;          /* records handed out */
+    struct dwarf_cie_record records[DWARF_CIE_CACHE_SIZE];
+  };
+
+/* The DWARF expressions of CFI rules evaluated in an address space,
+   decoded like CFI programs, by address.  Expressions of more than
+   DWARF_EXPR_MAX_OPS operations are evaluated from memory every time.
+   The cache is made, filled and flushed like struct unw_cie_cache.  */
+
+#define DWARF_EXPR_MAX_OPS      16
+#define DWARF_EXPR_HASH_SIZE    64
+#define DWARF_EXPR_CACHE_SIZE   256
+
+typedef struct dwarf_expr_insn
+  {
+    uint8_t op;                 /* DW_OP_* opcode, see decode_op() */
+    uint16_t arg;               /* register, size, index or branch target */
+    unw_word_t operand;
+  }
+dwarf_expr_insn_t;
+
+struct dwarf_expr_record
+  {
+    volatile uint32_t generation;       /* set first when (re)written */
+    unw_word_t addr;            /* address of the expression's length */
+    unsigned int nops;
+    dwarf_expr_insn_t ops[DWARF_EXPR_MAX_OPS];
+    struct dwarf_expr_record *next;
+  };
+
+struct unw_expr_cache
+  {
+    struct dwarf_expr_record *hash[DWARF_EXPR_HASH_SIZE];
+    uint32_t generation;        /* of the records in the hash table */
+    unsigned int used;          /* records handed out */
+    struct dwarf_expr_record records[DWARF_EXPR_CACHE_SIZE];
   };
 
 /* A list of descriptors for loaded .debug_frame sections.  */
@@ -355,12 +537,17 @@ struct unw_debug_frame_list
     /* The start (inclusive) and end (exclusive) of the described region.  */
     unw_word_t start;
     unw_word_t end;
-    /* The debug frame itself.  */
+    /* The debug frame itself, and the file mapping it lies in.  */
     char *debug_frame;
     size_t debug_frame_size;
-    /* Index (for binary search).  */
-    struct table_entry *index;
-    size_t index_size;
+    void *debug_frame_map;
+    size_t debug_frame_map_size;
+    /* Index (for binary search), of the FDEs before offset index_end.  */
+    struct unw_debug_frame_index *index;
+    size_t index_end;
+    /* Where the complete index is saved, or NULL, and its identity.  */
+    char *index_file;
+    uint64_t index_key;
     /* Pointer to next descriptor.  */
     struct unw_debug_frame_list *next;
   };
@@ -372,6 +559,7 @@ struct dwarf_callback_data
     unw_proc_info_t *pi;        /* proc-info pointer */
     int need_unwind_info;
     /* out: */
+    unsigned long long dl_generation;   /* dlpi_adds + dlpi_subs, or 0 */
     int single_fde;             /* did we find a single FDE? (vs. a table) */
     unw_dyn_info_t di;          /* table info (if single_fde is false) */
     unw_dyn_info_t di_debug;    /* additional table info for .debug_frame */
@@ -387,11 +575,13 @@ struct dwarf_callback_data
 #define dwarf_put_unwind_info           UNW_OBJ (dwarf_put_unwind_info)
 #define dwarf_put_unwind_info           UNW_OBJ (dwarf_put_unwind_info)
 #define dwarf_eval_expr                 UNW_OBJ (dwarf_eval_expr)
+#define dwarf_eval_rule_expr            UNW_OBJ (dwarf_eval_rule_expr)
 #define dwarf_extract_proc_info_from_fde \
                 UNW_OBJ (dwarf_extract_proc_info_from_fde)
 #define dwarf_find_save_locs            UNW_OBJ (dwarf_find_save_locs)
 #define dwarf_create_state_record       UNW_OBJ (dwarf_create_state_record)
 #define dwarf_make_proc_info            UNW_OBJ (dwarf_make_proc_info)
+#define dwarf_reg_states_iterate        UNW_OBJ (dwarf_reg_states_iterate)
 #define dwarf_read_encoded_pointer      UNW_OBJ (dwarf_read_encoded_pointer)
 #define dwarf_step                      UNW_OBJ (dwarf_step)
 
@@ -419,6 +609,8 @@ extern void dwarf_put_unwind_info (unw_addr_space_t as,
 extern int dwarf_eval_expr (struct dwarf_cursor *c, unw_word_t *addr,
                             unw_word_t len, unw_word_t *valp,
                             int *is_register);
+extern int dwarf_eval_rule_expr (struct dwarf_cursor *c, unw_word_t addr,
+                                 unw_word_t *valp, int *is_register);
 extern int dwarf_extract_proc_info_from_fde (unw_addr_space_t as,
                                              unw_accessors_t *a,
                                              unw_word_t *fde_addr,
@@ -431,6 +623,9 @@ extern int dwarf_find_save_locs (struct dwarf_cursor *c);
 extern int dwarf_create_state_record (struct dwarf_cursor *c,
                                       dwarf_state_record_t *sr);
 extern int dwarf_make_proc_info (struct dwarf_cursor *c);
+extern int dwarf_reg_states_iterate (struct dwarf_cursor *c,
+                                     dwarf_reg_states_callback_t cb,
+                                     void *token);
 extern int dwarf_read_encoded_pointer (unw_addr_space_t as,
                                        unw_accessors_t *a,
                                        unw_word_t *addr,
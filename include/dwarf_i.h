@@ -23,6 +23,9 @@ extern const uint8_t dwarf_to_unw_regnum_map[DWARF_REGNUM_MAP_LENGTH];
   (((reg) < DWARF_REGNUM_MAP_LENGTH) ? dwarf_to_unw_regnum_map[reg] : 0)
 #endif
 
+/* How much of a CIE or FDE of unknown size to read at once.  */
+#define DWARF_WINDOW_SIZE       512
+
 #ifdef UNW_LOCAL_ONLY
 
 /* In the local-only case, we can let the compiler directly access
@@ -42,7 +45,7 @@ typedef union __attribute__ ((packed))
   }
 dwarf_misaligned_value_t;
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_reads8 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
               int8_t *val, void *arg)
 {
@@ -53,7 +56,7 @@ dwarf_reads8 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_reads16 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                int16_t *val, void *arg)
 {
@@ -64,7 +67,7 @@ dwarf_reads16 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_reads32 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                int32_t *val, void *arg)
 {
@@ -75,7 +78,7 @@ dwarf_reads32 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_reads64 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                int64_t *val, void *arg)
 {
@@ -86,7 +89,7 @@ dwarf_reads64 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_readu8 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
               uint8_t *val, void *arg)
 {
@@ -97,7 +100,7 @@ dwarf_readu8 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_readu16 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                uint16_t *val, void *arg)
 {
@@ -108,7 +111,7 @@ dwarf_readu16 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_readu32 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                uint32_t *val, void *arg)
 {
@@ -119,7 +122,7 @@ dwarf_readu32 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
-static inline int
+static ALWAYS_INLINE int
 dwarf_readu64 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
                uint64_t *val, void *arg)
 {
@@ -130,6 +133,19 @@ dwarf_readu64 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
+/* Memory is read directly: windows (see below) have nothing to do.  */
+struct dwarf_window
+  {
+    char unused;
+  };
+
+static inline void
+dwarf_window_open (unw_addr_space_t as, struct dwarf_window *w,
+                   unw_accessors_t **a, void **arg,
+                   unw_word_t start, unw_word_t end)
+{
+}
+
 #else /* !UNW_LOCAL_ONLY */
 
 static inline int
@@ -257,6 +273,87 @@ dwarf_reads64 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
+/* A window on remote memory, read at once with access_mem_range(), from
+   which the readers above parse a CIE, an FDE or a CFI program instead of
+   making an access_mem() call per byte.  dwarf_window_open() points A and
+   ARG at the window, which passes the reads outside of it on to the
+   accessors it stands in for.  Nothing changes if the range cannot be
+   read, so callers need not check.  */
+
+#define DWARF_WINDOW_PAGE       4096    /* a retry does not cross it */
+
+struct dwarf_window
+  {
+    unw_accessors_t acc;        /* what the readers are given */
+    unw_accessors_t *a;         /* the accessors behind the window */
+    void *arg;
+    unw_word_t start, end;      /* word-aligned */
+    unw_word_t words[DWARF_WINDOW_SIZE / sizeof (unw_word_t)];
+  };
+
+static inline int
+dwarf_window_access_mem (unw_addr_space_t as, unw_word_t addr,
+                         unw_word_t *val, int write, void *arg)
+{
+  struct dwarf_window *w = arg;
+
+  if (!write && addr >= w->start && addr + sizeof (*val) <= w->end)
+    {
+      *val = w->words[(addr - w->start) / sizeof (*val)];
+      return 0;
+    }
+  return (*w->a->access_mem) (as, addr, val, write, w->arg);
+}
+
+/* For a window opened while another one is.  */
+static inline int
+dwarf_window_access_mem_range (unw_addr_space_t as, unw_word_t addr,
+                               void *buf, size_t len, void *arg)
+{
+  struct dwarf_window *w = arg;
+
+  return (*w->a->access_mem_range) (as, addr, buf, len, w->arg);
+}
+
+/* Open a window on as much of [START, END) as it holds.  */
+static inline void
+dwarf_window_open (unw_addr_space_t as, struct dwarf_window *w,
+                   unw_accessors_t **a, void **arg,
+                   unw_word_t start, unw_word_t end)
+{
+  unw_word_t lo = start & -sizeof (unw_word_t);
+  unw_word_t hi = (end + sizeof (unw_word_t) - 1) & -sizeof (unw_word_t);
+  unw_word_t page_end = (lo | (DWARF_WINDOW_PAGE - 1)) + 1;
+
+  /* The words have to be what access_mem() returns, i.e. host-endian.  */
+  if (!(*a)->access_mem_range || as == unw_local_addr_space
+      || tdep_big_endian (as) != (__BYTE_ORDER == __BIG_ENDIAN)
+      || end <= start)
+    return;
+
+  if (hi - lo > sizeof (w->words))
+    hi = lo + sizeof (w->words);
+  if ((*(*a)->access_mem_range) (as, lo, w->words, hi - lo, *arg) < 0)
+    {
+      /* The end of the range may be past the end of the mapping.  */
+      if (hi <= page_end
+          || (*(*a)->access_mem_range) (as, lo, w->words, page_end - lo,
+                                        *arg) < 0)
+        return;
+      hi = page_end;
+    }
+
+  w->acc = **a;
+  w->acc.access_mem = dwarf_window_access_mem;
+  w->acc.access_mem_range = dwarf_window_access_mem_range;
+  w->a = *a;
+  w->arg = *arg;
+  w->start = lo;
+  w->end = hi;
+  *a = &w->acc;
+  *arg = w;
+}
+
 #endif /* !UNW_LOCAL_ONLY */
 
 static inline int
@@ -288,6 +385,35 @@ dwarf_readw (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
     }
 }
 
+#ifdef UNW_LOCAL_ONLY
+
+/* Read an unsigned or signed "little-endian base 128" value.  See
+   Chapter 7.6 of DWARF spec v3.  */
+
+static ALWAYS_INLINE int
+dwarf_read_uleb128 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
+                    unw_word_t *valp, void *arg)
+{
+  const unsigned char *bp = (const unsigned char *) (uintptr_t) *addr;
+
+  *valp = unwi_decode_leb128 (&bp, 0);
+  *addr = (uintptr_t) bp;
+  return 0;
+}
+
+static ALWAYS_INLINE int
+dwarf_read_sleb128 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
+                    unw_word_t *valp, void *arg)
+{
+  const unsigned char *bp = (const unsigned char *) (uintptr_t) *addr;
+
+  *valp = unwi_decode_leb128 (&bp, 1);
+  *addr = (uintptr_t) bp;
+  return 0;
+}
+
+#else /* !UNW_LOCAL_ONLY */
+
 /* Read an unsigned "little-endian base 128" value.  See Chapter 7.6
    of DWARF spec v3.  */
 
@@ -342,6 +468,8 @@ dwarf_read_sleb128 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   return 0;
 }
 
+#endif /* !UNW_LOCAL_ONLY */
+
 static ALWAYS_INLINE int
 dwarf_read_encoded_pointer_inlined (unw_addr_space_t as, unw_accessors_t *a,
                                     unw_word_t *addr, unsigned char encoding,
@@ -56,6 +56,8 @@ extern int _UCD_get_dyn_info_list_addr (unw_addr_space_t, unw_word_t *,
                                         void *);
 extern int _UCD_access_mem (unw_addr_space_t, unw_word_t, unw_word_t *, int,
                             void *);
+extern int _UCD_access_mem_range (unw_addr_space_t, unw_word_t, void *, size_t,
+                                  void *);
 extern int _UCD_access_reg (unw_addr_space_t, unw_regnum_t, unw_word_t *,
                             int, void *);
 extern int _UCD_access_fpreg (unw_addr_space_t, unw_regnum_t, unw_fpreg_t *,
@@ -63,6 +65,7 @@ extern int _UCD_access_fpreg (unw_addr_space_t, unw_regnum_t, unw_fpreg_t *,
 extern int _UCD_get_proc_name (unw_addr_space_t, unw_word_t, char *, size_t,
                                unw_word_t *, void *);
 extern int _UCD_resume (unw_addr_space_t, unw_cursor_t *, void *);
+extern void _UCD_get_mmap (unw_mmap_entry_t **, size_t *, void *);
 extern unw_accessors_t _UCD_accessors;
 
 
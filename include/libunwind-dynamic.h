@@ -151,11 +151,22 @@ typedef struct unw_dyn_info
   }
 unw_dyn_info_t;
 
+/* Version 1 of the list adds the cancellation log.  */
+#define UNW_DYN_INFO_LIST_VERSION       1
+#define UNW_DYN_CANCEL_LOG_SIZE         32
+
 typedef struct unw_dyn_info_list
   {
     uint32_t version;
     uint32_t generation;
     unw_dyn_info_t *first;
+    /* The number of entries ever cancelled and the most recently
+       cancelled ones, indexed by that number modulo
+       UNW_DYN_CANCEL_LOG_SIZE.  With these, a remote unwinder can bring
+       its copy of the list up to date by reading only the new entries
+       at the head of the list.  */
+    unw_word_t cancel_count;
+    unw_dyn_info_t *cancelled[UNW_DYN_CANCEL_LOG_SIZE];
   }
 unw_dyn_info_list_t;
 
@@ -46,6 +46,8 @@ extern int _UPT_get_dyn_info_list_addr (unw_addr_space_t, unw_word_t *,
                                         void *);
 extern int _UPT_access_mem (unw_addr_space_t, unw_word_t, unw_word_t *, int,
                             void *);
+extern int _UPT_access_mem_range (unw_addr_space_t, unw_word_t, void *, size_t,
+                                  void *);
 extern int _UPT_access_reg (unw_addr_space_t, unw_regnum_t, unw_word_t *,
                             int, void *);
 extern int _UPT_access_fpreg (unw_addr_space_t, unw_regnum_t, unw_fpreg_t *,
@@ -53,6 +55,7 @@ extern int _UPT_access_fpreg (unw_addr_space_t, unw_regnum_t, unw_fpreg_t *,
 extern int _UPT_get_proc_name (unw_addr_space_t, unw_word_t, char *, size_t,
                                unw_word_t *, void *);
 extern int _UPT_resume (unw_addr_space_t, unw_cursor_t *, void *);
+extern void _UPT_begin_unwind (unw_addr_space_t, void *);
 extern int _UPT_get_pid (void *);
 extern unw_accessors_t _UPT_accessors;
 
@@ -107,6 +107,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #pragma weak pthread_mutex_init
 #pragma weak pthread_mutex_lock
 #pragma weak pthread_mutex_unlock
+#pragma weak pthread_mutex_trylock
 
 #define mutex_init(l)                                                   \
         (pthread_mutex_init != NULL ? pthread_mutex_init ((l), NULL) : 0)
@@ -114,6 +115,8 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
         (pthread_mutex_lock != NULL ? pthread_mutex_lock (l) : 0)
 #define mutex_unlock(l)                                                 \
         (pthread_mutex_unlock != NULL ? pthread_mutex_unlock (l) : 0)
+#define mutex_trylock(l)                                                \
+        (pthread_mutex_trylock != NULL ? pthread_mutex_trylock (l) : 0)
 
 #ifdef HAVE_ATOMIC_OPS_H
 # include <atomic_ops.h>
@@ -227,6 +230,8 @@ do {                                                                        \
 #define unwi_dyn_remote_find_proc_info  UNWI_OBJ(dyn_remote_find_proc_info)
 #define unwi_dyn_remote_put_unwind_info UNWI_OBJ(dyn_remote_put_unwind_info)
 #define unwi_dyn_validate_cache         UNWI_OBJ(dyn_validate_cache)
+#define unwi_dyn_index_insert           UNWI_OBJ(dyn_index_insert)
+#define unwi_dyn_index_remove           UNWI_OBJ(dyn_index_remove)
 
 extern int unwi_find_dynamic_proc_info (unw_addr_space_t as,
                                         unw_word_t ip,
@@ -254,6 +259,37 @@ extern void unwi_dyn_remote_put_unwind_info (unw_addr_space_t as,
                                              void *arg);
 extern int unwi_dyn_validate_cache (unw_addr_space_t as, void *arg);
 
+/* A copy of the start and end addresses of a remote process' dynamic
+   unwind-info list, sorted by start address.  It is brought up to date
+   incrementally when the generation number of the list changes.  */
+
+struct unw_dyn_remote_index
+  {
+    unw_word_t list_addr;       /* remote address of the list */
+    uint32_t version;           /* version and generation of the list */
+    uint32_t generation;        /*   at the time of the last update */
+    unw_word_t cancel_count;    /* cancel_count at the last update */
+    unw_word_t next_seq;
+    size_t size;
+    size_t alloc;
+    struct unw_dyn_remote_entry
+      {
+        unw_word_t start_ip;
+        unw_word_t end_ip;
+        unw_word_t max_end;     /* largest end_ip up to this entry */
+        unw_word_t addr;        /* remote address of the unw_dyn_info_t */
+        unw_word_t seq;         /* on overlap, the largest seq wins */
+      }
+    *entries;
+  };
+
+/* These maintain the index of _U_dyn_info_list looked up by
+   _U_dyn_info_list_lookup().  They must be called with
+   _U_dyn_info_list_lock held.  */
+
+extern void unwi_dyn_index_insert (unw_dyn_info_t *di);
+extern void unwi_dyn_index_remove (unw_dyn_info_t *di);
+
 extern unw_dyn_info_list_t _U_dyn_info_list;
 extern pthread_mutex_t _U_dyn_info_list_lock;
 
@@ -289,6 +325,76 @@ print_error (const char *string)
 
 extern void mi_init (void);     /* machine-independent initializations */
 extern unw_word_t _U_dyn_info_list_addr (void);
+extern unw_dyn_info_t *_U_dyn_info_list_lookup (unw_word_t ip);
+
+/* Decode the "little-endian base 128" number at *BPP in local memory,
+   and move *BPP past it.  Most numbers in unwind info fit in a byte.
+   Longer ones of up to 8 bytes are read as one word, when that cannot
+   cross into the next page: the first byte without bit 7 set ends the
+   number, and its 7-bit groups are packed in three steps rather than
+   one byte at a time.  */
+static ALWAYS_INLINE unw_word_t
+unwi_decode_leb128 (const unsigned char **bpp, int is_signed)
+{
+  const unsigned char *bp = *bpp;
+  unw_word_t val = 0, shift = 0;
+  unsigned char byte;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  uint64_t word, stop;
+  unsigned int nbits;
+#endif
+
+  if (likely (!(bp[0] & 0x80)))
+    {
+      *bpp = bp + 1;
+      val = bp[0];
+      if (is_signed && (val & 0x40))
+        val -= 0x80;
+      return val;
+    }
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  /* 4096 divides the page size on every target.  */
+  if (((uintptr_t) bp & 4095) <= 4096 - sizeof (word))
+    {
+      memcpy (&word, bp, sizeof (word));
+      stop = ~word & 0x8080808080808080ULL;
+      if (likely (stop != 0))
+        {
+          nbits = __builtin_ctzll (stop) + 1;
+          *bpp = bp + nbits / 8;
+          word &= ~(uint64_t) 0 >> (64 - nbits);
+          word = ((word & 0x007f007f007f007fULL)
+                  | ((word & 0x7f007f007f007f00ULL) >> 1));
+          word = ((word & 0x00003fff00003fffULL)
+                  | ((word & 0x3fff00003fff0000ULL) >> 2));
+          word = ((word & 0x000000000fffffffULL)
+                  | ((word & 0x0fffffff00000000ULL) >> 4));
+          nbits = nbits / 8 * 7;
+          if (is_signed && ((word >> (nbits - 1)) & 1))
+            /* sign-extend negative value */
+            word |= ~(uint64_t) 0 << nbits;
+          return word;
+        }
+    }
+#endif
+
+  do
+    {
+      byte = *bp++;
+      if (shift < 8 * sizeof (unw_word_t))
+        val |= ((unw_word_t) byte & 0x7f) << shift;
+      shift += 7;
+    }
+  while (byte & 0x80);
+
+  if (is_signed && shift < 8 * sizeof (unw_word_t) && (byte & 0x40) != 0)
+    /* sign-extend negative value */
+    val |= ((unw_word_t) -1) << shift;
+
+  *bpp = bp;
+  return val;
+}
 
 /* This is needed/used by ELF targets only.  */
 
@@ -296,6 +402,9 @@ struct elf_image
   {
     void *image;                /* pointer to mmap'd image */
     size_t size;                /* (file-) size of the image */
+    dev_t dev;                  /* identity of the file the image */
+    ino_t ino;                  /* was mapped from, or an ino of 0 */
+    time_t mtime;               /* if it was not mapped from a file */
   };
 
 struct elf_dyn_info
@@ -57,7 +57,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #define mempool_free(p,o)       UNWI_ARCH_OBJ(_mempool_free)(p,o)
 
 /* The mempool structure should be treated as an opaque object.  It's
-   declared here only to enable static allocation of mempools.  */
+   declared here only to enable static allocation of mempools.
+
+   Each thread keeps a small magazine of objects per pool in front of
+   the shared free-list, refilled and drained in batches, so that most
+   allocations take neither the lock nor a signal-mask system call.  */
 struct mempool
   {
     pthread_mutex_t lock;
@@ -65,6 +69,7 @@ struct mempool
     size_t chunk_size;          /* allocation granularity */
     unsigned int reserve;       /* minimum (desired) size of the free-list */
     unsigned int num_free;      /* number of objects on the free-list */
+    int magazine;               /* slot of the per-thread magazines, or -1 */
     struct object
       {
         struct object *next;
@@ -0,0 +1,94 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#ifndef retire_h
+#define retire_h
+
+/* Deferred release of objects that readers use without a lock.
+
+   Readers bracket their use of the objects published through a
+   retire list with retire_read_begin() and retire_read_end().  A
+   writer that unpublishes an object hands it to retire_object()
+   instead of releasing it: the object is released by the first
+   thread, reader or writer, that sees no reader left once it was
+   retired, as none can still hold it then.  As that may be a reader
+   in a signal handler, the release callback must be async-signal-safe
+   unless the readers of the list never run in one.
+
+   The state of a list is a single word, so that a reader counts
+   itself in or out with one atomic operation: the number of readers
+   in its low half, and the number of objects retired so far in its
+   high half, which orders retirements against the times the reader
+   count drops to zero.
+
+   This is included by dwarf.h, for the address space, and so from
+   libunwind_i.h.  */
+
+#include <stdint.h>
+
+#include <libunwind.h>
+
+#ifndef UNWI_ARCH_OBJ   /* dwarf.h may come before libunwind_i.h */
+# define UNWI_ARCH_OBJ(fn) UNW_PASTE(UNW_PASTE(UNW_PASTE(_UI,UNW_TARGET),_), fn)
+#endif
+
+#define retire_object(l,o,f)    UNWI_ARCH_OBJ(_retire_object)(l,o,f)
+#define retire_release(l,s)     UNWI_ARCH_OBJ(_retire_release)(l,s)
+
+struct unw_retired
+  {
+    struct unw_retired *next;
+    uint32_t seq;               /* retirements when it was retired */
+    void (*release) (struct unw_retired *);
+  };
+
+struct unw_retire_list
+  {
+    volatile uint64_t state;    /* readers, and retirements << 32 */
+    struct unw_retired *volatile retired;
+  };
+
+/* Hand OBJ, no longer reachable by new readers of LIST, to RELEASE
+   once no reader can hold it.  */
+extern void retire_object (struct unw_retire_list *list,
+                           struct unw_retired *obj,
+                           void (*release) (struct unw_retired *));
+
+/* Release the objects of LIST retired before the reader count was last
+   seen at zero, when SEQ objects had been retired.  */
+extern void retire_release (struct unw_retire_list *list, uint32_t seq);
+
+static inline void
+retire_read_begin (struct unw_retire_list *list)
+{
+  __sync_fetch_and_add (&list->state, 1);
+}
+
+static inline void
+retire_read_end (struct unw_retire_list *list)
+{
+  uint64_t state = __sync_sub_and_fetch (&list->state, 1);
+
+  if ((uint32_t) state == 0 && list->retired)
+    retire_release (list, state >> 32);
+}
+
+#endif /* retire_h */
@@ -104,6 +104,7 @@ struct unw_addr_space
 #endif
     unw_word_t dyn_generation;
     unw_word_t dyn_info_list_addr;      /* (cached) dyn_info_list_addr */
+    struct unw_dyn_remote_index *dyn_index; /* see Gdyn-remote.c */
 #ifndef UNW_REMOTE_ONLY
     unsigned long long shared_object_removals;
 #endif
@@ -233,6 +234,7 @@ struct ia64_global_unwind_state
 #define tdep_reuse_frame(c,rs)          do {} while(0)
 #define tdep_stash_frame(c,rs)          do {} while(0)
 #define tdep_trace(cur,addr,n)          (-UNW_ENOINFO)
+#define tdep_trace_remote(cur,addr,n)   (*(n) = 0, -UNW_ENOINFO)
 #define tdep_get_as(c)                  ((c)->as)
 #define tdep_get_as_arg(c)              ((c)->as_arg)
 #define tdep_get_ip(c)                  ((c)->ip)
@@ -61,8 +61,13 @@ struct unw_addr_space
 #endif
   unw_word_t dyn_generation;    /* see dyn-common.h */
   unw_word_t dyn_info_list_addr;        /* (cached) dyn_info_list_addr */
+  struct unw_dyn_remote_index *dyn_index; /* see Gdyn-remote.c */
   struct dwarf_rs_cache global_cache;
   struct unw_debug_frame_list *debug_frames;
+  struct unw_remote_table *remote_tables; /* see Gfind_proc_info-lsb.c */
+  struct unw_retire_list table_retire; /* ditto */
+  struct unw_cie_cache *cie_cache; /* see Gfde.c */
+  struct unw_expr_cache *expr_cache; /* see Gexpr.c */
   int validate;
 };
 
@@ -322,6 +327,7 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #define tdep_reuse_frame(c,rs)          do {} while(0)
 #define tdep_stash_frame(c,rs)          do {} while(0)
 #define tdep_trace(cur,addr,n)          (-UNW_ENOINFO)
+#define tdep_trace_remote(cur,addr,n)   (*(n) = 0, -UNW_ENOINFO)
 #define tdep_get_func_addr              UNW_OBJ(get_func_addr)
 
 #ifdef UNW_LOCAL_ONLY
@@ -70,8 +70,15 @@ struct unw_addr_space
 #endif
     unw_word_t dyn_generation;          /* see dyn-common.h */
     unw_word_t dyn_info_list_addr;      /* (cached) dyn_info_list_addr */
+    struct unw_dyn_remote_index *dyn_index; /* see Gdyn-remote.c */
     struct dwarf_rs_cache global_cache;
     struct unw_debug_frame_list *debug_frames;
+    struct unw_remote_table *remote_tables; /* see Gfind_proc_info-lsb.c */
+    struct unw_retire_list table_retire; /* ditto */
+    struct unw_cie_cache *cie_cache; /* see Gfde.c */
+    struct unw_expr_cache *expr_cache; /* see Gexpr.c */
+    struct memory_map *eh_elf_map;      /* eh_elf memory map, if any */
+    struct unw_trace_cache *trace_cache; /* see Gtrace.c */
    };
 
 struct cursor
@@ -209,7 +216,12 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #endif
 #define tdep_stash_frame                UNW_OBJ(stash_frame)
 #define tdep_trace                      UNW_OBJ(tdep_trace)
+#define tdep_trace_remote               UNW_OBJ(tdep_trace_remote)
+#define x86_64_shared_trace_cache       UNW_OBJ(shared_trace_cache)
 #define x86_64_r_uc_addr                UNW_OBJ(r_uc_addr)
+#define x86_64_trace_cache_free         UNW_OBJ(trace_cache_free)
+#define tdep_destroy_addr_space(as)                                     \
+        do { eh_elf_clear (as); x86_64_trace_cache_free (as); } while (0)
 
 #ifdef UNW_LOCAL_ONLY
 # define tdep_find_proc_info(c,ip,n)                            \
@@ -231,6 +243,7 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #define tdep_big_endian(as)             0
 
 extern int tdep_init_done;
+extern int x86_64_shared_trace_cache;
 
 extern void tdep_init (void);
 extern void tdep_init_mem_validate (void);
@@ -249,14 +262,18 @@ extern int tdep_access_fpreg (struct cursor *c, unw_regnum_t reg,
 extern void tdep_fetch_frame (struct dwarf_cursor *c, unw_word_t ip,
                               int need_unwind_info);
 extern void tdep_cache_frame (struct dwarf_cursor *c,
-                              struct dwarf_reg_state *rs);
+                              struct dwarf_compact_rs *rs);
 extern void tdep_reuse_frame (struct dwarf_cursor *c,
-                              struct dwarf_reg_state *rs);
+                              struct dwarf_compact_rs *rs);
 extern void tdep_stash_frame (struct dwarf_cursor *c,
                               struct dwarf_reg_state *rs);
 #endif
 
 extern int tdep_getcontext_trace (unw_tdep_context_t *);
 extern int tdep_trace (unw_cursor_t *cursor, void **addresses, int *n);
+extern int tdep_trace_remote (unw_cursor_t *cursor, void **addresses,
+                              int *n);
+extern void x86_64_trace_cache_free (unw_addr_space_t as);
+extern void eh_elf_clear (unw_addr_space_t as);
 
 #endif /* X86_64_LIBUNWIND_I_H */
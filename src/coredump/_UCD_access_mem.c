@@ -24,19 +24,15 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include "_UCD_lib.h"
 #include "_UCD_internal.h"
 
+/* Read [ADDR, ADDR + LEN), which has to lie in a single segment, from
+   the core file or from the file backing the segment.  */
 int
-_UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
-                 int write, void *arg)
+_UCD_access_mem_range(unw_addr_space_t as, unw_word_t addr, void *buf,
+                      size_t len, void *arg)
 {
-  if (write)
-    {
-      Debug(0, "write is not supported\n");
-      return -UNW_EINVAL;
-    }
-
   struct UCD_info *ui = arg;
 
-  unw_word_t addr_last = addr + sizeof(*val)-1;
+  unw_word_t addr_last = addr + len - 1;
   coredump_phdr_t *phdr;
   unsigned i;
   for (i = 0; i < ui->phdrs_count; i++)
@@ -59,6 +55,7 @@ _UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
     {
       /* This part of mapped address space is not present in coredump file */
       /* Do we have it in the backup file? */
+      _UCD_open_mapped_file(ui, i);
       if (phdr->backing_fd < 0)
         {
           Debug(1, "access to not-present data in phdr[%d]: addr:0x%llx\n",
@@ -67,7 +64,7 @@ _UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
           return -UNW_EINVAL;
         }
       filename = phdr->backing_filename;
-      fileofs = addr - phdr->p_vaddr;
+      fileofs = phdr->backing_offset + (addr - phdr->p_vaddr);
       fd = phdr->backing_fd;
       goto read;
     }
@@ -76,13 +73,10 @@ _UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
   fileofs = phdr->p_offset + (addr - phdr->p_vaddr);
   fd = ui->coredump_fd;
  read:
-  if (lseek(fd, fileofs, SEEK_SET) != fileofs)
-    goto read_error;
-  if (read(fd, val, sizeof(*val)) != sizeof(*val))
+  if (pread(fd, buf, len, fileofs) != (ssize_t) len)
     goto read_error;
 
-  Debug(1, "0x%llx <- [addr:0x%llx fileofs:0x%llx]\n",
-        (unsigned long long)(*val),
+  Debug(1, "%zu bytes <- [addr:0x%llx fileofs:0x%llx]\n", len,
         (unsigned long long)addr,
         (unsigned long long)fileofs
   );
@@ -96,3 +90,24 @@ _UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
   );
   return -UNW_EINVAL;
 }
+
+int
+_UCD_access_mem(unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
+                 int write, void *arg)
+{
+  int ret;
+
+  if (write)
+    {
+      Debug(0, "write is not supported\n");
+      return -UNW_EINVAL;
+    }
+
+  ret = _UCD_access_mem_range(as, addr, val, sizeof(*val), arg);
+  if (ret == 0)
+    Debug(1, "0x%llx <- [addr:0x%llx]\n",
+          (unsigned long long)(*val),
+          (unsigned long long)addr
+    );
+  return ret;
+}
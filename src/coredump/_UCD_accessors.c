@@ -32,5 +32,12 @@ PROTECTED unw_accessors_t _UCD_accessors =
     .access_reg                 = _UCD_access_reg,
     .access_fpreg               = _UCD_access_fpreg,
     .resume                     = _UCD_resume,
-    .get_proc_name              = _UCD_get_proc_name
+    .get_proc_name              = _UCD_get_proc_name,
+    .eh_elf_init                = {
+        .init_mode              = UNW_EH_ELF_INIT_MMAP,
+        .init_data              = {
+            .get_mmap           = _UCD_get_mmap
+        }
+    },
+    .access_mem_range           = _UCD_access_mem_range
   };
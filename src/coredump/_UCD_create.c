@@ -125,6 +125,7 @@ _UCD_create(const char *filename)
     }
 
   _64bits = (elf_header32.e_ident[EI_CLASS] == ELFCLASS64);
+  ui->_64bits = _64bits;
   if (_64bits && sizeof(elf_header64.e_entry) > sizeof(off_t))
     {
       Debug(0, "Can't process '%s': 64-bit file "
@@ -245,6 +246,13 @@ _UCD_create(const char *filename)
               {
                 if (note_hdr->n_type == NT_PRSTATUS)
                   ui->threads[n_threads++] = NOTE_DATA (note_hdr);
+#ifdef NT_FILE
+                if (note_hdr->n_type == NT_FILE)
+                  {
+                    ui->file_note = NOTE_DATA (note_hdr);
+                    ui->file_note_size = note_hdr->n_descsz;
+                  }
+#endif
 
                 note_hdr = NOTE_NEXT (note_hdr);
               }
@@ -276,6 +284,8 @@ _UCD_create(const char *filename)
 
     ui->prstatus = ui->threads[0];
 
+    _UCD_set_backing_offsets(ui);
+
   return ui;
 
  err:
@@ -0,0 +1,151 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+
+#include "_UCD_lib.h"
+#include "_UCD_internal.h"
+
+/* Layout of the NT_FILE note descriptor, in words of the core's ELF
+   class: the number of mappings and the page size, then their start,
+   end and page offset, then their NUL-terminated file names, in the same
+   order.  */
+#define FILE_NOTE_HEADER_WORDS  2
+#define FILE_NOTE_ENTRY_WORDS   3
+
+/* Return word POS of the NT_FILE note of UI.  */
+static uint64_t
+file_note_word(struct UCD_info *ui, size_t pos)
+{
+    if(ui->_64bits) {
+        uint64_t word;
+        memcpy(&word, (char *) ui->file_note + pos * sizeof(word), sizeof(word));
+        return word;
+    } else {
+        uint32_t word;
+        memcpy(&word, (char *) ui->file_note + pos * sizeof(word), sizeof(word));
+        return word;
+    }
+}
+
+/* Read the mappings listed in the NT_FILE note into a malloc'd array.
+   Returns -1 if there is no usable such note.  */
+static int
+read_file_note(struct UCD_info *ui, unw_mmap_entry_t **entries, size_t *count)
+{
+    size_t word_size = ui->_64bits ? sizeof(uint64_t) : sizeof(uint32_t);
+    size_t nb_words = ui->file_note_size / word_size;
+    uint64_t nb_files, page_size;
+    size_t pos;
+
+    if(ui->file_note == NULL || nb_words < FILE_NOTE_HEADER_WORDS)
+        return -1;
+
+    nb_files = file_note_word(ui, 0);
+    page_size = file_note_word(ui, 1);
+    if(nb_files > (nb_words - FILE_NOTE_HEADER_WORDS) / FILE_NOTE_ENTRY_WORDS)
+        return -1;
+
+    char *name = (char *) ui->file_note
+        + (FILE_NOTE_HEADER_WORDS + nb_files * FILE_NOTE_ENTRY_WORDS)
+          * word_size;
+    char *note_end = (char *) ui->file_note + ui->file_note_size;
+
+    *entries = malloc(nb_files * sizeof(unw_mmap_entry_t));
+    if(*entries == NULL)
+        return -1;
+    for(pos = 0; pos < nb_files; ++pos) {
+        size_t word = FILE_NOTE_HEADER_WORDS + pos * FILE_NOTE_ENTRY_WORDS;
+        uint64_t start = file_note_word(ui, word);
+        uint64_t end = file_note_word(ui, word + 1);
+        uint64_t pgoff = file_note_word(ui, word + 2);
+        char *name_end = memchr(name, '\0', note_end - name);
+        if(name_end == NULL)
+            break;
+        (*entries)[pos].beg_ip = start;
+        (*entries)[pos].end_ip = end;
+        (*entries)[pos].offset = start - pgoff * page_size;
+        (*entries)[pos].object_name = name;
+        name = name_end + 1;
+    }
+    *count = pos;
+    return 0;
+}
+
+HIDDEN void
+_UCD_set_backing_offsets(struct UCD_info *ui)
+{
+    unw_mmap_entry_t *entries;
+    size_t count, pos;
+    unsigned i;
+
+    if(read_file_note(ui, &entries, &count) < 0)
+        return;
+    for(i = 0; i < ui->phdrs_count; ++i) {
+        coredump_phdr_t *phdr = &ui->phdrs[i];
+        for(pos = 0; pos < count; ++pos) {
+            if(phdr->p_type == PT_LOAD && entries[pos].beg_ip == phdr->p_vaddr) {
+                phdr->backing_offset = phdr->p_vaddr - entries[pos].offset;
+                phdr->mapped_filename = entries[pos].object_name;
+                break;
+            }
+        }
+    }
+    free(entries);
+}
+
+HIDDEN void
+_UCD_open_mapped_file(struct UCD_info *ui, unsigned i)
+{
+    coredump_phdr_t *phdr = &ui->phdrs[i];
+
+    if(phdr->backing_fd >= 0 || phdr->mapped_filename == NULL)
+        return;
+
+    // Try once the file the core says is mapped here
+    Debug(2, "using %s as backing file of phdr[%d]\n",
+            phdr->mapped_filename, i);
+    _UCD_add_backing_file_at_segment(ui, i, phdr->mapped_filename);
+    phdr->mapped_filename = NULL;
+}
+
+PROTECTED void
+_UCD_get_mmap(unw_mmap_entry_t **entries, size_t *count, void *arg)
+{
+    struct UCD_info *ui = arg;
+    size_t pos;
+
+    *entries = NULL;
+    *count = 0;
+
+    if(read_file_note(ui, entries, count) == 0) {
+        Debug(3, "%lu mappings from NT_FILE\n", *count);
+        return;
+    }
+
+    /* No NT_FILE note: fall back to the segments given a backing file.  */
+    *entries = malloc(ui->phdrs_count * sizeof(unw_mmap_entry_t));
+    if(*entries == NULL)
+        return;
+    for(pos = 0; pos < ui->phdrs_count; ++pos) {
+        coredump_phdr_t *phdr = &ui->phdrs[pos];
+        if(phdr->p_type != PT_LOAD || phdr->backing_filename == NULL)
+            continue;
+        (*entries)[*count].beg_ip = phdr->p_vaddr;
+        (*entries)[*count].end_ip = phdr->p_vaddr + phdr->p_memsz;
+        (*entries)[*count].offset = phdr->p_vaddr - phdr->backing_offset;
+        (*entries)[*count].object_name = phdr->backing_filename;
+        ++*count;
+    }
+    Debug(3, "%lu mappings from backing files\n", *count);
+}
@@ -45,6 +45,7 @@ CD_elf_map_image(struct UCD_info *ui, coredump_phdr_t *phdr)
           return NULL;
         }
       ei->size = phdr->p_filesz;
+      ei->ino = 0;
       size_t remainder_len = phdr->p_memsz - phdr->p_filesz;
       if (remainder_len > 0)
         {
@@ -67,6 +68,16 @@ CD_elf_map_image(struct UCD_info *ui, coredump_phdr_t *phdr)
           return NULL;
         }
       ei->size = phdr->backing_filesize;
+
+      struct stat st;
+      if (fstat(phdr->backing_fd, &st) == 0)
+        {
+          ei->dev = st.st_dev;
+          ei->ino = st.st_ino;
+          ei->mtime = st.st_mtime;
+        }
+      else
+        ei->ino = 0;
     }
 
   /* Check ELF header for sanity */
@@ -90,6 +101,8 @@ _UCD_get_elf_image(struct UCD_info *ui, unw_word_t ip)
       coredump_phdr_t *phdr = &ui->phdrs[i];
       if (phdr->p_vaddr <= ip && ip < phdr->p_vaddr + phdr->p_memsz)
         {
+          if (phdr->p_filesz < phdr->p_memsz)
+            _UCD_open_mapped_file(ui, i);
           phdr = CD_elf_map_image(ui, phdr);
           return phdr;
         }
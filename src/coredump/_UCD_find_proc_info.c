@@ -61,10 +61,9 @@ get_unwind_info(struct UCD_info *ui, unw_addr_space_t as, unw_word_t ip)
   /* segbase: where it is mapped in virtual memory */
   /* mapoff: offset in the file */
   segbase = phdr->p_vaddr;
-  /*mapoff  = phdr->p_offset; WRONG! phdr->p_offset is the offset in COREDUMP file */
-  mapoff  = 0;
-///FIXME. text segment is USUALLY, not always, at offset 0 in the binary/.so file.
-// ensure that at initialization.
+  /* phdr->p_offset is the offset in COREDUMP file: this one comes from
+     the NT_FILE note, if any, and is 0 otherwise.  */
+  mapoff  = phdr->backing_offset;
 
   /* Here, SEGBASE is the starting-address of the (mmap'ped) segment
      which covers the IP we're looking for.  */
@@ -68,6 +68,8 @@ struct coredump_phdr
     uoff_t   p_align;
     /* Data for backing file. If backing_fd < 0, there is no file */
     uoff_t   backing_filesize;
+    uoff_t   backing_offset; /* offset of the segment in the file */
+    const char *mapped_filename; /* file mapped here per NT_FILE, or NULL */
     char    *backing_filename; /* for error meesages only */
     int      backing_fd;
   };
@@ -85,6 +87,7 @@ typedef struct coredump_phdr coredump_phdr_t;
 struct UCD_info
   {
     int big_endian;  /* bool */
+    int _64bits;  /* bool: ELFCLASS64 core */
     int coredump_fd;
     char *coredump_filename; /* for error meesages only */
     coredump_phdr_t *phdrs; /* array, allocated */
@@ -93,11 +96,15 @@ struct UCD_info
     struct PRSTATUS_STRUCT *prstatus; /* points inside note_phdr */
     int n_threads;
     struct PRSTATUS_STRUCT **threads;
+    void *file_note; /* NT_FILE descriptor, points inside note_phdr, or NULL */
+    unsigned file_note_size;
 
     struct elf_dyn_info edi;
   };
 
 extern coredump_phdr_t * _UCD_get_elf_image(struct UCD_info *ui, unw_word_t ip);
+extern void _UCD_set_backing_offsets(struct UCD_info *ui);
+extern void _UCD_open_mapped_file(struct UCD_info *ui, unsigned i);
 
 #define STRUCT_MEMBER_P(struct_p, struct_offset) ((void *) ((char*) (struct_p) + (long) (struct_offset)))
 #define STRUCT_MEMBER(member_type, struct_p, struct_offset) (*(member_type*) STRUCT_MEMBER_P ((struct_p), (struct_offset)))
@@ -60,6 +60,8 @@ static const uint8_t operands[256] =
     [DW_OP_const4s] =           OPND1 (VAL32),
     [DW_OP_const8u] =           OPND1 (VAL64),
     [DW_OP_const8s] =           OPND1 (VAL64),
+    [DW_OP_constu] =            OPND1 (ULEB128),
+    [DW_OP_consts] =            OPND1 (SLEB128),
     [DW_OP_pick] =              OPND1 (VAL8),
     [DW_OP_plus_uconst] =       OPND1 (ULEB128),
     [DW_OP_skip] =              OPND1 (VAL16),
@@ -186,463 +188,725 @@ read_operand (unw_addr_space_t as, unw_accessors_t *a,
   return ret;
 }
 
-HIDDEN int
-dwarf_eval_expr (struct dwarf_cursor *c, unw_word_t *addr, unw_word_t len,
-                 unw_word_t *valp, int *is_register)
+/* Read the operation at *ADDR into OP.  Operands are read and sign-
+   extended, and the operations that only differ by their encoding are
+   made one: DW_OP_constu pushes any constant, DW_OP_bregx and DW_OP_regx
+   take their register in OP->arg.  */
+static int
+decode_op (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
+           dwarf_expr_insn_t *op, void *arg)
 {
-  unw_word_t operand1 = 0, operand2 = 0, tmp1, tmp2, tmp3, end_addr;
-  uint8_t opcode, operands_signature, u8;
-  unw_addr_space_t as;
-  unw_accessors_t *a;
-  void *arg;
-  unw_word_t stack[MAX_EXPR_STACK_SIZE];
-  unsigned int tos = 0;
-  uint16_t u16;
-  uint32_t u32;
-  uint64_t u64;
+  unw_word_t operand1 = 0, operand2 = 0;
+  uint8_t opcode, operands_signature;
   int ret;
+
+  if ((ret = dwarf_readu8 (as, a, addr, &opcode, arg)) < 0)
+    return ret;
+
+  operands_signature = operands[opcode];
+
+  if (unlikely (NUM_OPERANDS (operands_signature) > 0))
+    {
+      if ((ret = read_operand (as, a, addr,
+                               OPND1_TYPE (operands_signature),
+                               &operand1, arg)) < 0)
+        return ret;
+      if (NUM_OPERANDS (operands_signature) > 1)
+        if ((ret = read_operand (as, a, addr,
+                                 OPND2_TYPE (operands_signature),
+                                 &operand2, arg)) < 0)
+          return ret;
+    }
+
+  op->op = opcode;
+  op->arg = 0;
+  op->operand = operand1;
+
+  switch ((dwarf_expr_op_t) opcode)
+    {
+    case DW_OP_lit0:  case DW_OP_lit1:  case DW_OP_lit2:
+    case DW_OP_lit3:  case DW_OP_lit4:  case DW_OP_lit5:
+    case DW_OP_lit6:  case DW_OP_lit7:  case DW_OP_lit8:
+    case DW_OP_lit9:  case DW_OP_lit10: case DW_OP_lit11:
+    case DW_OP_lit12: case DW_OP_lit13: case DW_OP_lit14:
+    case DW_OP_lit15: case DW_OP_lit16: case DW_OP_lit17:
+    case DW_OP_lit18: case DW_OP_lit19: case DW_OP_lit20:
+    case DW_OP_lit21: case DW_OP_lit22: case DW_OP_lit23:
+    case DW_OP_lit24: case DW_OP_lit25: case DW_OP_lit26:
+    case DW_OP_lit27: case DW_OP_lit28: case DW_OP_lit29:
+    case DW_OP_lit30: case DW_OP_lit31:
+      op->op = DW_OP_constu;
+      op->operand = opcode - DW_OP_lit0;
+      break;
+
+    case DW_OP_addr:
+    case DW_OP_const1u:
+    case DW_OP_const2u:
+    case DW_OP_const4u:
+    case DW_OP_const8u:
+    case DW_OP_const8s:
+    case DW_OP_consts:
+      op->op = DW_OP_constu;
+      break;
+
+    case DW_OP_const1s:
+      op->op = DW_OP_constu;
+      op->operand = (int8_t) operand1;
+      break;
+
+    case DW_OP_const2s:
+      op->op = DW_OP_constu;
+      op->operand = (int16_t) operand1;
+      break;
+
+    case DW_OP_const4s:
+      op->op = DW_OP_constu;
+      op->operand = (int32_t) operand1;
+      break;
+
+    case DW_OP_breg0:  case DW_OP_breg1:  case DW_OP_breg2:
+    case DW_OP_breg3:  case DW_OP_breg4:  case DW_OP_breg5:
+    case DW_OP_breg6:  case DW_OP_breg7:  case DW_OP_breg8:
+    case DW_OP_breg9:  case DW_OP_breg10: case DW_OP_breg11:
+    case DW_OP_breg12: case DW_OP_breg13: case DW_OP_breg14:
+    case DW_OP_breg15: case DW_OP_breg16: case DW_OP_breg17:
+    case DW_OP_breg18: case DW_OP_breg19: case DW_OP_breg20:
+    case DW_OP_breg21: case DW_OP_breg22: case DW_OP_breg23:
+    case DW_OP_breg24: case DW_OP_breg25: case DW_OP_breg26:
+    case DW_OP_breg27: case DW_OP_breg28: case DW_OP_breg29:
+    case DW_OP_breg30: case DW_OP_breg31:
+      op->op = DW_OP_bregx;
+      op->arg = opcode - DW_OP_breg0;
+      break;
+
+    case DW_OP_reg0:  case DW_OP_reg1:  case DW_OP_reg2:
+    case DW_OP_reg3:  case DW_OP_reg4:  case DW_OP_reg5:
+    case DW_OP_reg6:  case DW_OP_reg7:  case DW_OP_reg8:
+    case DW_OP_reg9:  case DW_OP_reg10: case DW_OP_reg11:
+    case DW_OP_reg12: case DW_OP_reg13: case DW_OP_reg14:
+    case DW_OP_reg15: case DW_OP_reg16: case DW_OP_reg17:
+    case DW_OP_reg18: case DW_OP_reg19: case DW_OP_reg20:
+    case DW_OP_reg21: case DW_OP_reg22: case DW_OP_reg23:
+    case DW_OP_reg24: case DW_OP_reg25: case DW_OP_reg26:
+    case DW_OP_reg27: case DW_OP_reg28: case DW_OP_reg29:
+    case DW_OP_reg30: case DW_OP_reg31:
+      op->op = DW_OP_regx;
+      op->arg = opcode - DW_OP_reg0;
+      break;
+
+    case DW_OP_bregx:
+    case DW_OP_regx:
+      if (operand1 > UINT16_MAX)
+        {
+          Debug (1, "Invalid register number %lu\n", (long) operand1);
+          return -UNW_EBADREG;
+        }
+      op->arg = operand1;
+      op->operand = operand2;
+      break;
+
+    case DW_OP_deref_size:
+    case DW_OP_pick:
+      op->arg = operand1;
+      break;
+
+    case DW_OP_skip:
+    case DW_OP_bra:
+      op->operand = (int16_t) operand1;
+      break;
+
+    default:
+      break;
+    }
+  return 0;
+}
+
+struct expr_stack
+  {
+    unw_word_t val[MAX_EXPR_STACK_SIZE];
+    unsigned int tos;
+  };
+
 # define pop()                                  \
 ({                                              \
-  if ((tos - 1) >= MAX_EXPR_STACK_SIZE)         \
+  if ((st->tos - 1) >= MAX_EXPR_STACK_SIZE)     \
     {                                           \
       Debug (1, "Stack underflow\n");           \
       return -UNW_EINVAL;                       \
     }                                           \
-  stack[--tos];                                 \
+  st->val[--st->tos];                           \
 })
 # define push(x)                                \
 do {                                            \
   unw_word_t _x = (x);                          \
-  if (tos >= MAX_EXPR_STACK_SIZE)               \
+  if (st->tos >= MAX_EXPR_STACK_SIZE)           \
     {                                           \
       Debug (1, "Stack overflow\n");            \
       return -UNW_EINVAL;                       \
     }                                           \
-  stack[tos++] = _x;                            \
+  st->val[st->tos++] = _x;                      \
 } while (0)
 # define pick(n)                                \
 ({                                              \
-  unsigned int _index = tos - 1 - (n);          \
+  unsigned int _index = st->tos - 1 - (n);      \
   if (_index >= MAX_EXPR_STACK_SIZE)            \
     {                                           \
       Debug (1, "Out-of-stack pick\n");         \
       return -UNW_EINVAL;                       \
     }                                           \
-  stack[_index];                                \
+  st->val[_index];                              \
 })
 
-  as = c->as;
-  arg = c->as_arg;
-  a = unw_get_accessors (as);
-  end_addr = *addr + len;
-  *is_register = 0;
+/* What exec_op() tells its caller to do next.  */
+#define EXPR_NEXT       0       /* go on with the next operation */
+#define EXPR_JUMP       1       /* branch to operand */
+#define EXPR_REGISTER   2       /* stop, the result is register *valp */
 
-  Debug (14, "len=%lu, pushing cfa=0x%lx\n",
-         (unsigned long) len, (unsigned long) c->cfa);
-
-  push (c->cfa);        /* push current CFA as required by DWARF spec */
+/* Execute operation OP, as decoded by decode_op(), on stack ST.  */
+static inline int
+exec_op (struct dwarf_cursor *c, const dwarf_expr_insn_t *op,
+         struct expr_stack *st, unw_word_t *valp)
+{
+  unw_word_t operand1 = op->operand, tmp1, tmp2, tmp3;
+  unw_addr_space_t as = c->as;
+  unw_accessors_t *a;
+  void *arg = c->as_arg;
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  uint64_t u64;
+  int ret;
 
-  while (*addr < end_addr)
+  switch ((dwarf_expr_op_t) op->op)
     {
-      if ((ret = dwarf_readu8 (as, a, addr, &opcode, arg)) < 0)
+    case DW_OP_constu:
+      Debug (15, "OP_const(0x%lx)\n", (unsigned long) operand1);
+      push (operand1);
+      break;
+
+    case DW_OP_bregx:
+      Debug (15, "OP_bregx(r%d,0x%lx)\n",
+             (int) op->arg, (unsigned long) operand1);
+      if ((ret = unw_get_reg (dwarf_to_cursor (c),
+                              dwarf_to_unw_regnum (op->arg), &tmp1)) < 0)
         return ret;
+      push (tmp1 + operand1);
+      break;
 
-      operands_signature = operands[opcode];
+    case DW_OP_regx:
+      Debug (15, "OP_regx(r%d)\n", (int) op->arg);
+      *valp = dwarf_to_unw_regnum (op->arg);
+      return EXPR_REGISTER;
 
-      if (unlikely (NUM_OPERANDS (operands_signature) > 0))
-        {
-          if ((ret = read_operand (as, a, addr,
-                                   OPND1_TYPE (operands_signature),
-                                   &operand1, arg)) < 0)
-            return ret;
-          if (NUM_OPERANDS (operands_signature) > 1)
-            if ((ret = read_operand (as, a, addr,
-                                     OPND2_TYPE (operands_signature),
-                                     &operand2, arg)) < 0)
-              return ret;
-        }
+    case DW_OP_deref:
+      Debug (15, "OP_deref\n");
+      a = unw_get_accessors (as);
+      tmp1 = pop ();
+      if ((ret = dwarf_readw (as, a, &tmp1, &tmp2, arg)) < 0)
+        return ret;
+      push (tmp2);
+      break;
 
-      switch ((dwarf_expr_op_t) opcode)
+    case DW_OP_deref_size:
+      Debug (15, "OP_deref_size(%d)\n", (int) op->arg);
+      a = unw_get_accessors (as);
+      tmp1 = pop ();
+      switch (op->arg)
         {
-        case DW_OP_lit0:  case DW_OP_lit1:  case DW_OP_lit2:
-        case DW_OP_lit3:  case DW_OP_lit4:  case DW_OP_lit5:
-        case DW_OP_lit6:  case DW_OP_lit7:  case DW_OP_lit8:
-        case DW_OP_lit9:  case DW_OP_lit10: case DW_OP_lit11:
-        case DW_OP_lit12: case DW_OP_lit13: case DW_OP_lit14:
-        case DW_OP_lit15: case DW_OP_lit16: case DW_OP_lit17:
-        case DW_OP_lit18: case DW_OP_lit19: case DW_OP_lit20:
-        case DW_OP_lit21: case DW_OP_lit22: case DW_OP_lit23:
-        case DW_OP_lit24: case DW_OP_lit25: case DW_OP_lit26:
-        case DW_OP_lit27: case DW_OP_lit28: case DW_OP_lit29:
-        case DW_OP_lit30: case DW_OP_lit31:
-          Debug (15, "OP_lit(%d)\n", (int) opcode - DW_OP_lit0);
-          push (opcode - DW_OP_lit0);
+        default:
+          Debug (1, "Unexpected DW_OP_deref_size size %d\n", (int) op->arg);
+          return -UNW_EINVAL;
+
+        case 1:
+          if ((ret = dwarf_readu8 (as, a, &tmp1, &u8, arg)) < 0)
+            return ret;
+          tmp2 = u8;
           break;
 
-        case DW_OP_breg0:  case DW_OP_breg1:  case DW_OP_breg2:
-        case DW_OP_breg3:  case DW_OP_breg4:  case DW_OP_breg5:
-        case DW_OP_breg6:  case DW_OP_breg7:  case DW_OP_breg8:
-        case DW_OP_breg9:  case DW_OP_breg10: case DW_OP_breg11:
-        case DW_OP_breg12: case DW_OP_breg13: case DW_OP_breg14:
-        case DW_OP_breg15: case DW_OP_breg16: case DW_OP_breg17:
-        case DW_OP_breg18: case DW_OP_breg19: case DW_OP_breg20:
-        case DW_OP_breg21: case DW_OP_breg22: case DW_OP_breg23:
-        case DW_OP_breg24: case DW_OP_breg25: case DW_OP_breg26:
-        case DW_OP_breg27: case DW_OP_breg28: case DW_OP_breg29:
-        case DW_OP_breg30: case DW_OP_breg31:
-          Debug (15, "OP_breg(r%d,0x%lx)\n",
-                 (int) opcode - DW_OP_breg0, (unsigned long) operand1);
-          if ((ret = unw_get_reg (dwarf_to_cursor (c),
-                                  dwarf_to_unw_regnum (opcode - DW_OP_breg0),
-                                  &tmp1)) < 0)
+        case 2:
+          if ((ret = dwarf_readu16 (as, a, &tmp1, &u16, arg)) < 0)
             return ret;
-          push (tmp1 + operand1);
+          tmp2 = u16;
           break;
 
-        case DW_OP_bregx:
-          Debug (15, "OP_bregx(r%d,0x%lx)\n",
-                 (int) operand1, (unsigned long) operand2);
-          if ((ret = unw_get_reg (dwarf_to_cursor (c),
-                                  dwarf_to_unw_regnum (operand1), &tmp1)) < 0)
+        case 3:
+        case 4:
+          if ((ret = dwarf_readu32 (as, a, &tmp1, &u32, arg)) < 0)
+            return ret;
+          tmp2 = u32;
+          if (op->arg == 3)
+            {
+              if (dwarf_is_big_endian (as))
+                tmp2 >>= 8;
+              else
+                tmp2 &= 0xffffff;
+            }
+          break;
+        case 5:
+        case 6:
+        case 7:
+        case 8:
+          if ((ret = dwarf_readu64 (as, a, &tmp1, &u64, arg)) < 0)
             return ret;
-          push (tmp1 + operand2);
+          tmp2 = u64;
+          if (op->arg != 8)
+            {
+              if (dwarf_is_big_endian (as))
+                tmp2 >>= 64 - 8 * op->arg;
+              else
+                tmp2 &= (~ (unw_word_t) 0) << (8 * op->arg);
+            }
           break;
+        }
+      push (tmp2);
+      break;
 
-        case DW_OP_reg0:  case DW_OP_reg1:  case DW_OP_reg2:
-        case DW_OP_reg3:  case DW_OP_reg4:  case DW_OP_reg5:
-        case DW_OP_reg6:  case DW_OP_reg7:  case DW_OP_reg8:
-        case DW_OP_reg9:  case DW_OP_reg10: case DW_OP_reg11:
-        case DW_OP_reg12: case DW_OP_reg13: case DW_OP_reg14:
-        case DW_OP_reg15: case DW_OP_reg16: case DW_OP_reg17:
-        case DW_OP_reg18: case DW_OP_reg19: case DW_OP_reg20:
-        case DW_OP_reg21: case DW_OP_reg22: case DW_OP_reg23:
-        case DW_OP_reg24: case DW_OP_reg25: case DW_OP_reg26:
-        case DW_OP_reg27: case DW_OP_reg28: case DW_OP_reg29:
-        case DW_OP_reg30: case DW_OP_reg31:
-          Debug (15, "OP_reg(r%d)\n", (int) opcode - DW_OP_reg0);
-          *valp = dwarf_to_unw_regnum (opcode - DW_OP_reg0);
-          *is_register = 1;
-          return 0;
+    case DW_OP_dup:
+      Debug (15, "OP_dup\n");
+      push (pick (0));
+      break;
 
-        case DW_OP_regx:
-          Debug (15, "OP_regx(r%d)\n", (int) operand1);
-          *valp = dwarf_to_unw_regnum (operand1);
-          *is_register = 1;
-          return 0;
+    case DW_OP_drop:
+      Debug (15, "OP_drop\n");
+      (void) pop ();
+      break;
 
-        case DW_OP_addr:
-        case DW_OP_const1u:
-        case DW_OP_const2u:
-        case DW_OP_const4u:
-        case DW_OP_const8u:
-        case DW_OP_constu:
-        case DW_OP_const8s:
-        case DW_OP_consts:
-          Debug (15, "OP_const(0x%lx)\n", (unsigned long) operand1);
-          push (operand1);
-          break;
+    case DW_OP_pick:
+      Debug (15, "OP_pick(%d)\n", (int) op->arg);
+      push (pick (op->arg));
+      break;
 
-        case DW_OP_const1s:
-          if (operand1 & 0x80)
-            operand1 |= ((unw_word_t) -1) << 8;
-          Debug (15, "OP_const1s(%ld)\n", (long) operand1);
-          push (operand1);
-          break;
+    case DW_OP_over:
+      Debug (15, "OP_over\n");
+      push (pick (1));
+      break;
 
-        case DW_OP_const2s:
-          if (operand1 & 0x8000)
-            operand1 |= ((unw_word_t) -1) << 16;
-          Debug (15, "OP_const2s(%ld)\n", (long) operand1);
-          push (operand1);
-          break;
+    case DW_OP_swap:
+      Debug (15, "OP_swap\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp1);
+      push (tmp2);
+      break;
 
-        case DW_OP_const4s:
-          if (operand1 & 0x80000000)
-            operand1 |= (((unw_word_t) -1) << 16) << 16;
-          Debug (15, "OP_const4s(%ld)\n", (long) operand1);
-          push (operand1);
-          break;
+    case DW_OP_rot:
+      Debug (15, "OP_rot\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      tmp3 = pop ();
+      push (tmp1);
+      push (tmp3);
+      push (tmp2);
+      break;
 
-        case DW_OP_deref:
-          Debug (15, "OP_deref\n");
-          tmp1 = pop ();
-          if ((ret = dwarf_readw (as, a, &tmp1, &tmp2, arg)) < 0)
-            return ret;
-          push (tmp2);
-          break;
+    case DW_OP_abs:
+      Debug (15, "OP_abs\n");
+      tmp1 = pop ();
+      if (tmp1 & ((unw_word_t) 1 << (8 * dwarf_addr_size (as) - 1)))
+        tmp1 = -tmp1;
+      push (tmp1);
+      break;
 
-        case DW_OP_deref_size:
-          Debug (15, "OP_deref_size(%d)\n", (int) operand1);
-          tmp1 = pop ();
-          switch (operand1)
-            {
-            default:
-              Debug (1, "Unexpected DW_OP_deref_size size %d\n",
-                     (int) operand1);
-              return -UNW_EINVAL;
-
-            case 1:
-              if ((ret = dwarf_readu8 (as, a, &tmp1, &u8, arg)) < 0)
-                return ret;
-              tmp2 = u8;
-              break;
-
-            case 2:
-              if ((ret = dwarf_readu16 (as, a, &tmp1, &u16, arg)) < 0)
-                return ret;
-              tmp2 = u16;
-              break;
-
-            case 3:
-            case 4:
-              if ((ret = dwarf_readu32 (as, a, &tmp1, &u32, arg)) < 0)
-                return ret;
-              tmp2 = u32;
-              if (operand1 == 3)
-                {
-                  if (dwarf_is_big_endian (as))
-                    tmp2 >>= 8;
-                  else
-                    tmp2 &= 0xffffff;
-                }
-              break;
-            case 5:
-            case 6:
-            case 7:
-            case 8:
-              if ((ret = dwarf_readu64 (as, a, &tmp1, &u64, arg)) < 0)
-                return ret;
-              tmp2 = u64;
-              if (operand1 != 8)
-                {
-                  if (dwarf_is_big_endian (as))
-                    tmp2 >>= 64 - 8 * operand1;
-                  else
-                    tmp2 &= (~ (unw_word_t) 0) << (8 * operand1);
-                }
-              break;
-            }
-          push (tmp2);
-          break;
+    case DW_OP_and:
+      Debug (15, "OP_and\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp1 & tmp2);
+      break;
 
-        case DW_OP_dup:
-          Debug (15, "OP_dup\n");
-          push (pick (0));
-          break;
+    case DW_OP_div:
+      Debug (15, "OP_div\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      if (tmp1)
+        tmp1 = sword (as, tmp2) / sword (as, tmp1);
+      push (tmp1);
+      break;
 
-        case DW_OP_drop:
-          Debug (15, "OP_drop\n");
-          (void) pop ();
-          break;
+    case DW_OP_minus:
+      Debug (15, "OP_minus\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      tmp1 = tmp2 - tmp1;
+      push (tmp1);
+      break;
 
-        case DW_OP_pick:
-          Debug (15, "OP_pick(%d)\n", (int) operand1);
-          push (pick (operand1));
-          break;
+    case DW_OP_mod:
+      Debug (15, "OP_mod\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      if (tmp1)
+        tmp1 = tmp2 % tmp1;
+      push (tmp1);
+      break;
 
-        case DW_OP_over:
-          Debug (15, "OP_over\n");
-          push (pick (1));
-          break;
+    case DW_OP_mul:
+      Debug (15, "OP_mul\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      if (tmp1)
+        tmp1 = tmp2 * tmp1;
+      push (tmp1);
+      break;
 
-        case DW_OP_swap:
-          Debug (15, "OP_swap\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp1);
-          push (tmp2);
-          break;
+    case DW_OP_neg:
+      Debug (15, "OP_neg\n");
+      push (-pop ());
+      break;
 
-        case DW_OP_rot:
-          Debug (15, "OP_rot\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          tmp3 = pop ();
-          push (tmp1);
-          push (tmp3);
-          push (tmp2);
-          break;
+    case DW_OP_not:
+      Debug (15, "OP_not\n");
+      push (~pop ());
+      break;
 
-        case DW_OP_abs:
-          Debug (15, "OP_abs\n");
-          tmp1 = pop ();
-          if (tmp1 & ((unw_word_t) 1 << (8 * dwarf_addr_size (as) - 1)))
-            tmp1 = -tmp1;
-          push (tmp1);
-          break;
+    case DW_OP_or:
+      Debug (15, "OP_or\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp1 | tmp2);
+      break;
 
-        case DW_OP_and:
-          Debug (15, "OP_and\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp1 & tmp2);
-          break;
+    case DW_OP_plus:
+      Debug (15, "OP_plus\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp1 + tmp2);
+      break;
 
-        case DW_OP_div:
-          Debug (15, "OP_div\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          if (tmp1)
-            tmp1 = sword (as, tmp2) / sword (as, tmp1);
-          push (tmp1);
-          break;
+    case DW_OP_plus_uconst:
+      Debug (15, "OP_plus_uconst(%lu)\n", (unsigned long) operand1);
+      tmp1 = pop ();
+      push (tmp1 + operand1);
+      break;
 
-        case DW_OP_minus:
-          Debug (15, "OP_minus\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          tmp1 = tmp2 - tmp1;
-          push (tmp1);
-          break;
+    case DW_OP_shl:
+      Debug (15, "OP_shl\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp2 << tmp1);
+      break;
 
-        case DW_OP_mod:
-          Debug (15, "OP_mod\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          if (tmp1)
-            tmp1 = tmp2 % tmp1;
-          push (tmp1);
-          break;
+    case DW_OP_shr:
+      Debug (15, "OP_shr\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp2 >> tmp1);
+      break;
 
-        case DW_OP_mul:
-          Debug (15, "OP_mul\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          if (tmp1)
-            tmp1 = tmp2 * tmp1;
-          push (tmp1);
-          break;
+    case DW_OP_shra:
+      Debug (15, "OP_shra\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) >> tmp1);
+      break;
 
-        case DW_OP_neg:
-          Debug (15, "OP_neg\n");
-          push (-pop ());
-          break;
+    case DW_OP_xor:
+      Debug (15, "OP_xor\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (tmp1 ^ tmp2);
+      break;
 
-        case DW_OP_not:
-          Debug (15, "OP_not\n");
-          push (~pop ());
-          break;
+    case DW_OP_le:
+      Debug (15, "OP_le\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) <= sword (as, tmp1));
+      break;
 
-        case DW_OP_or:
-          Debug (15, "OP_or\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp1 | tmp2);
-          break;
+    case DW_OP_ge:
+      Debug (15, "OP_ge\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) >= sword (as, tmp1));
+      break;
 
-        case DW_OP_plus:
-          Debug (15, "OP_plus\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp1 + tmp2);
-          break;
+    case DW_OP_eq:
+      Debug (15, "OP_eq\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) == sword (as, tmp1));
+      break;
 
-        case DW_OP_plus_uconst:
-          Debug (15, "OP_plus_uconst(%lu)\n", (unsigned long) operand1);
-          tmp1 = pop ();
-          push (tmp1 + operand1);
-          break;
+    case DW_OP_lt:
+      Debug (15, "OP_lt\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) < sword (as, tmp1));
+      break;
 
-        case DW_OP_shl:
-          Debug (15, "OP_shl\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp2 << tmp1);
-          break;
+    case DW_OP_gt:
+      Debug (15, "OP_gt\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) > sword (as, tmp1));
+      break;
 
-        case DW_OP_shr:
-          Debug (15, "OP_shr\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp2 >> tmp1);
-          break;
+    case DW_OP_ne:
+      Debug (15, "OP_ne\n");
+      tmp1 = pop ();
+      tmp2 = pop ();
+      push (sword (as, tmp2) != sword (as, tmp1));
+      break;
 
-        case DW_OP_shra:
-          Debug (15, "OP_shra\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) >> tmp1);
-          break;
+    case DW_OP_skip:
+      Debug (15, "OP_skip(%d)\n", (int) operand1);
+      return EXPR_JUMP;
 
-        case DW_OP_xor:
-          Debug (15, "OP_xor\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (tmp1 ^ tmp2);
-          break;
+    case DW_OP_bra:
+      Debug (15, "OP_bra(%d)\n", (int) operand1);
+      tmp1 = pop ();
+      if (tmp1)
+        return EXPR_JUMP;
+      break;
 
-        case DW_OP_le:
-          Debug (15, "OP_le\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) <= sword (as, tmp1));
-          break;
+    case DW_OP_nop:
+      Debug (15, "OP_nop\n");
+      break;
 
-        case DW_OP_ge:
-          Debug (15, "OP_ge\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) >= sword (as, tmp1));
-          break;
+    case DW_OP_call2:
+    case DW_OP_call4:
+    case DW_OP_call_ref:
+    case DW_OP_fbreg:
+    case DW_OP_piece:
+    case DW_OP_push_object_address:
+    case DW_OP_xderef:
+    case DW_OP_xderef_size:
+    default:
+      Debug (1, "Unexpected opcode 0x%x\n", op->op);
+      return -UNW_EINVAL;
+    }
+  return EXPR_NEXT;
+}
 
-        case DW_OP_eq:
-          Debug (15, "OP_eq\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) == sword (as, tmp1));
-          break;
+HIDDEN int
+dwarf_eval_expr (struct dwarf_cursor *c, unw_word_t *addr, unw_word_t len,
+                 unw_word_t *valp, int *is_register)
+{
+  unw_word_t end_addr;
+  unw_addr_space_t as;
+  unw_accessors_t *a;
+  struct expr_stack stack, *st = &stack;
+  dwarf_expr_insn_t op;
+  void *arg;
+  int ret;
 
-        case DW_OP_lt:
-          Debug (15, "OP_lt\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) < sword (as, tmp1));
-          break;
+  as = c->as;
+  arg = c->as_arg;
+  a = unw_get_accessors (as);
+  end_addr = *addr + len;
+  *is_register = 0;
+  st->tos = 0;
 
-        case DW_OP_gt:
-          Debug (15, "OP_gt\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) > sword (as, tmp1));
-          break;
+  Debug (14, "len=%lu, pushing cfa=0x%lx\n",
+         (unsigned long) len, (unsigned long) c->cfa);
 
-        case DW_OP_ne:
-          Debug (15, "OP_ne\n");
-          tmp1 = pop ();
-          tmp2 = pop ();
-          push (sword (as, tmp2) != sword (as, tmp1));
-          break;
+  push (c->cfa);        /* push current CFA as required by DWARF spec */
 
-        case DW_OP_skip:
-          Debug (15, "OP_skip(%d)\n", (int16_t) operand1);
-          *addr += (int16_t) operand1;
-          break;
+  while (*addr < end_addr)
+    {
+      if ((ret = decode_op (as, a, addr, &op, arg)) < 0
+          || (ret = exec_op (c, &op, st, valp)) < 0)
+        return ret;
+      if (ret == EXPR_REGISTER)
+        {
+          *is_register = 1;
+          return 0;
+        }
+      if (ret == EXPR_JUMP)
+        *addr += op.operand;
+    }
+  *valp = pop ();
+  Debug (14, "final value = 0x%lx\n", (unsigned long) *valp);
+  return 0;
+}
 
-        case DW_OP_bra:
-          Debug (15, "OP_skip(%d)\n", (int16_t) operand1);
-          tmp1 = pop ();
-          if (tmp1)
-            *addr += (int16_t) operand1;
-          break;
+/* Same as dwarf_eval_expr(), on the NOPS decoded operations OPS.  */
+static int
+eval_ops (struct dwarf_cursor *c, const dwarf_expr_insn_t *ops,
+          unsigned int nops, unw_word_t *valp, int *is_register)
+{
+  struct expr_stack stack, *st = &stack;
+  unsigned int i = 0;
+  int ret;
 
-        case DW_OP_nop:
-          Debug (15, "OP_nop\n");
-          break;
+  *is_register = 0;
+  st->tos = 0;
+  push (c->cfa);        /* push current CFA as required by DWARF spec */
 
-        case DW_OP_call2:
-        case DW_OP_call4:
-        case DW_OP_call_ref:
-        case DW_OP_fbreg:
-        case DW_OP_piece:
-        case DW_OP_push_object_address:
-        case DW_OP_xderef:
-        case DW_OP_xderef_size:
-        default:
-          Debug (1, "Unexpected opcode 0x%x\n", opcode);
-          return -UNW_EINVAL;
+  while (i < nops)
+    {
+      if ((ret = exec_op (c, &ops[i], st, valp)) < 0)
+        return ret;
+      if (ret == EXPR_REGISTER)
+        {
+          *is_register = 1;
+          return 0;
         }
+      i = (ret == EXPR_JUMP) ? ops[i].arg : i + 1;
     }
   *valp = pop ();
   Debug (14, "final value = 0x%lx\n", (unsigned long) *valp);
   return 0;
 }
+
+/* Decode the expression in [ADDR, END_ADDR) into R.  Fails if it is
+   too long, or branches elsewhere than to one of its operations or its
+   end, for the caller to evaluate it from memory.  */
+static int
+decode_expr (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
+             unw_word_t end_addr, struct dwarf_expr_record *r, void *arg)
+{
+  unw_word_t op_addr[DWARF_EXPR_MAX_OPS + 1], target;
+  unsigned int i, j;
+  int ret;
+
+  for (i = 0; addr < end_addr; ++i)
+    {
+      if (i == DWARF_EXPR_MAX_OPS)
+        return -UNW_EINVAL;
+      op_addr[i] = addr;
+      if ((ret = decode_op (as, a, &addr, &r->ops[i], arg)) < 0)
+        return ret;
+    }
+  op_addr[i] = addr;
+  r->nops = i;
+
+  for (i = 0; i < r->nops; ++i)
+    if (r->ops[i].op == DW_OP_skip || r->ops[i].op == DW_OP_bra)
+      {
+        target = op_addr[i + 1] + r->ops[i].operand;
+        for (j = 0; j <= r->nops && op_addr[j] != target; ++j)
+          ;
+        if (j > r->nops)
+          return -UNW_EINVAL;
+        r->ops[i].arg = j;
+      }
+  return 0;
+}
+
+/* The cache of decoded expressions of AS, see struct unw_expr_cache.
+   It is searched without a lock and flushed by generation, the way the
+   cache of CIEs is (see Gfde.c).  */
+
+static define_lock (expr_cache_lock);
+
+static inline unsigned int
+expr_hash (unw_word_t addr)
+{
+  return (addr ^ (addr >> 6) ^ (addr >> 12)) % DWARF_EXPR_HASH_SIZE;
+}
+
+static struct unw_expr_cache *
+get_expr_cache (unw_addr_space_t as)
+{
+  struct unw_expr_cache *cache = as->expr_cache;
+
+  if (likely (cache != NULL))
+    return cache;
+
+  GET_MEMORY (cache, sizeof (*cache));
+  if (!cache)
+    return NULL;
+  cache->generation = as->cache_generation;
+  if (!cmpxchg_ptr (&as->expr_cache, NULL, cache))
+    {
+      /* another thread was faster */
+      munmap (cache, sizeof (*cache));
+      cache = as->expr_cache;
+    }
+  return cache;
+}
+
+static inline const struct dwarf_expr_record *
+find_expr (const struct unw_expr_cache *cache, uint32_t gen, unw_word_t addr)
+{
+  const struct dwarf_expr_record *r = cache->hash[expr_hash (addr)];
+  unsigned int n;
+
+  for (n = 0; r && n < DWARF_EXPR_CACHE_SIZE; r = r->next, ++n)
+    if (r->generation != gen)
+      return NULL;
+    else if (r->addr == addr)
+      return r;
+  return NULL;
+}
+
+/* Add REC, decoded in generation GEN, unless the cache was flushed
+   since.  */
+static void
+add_expr (unw_addr_space_t as, struct unw_expr_cache *cache, uint32_t gen,
+          const struct dwarf_expr_record *rec)
+{
+  struct dwarf_expr_record *r;
+  intrmask_t saved_mask;
+  unsigned int h = expr_hash (rec->addr);
+
+  lock_acquire (&expr_cache_lock, saved_mask);
+  if (gen == (uint32_t) as->cache_generation && cache->generation != gen)
+    {
+      /* first record since a flush: start over */
+      memset (cache->hash, 0, sizeof (cache->hash));
+      cache->generation = gen;
+      cache->used = 0;
+    }
+  if (gen == cache->generation
+      && !find_expr (cache, gen, rec->addr)
+      && cache->used < DWARF_EXPR_CACHE_SIZE)
+    {
+      r = &cache->records[cache->used++];
+      r->generation = gen;
+      __sync_synchronize ();
+      r->addr = rec->addr;
+      r->nops = rec->nops;
+      memcpy (r->ops, rec->ops, rec->nops * sizeof (rec->ops[0]));
+      r->next = cache->hash[h];
+      /* publish the record once it is complete */
+      cmpxchg_ptr (&cache->hash[h], r->next, r);
+    }
+  lock_release (&expr_cache_lock, saved_mask);
+}
+
+/* Evaluate the expression of a CFI rule: a DW_FORM_block at ADDR, its
+   length first.  The expression is decoded once, then evaluated from
+   the cache of the address space.  A cached record is copied before it
+   is evaluated, as it may be reused after a flush.  */
+HIDDEN int
+dwarf_eval_rule_expr (struct dwarf_cursor *c, unw_word_t addr,
+                      unw_word_t *valp, int *is_register)
+{
+  struct unw_expr_cache *cache = get_expr_cache (c->as);
+  uint32_t gen = c->as->cache_generation;
+  const struct dwarf_expr_record *r;
+  struct dwarf_expr_record decoded;
+  unw_addr_space_t as = c->as;
+  unw_accessors_t *a;
+  void *arg = c->as_arg;
+  unw_word_t len;
+  int ret;
+
+  if (cache && (r = find_expr (cache, gen, addr)))
+    {
+      decoded.nops = r->nops;
+      if (decoded.nops <= DWARF_EXPR_MAX_OPS)
+        memcpy (decoded.ops, r->ops, decoded.nops * sizeof (r->ops[0]));
+      __sync_synchronize ();
+      if (r->generation == gen && decoded.nops <= DWARF_EXPR_MAX_OPS)
+        return eval_ops (c, decoded.ops, decoded.nops, valp, is_register);
+    }
+
+  a = unw_get_accessors (as);
+  decoded.addr = addr;
+
+  /* read the length of the expression: */
+  if ((ret = dwarf_read_uleb128 (as, a, &addr, &len, arg)) < 0)
+    return ret;
+
+  if (cache && decode_expr (as, a, addr, addr + len, &decoded, arg) >= 0)
+    {
+      add_expr (as, cache, gen, &decoded);
+      return eval_ops (c, decoded.ops, decoded.nops, valp, is_register);
+    }
+
+  return dwarf_eval_expr (c, &addr, len, valp, is_register);
+}
@@ -49,6 +49,7 @@ parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
 {
   uint8_t version, ch, augstr[5], fde_encoding, handler_encoding;
   unw_word_t len, cie_end_addr, aug_size;
+  struct dwarf_window w;
   uint32_t u32val;
   uint64_t u64val;
   size_t i;
@@ -56,6 +57,8 @@ parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
 # define STR2(x)        #x
 # define STR(x)         STR2(x)
 
+  dwarf_window_open (as, &w, &a, &arg, addr, addr + DWARF_WINDOW_SIZE);
+
   /* Pick appropriate default for FDE-encoding.  DWARF spec says
      start-IP (initial_location) and the code-size (address_range) are
      "address-unit sized constants".  The `R' augmentation can be used
@@ -212,6 +215,124 @@ parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
   return 0;
 }
 
+/* The cache of parsed CIEs of AS, see struct unw_cie_cache.  Records
+   are only ever added to the current generation, so that lookups need
+   no lock; they may race with the reuse of a record after a flush, but
+   a record being reused is tagged with the new generation before it is
+   overwritten, so that a lookup checks the tag again once it has copied
+   the record.  The memory comes from mmap(), as we may be unwinding
+   from a signal handler.  */
+
+static define_lock (cie_cache_lock);
+
+static inline unsigned int
+cie_hash (unw_word_t addr)
+{
+  return (addr ^ (addr >> 8) ^ (addr >> 16)) % DWARF_CIE_HASH_SIZE;
+}
+
+static struct unw_cie_cache *
+get_cie_cache (unw_addr_space_t as)
+{
+  struct unw_cie_cache *cache = as->cie_cache;
+
+  if (likely (cache != NULL))
+    return cache;
+
+  GET_MEMORY (cache, sizeof (*cache));
+  if (!cache)
+    return NULL;
+  cache->generation = as->cache_generation;
+  if (!cmpxchg_ptr (&as->cie_cache, NULL, cache))
+    {
+      /* another thread was faster */
+      munmap (cache, sizeof (*cache));
+      cache = as->cie_cache;
+    }
+  return cache;
+}
+
+/* The record of the CIE at ADDR in generation GEN, or NULL.  Only the
+   records of the generation are followed, and no more of them than
+   there are, however the chains change under us.  */
+static inline const struct dwarf_cie_record *
+find_cie (const struct unw_cie_cache *cache, uint32_t gen, unw_word_t addr,
+          int is_debug_frame)
+{
+  const struct dwarf_cie_record *r = cache->hash[cie_hash (addr)];
+  unsigned int n;
+
+  for (n = 0; r && n < DWARF_CIE_CACHE_SIZE; r = r->next, ++n)
+    if (r->generation != gen)
+      return NULL;
+    else if (r->addr == addr && r->is_debug_frame == is_debug_frame)
+      return r;
+  return NULL;
+}
+
+/* Add the CIE at ADDR, parsed in generation GEN, unless the cache was
+   flushed since.  */
+static void
+add_cie (unw_addr_space_t as, struct unw_cie_cache *cache, uint32_t gen,
+         unw_word_t addr, const struct dwarf_cie_info *dci,
+         int is_debug_frame)
+{
+  struct dwarf_cie_record *r;
+  intrmask_t saved_mask;
+  unsigned int h = cie_hash (addr);
+
+  lock_acquire (&cie_cache_lock, saved_mask);
+  if (gen == (uint32_t) as->cache_generation && cache->generation != gen)
+    {
+      /* first record since a flush: start over */
+      memset (cache->hash, 0, sizeof (cache->hash));
+      cache->generation = gen;
+      cache->used = 0;
+    }
+  if (gen == cache->generation
+      && !find_cie (cache, gen, addr, is_debug_frame)
+      && cache->used < DWARF_CIE_CACHE_SIZE)
+    {
+      r = &cache->records[cache->used++];
+      r->generation = gen;
+      __sync_synchronize ();
+      r->addr = addr;
+      r->is_debug_frame = is_debug_frame;
+      r->dci = *dci;
+      r->next = cache->hash[h];
+      /* publish the record once it is complete */
+      cmpxchg_ptr (&cache->hash[h], r->next, r);
+    }
+  lock_release (&cie_cache_lock, saved_mask);
+}
+
+/* parse_cie(), from the cache of AS when the CIE was parsed before.  */
+static int
+get_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
+         const unw_proc_info_t *pi, struct dwarf_cie_info *dci,
+         int is_debug_frame, void *arg)
+{
+  struct unw_cie_cache *cache = get_cie_cache (as);
+  uint32_t gen = as->cache_generation;
+  const struct dwarf_cie_record *r;
+  int ret;
+
+  if (cache && (r = find_cie (cache, gen, addr, is_debug_frame)))
+    {
+      *dci = r->dci;
+      __sync_synchronize ();
+      if (r->generation == gen)
+        return 0;
+    }
+
+  if ((ret = parse_cie (as, a, addr, pi, dci, is_debug_frame, arg)) < 0)
+    return ret;
+
+  if (cache)
+    add_cie (as, cache, gen, addr, dci, is_debug_frame);
+  return 0;
+}
+
 /* Extract proc-info from the FDE starting at adress ADDR.
    
    Pass BASE as zero for eh_frame behaviour, or a pointer to
@@ -228,11 +349,14 @@ dwarf_extract_proc_info_from_fde (unw_addr_space_t as, unw_accessors_t *a,
   unw_word_t start_ip, ip_range, aug_size, addr = *addrp;
   int ret, ip_range_encoding;
   struct dwarf_cie_info dci;
+  struct dwarf_window w;
   uint64_t u64val;
   uint32_t u32val;
 
   Debug (12, "FDE @ 0x%lx\n", (long) addr);
 
+  dwarf_window_open (as, &w, &a, &arg, addr, addr + DWARF_WINDOW_SIZE);
+
   memset (&dci, 0, sizeof (dci));
 
   if ((ret = dwarf_readu32 (as, a, &addr, &u32val, arg)) < 0)
@@ -299,7 +423,7 @@ dwarf_extract_proc_info_from_fde (unw_addr_space_t as, unw_accessors_t *a,
 
   Debug (15, "looking for CIE at address %lx\n", (long) cie_addr);
 
-  if ((ret = parse_cie (as, a, cie_addr, pi, &dci, is_debug_frame, arg)) < 0)
+  if ((ret = get_cie (as, a, cie_addr, pi, &dci, is_debug_frame, arg)) < 0)
     return ret;
 
   /* IP-range has same encoding as FDE pointers, except that it's
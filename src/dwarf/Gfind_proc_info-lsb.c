@@ -26,10 +26,13 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 /* Locate an FDE via the ELF data-structures defined by LSB v1.3
    (http://www.linuxbase.org/spec/).  */
 
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <limits.h>
 
+#include <sys/stat.h>
+
 #include "dwarf_i.h"
 #include "dwarf-eh.h"
 #include "libunwind_i.h"
@@ -40,12 +43,280 @@ struct table_entry
     int32_t fde_offset;
   };
 
+/* A B-tree over a large search table, whose leaves are the table itself
+   cut into blocks of TABLE_INDEX_LEAF entries.  levels[0] holds the
+   first start IP of each leaf, and every level above the first key of
+   each block of TABLE_INDEX_KEYS keys of the level below, up to a level
+   that fits in one block.  A block is a cache line, so a lookup reads
+   one line per level and one of the table, where a binary search of
+   the table reads a line per step.  The levels take half a byte per
+   entry of the table and stay in the cache.  */
+
+#define TABLE_INDEX_KEYS        16      /* keys per block */
+#define TABLE_INDEX_LEAF        8       /* table entries per leaf */
+#define TABLE_INDEX_MAX_LEVELS  8       /* enough for 2^32 entries */
+
+struct unw_table_index
+  {
+    size_t size;                        /* number of entries */
+    int nlevels;
+    int32_t *levels[TABLE_INDEX_MAX_LEVELS];    /* padded with INT32_MAX */
+  };
+
+static inline const struct table_entry *
+lookup (const struct table_entry *table, size_t table_size, int32_t rel_ip)
+{
+  unsigned long table_len = table_size / sizeof (struct table_entry);
+  const struct table_entry *e = NULL;
+  unsigned long lo, hi, mid;
+
+  /* do a binary search for right entry: */
+  for (lo = 0, hi = table_len; lo < hi;)
+    {
+      mid = (lo + hi) / 2;
+      e = table + mid;
+      Debug (15, "e->start_ip_offset = %lx\n", (long) e->start_ip_offset);
+      if (rel_ip < e->start_ip_offset)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+  if (hi <= 0)
+        return NULL;
+  e = table + hi - 1;
+  return e;
+}
+
+/* Search tables of at least this many entries are indexed, the first
+   time they are searched: smaller ones fit in a few cache lines.  */
+#define TABLE_INDEX_MIN_ENTRIES 1024
+
+/* The number of keys in each level of the index of a table of SIZE
+   entries, in LEN.  Returns the number of levels, or 0 if there are too
+   many.  */
+static int
+table_index_levels (size_t size, size_t len[TABLE_INDEX_MAX_LEVELS])
+{
+  size_t n = (size + TABLE_INDEX_LEAF - 1) / TABLE_INDEX_LEAF;
+  int nlevels = 0;
+
+  do
+    {
+      if (nlevels == TABLE_INDEX_MAX_LEVELS)
+        return 0;
+      len[nlevels++] = n;
+      n = (n + TABLE_INDEX_KEYS - 1) / TABLE_INDEX_KEYS;
+    }
+  while (len[nlevels - 1] > TABLE_INDEX_KEYS);
+  return nlevels;
+}
+
+/* How many bytes the index of a table of SIZE entries takes, or 0 if
+   the table is not worth one.  */
+static size_t
+table_index_size (size_t size)
+{
+  size_t len[TABLE_INDEX_MAX_LEVELS], nkeys = 0;
+  int l, nlevels;
+
+  if (size < TABLE_INDEX_MIN_ENTRIES
+      || !(nlevels = table_index_levels (size, len)))
+    return 0;
+  for (l = 0; l < nlevels; ++l)
+    nkeys += (len[l] + TABLE_INDEX_KEYS - 1) / TABLE_INDEX_KEYS
+             * TABLE_INDEX_KEYS;
+  /* The blocks are aligned on cache lines.  */
+  return sizeof (struct unw_table_index) + 63 + nkeys * sizeof (int32_t);
+}
+
+/* Index the SIZE entries of TABLE into INDEX, which has room for it.  */
+static void
+table_index_init (struct unw_table_index *index,
+                  const struct table_entry *table, size_t size)
+{
+  size_t len[TABLE_INDEX_MAX_LEVELS], i;
+  int32_t *keys;
+  int l;
+
+  index->size = size;
+  index->nlevels = table_index_levels (size, len);
+  keys = (int32_t *) (((uintptr_t) (index + 1) + 63) & ~(uintptr_t) 63);
+  for (l = 0; l < index->nlevels; ++l)
+    {
+      index->levels[l] = keys;
+      for (i = 0; i < len[l]; ++i)
+        keys[i] = l ? index->levels[l - 1][i * TABLE_INDEX_KEYS]
+                    : table[i * TABLE_INDEX_LEAF].start_ip_offset;
+      for (; i % TABLE_INDEX_KEYS; ++i)
+        keys[i] = INT32_MAX;
+      keys += i;
+    }
+  Debug (3, "indexed table at %p (%zu entries, %d levels)\n",
+         table, size, index->nlevels);
+}
+
+/* The records of the search tables of an address space, see
+   struct unw_remote_table.  The list is only ever prepended to, until
+   it is flushed, so that it can be searched without a lock; its
+   readers count themselves on the table_retire list of the address
+   space, which holds the flushed records until none is left.  */
+
+static struct unw_remote_table *
+find_table (struct unw_remote_table *list, unw_word_t addr, size_t size,
+            unw_word_t segbase, unsigned long long dl_generation)
+{
+  struct unw_remote_table *t;
+
+  for (t = list; t; t = t->next)
+    if (t->addr == addr && t->size == size && t->segbase == segbase
+        && t->dl_generation == dl_generation)
+      break;
+  return t;
+}
+
+/* Add record T to AS, unless another thread added one for the same
+   table first.  Returns the record in AS.  */
+static struct unw_remote_table *
+add_table (unw_addr_space_t as, struct unw_remote_table *t)
+{
+  struct unw_remote_table *head, *other;
+
+  do
+    {
+      head = as->remote_tables;
+      if ((other = find_table (head, t->addr, t->size, t->segbase,
+                               t->dl_generation)))
+        return other;
+      t->next = head;
+    }
+  while (!cmpxchg_ptr (&as->remote_tables, head, t));
+  return t;
+}
+
+/* Same as lookup(), through the index of TABLE.  */
+static inline const struct table_entry *
+table_index_lookup (const struct unw_table_index *index,
+                    const struct table_entry *table, int32_t rel_ip)
+{
+  const struct table_entry *e;
+  const int32_t *keys;
+  size_t j = 0, n, i;
+  unsigned int count;
+  int l;
+
+  if (unlikely (rel_ip == INT32_MAX))   /* would count the padding */
+    return lookup (table, index->size * sizeof (struct table_entry), rel_ip);
+
+  /* In each block, the number of keys at or below REL_IP tells which
+     block of the level below to go on with.  Counting them has no
+     branch to mispredict, and compilers turn it into SIMD compares.  */
+  for (l = index->nlevels - 1; l >= 0; --l)
+    {
+      keys = index->levels[l] + j * TABLE_INDEX_KEYS;
+      for (count = 0, i = 0; i < TABLE_INDEX_KEYS; ++i)
+        count += keys[i] <= rel_ip;
+      if (count == 0)
+        return NULL;    /* below the first entry */
+      j = j * TABLE_INDEX_KEYS + count - 1;
+    }
+
+  e = table + j * TABLE_INDEX_LEAF;
+  n = index->size - j * TABLE_INDEX_LEAF;
+  if (n > TABLE_INDEX_LEAF)
+    n = TABLE_INDEX_LEAF;
+  for (count = 0, i = 0; i < n; ++i)
+    count += e[i].start_ip_offset <= rel_ip;
+  if (unlikely (count == 0))
+    return lookup (table, index->size * sizeof (struct table_entry), rel_ip);
+  return e + count - 1;
+}
+
+/* Lookup an unwind-table entry in TABLE, which T describes.  */
+static inline const struct table_entry *
+table_lookup (const struct unw_remote_table *t,
+              const struct table_entry *table, int32_t rel_ip)
+{
+  if (t->index)
+    return table_index_lookup (t->index, table, rel_ip);
+  return lookup (table, t->size, rel_ip);
+}
+
 #ifndef UNW_REMOTE_ONLY
 
 #ifdef __linux
 #include "os-linux.h"
 #endif
 
+static void
+release_local_table (struct unw_retired *obj)
+{
+  struct unw_remote_table *t = (struct unw_remote_table *) obj;
+
+  munmap (t, t->map_size);
+}
+
+/* The record of the local search table TABLE of SIZE bytes, of the
+   object loaded at SEGBASE, indexed, or NULL if the table is not worth
+   an index.  The records are only valid for the DL_GENERATION they
+   were made in, as another object may have been loaded at the same
+   place since: the first lookup that sees objects loaded or unloaded
+   since the records were made retires them all.  DL_GENERATION is 0
+   when the C library does not count those, and tables are then never
+   indexed.  We may be unwinding from a signal handler, so the record
+   and the index come from mmap() rather than malloc().  The caller
+   counts itself as a reader of the table_retire list.  */
+static struct unw_remote_table *
+get_local_table (unw_addr_space_t as, const struct table_entry *table,
+                 size_t size, unw_word_t segbase,
+                 unsigned long long dl_generation)
+{
+  struct unw_remote_table *t, *other, *head, *next;
+  size_t index_size, map_size;
+
+  if (!dl_generation)
+    return NULL;
+  if ((t = find_table (as->remote_tables, (uintptr_t) table, size, segbase,
+                       dl_generation)))
+    return t;
+
+  /* The records are prepended as they are made, so the first one is
+     the most recent.  Only a lookup that saw more objects come and go
+     retires them, the others do without.  */
+  head = as->remote_tables;
+  if (head && head->dl_generation != dl_generation)
+    {
+      if (head->dl_generation > dl_generation)
+        return NULL;
+      if (cmpxchg_ptr (&as->remote_tables, head, NULL))
+        for (t = head; t; t = next)
+          {
+            next = t->next;
+            retire_object (&as->table_retire, &t->retired,
+                           release_local_table);
+          }
+    }
+
+  index_size = table_index_size (size / sizeof (struct table_entry));
+  if (!index_size)
+    return NULL;
+  map_size = sizeof (*t) + index_size;
+  GET_MEMORY (t, map_size);
+  if (!t)
+    return NULL;
+  memset (t, 0, sizeof (*t));
+  t->addr = (uintptr_t) table;
+  t->size = size;
+  t->segbase = segbase;
+  t->dl_generation = dl_generation;
+  t->map_size = map_size;
+  t->index = (struct unw_table_index *) (t + 1);
+  table_index_init (t->index, table, size / sizeof (struct table_entry));
+
+  if ((other = add_table (as, t)) != t)
+    munmap (t, map_size);       /* another thread was faster */
+  return other;
+}
+
 static int
 linear_search (unw_addr_space_t as, unw_word_t ip,
                unw_word_t eh_frame_start, unw_word_t eh_frame_end,
@@ -83,98 +354,164 @@ linear_search (unw_addr_space_t as, unw_word_t ip,
 #endif /* !UNW_REMOTE_ONLY */
 
 #ifdef CONFIG_DEBUG_FRAME
-/* Load .debug_frame section from FILE.  Allocates and returns space
-   in *BUF, and sets *BUFSIZE to its size.  IS_LOCAL is 1 if using the
-   local process, in which case we can search the system debug file
-   directory; 0 for other address spaces, in which case we do not; or
-   -1 for recursive calls following .gnu_debuglink.  Returns 0 on
-   success, 1 on error.  Succeeds even if the file contains no
-   .debug_frame.  */
-/* XXX: Could use mmap; but elf_map_image keeps tons mapped in.  */
+/* A .debug_frame section is mapped in place and its FDEs are indexed on
+   demand: a lookup that the index built so far cannot answer indexes
+   more of the section, at least as many FDEs again as are already
+   indexed, until it finds one that covers its IP.  If
+   UNW_DEBUG_FRAME_INDEX_DIR names a directory, complete indexes are
+   saved there and reused by later runs.  */
+
+#define DEBUG_FRAME_INDEX_MIN   1024
+
+/* Header of a saved index, followed by COUNT table entries.  */
+struct debug_frame_index_file
+  {
+    char magic[8];
+    uint64_t key;
+    uint64_t debug_frame_size;
+    uint64_t count;
+  };
+
+static const char debug_frame_index_magic[8] = "UNWDFI1";
+
+static define_lock (debug_frame_index_lock);
+
+static uint64_t
+debug_frame_index_key (const struct stat *st, const Elf_W (Shdr) *shdr)
+{
+  uint64_t fields[7], hash = 0xcbf29ce484222325ULL;
+  const uint8_t *p = (const uint8_t *) fields;
+  size_t i;
+
+  fields[0] = st->st_dev;
+  fields[1] = st->st_ino;
+  fields[2] = st->st_size;
+  fields[3] = st->st_mtim.tv_sec;
+  fields[4] = st->st_mtim.tv_nsec;
+  fields[5] = shdr->sh_offset;
+  fields[6] = shdr->sh_size;
+  for (i = 0; i < sizeof (fields); ++i)
+    hash = (hash ^ p[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
+/* Load .debug_frame section from FILE into FDESC.  Only the pages of
+   the section stay mapped.  IS_LOCAL is 1 if using the local process,
+   in which case we can search the system debug file directory; 0 for
+   other address spaces, in which case we do not; or -1 for recursive
+   calls following .gnu_debuglink.  Returns 0 on success, 1 on error.
+   Succeeds even if the file contains no .debug_frame.  */
 
 static int
-load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
+load_debug_frame (const char *file, struct unw_debug_frame_list *fdesc,
+                  int is_local)
 {
-  FILE *f;
-  Elf_W (Ehdr) ehdr;
-  Elf_W (Half) shstrndx;
-  Elf_W (Shdr) *sec_hdrs = NULL;
-  char *stringtab = NULL;
+  struct elf_image ei;
+  struct stat st;
+  Elf_W (Ehdr) *ehdr;
+  Elf_W (Shdr) *sec_hdrs, *shdr;
+  char *stringtab, *linkbuf = NULL;
+  size_t linksize = 0, offset;
   unsigned int i;
-  size_t linksize = 0;
-  char *linkbuf = NULL;
-  
-  *buf = NULL;
-  *bufsize = 0;
-  
-  f = fopen (file, "r");
-  
-  if (!f)
+  int fd;
+
+  fdesc->debug_frame = NULL;
+  fdesc->debug_frame_size = 0;
+  fdesc->debug_frame_map = NULL;
+  fdesc->debug_frame_map_size = 0;
+
+  fd = open (file, O_RDONLY);
+  if (fd < 0)
     return 1;
-  
-  if (fread (&ehdr, sizeof (Elf_W (Ehdr)), 1, f) != 1)
+
+  if (fstat (fd, &st) < 0)
+    {
+      close (fd);
+      return 1;
+    }
+  ei.size = st.st_size;
+  ei.image = mmap (NULL, ei.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ei.image == MAP_FAILED)
+    {
+      close (fd);
+      return 1;
+    }
+
+  ehdr = ei.image;
+  if (!elf_w (valid_object) (&ei)
+      || ei.size < sizeof (Elf_W (Ehdr))
+      || ehdr->e_shoff > ei.size
+      || ehdr->e_shnum > (ei.size - ehdr->e_shoff) / sizeof (Elf_W (Shdr))
+      || ehdr->e_shstrndx >= ehdr->e_shnum)
     goto file_error;
-  
-  shstrndx = ehdr.e_shstrndx;
-  
+
   Debug (4, "opened file '%s'. Section header at offset %d\n",
-         file, (int) ehdr.e_shoff);
+         file, (int) ehdr->e_shoff);
 
-  fseek (f, ehdr.e_shoff, SEEK_SET);
-  sec_hdrs = calloc (ehdr.e_shnum, sizeof (Elf_W (Shdr)));
-  if (fread (sec_hdrs, sizeof (Elf_W (Shdr)), ehdr.e_shnum, f) != ehdr.e_shnum)
+  sec_hdrs = (Elf_W (Shdr) *) ((char *) ei.image + ehdr->e_shoff);
+  shdr = &sec_hdrs[ehdr->e_shstrndx];
+  if (shdr->sh_offset > ei.size || shdr->sh_size > ei.size - shdr->sh_offset)
     goto file_error;
-  
-  Debug (4, "loading string table of size %zd\n",
-           sec_hdrs[shstrndx].sh_size);
-  stringtab = malloc (sec_hdrs[shstrndx].sh_size);
-  fseek (f, sec_hdrs[shstrndx].sh_offset, SEEK_SET);
-  if (fread (stringtab, 1, sec_hdrs[shstrndx].sh_size, f) != sec_hdrs[shstrndx].sh_size)
-    goto file_error;
-  
-  for (i = 1; i < ehdr.e_shnum && *buf == NULL; i++)
-    {
-      char *secname = &stringtab[sec_hdrs[i].sh_name];
+  stringtab = (char *) ei.image + shdr->sh_offset;
 
-      if (strcmp (secname, ".debug_frame") == 0)
-        {
-          *bufsize = sec_hdrs[i].sh_size;
-          *buf = malloc (*bufsize);
+  for (i = 1; i < ehdr->e_shnum && fdesc->debug_frame_map == NULL; i++)
+    {
+      char *secname;
 
-          fseek (f, sec_hdrs[i].sh_offset, SEEK_SET);
-          if (fread (*buf, 1, *bufsize, f) != *bufsize)
-            goto file_error;
+      shdr = &sec_hdrs[i];
+      if (shdr->sh_name >= sec_hdrs[ehdr->e_shstrndx].sh_size
+          || shdr->sh_type == SHT_NOBITS
+          || shdr->sh_offset > ei.size
+          || shdr->sh_size > ei.size - shdr->sh_offset)
+        continue;
+      secname = &stringtab[shdr->sh_name];
 
-          Debug (4, "read %zd bytes of .debug_frame from offset %zd\n",
-                 *bufsize, sec_hdrs[i].sh_offset);
+      if (strcmp (secname, ".debug_frame") == 0 && shdr->sh_size > 0)
+        {
+          offset = shdr->sh_offset & ~((size_t) getpagesize () - 1);
+          fdesc->debug_frame_map_size = shdr->sh_offset + shdr->sh_size
+                                        - offset;
+          fdesc->debug_frame_map = mmap (NULL, fdesc->debug_frame_map_size,
+                                         PROT_READ, MAP_PRIVATE, fd, offset);
+          if (fdesc->debug_frame_map == MAP_FAILED)
+            {
+              fdesc->debug_frame_map = NULL;
+              goto file_error;
+            }
+          fdesc->debug_frame = ((char *) fdesc->debug_frame_map
+                                + (shdr->sh_offset - offset));
+          fdesc->debug_frame_size = shdr->sh_size;
+          fdesc->index_key = debug_frame_index_key (&st, shdr);
+
+          Debug (4, "mapped %zd bytes of .debug_frame from offset %zd\n",
+                 fdesc->debug_frame_size, (size_t) shdr->sh_offset);
         }
       else if (strcmp (secname, ".gnu_debuglink") == 0)
         {
-          linksize = sec_hdrs[i].sh_size;
-          linkbuf = malloc (linksize);
+          linksize = shdr->sh_size;
+          linkbuf = (char *) ei.image + shdr->sh_offset;
 
-          fseek (f, sec_hdrs[i].sh_offset, SEEK_SET);
-          if (fread (linkbuf, 1, linksize, f) != linksize)
-            goto file_error;
-
-          Debug (4, "read %zd bytes of .gnu_debuglink from offset %zd\n",
-                 linksize, sec_hdrs[i].sh_offset);
+          Debug (4, "found %zd bytes of .gnu_debuglink at offset %zd\n",
+                 linksize, (size_t) shdr->sh_offset);
         }
     }
 
-  free (stringtab);
-  free (sec_hdrs);
-
-  fclose (f);
+  close (fd);
 
   /* Ignore separate debug files which contain a .gnu_debuglink section. */
   if (linkbuf && is_local == -1)
     {
-      free (linkbuf);
+      if (fdesc->debug_frame_map)
+        munmap (fdesc->debug_frame_map, fdesc->debug_frame_map_size);
+      fdesc->debug_frame = NULL;
+      fdesc->debug_frame_size = 0;
+      fdesc->debug_frame_map = NULL;
+      munmap (ei.image, ei.size);
       return 1;
     }
 
-  if (*buf == NULL && linkbuf != NULL && memchr (linkbuf, 0, linksize) != NULL)
+  if (fdesc->debug_frame == NULL && linkbuf != NULL
+      && memchr (linkbuf, 0, linksize) != NULL)
     {
       char *newname, *basedir, *p;
       static const char *debugdir = "/usr/lib/debug";
@@ -197,14 +534,14 @@ load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
       strcpy (newname, basedir);
       strcat (newname, "/");
       strcat (newname, linkbuf);
-      ret = load_debug_frame (newname, buf, bufsize, -1);
+      ret = load_debug_frame (newname, fdesc, -1);
 
       if (ret == 1)
         {
           strcpy (newname, basedir);
           strcat (newname, "/.debug/");
           strcat (newname, linkbuf);
-          ret = load_debug_frame (newname, buf, bufsize, -1);
+          ret = load_debug_frame (newname, fdesc, -1);
         }
 
       if (ret == 1 && is_local == 1)
@@ -213,26 +550,144 @@ load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
           strcat (newname, basedir);
           strcat (newname, "/");
           strcat (newname, linkbuf);
-          ret = load_debug_frame (newname, buf, bufsize, -1);
+          ret = load_debug_frame (newname, fdesc, -1);
         }
 
       free (basedir);
       free (newname);
     }
-  free (linkbuf);
+  munmap (ei.image, ei.size);
 
   return 0;
 
 /* An error reading image file. Release resources and return error code */
 file_error:
-  free(stringtab);
-  free(sec_hdrs);
-  free(linkbuf);
-  fclose(f);
+  munmap (ei.image, ei.size);
+  close (fd);
 
   return 1;
 }
 
+/* Return the name of the file the complete index of FDESC is saved to,
+   or NULL if indexes are not saved.  */
+
+static char *
+debug_frame_index_file (struct unw_debug_frame_list *fdesc, const char *name)
+{
+  const char *dir = getenv ("UNW_DEBUG_FRAME_INDEX_DIR");
+  const char *base = strrchr (name, '/');
+  char *path;
+  size_t len;
+
+  if (!dir || !*dir)
+    return NULL;
+  base = base ? base + 1 : name;
+
+  len = strlen (dir) + strlen (base) + 32;
+  path = malloc (len);
+  if (path)
+    snprintf (path, len, "%s/%s.%016llx.dfi", dir, base,
+              (unsigned long long) fdesc->index_key);
+  return path;
+}
+
+/* Load the index saved in FDESC->index_file, if it is there and
+   matches FDESC.  */
+
+static void
+debug_frame_index_load (struct unw_debug_frame_list *fdesc)
+{
+  struct debug_frame_index_file hdr;
+  struct unw_debug_frame_index *index;
+  size_t size, i;
+  int fd;
+
+  fd = open (fdesc->index_file, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  if (read (fd, &hdr, sizeof (hdr)) != sizeof (hdr)
+      || memcmp (hdr.magic, debug_frame_index_magic, sizeof (hdr.magic)) != 0
+      || hdr.key != fdesc->index_key
+      || hdr.debug_frame_size != fdesc->debug_frame_size
+      || hdr.count > fdesc->debug_frame_size / sizeof (struct table_entry))
+    {
+      close (fd);
+      return;
+    }
+
+  size = hdr.count * sizeof (struct table_entry);
+  index = malloc (sizeof (*index) + size);
+  if (!index)
+    {
+      close (fd);
+      return;
+    }
+  index->prev = NULL;
+  index->size = hdr.count;
+  index->table = (struct table_entry *) (index + 1);
+  if (read (fd, index->table, size) != (ssize_t) size)
+    {
+      free (index);
+      close (fd);
+      return;
+    }
+  close (fd);
+
+  for (i = 0; i < index->size; ++i)
+    if ((uint32_t) index->table[i].fde_offset >= fdesc->debug_frame_size
+        || (i > 0 && (index->table[i].start_ip_offset
+                      < index->table[i - 1].start_ip_offset)))
+      {
+        Debug (1, "ignoring corrupt index `%s'\n", fdesc->index_file);
+        free (index);
+        return;
+      }
+
+  Debug (4, "loaded %zd FDEs from `%s'\n", index->size, fdesc->index_file);
+  fdesc->index = index;
+  fdesc->index_end = fdesc->debug_frame_size;
+}
+
+static void
+debug_frame_index_save (struct unw_debug_frame_list *fdesc)
+{
+  struct unw_debug_frame_index *index = fdesc->index;
+  struct debug_frame_index_file hdr;
+  size_t len = strlen (fdesc->index_file) + 32;
+  size_t size = index->size * sizeof (struct table_entry);
+  char *tmp;
+  int fd, ok;
+
+  tmp = malloc (len);
+  if (!tmp)
+    return;
+  /* Write to a temporary file first, so that a concurrent run never
+     sees a partial index.  */
+  snprintf (tmp, len, "%s.%d", fdesc->index_file, (int) getpid ());
+  fd = open (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      free (tmp);
+      return;
+    }
+
+  memset (&hdr, 0, sizeof (hdr));
+  memcpy (hdr.magic, debug_frame_index_magic, sizeof (hdr.magic));
+  hdr.key = fdesc->index_key;
+  hdr.debug_frame_size = fdesc->debug_frame_size;
+  hdr.count = index->size;
+  ok = (write (fd, &hdr, sizeof (hdr)) == sizeof (hdr)
+        && write (fd, index->table, size) == (ssize_t) size);
+  ok = (close (fd) == 0) && ok;
+
+  if (ok && rename (tmp, fdesc->index_file) == 0)
+    Debug (4, "saved %zd FDEs to `%s'\n", index->size, fdesc->index_file);
+  else
+    unlink (tmp);
+  free (tmp);
+}
+
 /* Locate the binary which originated the contents of address ADDR. Return
    the name of the binary in *name (space is allocated by the caller)
    Returns 0 if a binary is successfully found, or 1 if an error occurs.  */
@@ -241,26 +696,19 @@ static int
 find_binary_for_address (unw_word_t ip, char *name, size_t name_size)
 {
 #if defined(__linux) && (!UNW_REMOTE_ONLY)
-  struct map_iterator mi;
-  int found = 0;
+  char path[PATH_MAX];
   int pid = getpid ();
   unsigned long segbase, mapoff, hi;
+  size_t len;
 
-  maps_init (&mi, pid);
-  while (maps_next (&mi, &segbase, &hi, &mapoff))
-    if (ip >= segbase && ip < hi)
-      {
-        size_t len = strlen (mi.path);
+  if (!maps_find (pid, ip, &segbase, &hi, &mapoff, path, sizeof (path)))
+    return 1;
 
-        if (len + 1 <= name_size)
-          {
-            memcpy (name, mi.path, len + 1);
-            found = 1;
-          }
-        break;
-      }
-  maps_close (&mi);
-  return !found;
+  len = strlen (path);
+  if (len + 1 > name_size)
+    return 1;
+  memcpy (name, path, len + 1);
+  return 0;
 #endif
 
   return 1;
@@ -277,8 +725,6 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
   char path[PATH_MAX];
   char *name = path;
   int err;
-  char *buf;
-  size_t bufsize;
 
   /* First, see if we loaded this frame already.  */
 
@@ -305,58 +751,30 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
   else
     name = (char*) dlname;
 
-  err = load_debug_frame (name, &buf, &bufsize, as == unw_local_addr_space);
-  
-  if (!err)
-    {
-      fdesc = malloc (sizeof (struct unw_debug_frame_list));
-
-      fdesc->start = start;
-      fdesc->end = end;
-      fdesc->debug_frame = buf;
-      fdesc->debug_frame_size = bufsize;
-      fdesc->index = NULL;
-      fdesc->next = as->debug_frames;
-      
-      as->debug_frames = fdesc;
-    }
-  
-  return fdesc;
-}
-
-struct debug_frame_tab
-  {
-    struct table_entry *tab;
-    uint32_t length;
-    uint32_t size;
-  };
-
-static void
-debug_frame_tab_append (struct debug_frame_tab *tab,
-                        unw_word_t fde_offset, unw_word_t start_ip)
-{
-  unsigned int length = tab->length;
+  fdesc = calloc (1, sizeof (struct unw_debug_frame_list));
+  if (!fdesc)
+    return 0;
 
-  if (length == tab->size)
+  err = load_debug_frame (name, fdesc, as == unw_local_addr_space);
+  if (err)
     {
-      tab->size *= 2;
-      tab->tab = realloc (tab->tab, sizeof (struct table_entry) * tab->size);
+      free (fdesc);
+      return 0;
     }
-  
-  tab->tab[length].fde_offset = fde_offset;
-  tab->tab[length].start_ip_offset = start_ip;
-  
-  tab->length = length + 1;
-}
 
-static void
-debug_frame_tab_shrink (struct debug_frame_tab *tab)
-{
-  if (tab->size > tab->length)
+  fdesc->start = start;
+  fdesc->end = end;
+  if (fdesc->debug_frame_size > 0)
     {
-      tab->tab = realloc (tab->tab, sizeof (struct table_entry) * tab->length);
-      tab->size = tab->length;
+      fdesc->index_file = debug_frame_index_file (fdesc, name);
+      if (fdesc->index_file)
+        debug_frame_index_load (fdesc);
     }
+  fdesc->next = as->debug_frames;
+
+  as->debug_frames = fdesc;
+
+  return fdesc;
 }
 
 static int
@@ -372,6 +790,175 @@ debug_frame_tab_compare (const void *a, const void *b)
     return 0;
 }
 
+/* Return whether the index of FDESC finds the FDE covering REL_IP, if
+   there is one.  */
+
+static int
+debug_frame_index_covers (struct unw_debug_frame_list *fdesc,
+                          unw_word_t rel_ip)
+{
+  struct unw_debug_frame_index *index = fdesc->index;
+  const struct table_entry *e;
+  unw_proc_info_t pi;
+  unw_word_t fde_addr;
+
+  if (fdesc->index_end >= fdesc->debug_frame_size)
+    return 1;
+  if (!index)
+    return 0;
+
+  e = lookup (index->table, index->size * sizeof (struct table_entry), rel_ip);
+  if (!e)
+    return 0;
+
+  fde_addr = (unw_word_t) (uintptr_t) (fdesc->debug_frame + e->fde_offset);
+  if (dwarf_extract_proc_info_from_fde (unw_local_addr_space,
+                                        unw_get_accessors (unw_local_addr_space),
+                                        &fde_addr, &pi,
+                                        (uintptr_t) fdesc->debug_frame, 0, 1,
+                                        NULL) < 0)
+    return 0;
+  return rel_ip >= pi.start_ip && rel_ip < pi.end_ip;
+}
+
+/* Index more FDEs of FDESC, until one covering REL_IP is found and the
+   index has at least doubled, or the end of the section is reached.  */
+
+static void
+debug_frame_index_extend (struct unw_debug_frame_list *fdesc,
+                          unw_word_t rel_ip)
+{
+  struct unw_debug_frame_index *old = fdesc->index, *index;
+  char *buf = fdesc->debug_frame;
+  unw_word_t addr, buf_end, item_start, item_end = 0;
+  unw_accessors_t *a;
+  size_t old_length, length, size, min_new;
+  uint32_t u32val = 0;
+  uint64_t cie_id = 0;
+  int found = 0;
+
+  length = old_length = old ? old->size : 0;
+  min_new = length > DEBUG_FRAME_INDEX_MIN ? length : DEBUG_FRAME_INDEX_MIN;
+  size = length + min_new;
+  index = malloc (sizeof (*index) + size * sizeof (struct table_entry));
+  if (!index)
+    return;
+  index->table = (struct table_entry *) (index + 1);
+  if (length)
+    memcpy (index->table, old->table, length * sizeof (struct table_entry));
+
+  a = unw_get_accessors (unw_local_addr_space);
+  addr = (unw_word_t) (uintptr_t) (buf + fdesc->index_end);
+  buf_end = (unw_word_t) (uintptr_t) (buf + fdesc->debug_frame_size);
+
+  while (addr < buf_end && !(found && length - old_length >= min_new))
+    {
+      uint64_t id_for_cie;
+      item_start = addr;
+
+      dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
+
+      if (u32val == 0)
+        {
+          addr = buf_end;
+          break;
+        }
+      else if (u32val != 0xffffffff)
+        {
+          uint32_t cie_id32 = 0;
+          item_end = addr + u32val;
+          dwarf_readu32 (unw_local_addr_space, a, &addr, &cie_id32, NULL);
+          cie_id = cie_id32;
+          id_for_cie = 0xffffffff;
+        }
+      else
+        {
+          uint64_t u64val = 0;
+          /* Extended length.  */
+          dwarf_readu64 (unw_local_addr_space, a, &addr, &u64val, NULL);
+          item_end = addr + u64val;
+
+          dwarf_readu64 (unw_local_addr_space, a, &addr, &cie_id, NULL);
+          id_for_cie = 0xffffffffffffffffull;
+        }
+
+      if (item_end > buf_end || item_end <= item_start)
+        {
+          Debug (1, "truncated .debug_frame entry at %lx\n", (long) item_start);
+          addr = buf_end;
+          break;
+        }
+
+      if (cie_id != id_for_cie)
+        {
+          unw_word_t fde_addr = item_start;
+          unw_proc_info_t this_pi;
+          int err;
+
+          err = dwarf_extract_proc_info_from_fde (unw_local_addr_space,
+                                                  a, &fde_addr,
+                                                  &this_pi,
+                                                  (uintptr_t) buf, 0, 1,
+                                                  NULL);
+          if (err == 0)
+            {
+              Debug (15, "start_ip = %lx, end_ip = %lx\n",
+                     (long) this_pi.start_ip, (long) this_pi.end_ip);
+              if (length == size)
+                {
+                  struct unw_debug_frame_index *grown;
+
+                  size *= 2;
+                  grown = realloc (index, sizeof (*index)
+                                   + size * sizeof (struct table_entry));
+                  if (!grown)
+                    {
+                      free (index);
+                      return;
+                    }
+                  index = grown;
+                  index->table = (struct table_entry *) (index + 1);
+                }
+              index->table[length].fde_offset = item_start - (uintptr_t) buf;
+              index->table[length].start_ip_offset = this_pi.start_ip;
+              ++length;
+              if (rel_ip >= this_pi.start_ip && rel_ip < this_pi.end_ip)
+                found = 1;
+            }
+        }
+
+      addr = item_end;
+    }
+
+  qsort (index->table, length, sizeof (struct table_entry),
+         debug_frame_tab_compare);
+  index->size = length;
+  /* Lookups may still be using the older indexes, which are only freed
+     along with FDESC.  */
+  index->prev = old;
+  fdesc->index = index;
+  fdesc->index_end = addr - (uintptr_t) buf;
+  Debug (15, "indexed %zd FDEs, %zd of %zd bytes\n", length,
+         fdesc->index_end, fdesc->debug_frame_size);
+
+  if (fdesc->index_end >= fdesc->debug_frame_size && fdesc->index_file)
+    debug_frame_index_save (fdesc);
+}
+
+/* Make sure the index of FDESC can answer a lookup of REL_IP.  */
+
+static void
+debug_frame_index_prepare (struct unw_debug_frame_list *fdesc,
+                           unw_word_t rel_ip)
+{
+  intrmask_t saved_mask;
+
+  lock_acquire (&debug_frame_index_lock, saved_mask);
+  if (!debug_frame_index_covers (fdesc, rel_ip))
+    debug_frame_index_extend (fdesc, rel_ip);
+  lock_release (&debug_frame_index_lock, saved_mask);
+}
+
 PROTECTED int
 dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
                         unw_word_t segbase, const char* obj_name,
@@ -379,8 +966,6 @@ dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
 {
   unw_dyn_info_t *di;
   struct unw_debug_frame_list *fdesc = 0;
-  unw_accessors_t *a;
-  unw_word_t addr;
 
   Debug (15, "Trying to find .debug_frame for %s\n", obj_name);
   di = di_debug;
@@ -394,112 +979,16 @@ dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
     }
   else
     {
-      char *buf;
-      size_t bufsize;
-      unw_word_t item_start, item_end = 0;
-      uint32_t u32val = 0;
-      uint64_t cie_id = 0;
-      struct debug_frame_tab tab;
-
       Debug (15, "loaded .debug_frame\n");
 
-      buf = fdesc->debug_frame;
-      bufsize = fdesc->debug_frame_size;
-
-      if (bufsize == 0)
+      if (fdesc->debug_frame_size == 0)
        {
          Debug (15, "zero-length .debug_frame\n");
          return found;
        }
 
-      /* Now create a binary-search table, if it does not already exist.  */
-      if (!fdesc->index)
-       {
-         addr = (unw_word_t) (uintptr_t) buf;
-
-         a = unw_get_accessors (unw_local_addr_space);
-
-         /* Find all FDE entries in debug_frame, and make into a sorted
-            index.  */
-
-         tab.length = 0;
-         tab.size = 16;
-         tab.tab = calloc (tab.size, sizeof (struct table_entry));
-
-         while (addr < (unw_word_t) (uintptr_t) (buf + bufsize))
-           {
-             uint64_t id_for_cie;
-             item_start = addr;
-
-             dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
-
-             if (u32val == 0)
-               break;
-             else if (u32val != 0xffffffff)
-               {
-                 uint32_t cie_id32 = 0;
-                 item_end = addr + u32val;
-                 dwarf_readu32 (unw_local_addr_space, a, &addr, &cie_id32,
-                                NULL);
-                 cie_id = cie_id32;
-                 id_for_cie = 0xffffffff;
-               }
-             else
-               {
-                 uint64_t u64val = 0;
-                 /* Extended length.  */
-                 dwarf_readu64 (unw_local_addr_space, a, &addr, &u64val, NULL);
-                 item_end = addr + u64val;
-
-                 dwarf_readu64 (unw_local_addr_space, a, &addr, &cie_id, NULL);
-                 id_for_cie = 0xffffffffffffffffull;
-               }
-
-             /*Debug (1, "CIE/FDE id = %.8x\n", (int) cie_id);*/
-
-             if (cie_id == id_for_cie)
-               ;
-             /*Debug (1, "Found CIE at %.8x.\n", item_start);*/
-             else
-               {
-                 unw_word_t fde_addr = item_start;
-                 unw_proc_info_t this_pi;
-                 int err;
-
-                 /*Debug (1, "Found FDE at %.8x\n", item_start);*/
-
-                 err = dwarf_extract_proc_info_from_fde (unw_local_addr_space,
-                                                         a, &fde_addr,
-                                                         &this_pi,
-                                                         (uintptr_t) buf, 0, 1,
-                                                         NULL);
-                 if (err == 0)
-                   {
-                     Debug (15, "start_ip = %lx, end_ip = %lx\n",
-                            (long) this_pi.start_ip, (long) this_pi.end_ip);
-                     debug_frame_tab_append (&tab,
-                                             item_start - (unw_word_t) (uintptr_t) buf,
-                                             this_pi.start_ip);
-                   }
-                 /*else
-                   Debug (1, "FDE parse failed\n");*/
-               }
-
-             addr = item_end;
-           }
-
-         debug_frame_tab_shrink (&tab);
-         qsort (tab.tab, tab.length, sizeof (struct table_entry),
-                debug_frame_tab_compare);
-         /* for (i = 0; i < tab.length; i++)
-            {
-            fprintf (stderr, "ip %x, fde offset %x\n",
-            (int) tab.tab[i].start_ip_offset,
-            (int) tab.tab[i].fde_offset);
-            }*/
-         fdesc->index = tab.tab;
-         fdesc->index_size = tab.length;
-       }
+      /* The binary-search table is built or extended by
+         dwarf_search_unwind_table, only if it needs it.  */
 
       di->format = UNW_INFO_FORMAT_TABLE;
       di->start_ip = fdesc->start;
@@ -554,6 +1043,10 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
   Debug (15, "checking %s, base=0x%lx)\n",
          info->dlpi_name, (long) info->dlpi_addr);
 
+  if (size >= offsetof (struct dl_phdr_info, dlpi_subs)
+              + sizeof (info->dlpi_subs))
+    cb_data->dl_generation = info->dlpi_adds + info->dlpi_subs;
+
   phdr = info->dlpi_phdr;
   load_base = info->dlpi_addr;
   p_text = NULL;
@@ -708,6 +1201,10 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
   return found;
 }
 
+static int search_unwind_table (unw_addr_space_t, unw_word_t,
+                                unw_dyn_info_t *, unw_proc_info_t *, int,
+                                void *, unsigned long long);
+
 HIDDEN int
 dwarf_find_proc_info (unw_addr_space_t as, unw_word_t ip,
                       unw_proc_info_t *pi, int need_unwind_info, void *arg)
@@ -741,52 +1238,30 @@ dwarf_find_proc_info (unw_addr_space_t as, unw_word_t ip,
 
   /* search the table: */
   if (cb_data.di.format != -1)
-    ret = dwarf_search_unwind_table (as, ip, &cb_data.di,
-                                      pi, need_unwind_info, arg);
+    ret = search_unwind_table (as, ip, &cb_data.di, pi, need_unwind_info,
+                               arg, cb_data.dl_generation);
   else
     ret = -UNW_ENOINFO;
 
   if (ret == -UNW_ENOINFO && cb_data.di_debug.format != -1)
-    ret = dwarf_search_unwind_table (as, ip, &cb_data.di_debug, pi,
-                                     need_unwind_info, arg);
+    ret = search_unwind_table (as, ip, &cb_data.di_debug, pi,
+                               need_unwind_info, arg,
+                               cb_data.dl_generation);
   return ret;
 }
 
-static inline const struct table_entry *
-lookup (const struct table_entry *table, size_t table_size, int32_t rel_ip)
-{
-  unsigned long table_len = table_size / sizeof (struct table_entry);
-  const struct table_entry *e = NULL;
-  unsigned long lo, hi, mid;
-
-  /* do a binary search for right entry: */
-  for (lo = 0, hi = table_len; lo < hi;)
-    {
-      mid = (lo + hi) / 2;
-      e = table + mid;
-      Debug (15, "e->start_ip_offset = %lx\n", (long) e->start_ip_offset);
-      if (rel_ip < e->start_ip_offset)
-        hi = mid;
-      else
-        lo = mid + 1;
-    }
-  if (hi <= 0)
-        return NULL;
-  e = table + hi - 1;
-  return e;
-}
-
 #endif /* !UNW_REMOTE_ONLY */
 
 #ifndef UNW_LOCAL_ONLY
 
 /* Lookup an unwind-table entry in remote memory.  Returns 1 if an
    entry is found, 0 if no entry is found, negative if an error
-   occurred reading remote memory.  */
+   occurred reading remote memory.  The access_mem() calls made are
+   added to *READS, unless READS is NULL.  */
 static int
 remote_lookup (unw_addr_space_t as,
                unw_word_t table, size_t table_size, int32_t rel_ip,
-               struct table_entry *e, void *arg)
+               struct table_entry *e, unsigned long *reads, void *arg)
 {
   unsigned long table_len = table_size / sizeof (struct table_entry);
   unw_accessors_t *a = unw_get_accessors (as);
@@ -800,6 +1275,8 @@ remote_lookup (unw_addr_space_t as,
     {
       mid = (lo + hi) / 2;
       e_addr = table + mid * sizeof (struct table_entry);
+      if (reads)
+        *reads += sizeof (int32_t);
       if ((ret = dwarf_reads32 (as, a, &e_addr, &start, arg)) < 0)
         return ret;
 
@@ -811,12 +1288,176 @@ remote_lookup (unw_addr_space_t as,
   if (hi <= 0)
     return 0;
   e_addr = table + (hi - 1) * sizeof (struct table_entry);
+  if (reads)
+    *reads += 2 * sizeof (int32_t);
   if ((ret = dwarf_reads32 (as, a, &e_addr, &e->start_ip_offset, arg)) < 0
    || (ret = dwarf_reads32 (as, a, &e_addr, &e->fde_offset, arg)) < 0)
     return ret;
   return 1;
 }
 
+/* Searching a table in remote memory reads every byte of the entries it
+   probes with a separate access_mem() call, which is a syscall with
+   libunwind-ptrace.  Once the searches of a table have made as many
+   calls as there are words in it, the table is copied into local memory
+   and searched there from then on: that never costs more than twice
+   copying it upfront, and nothing for objects seldom looked up.  With
+   an access_mem_range() accessor, the copy is a single read and is made
+   the first time the table is searched.  Large copies are indexed like
+   local tables.  The copies go away with unw_flush_cache(), which is how
+   the caller tells that the memory map changed; with UNW_CACHE_NONE,
+   it may change at any time, and tables are never copied.  */
+
+static struct unw_remote_table *
+get_remote_table (unw_addr_space_t as, unw_word_t addr, size_t size)
+{
+  struct unw_remote_table *t, *other;
+
+  if ((t = find_table (as->remote_tables, addr, size, 0, 0)))
+    return t;
+  if (!(t = calloc (1, sizeof (*t))))
+    return NULL;
+  t->addr = addr;
+  t->size = size;
+  if ((other = add_table (as, t)) != t)
+    free (t);
+  return other;
+}
+
+/* The byte at offset OFF of a word read with access_mem(), the way
+   dwarf_readu8() extracts it.  */
+static inline uint8_t
+word_byte (unw_word_t val, unw_word_t off)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  return (uint8_t) (val >> 8 * off);
+#else
+  return (uint8_t) (val >> 8 * (sizeof (unw_word_t) - 1 - off));
+#endif
+}
+
+static int
+copy_remote_table (unw_addr_space_t as, struct unw_remote_table *t,
+                   void *arg)
+{
+  unw_accessors_t *a = unw_get_accessors (as);
+  unw_word_t start = t->addr & -sizeof (unw_word_t);
+  size_t i, j, nwords, nentries = t->size / sizeof (struct table_entry);
+  struct unw_table_index *index;
+  struct table_entry *table;
+  size_t size;
+  unw_word_t *words, off;
+  uint32_t val[2];
+  uint8_t b[4];
+  int k, ret;
+
+  table = malloc (nentries * sizeof (struct table_entry));
+  if (!table)
+    return -UNW_ENOMEM;
+
+  /* The entries are laid out in memory the way we want them.  */
+  if (a->access_mem_range
+      && tdep_big_endian (as) == (__BYTE_ORDER == __BIG_ENDIAN)
+      && (*a->access_mem_range) (as, t->addr, table, t->size, arg) == 0)
+    goto publish;
+
+  nwords = (t->addr + t->size - start + sizeof (unw_word_t) - 1)
+           / sizeof (unw_word_t);
+  words = malloc (nwords * sizeof (unw_word_t));
+  if (!words)
+    {
+      free (table);
+      return -UNW_ENOMEM;
+    }
+
+  for (i = 0; i < nwords; ++i)
+    if ((ret = (*a->access_mem) (as, start + i * sizeof (unw_word_t),
+                                 &words[i], 0, arg)) < 0)
+      {
+        free (words);
+        free (table);
+        return ret;
+      }
+
+  for (i = 0; i < nentries; ++i)
+    {
+      for (k = 0; k < 2; ++k)
+        {
+          for (j = 0; j < 4; ++j)
+            {
+              off = t->addr - start + i * sizeof (struct table_entry)
+                    + k * sizeof (int32_t) + j;
+              b[j] = word_byte (words[off / sizeof (unw_word_t)],
+                                off % sizeof (unw_word_t));
+            }
+          if (tdep_big_endian (as))
+            val[k] = (uint32_t) b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+          else
+            val[k] = (uint32_t) b[3] << 24 | b[2] << 16 | b[1] << 8 | b[0];
+        }
+      table[i].start_ip_offset = val[0];
+      table[i].fde_offset = val[1];
+    }
+  free (words);
+
+ publish:
+  if (!cmpxchg_ptr (&t->table, NULL, table))
+    {
+      free (table);     /* another thread was faster */
+      return 0;
+    }
+  Debug (3, "copied remote table at 0x%lx (%zu entries)\n",
+         (long) t->addr, nentries);
+
+  if ((size = table_index_size (nentries)) && (index = malloc (size)))
+    {
+      table_index_init (index, table, nentries);
+      cmpxchg_ptr (&t->index, NULL, index);
+    }
+  return 0;
+}
+
+/* Lookup an unwind-table entry, in the local copy of the table once
+   there is one.  */
+static int
+remote_table_lookup (unw_addr_space_t as,
+                     unw_word_t table, size_t table_size, int32_t rel_ip,
+                     struct table_entry *e, void *arg)
+{
+  const struct table_entry *f;
+  struct unw_remote_table *t;
+  unsigned long reads = 0;
+  int ret;
+
+  /* Nothing is kept of the table, nor of what searching it costs.  */
+  if (as->caching_policy == UNW_CACHE_NONE)
+    return remote_lookup (as, table, table_size, rel_ip, e, NULL, arg);
+
+  retire_read_begin (&as->table_retire);
+  t = get_remote_table (as, table, table_size);
+  /* Copy the table once its searches have made as many access_mem()
+     calls as copying it word by word takes.  */
+  if (t && !t->table
+      && (unw_get_accessors (as)->access_mem_range
+          || t->reads >= table_size / sizeof (unw_word_t))
+      && copy_remote_table (as, t, arg) < 0)
+    t = NULL;
+
+  if (t && t->table)
+    {
+      if ((f = table_lookup (t, t->table, rel_ip)))
+        *e = *f;
+      retire_read_end (&as->table_retire);
+      return f != NULL;
+    }
+
+  ret = remote_lookup (as, table, table_size, rel_ip, e, &reads, arg);
+  if (t)
+    t->reads += reads;
+  retire_read_end (&as->table_retire);
+  return ret;
+}
+
 #endif /* !UNW_LOCAL_ONLY */
 
 static int is_remote_table(int format)
@@ -825,10 +1466,12 @@ static int is_remote_table(int format)
           format == UNW_INFO_FORMAT_IP_OFFSET);
 }
 
-PROTECTED int
-dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
-                           unw_dyn_info_t *di, unw_proc_info_t *pi,
-                           int need_unwind_info, void *arg)
+/* DL_GENERATION is what dl_iterate_phdr() told of the objects loaded
+   and unloaded when DI was found, or 0 if unknown.  */
+static int
+search_unwind_table (unw_addr_space_t as, unw_word_t ip, unw_dyn_info_t *di,
+                     unw_proc_info_t *pi, int need_unwind_info, void *arg,
+                     unsigned long long dl_generation)
 {
   const struct table_entry *e = NULL, *table;
   unw_word_t ip_base = 0, segbase = 0, fde_addr;
@@ -859,14 +1502,19 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
       assert(di->format == UNW_INFO_FORMAT_TABLE);
 #ifndef UNW_REMOTE_ONLY
       struct unw_debug_frame_list *fdesc = (void *) di->u.ti.table_data;
+      struct unw_debug_frame_index *index;
 
       /* UNW_INFO_FORMAT_TABLE (i.e. .debug_frame) is read from local address
          space.  Both the index and the unwind tables live in local memory, but
          the address space to check for properties like the address size and
          endianness is the target one.  */
       as = unw_local_addr_space;
-      table = fdesc->index;
-      table_len = fdesc->index_size * sizeof (struct table_entry);
+#ifdef CONFIG_DEBUG_FRAME
+      debug_frame_index_prepare (fdesc, ip - di->u.ti.segbase);
+#endif
+      index = fdesc->index;
+      table = index ? index->table : NULL;
+      table_len = index ? index->size * sizeof (struct table_entry) : 0;
       debug_frame_base = (uintptr_t) fdesc->debug_frame;
 #endif
     }
@@ -883,15 +1531,30 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
 #ifndef UNW_REMOTE_ONLY
   if (as == unw_local_addr_space)
     {
-      e = lookup (table, table_len, ip - ip_base);
+      struct unw_remote_table *t = NULL;
+
+      /* Not the .debug_frame index, which is replaced as it grows and
+         would leave a record behind each time.  */
+      if (is_remote_table (di->format)
+          && table_len >= TABLE_INDEX_MIN_ENTRIES * sizeof (struct table_entry))
+        {
+          retire_read_begin (&as->table_retire);
+          if ((t = get_local_table (as, table, table_len, segbase,
+                                    dl_generation)))
+            e = table_lookup (t, table, ip - ip_base);
+          retire_read_end (&as->table_retire);
+        }
+      if (!t)
+        e = lookup (table, table_len, ip - ip_base);
     }
   else
 #endif
     {
 #ifndef UNW_LOCAL_ONLY
       segbase = di->u.rti.segbase;
-      if ((ret = remote_lookup (as, (uintptr_t) table, table_len,
-                                ip - ip_base, &ent, arg)) < 0)
+      ret = remote_table_lookup (as, (uintptr_t) table, table_len,
+                                 ip - ip_base, &ent, arg);
+      if (ret < 0)
         return ret;
       if (ret)
         e = &ent;
@@ -938,6 +1601,14 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
   return 0;
 }
 
+PROTECTED int
+dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
+                           unw_dyn_info_t *di, unw_proc_info_t *pi,
+                           int need_unwind_info, void *arg)
+{
+  return search_unwind_table (as, ip, di, pi, need_unwind_info, arg, 0);
+}
+
 HIDDEN void
 dwarf_put_unwind_info (unw_addr_space_t as, unw_proc_info_t *pi, void *arg)
 {
@@ -55,341 +55,497 @@ set_reg (dwarf_state_record_t *sr, unw_word_t regnum, dwarf_where_t where,
   sr->rs_current.reg[regnum].val = val;
 }
 
-/* Run a CFI program to update the register state.  */
+/* Read the CFI instruction at *ADDR into INSN.  Like DWARF expressions,
+   see decode_op(), instructions that only differ by their encoding are
+   made one: DW_CFA_advance_loc advances by INSN->val bytes, DW_CFA_offset
+   saves INSN->regnum at CFA+INSN->val, DW_CFA_restore restores any
+   register, DW_CFA_def_cfa and DW_CFA_def_cfa_offset take a factored
+   offset; DW_CFA_set_loc takes the address it sets.  */
 static int
-run_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
-                 unw_word_t ip, unw_word_t *addr, unw_word_t end_addr,
-                 struct dwarf_cie_info *dci)
+decode_cfa (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
+            struct dwarf_cie_info *dci, const unw_proc_info_t *pi,
+            dwarf_cfa_insn_t *insn, void *arg)
 {
-  unw_word_t curr_ip, operand = 0, regnum, val, len, fde_encoding;
-  dwarf_reg_state_t *rs_stack = NULL, *new_rs, *old_rs;
-  unw_addr_space_t as;
-  unw_accessors_t *a;
+  unw_word_t operand = 0, regnum, val, len;
   uint8_t u8, op;
   uint16_t u16;
   uint32_t u32;
-  void *arg;
   int ret;
 
-  as = c->as;
-  arg = c->as_arg;
-  if (c->pi.flags & UNW_PI_FLAG_DEBUG_FRAME)
+  if ((ret = dwarf_readu8 (as, a, addr, &op, arg)) < 0)
+    return ret;
+
+  if (op & DWARF_CFA_OPCODE_MASK)
     {
-      /* .debug_frame CFI is stored in local address space.  */
-      as = unw_local_addr_space;
-      arg = NULL;
+      operand = op & DWARF_CFA_OPERAND_MASK;
+      op &= ~DWARF_CFA_OPERAND_MASK;
     }
-  a = unw_get_accessors (as);
-  curr_ip = c->pi.start_ip;
+  insn->op = op;
+  insn->regnum = 0;
+  insn->val = 0;
 
-  /* Process everything up to and including the current 'ip',
-     including all the DW_CFA_advance_loc instructions.  See
-     'c->use_prev_instr' use in 'fetch_proc_info' for details. */
-  while (curr_ip <= ip && *addr < end_addr)
+  switch ((dwarf_cfa_t) op)
     {
-      if ((ret = dwarf_readu8 (as, a, addr, &op, arg)) < 0)
+    case DW_CFA_advance_loc:
+      insn->val = operand * dci->code_align;
+      break;
+
+    case DW_CFA_advance_loc1:
+      if ((ret = dwarf_readu8 (as, a, addr, &u8, arg)) < 0)
+        return ret;
+      insn->op = DW_CFA_advance_loc;
+      insn->val = u8 * dci->code_align;
+      break;
+
+    case DW_CFA_advance_loc2:
+      if ((ret = dwarf_readu16 (as, a, addr, &u16, arg)) < 0)
+        return ret;
+      insn->op = DW_CFA_advance_loc;
+      insn->val = u16 * dci->code_align;
+      break;
+
+    case DW_CFA_advance_loc4:
+      if ((ret = dwarf_readu32 (as, a, addr, &u32, arg)) < 0)
+        return ret;
+      insn->op = DW_CFA_advance_loc;
+      insn->val = u32 * dci->code_align;
+      break;
+
+    case DW_CFA_MIPS_advance_loc8:
+#ifdef UNW_TARGET_MIPS
+      {
+        uint64_t u64;
+
+        if ((ret = dwarf_readu64 (as, a, addr, &u64, arg)) < 0)
+          return ret;
+        insn->op = DW_CFA_advance_loc;
+        insn->val = u64 * dci->code_align;
+        break;
+      }
+#else
+      Debug (1, "DW_CFA_MIPS_advance_loc8 on non-MIPS target\n");
+      return -UNW_EINVAL;
+#endif
+
+    case DW_CFA_offset:
+      regnum = operand;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
+        {
+          Debug (1, "Invalid register number %u in DW_cfa_OFFSET\n",
+                 (unsigned int) regnum);
+          return -UNW_EBADREG;
+        }
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
+        return ret;
+      insn->regnum = regnum;
+      insn->val = val * dci->data_align;
+      break;
+
+    case DW_CFA_offset_extended:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        return ret;
+      insn->op = DW_CFA_offset;
+      insn->regnum = regnum;
+      insn->val = val * dci->data_align;
+      break;
+
+    case DW_CFA_offset_extended_sf:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
         return ret;
+      insn->op = DW_CFA_offset;
+      insn->regnum = regnum;
+      insn->val = val * dci->data_align;
+      break;
+
+    case DW_CFA_GNU_negative_offset_extended:
+      /* A comment in GCC says that this is obsoleted by
+         DW_CFA_offset_extended_sf, but that it's used by older
+         PowerPC code.  */
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        return ret;
+      insn->op = DW_CFA_offset;
+      insn->regnum = regnum;
+      insn->val = -(val * dci->data_align);
+      break;
 
-      if (op & DWARF_CFA_OPCODE_MASK)
+    case DW_CFA_restore:
+      regnum = operand;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
         {
-          operand = op & DWARF_CFA_OPERAND_MASK;
-          op &= ~DWARF_CFA_OPERAND_MASK;
+          Debug (1, "Invalid register number %u in DW_CFA_restore\n",
+                 (unsigned int) regnum);
+          return -UNW_EINVAL;
         }
-      switch ((dwarf_cfa_t) op)
+      insn->regnum = regnum;
+      break;
+
+    case DW_CFA_restore_extended:
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &regnum, arg)) < 0)
+        return ret;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
         {
-        case DW_CFA_advance_loc:
-          curr_ip += operand * dci->code_align;
-          Debug (15, "CFA_advance_loc to 0x%lx\n", (long) curr_ip);
-          break;
+          Debug (1, "Invalid register number %u in "
+                 "DW_CFA_restore_extended\n", (unsigned int) regnum);
+          return -UNW_EINVAL;
+        }
+      insn->op = DW_CFA_restore;
+      insn->regnum = regnum;
+      break;
 
-        case DW_CFA_advance_loc1:
-          if ((ret = dwarf_readu8 (as, a, addr, &u8, arg)) < 0)
-            goto fail;
-          curr_ip += u8 * dci->code_align;
-          Debug (15, "CFA_advance_loc1 to 0x%lx\n", (long) curr_ip);
-          break;
+    case DW_CFA_set_loc:
+      if ((ret = dwarf_read_encoded_pointer (as, a, addr, dci->fde_encoding,
+                                             pi, &insn->val, arg)) < 0)
+        return ret;
+      break;
 
-        case DW_CFA_advance_loc2:
-          if ((ret = dwarf_readu16 (as, a, addr, &u16, arg)) < 0)
-            goto fail;
-          curr_ip += u16 * dci->code_align;
-          Debug (15, "CFA_advance_loc2 to 0x%lx\n", (long) curr_ip);
-          break;
+    case DW_CFA_undefined:
+    case DW_CFA_same_value:
+    case DW_CFA_def_cfa_register:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        return ret;
+      insn->regnum = regnum;
+      break;
 
-        case DW_CFA_advance_loc4:
-          if ((ret = dwarf_readu32 (as, a, addr, &u32, arg)) < 0)
-            goto fail;
-          curr_ip += u32 * dci->code_align;
-          Debug (15, "CFA_advance_loc4 to 0x%lx\n", (long) curr_ip);
-          break;
+    case DW_CFA_register:
+    case DW_CFA_def_cfa:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        return ret;
+      insn->regnum = regnum;
+      insn->val = val;
+      break;
 
-        case DW_CFA_MIPS_advance_loc8:
-#ifdef UNW_TARGET_MIPS
-          {
-            uint64_t u64;
+    case DW_CFA_def_cfa_sf:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
+        return ret;
+      insn->op = DW_CFA_def_cfa;
+      insn->regnum = regnum;
+      insn->val = val * dci->data_align;        /* factored! */
+      break;
 
-            if ((ret = dwarf_readu64 (as, a, addr, &u64, arg)) < 0)
-              goto fail;
-            curr_ip += u64 * dci->code_align;
-            Debug (15, "CFA_MIPS_advance_loc8\n");
-            break;
-          }
+    case DW_CFA_def_cfa_offset:
+    case DW_CFA_GNU_args_size:
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &insn->val, arg)) < 0)
+        return ret;
+      break;
+
+    case DW_CFA_def_cfa_offset_sf:
+      if ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0)
+        return ret;
+      insn->op = DW_CFA_def_cfa_offset;
+      insn->val = val * dci->data_align;        /* factored! */
+      break;
+
+    case DW_CFA_expression:
+    case DW_CFA_val_expression:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        return ret;
+      insn->regnum = regnum;
+      /* FALL THROUGH */
+    case DW_CFA_def_cfa_expression:
+      /* Save the address of the DW_FORM_block for later evaluation. */
+      insn->val = *addr;
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
+        return ret;
+      *addr += len;
+      break;
+
+    case DW_CFA_GNU_window_save:
+#ifdef UNW_TARGET_SPARC
+      break;
 #else
-          Debug (1, "DW_CFA_MIPS_advance_loc8 on non-MIPS target\n");
-          ret = -UNW_EINVAL;
-          goto fail;
+      /* FALL THROUGH */
 #endif
+    case DW_CFA_lo_user:
+    case DW_CFA_hi_user:
+      Debug (1, "Unexpected CFA opcode 0x%x\n", op);
+      return -UNW_EINVAL;
 
-        case DW_CFA_offset:
-          regnum = operand;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in DW_cfa_OFFSET\n",
-                     (unsigned int) regnum);
-              ret = -UNW_EBADREG;
-              goto fail;
-            }
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset r%lu at cfa+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+    default:
+      break;
+    }
+  return 0;
+}
 
-        case DW_CFA_offset_extended:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset_extended r%lu at cf+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+/* Execute INSN, as decoded by decode_cfa(), to update the register
+   state and *CURR_IP.  */
+static inline int
+exec_cfa (dwarf_state_record_t *sr, const dwarf_cfa_insn_t *insn,
+          unw_word_t *curr_ip, dwarf_reg_state_t **rs_stack)
+{
+  dwarf_reg_state_t *new_rs, *old_rs;
+  unw_word_t regnum = insn->regnum, val = insn->val;
 
-        case DW_CFA_offset_extended_sf:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset_extended_sf r%lu at cf+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+  switch ((dwarf_cfa_t) insn->op)
+    {
+    case DW_CFA_advance_loc:
+      *curr_ip += val;
+      Debug (15, "CFA_advance_loc to 0x%lx\n", (long) *curr_ip);
+      break;
 
-        case DW_CFA_restore:
-          regnum = operand;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in DW_CFA_restore\n",
-                     (unsigned int) regnum);
-              ret = -UNW_EINVAL;
-              goto fail;
-            }
-          sr->rs_current.reg[regnum] = sr->rs_initial.reg[regnum];
-          Debug (15, "CFA_restore r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_set_loc:
+      *curr_ip = val;
+      Debug (15, "CFA_set_loc to 0x%lx\n", (long) *curr_ip);
+      break;
 
-        case DW_CFA_restore_extended:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in "
-                     "DW_CFA_restore_extended\n", (unsigned int) regnum);
-              ret = -UNW_EINVAL;
-              goto fail;
-            }
-          sr->rs_current.reg[regnum] = sr->rs_initial.reg[regnum];
-          Debug (15, "CFA_restore_extended r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_offset:
+      set_reg (sr, regnum, DWARF_WHERE_CFAREL, val);
+      Debug (15, "CFA_offset r%lu at cfa+0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_nop:
-          break;
+    case DW_CFA_restore:
+      sr->rs_current.reg[regnum] = sr->rs_initial.reg[regnum];
+      Debug (15, "CFA_restore r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_set_loc:
-          fde_encoding = dci->fde_encoding;
-          if ((ret = dwarf_read_encoded_pointer (as, a, addr, fde_encoding,
-                                                 &c->pi, &curr_ip,
-                                                 arg)) < 0)
-            goto fail;
-          Debug (15, "CFA_set_loc to 0x%lx\n", (long) curr_ip);
-          break;
+    case DW_CFA_undefined:
+      set_reg (sr, regnum, DWARF_WHERE_UNDEF, 0);
+      Debug (15, "CFA_undefined r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_undefined:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_UNDEF, 0);
-          Debug (15, "CFA_undefined r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_same_value:
+      set_reg (sr, regnum, DWARF_WHERE_SAME, 0);
+      Debug (15, "CFA_same_value r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_same_value:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_SAME, 0);
-          Debug (15, "CFA_same_value r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_register:
+      set_reg (sr, regnum, DWARF_WHERE_REG, val);
+      Debug (15, "CFA_register r%lu to r%lu\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_register:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_REG, val);
-          Debug (15, "CFA_register r%lu to r%lu\n", (long) regnum, (long) val);
-          break;
+    case DW_CFA_remember_state:
+      new_rs = alloc_reg_state ();
+      if (!new_rs)
+        {
+          Debug (1, "Out of memory in DW_CFA_remember_state\n");
+          return -UNW_ENOMEM;
+        }
 
-        case DW_CFA_remember_state:
-          new_rs = alloc_reg_state ();
-          if (!new_rs)
-            {
-              Debug (1, "Out of memory in DW_CFA_remember_state\n");
-              ret = -UNW_ENOMEM;
-              goto fail;
-            }
+      memcpy (new_rs->reg, sr->rs_current.reg, sizeof (new_rs->reg));
+      new_rs->next = *rs_stack;
+      *rs_stack = new_rs;
+      Debug (15, "CFA_remember_state\n");
+      break;
 
-          memcpy (new_rs->reg, sr->rs_current.reg, sizeof (new_rs->reg));
-          new_rs->next = rs_stack;
-          rs_stack = new_rs;
-          Debug (15, "CFA_remember_state\n");
-          break;
+    case DW_CFA_restore_state:
+      if (!*rs_stack)
+        {
+          Debug (1, "register-state stack underflow\n");
+          return -UNW_EINVAL;
+        }
+      old_rs = *rs_stack;
+      memcpy (&sr->rs_current.reg, &old_rs->reg, sizeof (old_rs->reg));
+      *rs_stack = old_rs->next;
+      free_reg_state (old_rs);
+      Debug (15, "CFA_restore_state\n");
+      break;
 
-        case DW_CFA_restore_state:
-          if (!rs_stack)
-            {
-              Debug (1, "register-state stack underflow\n");
-              ret = -UNW_EINVAL;
-              goto fail;
-            }
-          memcpy (&sr->rs_current.reg, &rs_stack->reg, sizeof (rs_stack->reg));
-          old_rs = rs_stack;
-          rs_stack = rs_stack->next;
-          free_reg_state (old_rs);
-          Debug (15, "CFA_restore_state\n");
-          break;
+    case DW_CFA_def_cfa:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
+      set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);
+      Debug (15, "CFA_def_cfa r%lu+0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_def_cfa:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);   /* NOT factored! */
-          Debug (15, "CFA_def_cfa r%lu+0x%lx\n", (long) regnum, (long) val);
-          break;
+    case DW_CFA_def_cfa_register:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
+      Debug (15, "CFA_def_cfa_register r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_def_cfa_sf:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0,
-                   val * dci->data_align);              /* factored! */
-          Debug (15, "CFA_def_cfa_sf r%lu+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+    case DW_CFA_def_cfa_offset:
+      set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);
+      Debug (15, "CFA_def_cfa_offset 0x%lx\n", (long) val);
+      break;
 
-        case DW_CFA_def_cfa_register:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          Debug (15, "CFA_def_cfa_register r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_def_cfa_expression:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_EXPR, val);
+      Debug (15, "CFA_def_cfa_expr @ 0x%lx\n", (long) val);
+      break;
 
-        case DW_CFA_def_cfa_offset:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            goto fail;
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);   /* NOT factored! */
-          Debug (15, "CFA_def_cfa_offset 0x%lx\n", (long) val);
-          break;
+    case DW_CFA_expression:
+      set_reg (sr, regnum, DWARF_WHERE_EXPR, val);
+      Debug (15, "CFA_expression r%lu @ 0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_def_cfa_offset_sf:
-          if ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0)
-            goto fail;
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0,
-                   val * dci->data_align);      /* factored! */
-          Debug (15, "CFA_def_cfa_offset_sf 0x%lx\n",
-                 (long) (val * dci->data_align));
-          break;
+    case DW_CFA_val_expression:
+      set_reg (sr, regnum, DWARF_WHERE_VAL_EXPR, val);
+      Debug (15, "CFA_val_expression r%lu @ 0x%lx\n",
+             (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_def_cfa_expression:
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_EXPR, *addr);
+    case DW_CFA_GNU_args_size:
+      sr->args_size = val;
+      Debug (15, "CFA_GNU_args_size %lu\n", (long) val);
+      break;
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            goto fail;
+#ifdef UNW_TARGET_SPARC
+    case DW_CFA_GNU_window_save:
+      /* This is a special CFA to handle all 16 windowed registers
+         on SPARC.  */
+      for (regnum = 16; regnum < 32; ++regnum)
+        set_reg (sr, regnum, DWARF_WHERE_CFAREL,
+                 (regnum - 16) * sizeof (unw_word_t));
+      Debug (15, "CFA_GNU_window_save\n");
+      break;
+#endif
 
-          Debug (15, "CFA_def_cfa_expr @ 0x%lx [%lu bytes]\n",
-                 (long) *addr, (long) len);
-          *addr += len;
-          break;
+    default:
+      break;
+    }
+  return 0;
+}
 
-        case DW_CFA_expression:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
+static inline unw_hash_index_t CONST_ATTR
+hash (unw_word_t ip)
+{
+  /* based on (sqrt(5)/2-1)*2^64 */
+# define magic  ((unw_word_t) 0x9e3779b97f4a7c16ULL)
 
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, regnum, DWARF_WHERE_EXPR, *addr);
+  return ip * magic >> ((sizeof(unw_word_t) * 8) - DWARF_LOG_UNW_HASH_SIZE);
+}
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            goto fail;
+static inline unsigned short CONST_ATTR
+cfi_hash (unw_word_t addr)
+{
+  return addr * magic >> ((sizeof(unw_word_t) * 8) - DWARF_LOG_CFI_HASH_SIZE);
+}
 
-          Debug (15, "CFA_expression r%lu @ 0x%lx [%lu bytes]\n",
-                 (long) regnum, (long) addr, (long) len);
-          *addr += len;
-          break;
+static inline void
+flush_cfi_cache (struct dwarf_rs_cache *cache)
+{
+  int i;
 
-        case DW_CFA_val_expression:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            goto fail;
+  cache->cfi_nprogs = 0;
+  cache->cfi_ninsns = 0;
+  for (i = 0; i < DWARF_CFI_HASH_SIZE; ++i)
+    cache->cfi_hash[i] = -1;
+}
 
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, regnum, DWARF_WHERE_VAL_EXPR, *addr);
+/* Return the decoded instructions of the CFI program [ADDR, END_ADDR)
+   from CACHE, decoding them there first if need be, or NULL if they do
+   not fit or cannot all be decoded: the program is then decoded as it
+   runs, which may stop before reaching a bad instruction.  */
+static struct dwarf_cfi_prog *
+get_cfi_prog (struct dwarf_rs_cache *cache, unw_addr_space_t as,
+              unw_accessors_t *a, unw_word_t addr, unw_word_t end_addr,
+              int local, struct dwarf_cie_info *dci, const unw_proc_info_t *pi,
+              void *arg)
+{
+  struct dwarf_cfi_prog *prog;
+  unsigned short i, start, h = cfi_hash (addr);
+  dwarf_cfa_insn_t *insn;
+  unw_word_t next;
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            goto fail;
+  if (!cache->cfi)
+    {
+      struct dwarf_cfi_arena *cfi;
 
-          Debug (15, "CFA_val_expression r%lu @ 0x%lx [%lu bytes]\n",
-                 (long) regnum, (long) addr, (long) len);
-          *addr += len;
-          break;
+      GET_MEMORY (cfi, sizeof (*cfi));
+      if (!cfi)
+        return NULL;
+      /* the per-thread policy does not lock the cache */
+      if (!cmpxchg_ptr (&cache->cfi, NULL, cfi))
+        munmap (cfi, sizeof (*cfi));
+    }
 
-        case DW_CFA_GNU_args_size:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            goto fail;
-          sr->args_size = val;
-          Debug (15, "CFA_GNU_args_size %lu\n", (long) val);
-          break;
+  for (i = cache->cfi_hash[h]; i < DWARF_CFI_CACHE_PROGS;
+       i = prog->coll_chain)
+    {
+      prog = cache->cfi->progs + i;
+      if (prog->addr == addr && prog->end_addr == end_addr
+          && prog->local == local)
+        return prog;
+    }
 
-        case DW_CFA_GNU_negative_offset_extended:
-          /* A comment in GCC says that this is obsoleted by
-             DW_CFA_offset_extended_sf, but that it's used by older
-             PowerPC code.  */
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            goto fail;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, -(val * dci->data_align));
-          Debug (15, "CFA_GNU_negative_offset_extended cfa+0x%lx\n",
-                 (long) -(val * dci->data_align));
-          break;
+  if (cache->cfi_nprogs >= DWARF_CFI_CACHE_PROGS)
+    flush_cfi_cache (cache);
 
-        case DW_CFA_GNU_window_save:
-#ifdef UNW_TARGET_SPARC
-          /* This is a special CFA to handle all 16 windowed registers
-             on SPARC.  */
-          for (regnum = 16; regnum < 32; ++regnum)
-            set_reg (sr, regnum, DWARF_WHERE_CFAREL,
-                     (regnum - 16) * sizeof (unw_word_t));
-          Debug (15, "CFA_GNU_window_save\n");
-          break;
-#else
-          /* FALL THROUGH */
-#endif
-        case DW_CFA_lo_user:
-        case DW_CFA_hi_user:
-          Debug (1, "Unexpected CFA opcode 0x%x\n", op);
-          ret = -UNW_EINVAL;
-          goto fail;
+  while (1)
+    {
+      start = cache->cfi_ninsns;
+      for (next = addr;
+           next < end_addr && cache->cfi_ninsns < DWARF_CFI_CACHE_INSNS;)
+        {
+          insn = cache->cfi->insns + cache->cfi_ninsns;
+          if (decode_cfa (as, a, &next, dci, pi, insn, arg) < 0)
+            {
+              cache->cfi_ninsns = start;
+              return NULL;
+            }
+          if (insn->op != DW_CFA_nop)
+            ++cache->cfi_ninsns;
         }
+      if (next >= end_addr)
+        break;
+
+      /* out of room: start over in an empty cache, if it helps */
+      cache->cfi_ninsns = start;
+      if (start == 0)
+        return NULL;
+      flush_cfi_cache (cache);
     }
-  ret = 0;
 
- fail:
+  prog = cache->cfi->progs + cache->cfi_nprogs;
+  prog->addr = addr;
+  prog->end_addr = end_addr;
+  prog->start = start;
+  prog->count = cache->cfi_ninsns - start;
+  prog->local = local;
+  prog->coll_chain = cache->cfi_hash[h];
+  cache->cfi_hash[h] = cache->cfi_nprogs++;
+  return prog;
+}
+
+/* Run a CFI program to update the register state.  */
+static int
+run_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
+                 unw_word_t ip, unw_word_t addr, unw_word_t end_addr,
+                 struct dwarf_cie_info *dci, struct dwarf_rs_cache *cache)
+{
+  dwarf_reg_state_t *rs_stack = NULL, *old_rs;
+  const dwarf_cfa_insn_t *insn, *end;
+  struct dwarf_cfi_prog *prog;
+  dwarf_cfa_insn_t decoded;
+  unw_word_t curr_ip;
+  struct dwarf_window w;
+  unw_addr_space_t as;
+  unw_accessors_t *a;
+  void *arg;
+  int ret = 0, local = 0;
+
+  as = c->as;
+  arg = c->as_arg;
+  if (c->pi.flags & UNW_PI_FLAG_DEBUG_FRAME)
+    {
+      /* .debug_frame CFI is stored in local address space.  */
+      as = unw_local_addr_space;
+      arg = NULL;
+      local = 1;
+    }
+  a = unw_get_accessors (as);
+  dwarf_window_open (as, &w, &a, &arg, addr, end_addr);
+  curr_ip = c->pi.start_ip;
+
+  /* Process everything up to and including the current 'ip',
+     including all the DW_CFA_advance_loc instructions.  See
+     'c->use_prev_instr' use in 'fetch_proc_info' for details. */
+  if (cache && (prog = get_cfi_prog (cache, as, a, addr, end_addr, local,
+                                     dci, &c->pi, arg)))
+    {
+      insn = cache->cfi->insns + prog->start;
+      for (end = insn + prog->count; curr_ip <= ip && insn < end; ++insn)
+        if ((ret = exec_cfa (sr, insn, &curr_ip, &rs_stack)) < 0)
+          break;
+    }
+  else
+    while (curr_ip <= ip && addr < end_addr)
+      if ((ret = decode_cfa (as, a, &addr, dci, &c->pi, &decoded, arg)) < 0
+          || (ret = exec_cfa (sr, &decoded, &curr_ip, &rs_stack)) < 0)
+        break;
+
   /* Free the register-state stack, if not empty already.  */
   while (rs_stack)
     {
@@ -485,24 +641,36 @@ put_unwind_info (struct dwarf_cursor *c, unw_proc_info_t *pi)
 }
 
 static inline int
-parse_fde (struct dwarf_cursor *c, unw_word_t ip, dwarf_state_record_t *sr)
+parse_cie (struct dwarf_cursor *c, dwarf_state_record_t *sr,
+           struct dwarf_rs_cache *cache)
 {
   struct dwarf_cie_info *dci;
-  unw_word_t addr;
   int ret;
 
   dci = c->pi.unwind_info;
   c->ret_addr_column = dci->ret_addr_column;
 
-  addr = dci->cie_instr_start;
-  if ((ret = run_cfi_program (c, sr, ~(unw_word_t) 0, &addr,
-                              dci->cie_instr_end, dci)) < 0)
+  if ((ret = run_cfi_program (c, sr, ~(unw_word_t) 0, dci->cie_instr_start,
+                              dci->cie_instr_end, dci, cache)) < 0)
     return ret;
 
   memcpy (&sr->rs_initial, &sr->rs_current, sizeof (sr->rs_initial));
+  return 0;
+}
 
-  addr = dci->fde_instr_start;
-  if ((ret = run_cfi_program (c, sr, ip, &addr, dci->fde_instr_end, dci)) < 0)
+static inline int
+parse_fde (struct dwarf_cursor *c, unw_word_t ip, dwarf_state_record_t *sr,
+           struct dwarf_rs_cache *cache)
+{
+  struct dwarf_cie_info *dci;
+  int ret;
+
+  dci = c->pi.unwind_info;
+  if ((ret = parse_cie (c, sr, cache)) < 0)
+    return ret;
+
+  if ((ret = run_cfi_program (c, sr, ip, dci->fde_instr_start,
+                              dci->fde_instr_end, dci, cache)) < 0)
     return ret;
 
   return 0;
@@ -526,6 +694,8 @@ flush_rs_cache (struct dwarf_rs_cache *cache)
     }
   for (i = 0; i<DWARF_UNW_HASH_SIZE; ++i)
     cache->hash[i] = -1;
+
+  flush_cfi_cache (cache);
 }
 
 static inline struct dwarf_rs_cache *
@@ -563,27 +733,18 @@ put_rs_cache (unw_addr_space_t as, struct dwarf_rs_cache *cache,
     lock_release (&cache->lock, *saved_maskp);
 }
 
-static inline unw_hash_index_t CONST_ATTR
-hash (unw_word_t ip)
-{
-  /* based on (sqrt(5)/2-1)*2^64 */
-# define magic  ((unw_word_t) 0x9e3779b97f4a7c16ULL)
-
-  return ip * magic >> ((sizeof(unw_word_t) * 8) - DWARF_LOG_UNW_HASH_SIZE);
-}
-
 static inline long
-cache_match (dwarf_reg_state_t *rs, unw_word_t ip)
+cache_match (dwarf_compact_rs_t *rs, unw_word_t ip)
 {
   if (rs->valid && (ip == rs->ip))
     return 1;
   return 0;
 }
 
-static dwarf_reg_state_t *
+static dwarf_compact_rs_t *
 rs_lookup (struct dwarf_rs_cache *cache, struct dwarf_cursor *c)
 {
-  dwarf_reg_state_t *rs = cache->buckets + c->hint;
+  dwarf_compact_rs_t *rs = cache->buckets + c->hint;
   unsigned short index;
   unw_word_t ip;
 
@@ -612,10 +773,10 @@ rs_lookup (struct dwarf_rs_cache *cache, struct dwarf_cursor *c)
     }
 }
 
-static inline dwarf_reg_state_t *
+static inline dwarf_compact_rs_t *
 rs_new (struct dwarf_rs_cache *cache, struct dwarf_cursor * c)
 {
-  dwarf_reg_state_t *rs, *prev, *tmp;
+  dwarf_compact_rs_t *rs, *prev, *tmp;
   unw_hash_index_t index;
   unsigned short head;
 
@@ -667,23 +828,32 @@ rs_new (struct dwarf_rs_cache *cache, struct dwarf_cursor * c)
   return rs;
 }
 
+static inline void
+init_state_record (dwarf_state_record_t *sr)
+{
+  int i;
+
+  memset (sr, 0, sizeof (*sr));
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS + 2; ++i)
+    set_reg (sr, i, DWARF_WHERE_SAME, 0);
+}
+
+/* CACHE is the rs cache we hold, if any, to keep decoded CFI in.  */
 static int
 create_state_record_for (struct dwarf_cursor *c, dwarf_state_record_t *sr,
-                         unw_word_t ip)
+                         unw_word_t ip, struct dwarf_rs_cache *cache)
 {
-  int i, ret;
+  int ret;
 
   assert (c->pi_valid);
 
-  memset (sr, 0, sizeof (*sr));
-  for (i = 0; i < DWARF_NUM_PRESERVED_REGS + 2; ++i)
-    set_reg (sr, i, DWARF_WHERE_SAME, 0);
+  init_state_record (sr);
 
   switch (c->pi.format)
     {
     case UNW_INFO_FORMAT_TABLE:
     case UNW_INFO_FORMAT_REMOTE_TABLE:
-      ret = parse_fde (c, ip, sr);
+      ret = parse_fde (c, ip, sr, cache);
       break;
 
     case UNW_INFO_FORMAT_DYNAMIC:
@@ -697,20 +867,102 @@ create_state_record_for (struct dwarf_cursor *c, dwarf_state_record_t *sr,
   return ret;
 }
 
+/* Store VAL, the value of a WHERE rule, into *OUT, relative to the
+   expression base of RS for an expression.  Fails if it does not fit on
+   32 bits, which no sane CFI needs.  */
 static inline int
-eval_location_expr (struct dwarf_cursor *c, unw_addr_space_t as,
-                    unw_accessors_t *a, unw_word_t addr,
-                    dwarf_loc_t *locp, void *arg)
+compact_val (dwarf_compact_rs_t *rs, dwarf_where_t where, unw_word_t val,
+             int32_t *out)
 {
-  int ret, is_register;
-  unw_word_t len, val;
+  if (where == DWARF_WHERE_EXPR || where == DWARF_WHERE_VAL_EXPR)
+    {
+      if (!rs->expr_base)
+        rs->expr_base = val;
+      val -= rs->expr_base;
+    }
+  *out = (int32_t) val;
+  if ((unw_sword_t) *out != (unw_sword_t) val)
+    {
+      Debug (1, "register rule value 0x%lx out of range\n", (long) val);
+      return -UNW_EINVAL;
+    }
+  return 0;
+}
 
-  /* read the length of the expression: */
-  if ((ret = dwarf_read_uleb128 (as, a, &addr, &len, arg)) < 0)
+/* Fill in the register rules of RS from the full register state FULL.  */
+static int
+compact_reg_state (dwarf_compact_rs_t *rs, const dwarf_reg_state_t *full)
+{
+  const dwarf_save_loc_t *cfa = &full->reg[DWARF_CFA_REG_COLUMN];
+  dwarf_compact_loc_t *loc = rs->loc;
+  int i, ret;
+
+  rs->expr_base = 0;
+  rs->cfa_where = cfa->where;
+  if ((ret = compact_val (rs, cfa->where, cfa->val, &rs->cfa_val)) < 0
+      || (ret = compact_val (rs, DWARF_WHERE_CFAREL,
+                             full->reg[DWARF_CFA_OFF_COLUMN].val,
+                             &rs->cfa_offset)) < 0)
     return ret;
 
+  /* As a special-case, if the stack-pointer is the CFA and the
+     stack-pointer wasn't saved, popping the CFA implicitly pops
+     the stack-pointer as well.  */
+  rs->cfa_is_sp = (cfa->where == DWARF_WHERE_REG && cfa->val == UNW_TDEP_SP
+                   && UNW_TDEP_SP < DWARF_NUM_PRESERVED_REGS
+                   && full->reg[UNW_TDEP_SP].where == DWARF_WHERE_SAME);
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+    {
+      if (full->reg[i].where == DWARF_WHERE_SAME)
+        continue;
+      loc->regnum = i;
+      loc->where = full->reg[i].where;
+      if ((ret = compact_val (rs, full->reg[i].where, full->reg[i].val,
+                              &loc->val)) < 0)
+        return ret;
+      ++loc;
+    }
+  rs->nlocs = loc - rs->loc;
+  return 0;
+}
+
+/* The inverse of compact_reg_state(), for tdep_stash_frame().  */
+static void
+expand_reg_state (dwarf_reg_state_t *full, const dwarf_compact_rs_t *rs)
+{
+  unw_word_t base;
+  int i;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS + 2; ++i)
+    {
+      full->reg[i].where = DWARF_WHERE_SAME;
+      full->reg[i].val = 0;
+    }
+
+  for (i = 0; i < rs->nlocs; ++i)
+    {
+      base = (rs->loc[i].where == DWARF_WHERE_EXPR
+              || rs->loc[i].where == DWARF_WHERE_VAL_EXPR) ? rs->expr_base : 0;
+      full->reg[rs->loc[i].regnum].where = rs->loc[i].where;
+      full->reg[rs->loc[i].regnum].val = base + rs->loc[i].val;
+    }
+
+  base = rs->cfa_where == DWARF_WHERE_EXPR ? rs->expr_base : 0;
+  full->reg[DWARF_CFA_REG_COLUMN].where = rs->cfa_where;
+  full->reg[DWARF_CFA_REG_COLUMN].val = base + rs->cfa_val;
+  full->reg[DWARF_CFA_OFF_COLUMN].where = DWARF_WHERE_UNDEF;
+  full->reg[DWARF_CFA_OFF_COLUMN].val = rs->cfa_offset;
+}
+
+static inline int
+eval_location_expr (struct dwarf_cursor *c, unw_word_t addr, dwarf_loc_t *locp)
+{
+  int ret, is_register;
+  unw_word_t val;
+
   /* evaluate the expression: */
-  if ((ret = dwarf_eval_expr (c, &addr, len, &val, &is_register)) < 0)
+  if ((ret = dwarf_eval_rule_expr (c, addr, &val, &is_register)) < 0)
     return ret;
 
   if (is_register)
@@ -722,53 +974,41 @@ eval_location_expr (struct dwarf_cursor *c, unw_addr_space_t as,
 }
 
 static int
-apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
+apply_reg_state (struct dwarf_cursor *c, const dwarf_compact_rs_t *rs)
 {
-  unw_word_t regnum, addr, cfa, ip;
+  const dwarf_compact_loc_t *loc, *end;
+  unw_word_t addr, cfa, ip;
   unw_word_t prev_ip, prev_cfa;
-  unw_addr_space_t as;
+  dwarf_reg_state_t full;
   dwarf_loc_t cfa_loc;
-  unw_accessors_t *a;
   int i, ret;
-  void *arg;
 
   prev_ip = c->ip;
   prev_cfa = c->cfa;
 
-  as = c->as;
-  arg = c->as_arg;
-  a = unw_get_accessors (as);
-
   /* Evaluate the CFA first, because it may be referred to by other
      expressions.  */
 
-  if (rs->reg[DWARF_CFA_REG_COLUMN].where == DWARF_WHERE_REG)
+  if (rs->cfa_where == DWARF_WHERE_REG)
     {
       /* CFA is equal to [reg] + offset: */
 
-      /* As a special-case, if the stack-pointer is the CFA and the
-         stack-pointer wasn't saved, popping the CFA implicitly pops
-         the stack-pointer as well.  */
-      if ((rs->reg[DWARF_CFA_REG_COLUMN].val == UNW_TDEP_SP)
-          && (UNW_TDEP_SP < ARRAY_SIZE(rs->reg))
-          && (rs->reg[UNW_TDEP_SP].where == DWARF_WHERE_SAME))
-          cfa = c->cfa;
-      else
-        {
-          regnum = dwarf_to_unw_regnum (rs->reg[DWARF_CFA_REG_COLUMN].val);
-          if ((ret = unw_get_reg ((unw_cursor_t *) c, regnum, &cfa)) < 0)
-            return ret;
-        }
-      cfa += rs->reg[DWARF_CFA_OFF_COLUMN].val;
+      if (rs->cfa_is_sp)
+        cfa = c->cfa;
+      else if ((ret = unw_get_reg ((unw_cursor_t *) c,
+                                   dwarf_to_unw_regnum (rs->cfa_val),
+                                   &cfa)) < 0)
+        return ret;
+      cfa += rs->cfa_offset;
     }
   else
     {
       /* CFA is equal to EXPR: */
 
-      assert (rs->reg[DWARF_CFA_REG_COLUMN].where == DWARF_WHERE_EXPR);
+      assert (rs->cfa_where == DWARF_WHERE_EXPR);
 
-      addr = rs->reg[DWARF_CFA_REG_COLUMN].val;
-      if ((ret = eval_location_expr (c, as, a, addr, &cfa_loc, arg)) < 0)
+      addr = rs->expr_base + rs->cfa_val;
+      if ((ret = eval_location_expr (c, addr, &cfa_loc)) < 0)
         return ret;
       /* the returned location better be a memory location... */
       if (DWARF_IS_REG_LOC (cfa_loc))
@@ -776,9 +1016,10 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
       cfa = DWARF_GET_LOC (cfa_loc);
     }
 
-  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+  for (loc = rs->loc, end = loc + rs->nlocs; loc < end; ++loc)
     {
-      switch ((dwarf_where_t) rs->reg[i].where)
+      i = loc->regnum;
+      switch ((dwarf_where_t) loc->where)
         {
         case DWARF_WHERE_UNDEF:
           c->loc[i] = DWARF_NULL_LOC;
@@ -788,22 +1029,22 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
           break;
 
         case DWARF_WHERE_CFAREL:
-          c->loc[i] = DWARF_MEM_LOC (c, cfa + rs->reg[i].val);
+          c->loc[i] = DWARF_MEM_LOC (c, cfa + loc->val);
           break;
 
         case DWARF_WHERE_REG:
-          c->loc[i] = DWARF_REG_LOC (c, dwarf_to_unw_regnum (rs->reg[i].val));
+          c->loc[i] = DWARF_REG_LOC (c, dwarf_to_unw_regnum (loc->val));
           break;
 
         case DWARF_WHERE_EXPR:
-          addr = rs->reg[i].val;
-          if ((ret = eval_location_expr (c, as, a, addr, c->loc + i, arg)) < 0)
+          addr = rs->expr_base + loc->val;
+          if ((ret = eval_location_expr (c, addr, c->loc + i)) < 0)
             return ret;
           break;
 
         case DWARF_WHERE_VAL_EXPR:
-          addr = rs->reg[i].val;
-          if ((ret = eval_location_expr (c, as, a, addr, c->loc + i, arg)) < 0)
+          addr = rs->expr_base + loc->val;
+          if ((ret = eval_location_expr (c, addr, c->loc + i)) < 0)
             return ret;
           c->loc[i] = DWARF_VAL_LOC (c, DWARF_GET_LOC (c->loc[i]));
           break;
@@ -831,7 +1072,10 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
     }
 
   if (c->stash_frames)
-    tdep_stash_frame (c, rs);
+    {
+      expand_reg_state (&full, rs);
+      tdep_stash_frame (c, &full);
+    }
 
   return 0;
 }
@@ -840,6 +1084,7 @@ static int
 uncached_dwarf_find_save_locs (struct dwarf_cursor *c)
 {
   dwarf_state_record_t sr;
+  dwarf_compact_rs_t rs;
   int ret;
 
   if ((ret = fetch_proc_info (c, c->ip, 1)) < 0)
@@ -848,10 +1093,11 @@ uncached_dwarf_find_save_locs (struct dwarf_cursor *c)
       return ret;
     }
 
-  if ((ret = create_state_record_for (c, &sr, c->ip)) < 0)
+  if ((ret = create_state_record_for (c, &sr, c->ip, NULL)) < 0
+      || (ret = compact_reg_state (&rs, &sr.rs_current)) < 0)
     return ret;
 
-  if ((ret = apply_reg_state (c, &sr.rs_current)) < 0)
+  if ((ret = apply_reg_state (c, &rs)) < 0)
     return ret;
 
   put_unwind_info (c, &c->pi);
@@ -864,7 +1110,7 @@ HIDDEN int
 dwarf_find_save_locs (struct dwarf_cursor *c)
 {
   dwarf_state_record_t sr;
-  dwarf_reg_state_t *rs, rs_copy;
+  dwarf_compact_rs_t *rs, rs_copy;
   struct dwarf_rs_cache *cache;
   int ret = 0;
   intrmask_t saved_mask;
@@ -883,7 +1129,7 @@ dwarf_find_save_locs (struct dwarf_cursor *c)
   else
     {
       if ((ret = fetch_proc_info (c, c->ip, 1)) < 0 ||
-          (ret = create_state_record_for (c, &sr, c->ip)) < 0)
+          (ret = create_state_record_for (c, &sr, c->ip, cache)) < 0)
         {
           put_rs_cache (c->as, cache, &saved_mask);
           put_unwind_info (c, &c->pi);
@@ -891,7 +1137,13 @@ dwarf_find_save_locs (struct dwarf_cursor *c)
         }
 
       rs = rs_new (cache, c);
-      memcpy(rs, &sr.rs_current, offsetof(struct dwarf_reg_state, ip));
+      if ((ret = compact_reg_state (rs, &sr.rs_current)) < 0)
+        {
+          rs->valid = 0;
+          put_rs_cache (c->as, cache, &saved_mask);
+          put_unwind_info (c, &c->pi);
+          return ret;
+        }
       cache->buckets[c->prev_rs].hint = rs - cache->buckets;
 
       c->hint = rs->hint;
@@ -900,7 +1152,7 @@ dwarf_find_save_locs (struct dwarf_cursor *c)
       put_unwind_info (c, &c->pi);
     }
 
-  memcpy (&rs_copy, rs, sizeof (rs_copy));
+  memcpy (&rs_copy, rs, DWARF_COMPACT_RS_SIZE (rs));
   put_rs_cache (c->as, cache, &saved_mask);
 
   tdep_reuse_frame (c, &rs_copy);
@@ -915,7 +1167,7 @@ dwarf_find_save_locs (struct dwarf_cursor *c)
 HIDDEN int
 dwarf_create_state_record (struct dwarf_cursor *c, dwarf_state_record_t *sr)
 {
-  return create_state_record_for (c, sr, c->ip);
+  return create_state_record_for (c, sr, c->ip, NULL);
 }
 
 HIDDEN int
@@ -929,3 +1181,81 @@ dwarf_make_proc_info (struct dwarf_cursor *c)
     return fetch_proc_info (c, c->ip, 0);
   return 0;
 }
+
+/* Call CB with the register state of each row of the FDE that covers
+   the ip of C, in order, along with the range of ips where the row
+   applies.  The CFI program of the FDE is run once, each row taking
+   over from the one before.  Stops at the first nonzero return of CB,
+   and returns it.  */
+HIDDEN int
+dwarf_reg_states_iterate (struct dwarf_cursor *c,
+                          dwarf_reg_states_callback_t cb, void *token)
+{
+  dwarf_reg_state_t *rs_stack = NULL, *old_rs;
+  dwarf_state_record_t sr;
+  struct dwarf_cie_info *dci;
+  dwarf_cfa_insn_t insn;
+  unw_word_t addr, end_addr, curr_ip, prev_ip;
+  struct dwarf_window w;
+  unw_addr_space_t as;
+  unw_accessors_t *a;
+  void *arg;
+  int ret;
+
+  if ((ret = fetch_proc_info (c, c->ip, 1)) < 0)
+    {
+      put_unwind_info (c, &c->pi);
+      return ret;
+    }
+  if (c->pi.format == UNW_INFO_FORMAT_DYNAMIC)
+    {
+      put_unwind_info (c, &c->pi);
+      return -UNW_ENOINFO;
+    }
+
+  init_state_record (&sr);
+  if ((ret = parse_cie (c, &sr, NULL)) < 0)
+    {
+      put_unwind_info (c, &c->pi);
+      return ret;
+    }
+
+  as = c->as;
+  arg = c->as_arg;
+  if (c->pi.flags & UNW_PI_FLAG_DEBUG_FRAME)
+    {
+      /* .debug_frame CFI is stored in local address space.  */
+      as = unw_local_addr_space;
+      arg = NULL;
+    }
+  a = unw_get_accessors (as);
+  dci = c->pi.unwind_info;
+  addr = dci->fde_instr_start;
+  end_addr = dci->fde_instr_end;
+  dwarf_window_open (as, &w, &a, &arg, addr, end_addr);
+  curr_ip = c->pi.start_ip;
+
+  /* A row ends where the location advances, which leaves the register
+     state as it is.  */
+  while (ret == 0 && addr < end_addr && curr_ip < c->pi.end_ip)
+    {
+      prev_ip = curr_ip;
+      if ((ret = decode_cfa (as, a, &addr, dci, &c->pi, &insn, arg)) < 0
+          || (ret = exec_cfa (&sr, &insn, &curr_ip, &rs_stack)) < 0)
+        break;
+      if (curr_ip > prev_ip)
+        ret = (*cb) (token, &sr.rs_current, prev_ip,
+                     curr_ip < c->pi.end_ip ? curr_ip : c->pi.end_ip);
+    }
+  if (ret == 0 && curr_ip < c->pi.end_ip)
+    ret = (*cb) (token, &sr.rs_current, curr_ip, c->pi.end_ip);
+
+  while (rs_stack)
+    {
+      old_rs = rs_stack;
+      rs_stack = rs_stack->next;
+      free_reg_state (old_rs);
+    }
+  put_unwind_info (c, &c->pi);
+  return ret;
+}
@@ -0,0 +1,231 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+/* Raw-register local backtrace: the eh_elf functions only need the values of
+ * a handful of registers, so carry those from frame to frame instead of going
+ * through a cursor's `dwarf_loc_t`s. A full cursor is only set up for the
+ * frames eh_elf cannot unwind. */
+
+#ifndef UNW_REMOTE_ONLY
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "../x86_64/init.h"
+#include "builtin.h"
+#include "eh_elf.h"
+#include "jit.h"
+#include "memory_map.h"
+
+static uintptr_t deref_local(uintptr_t addr) {
+    return *(uintptr_t*)addr;
+}
+
+/// Step `context` once through eh_elf. Returns 1 on success, 2 out of a signal
+/// frame, 0 at the end of the call chain, or a negative value if eh_elf cannot
+/// unwind this frame.
+static ALWAYS_INLINE int
+raw_step(unwind_context_t* context)
+{
+    mmap_entry_t* mmap_entry;
+    unwind_context_t next;
+    int ret = 1;
+
+    context->flags = 0;
+    if(builtin_is_sigreturn(context->rip)) {
+        next = builtin_sigreturn_step(*context, deref_local);
+        ret = 2;
+    }
+    else if(!jit_step(*context, deref_local, &next)
+            && !builtin_step(*context, deref_local, &next))
+    {
+        if(mmap_is_prepared())
+            mmap_entry = mmap_get_prepared_entry(context->rip);
+        else
+            mmap_entry = mmap_get_entry(unw_local_addr_space->eh_elf_map,
+                    context->rip);
+        if(mmap_entry == NULL)
+            return -1;
+
+        if(mmap_entry->fde_func != NULL)
+            next = mmap_entry->fde_func(
+                    *context,
+                    context->rip - mmap_entry->offset,
+                    deref_local);
+        else
+            next.flags = 1u << UNWF_ERROR;
+
+        // The signal trampoline's CFI is beyond eh_elf
+        if((next.flags & (1u << UNWF_ERROR)) != 0
+                && builtin_check_sigreturn(context->rip, mmap_entry->end_ip))
+        {
+            next = builtin_sigreturn_step(*context, deref_local);
+            ret = 2;
+        }
+        else if(mmap_entry->fde_func == NULL)
+            return -1;
+    }
+
+    // Failures are counted by the `unw_step` that takes over
+    if((next.flags & (1u << UNWF_ERROR)) != 0)
+        return -3;
+    if((next.flags & (1u << UNWF_RIP)) == 0) {
+        eh_elf_count_raw_step();
+        return 0;
+    }
+    if(next.rip < 10 || ((next.flags & (1u << UNWF_RSP)) && next.rsp < 10))
+        return -5;
+
+    // Registers eh_elf says nothing about keep their value
+    context->rip = next.rip;
+    if(next.flags & (1u << UNWF_RSP))
+        context->rsp = next.rsp;
+    if(next.flags & (1u << UNWF_RBP))
+        context->rbp = next.rbp;
+    if(next.flags & (1u << UNWF_RBX))
+        context->rbx = next.rbx;
+    eh_elf_count_raw_step();
+    return ret;
+}
+
+/// Unwind one frame that eh_elf could not handle with a full cursor, set up
+/// from `context` and the other callee-saved registers in `frame_uc`. Those
+/// are only known if `*callee_known`, that is, if no eh_elf step came since
+/// they were recovered, as eh_elf does not track them; otherwise they are
+/// left undefined. On success, they are updated for the caller's frame.
+static int
+cursor_step(unwind_context_t* context, ucontext_t* frame_uc,
+        int* callee_known)
+{
+    static const int callee_regs[] = {
+        UNW_X86_64_R12, UNW_X86_64_R13, UNW_X86_64_R14, UNW_X86_64_R15 };
+    static const int callee_gregs[] = { REG_R12, REG_R13, REG_R14, REG_R15 };
+    unw_cursor_t cursor;
+    struct cursor* c = (struct cursor*) &cursor;
+    unw_word_t val;
+    unsigned i;
+    int ret;
+
+    frame_uc->uc_mcontext.gregs[REG_RIP] = context->rip;
+    frame_uc->uc_mcontext.gregs[REG_RSP] = context->rsp;
+    frame_uc->uc_mcontext.gregs[REG_RBP] = context->rbp;
+    frame_uc->uc_mcontext.gregs[REG_RBX] = context->rbx;
+
+    // As unw_init_local, without re-initialising the memory map
+    c->dwarf.as = unw_local_addr_space;
+    c->dwarf.as_arg = c;
+    c->uc = frame_uc;
+    c->validate = 0;
+    if(common_init(c, 1) < 0)
+        return -1;
+    if(!*callee_known)
+        for(i = 0; i < sizeof(callee_regs) / sizeof(callee_regs[0]); ++i)
+            c->dwarf.loc[callee_regs[i]] = DWARF_NULL_LOC;
+
+    ret = unw_step(&cursor);
+    if(ret <= 0)
+        return ret;
+
+    if(unw_get_reg(&cursor, UNW_X86_64_RIP, &val) < 0)
+        return -1;
+    context->rip = val;
+    if(unw_get_reg(&cursor, UNW_X86_64_RSP, &val) < 0)
+        return -1;
+    context->rsp = val;
+    if(unw_get_reg(&cursor, UNW_X86_64_RBP, &val) < 0)
+        return -1;
+    context->rbp = val;
+    if(unw_get_reg(&cursor, UNW_X86_64_RBX, &val) < 0)
+        return -1;
+    context->rbx = val;
+
+    *callee_known = 1;
+    for(i = 0; i < sizeof(callee_regs) / sizeof(callee_regs[0]); ++i) {
+        if(unw_get_reg(&cursor, callee_regs[i], &val) < 0) {
+            *callee_known = 0;
+            break;
+        }
+        frame_uc->uc_mcontext.gregs[callee_gregs[i]] = val;
+    }
+    return context->rip != 0;
+}
+
+/// Plain cursor-based backtrace, for when eh_elf is disabled
+static int
+cursor_backtrace(ucontext_t* uc, void** buffer, int size)
+{
+    unw_cursor_t cursor;
+    unw_word_t ip;
+    int n = 0;
+
+    if(unw_init_local(&cursor, uc) < 0)
+        return 0;
+    do {
+        if(unw_get_reg(&cursor, UNW_REG_IP, &ip) < 0 || ip == 0)
+            break;
+        buffer[n++] = (void *) ip;
+    } while(n < size && unw_step(&cursor) > 0);
+    return n;
+}
+
+int
+unw_eh_elf_backtrace (unw_context_t *uc, void **buffer, int size)
+{
+    unwind_context_t context;
+    ucontext_t frame_uc;
+    uintptr_t prev_rsp;
+    int n = 0, ret, callee_known = 1;
+
+    if (unlikely (!tdep_init_done))
+        tdep_init ();
+    if (!eh_elf_enabled)
+        return cursor_backtrace(uc, buffer, size);
+    if (eh_elf_init_local(unw_local_addr_space) < 0)
+        return 0;
+
+    context.flags = 0;
+    context.rip = uc->uc_mcontext.gregs[REG_RIP];
+    context.rsp = uc->uc_mcontext.gregs[REG_RSP];
+    context.rbp = uc->uc_mcontext.gregs[REG_RBP];
+    context.rbx = uc->uc_mcontext.gregs[REG_RBX];
+    memcpy(&frame_uc, uc, sizeof(frame_uc));
+
+    mmap_prepared_read_begin();
+    while(n < size && context.rip != 0) {
+        buffer[n++] = (void *) context.rip;
+
+        prev_rsp = context.rsp;
+        ret = raw_step(&context);
+        if(ret < 0) {
+            Debug(3, "eh_elf failed (%d) at ip=%lx, using a cursor\n",
+                    ret, context.rip);
+            ret = cursor_step(&context, &frame_uc, &callee_known);
+        }
+        else if(ret > 0)
+            callee_known = 0;
+        if(ret <= 0)
+            break;
+
+        // The stack only grows back up while unwinding, but for signal frames
+        // as the handler may run on an alternate stack
+        if(ret == 1 && context.rsp <= prev_rsp) {
+            Debug(2, "rsp went from %lx to %lx, stopping\n",
+                    prev_rsp, context.rsp);
+            break;
+        }
+    }
+    mmap_prepared_read_end();
+    return n;
+}
+
+#endif /* !UNW_REMOTE_ONLY */
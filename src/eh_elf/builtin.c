@@ -0,0 +1,347 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+/* Built-in unwinding of the local code that has no eh_elf object. The memory
+ * map leaves out special regions, so the vDSO's `.eh_frame` is compiled at
+ * init into rules like those registered by JITs, and the signal trampoline is
+ * recognised by its code: the registers of the interrupted frame are then read
+ * back from the ucontext that the kernel pushed on the stack. */
+
+#ifndef UNW_REMOTE_ONLY
+#define UNW_LOCAL_ONLY
+#endif
+#include <libunwind.h>
+
+#include "builtin.h"
+#include "dwarf-eh.h"
+#include "jit.h"
+#include "../x86_64/ucontext_i.h"
+
+#include <stdlib.h>
+#ifdef HAVE_SYS_AUXV_H
+#include <sys/auxv.h>
+#endif
+
+HIDDEN unwind_context_t builtin_sigreturn_step(unwind_context_t context,
+        deref_func_t deref)
+{
+    unwind_context_t next;
+
+    next.flags = (1u << UNWF_RIP) | (1u << UNWF_RSP)
+        | (1u << UNWF_RBP) | (1u << UNWF_RBX);
+    next.rip = deref(context.rsp + UC_MCONTEXT_GREGS_RIP);
+    next.rsp = deref(context.rsp + UC_MCONTEXT_GREGS_RSP);
+    next.rbp = deref(context.rsp + UC_MCONTEXT_GREGS_RBP);
+    next.rbx = deref(context.rsp + UC_MCONTEXT_GREGS_RBX);
+    return next;
+}
+
+#ifndef UNW_REMOTE_ONLY
+
+/// Rules compiled from one FDE of the vDSO
+typedef struct {
+    uintptr_t beg_ip, end_ip;
+    size_t first, count;    ///< Slice of `_vdso_rules`
+} vdso_fde_t;
+
+static define_lock(_vdso_lock);
+static int _vdso_done = 0;
+static vdso_fde_t* _vdso_fdes = NULL;
+static size_t _vdso_fde_count = 0;
+static unw_eh_elf_jit_rule_t* _vdso_rules = NULL;
+/// Range covered by `_vdso_fdes`. `_vdso_end` is set last, once the rules are
+/// all in place: until then, no ip is looked up.
+static uintptr_t _vdso_beg = 0;
+static volatile uintptr_t _vdso_end = 0;
+
+/// Address of the signal trampoline, once recognised
+static volatile uintptr_t _sigreturn_ip = 0;
+
+typedef struct {
+    unw_eh_elf_jit_rule_t* rules;
+    size_t size, alloc;
+    size_t first;           ///< First rule of the FDE being compiled
+    const struct dwarf_cursor* dwarf;   ///< Cursor on that FDE
+} rule_buffer_t;
+
+/// Set `*offset` to where `rs` saves `reg` from the CFA, or to 0 if it is left
+/// as it is. Fails if eh_elf rules cannot express where it is.
+static int saved_offset(const dwarf_reg_state_t* rs, unw_word_t reg,
+        int16_t* offset)
+{
+    unw_sword_t val = rs->reg[reg].val;
+
+    switch(rs->reg[reg].where) {
+        case DWARF_WHERE_UNDEF:
+        case DWARF_WHERE_SAME:
+            *offset = 0;
+            return 0;
+        case DWARF_WHERE_CFAREL:
+            if(val == 0 || val != (int16_t) val)
+                return -UNW_EINVAL;
+            *offset = val;
+            return 0;
+        default:
+            return -UNW_EINVAL;
+    }
+}
+
+/** Append the rule for the row `rs` of the FDE being compiled, which applies
+ * from `start` on. Called by `dwarf_reg_states_iterate`: this translation into
+ * the rules registered by JITs is all that the vDSO needs on top of DWARF.
+ * @return 0 on success, or a negative value if eh_elf rules cannot express
+ * the row.
+ **/
+static int emit_rule(void* token, const dwarf_reg_state_t* rs,
+        unw_word_t start, unw_word_t end)
+{
+    rule_buffer_t* buf = token;
+    const struct dwarf_cursor* dwarf = buf->dwarf;
+    const dwarf_save_loc_t* cfa_reg = &rs->reg[DWARF_CFA_REG_COLUMN];
+    unw_word_t cfa_offset = rs->reg[DWARF_CFA_OFF_COLUMN].val;
+    unw_word_t offset = start - dwarf->pi.start_ip;
+    unw_eh_elf_jit_rule_t rule;
+
+    memset(&rule, 0, sizeof(rule));
+    if(cfa_reg->where != DWARF_WHERE_REG)
+        return -UNW_EINVAL;
+    if(cfa_reg->val == UNW_X86_64_RSP)
+        rule.cfa_reg = UNW_TDEP_SP;
+    else if(cfa_reg->val == UNW_X86_64_RBP)
+        rule.cfa_reg = UNW_TDEP_BP;
+    else
+        return -UNW_EINVAL;
+    if(offset > UINT32_MAX
+            || (unw_sword_t) cfa_offset != (int32_t) cfa_offset
+            || saved_offset(rs, dwarf->ret_addr_column, &rule.ra_offset) < 0
+            || rule.ra_offset == 0
+            || saved_offset(rs, UNW_X86_64_RBP, &rule.bp_offset) < 0
+            || saved_offset(rs, UNW_X86_64_RBX, &rule.bx_offset) < 0)
+        return -UNW_EINVAL;
+    rule.offset = offset;
+    rule.cfa_offset = cfa_offset;
+
+    if(buf->size > buf->first) {
+        const unw_eh_elf_jit_rule_t* last = &buf->rules[buf->size - 1];
+        if(last->cfa_reg == rule.cfa_reg
+                && last->cfa_offset == rule.cfa_offset
+                && last->ra_offset == rule.ra_offset
+                && last->bp_offset == rule.bp_offset
+                && last->bx_offset == rule.bx_offset)
+            return 0;
+    }
+
+    if(buf->size == buf->alloc) {
+        size_t alloc = buf->alloc ? 2 * buf->alloc : 64;
+        unw_eh_elf_jit_rule_t* rules = realloc(buf->rules,
+                alloc * sizeof(unw_eh_elf_jit_rule_t));
+        if(rules == NULL)
+            return -UNW_ENOMEM;
+        buf->rules = rules;
+        buf->alloc = alloc;
+    }
+    buf->rules[buf->size++] = rule;
+    return 0;
+}
+
+/// Compile the FDE of the vDSO that starts at `ip` into `fde`, appending its
+/// rules to `buf`
+static int compile_fde(uintptr_t ip, vdso_fde_t* fde, rule_buffer_t* buf) {
+    struct cursor c;
+    int ret;
+
+    // The FDE is looked up and its CFI run as `unw_step` would
+    memset(&c, 0, sizeof(c));
+    c.dwarf.as = unw_local_addr_space;
+    c.dwarf.ip = ip;
+    buf->first = buf->size;
+    buf->dwarf = &c.dwarf;
+    ret = dwarf_make_proc_info(&c.dwarf);
+    if(ret >= 0 && c.dwarf.pi.start_ip != ip)
+        ret = -UNW_ENOINFO;
+    if(ret >= 0)
+        ret = dwarf_reg_states_iterate(&c.dwarf, emit_rule, buf);
+
+    if(ret < 0) {
+        // Leave this function to DWARF
+        buf->size = buf->first;
+        return ret;
+    }
+    fde->beg_ip = c.dwarf.pi.start_ip;
+    fde->end_ip = c.dwarf.pi.end_ip;
+    fde->first = buf->first;
+    fde->count = buf->size - buf->first;
+    return 0;
+}
+
+/// Compile every FDE listed in the `.eh_frame_hdr` of the vDSO at `base`
+static int compile_vdso(uintptr_t base) {
+    unw_accessors_t* a = unw_get_accessors(unw_local_addr_space);
+    const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*) base;
+    const Elf64_Phdr* phdr = (const Elf64_Phdr*) (base + ehdr->e_phoff);
+    const Elf64_Phdr* p_eh_hdr = NULL;
+    uintptr_t load_base = base;
+    struct dwarf_eh_frame_hdr* hdr;
+    unw_word_t addr, eh_frame, fde_count;
+    rule_buffer_t buf = { .rules = NULL };
+    unw_proc_info_t pi;
+    vdso_fde_t* fdes;
+    size_t count = 0;
+    int ret;
+
+    for(int id = 0; id < ehdr->e_phnum; ++id) {
+        if(phdr[id].p_type == PT_LOAD && phdr[id].p_offset == 0)
+            load_base = base - phdr[id].p_vaddr;
+        else if(phdr[id].p_type == PT_GNU_EH_FRAME)
+            p_eh_hdr = &phdr[id];
+    }
+    if(p_eh_hdr == NULL)
+        return -UNW_ENOINFO;
+
+    hdr = (struct dwarf_eh_frame_hdr*) (load_base + p_eh_hdr->p_vaddr);
+    if(hdr->version != DW_EH_VERSION
+            || hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+        return -UNW_ENOINFO;
+
+    memset(&pi, 0, sizeof(pi));
+    addr = (unw_word_t) (uintptr_t) (hdr + 1);
+    if((ret = dwarf_read_encoded_pointer(unw_local_addr_space, a, &addr,
+                    hdr->eh_frame_ptr_enc, &pi, &eh_frame, NULL)) < 0
+            || (ret = dwarf_read_encoded_pointer(unw_local_addr_space, a,
+                    &addr, hdr->fde_count_enc, &pi, &fde_count, NULL)) < 0)
+        return ret;
+
+    fdes = malloc(fde_count * sizeof(vdso_fde_t));
+    if(fdes == NULL)
+        return -UNW_ENOMEM;
+
+    // The table is sorted by ip, and so are the compiled FDEs
+    const int32_t* table = (const int32_t*) (uintptr_t) addr;
+    for(size_t id = 0; id < fde_count; ++id) {
+        ret = compile_fde((uintptr_t) hdr + table[2 * id],
+                &fdes[count], &buf);
+        if(ret == -UNW_ENOMEM) {
+            free(buf.rules);
+            free(fdes);
+            return ret;
+        }
+        if(ret >= 0)
+            ++count;
+    }
+
+    Debug(2, "Compiled %lu of %lu vDSO FDEs into %lu rules\n",
+            (unsigned long) count, (unsigned long) fde_count,
+            (unsigned long) buf.size);
+    if(count == 0) {
+        free(buf.rules);
+        free(fdes);
+        return 0;
+    }
+
+    _vdso_fdes = fdes;
+    _vdso_fde_count = count;
+    _vdso_rules = buf.rules;
+    _vdso_beg = fdes[0].beg_ip;
+    __sync_synchronize();
+    _vdso_end = fdes[count - 1].end_ip;
+    return 0;
+}
+
+HIDDEN int builtin_init_local(void) {
+    intrmask_t saved_mask;
+    int ret = 0;
+
+    if(_vdso_done)
+        return 0;
+
+    lock_acquire(&_vdso_lock, saved_mask);
+    if(!_vdso_done) {
+#if defined(HAVE_GETAUXVAL) && defined(AT_SYSINFO_EHDR)
+        uintptr_t base = getauxval(AT_SYSINFO_EHDR);
+        if(base != 0)
+            ret = compile_vdso(base);
+#endif
+        // Do not try again on failure: the vDSO is then left to DWARF
+        _vdso_done = 1;
+    }
+    lock_release(&_vdso_lock, saved_mask);
+    return ret;
+}
+
+HIDDEN int builtin_step(unwind_context_t context, deref_func_t deref,
+        unwind_context_t* next)
+{
+    if(context.rip >= _vdso_end || context.rip < _vdso_beg)
+        return 0;
+
+    size_t low = 0, high = _vdso_fde_count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(_vdso_fdes[mid].end_ip <= context.rip)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if(low == _vdso_fde_count || _vdso_fdes[low].beg_ip > context.rip)
+        return 0;
+
+    const vdso_fde_t* fde = &_vdso_fdes[low];
+    *next = jit_apply_rules(&_vdso_rules[fde->first], fde->count,
+            context.rip - fde->beg_ip, context, deref);
+    return 1;
+}
+
+HIDDEN int builtin_is_sigreturn(uintptr_t ip) {
+    return ip != 0 && ip == _sigreturn_ip;
+}
+
+HIDDEN int builtin_check_sigreturn(uintptr_t ip, uintptr_t end_ip) {
+    /* __restore_rt:
+         48 c7 c0 0f 00 00 00    mov $__NR_rt_sigreturn, %rax
+         0f 05                   syscall */
+    static const uint8_t code[] = {
+        0x48, 0xc7, 0xc0, 0x0f, 0x00, 0x00, 0x00, 0x0f, 0x05
+    };
+
+    // The trampoline starts at ip, where the kernel made the handler return
+    if(ip >= end_ip || end_ip - ip < sizeof(code)
+            || memcmp((const void*) ip, code, sizeof(code)) != 0)
+        return 0;
+
+    Debug(3, "Signal trampoline found at %lx\n", ip);
+    _sigreturn_ip = ip;
+    return 1;
+}
+
+#else /* UNW_REMOTE_ONLY */
+
+HIDDEN int builtin_init_local(void) {
+    return 0;
+}
+
+HIDDEN int builtin_step(unwind_context_t context, deref_func_t deref,
+        unwind_context_t* next)
+{
+    return 0;
+}
+
+HIDDEN int builtin_is_sigreturn(uintptr_t ip) {
+    return 0;
+}
+
+HIDDEN int builtin_check_sigreturn(uintptr_t ip, uintptr_t end_ip) {
+    return 0;
+}
+
+#endif /* UNW_REMOTE_ONLY */
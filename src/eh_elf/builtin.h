@@ -0,0 +1,48 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+#pragma once
+
+#include "libunwind_i.h"
+#include "context_struct.h"
+
+/** Compile the unwind rules of the local vDSO, once per process. Later calls
+ * return immediately.
+ * @return 0 on success, or a negative value upon failure
+ **/
+int builtin_init_local(void);
+
+/** Unwind `context` through the compiled rules of the vDSO, if its rip lies
+ * there. Like `jit_step`, this is async-signal-safe.
+ * @return 1 if `*next` was set, or 0 if rip is not covered.
+ **/
+int builtin_step(unwind_context_t context, deref_func_t deref,
+        unwind_context_t* next);
+
+/// Whether `ip` is the signal trampoline of the local process, as already
+/// recognised by `builtin_check_sigreturn`.
+int builtin_is_sigreturn(uintptr_t ip);
+
+/** Whether `ip` is the first instruction of the local `rt_sigreturn`
+ * trampoline. Only the code at `ip` itself is compared, and `ip` must lie in
+ * mapped code that extends up to `end_ip`. If so, `ip` is remembered for
+ * `builtin_is_sigreturn`.
+ **/
+int builtin_check_sigreturn(uintptr_t ip, uintptr_t end_ip);
+
+/** Unwind `context`, whose rip is the signal trampoline, from the ucontext
+ * that the kernel saved at its rsp. All four registers are restored.
+ **/
+unwind_context_t builtin_sigreturn_step(unwind_context_t context,
+        deref_func_t deref);
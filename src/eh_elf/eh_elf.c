@@ -15,32 +15,108 @@
 #include "eh_elf.h"
 #include "context_struct.h"
 #include "libunwind.h"
+#include "builtin.h"
+#include "jit.h"
 #include "memory_map.h"
 #include "remote.h"
+#include "../x86_64/ucontext_i.h"
 
-int eh_elf_init_local() {
-    return mmap_init_local();
+/// Local address space for which `eh_elf_prepare_local` was called
+static unw_addr_space_t _prepared_as = NULL;
+
+int eh_elf_enabled = 1;
+
+/// Counters behind `unw_eh_elf_get_stats`, per thread so that counting
+/// costs no synchronization, and stays signal-safe
+static __thread unw_eh_elf_stats_t _stats;
+
+/// The memory map of `as`, created on first use
+static memory_map_t* as_memory_map(unw_addr_space_t as) {
+    if(as->eh_elf_map == NULL)
+        as->eh_elf_map = mmap_create();
+    return as->eh_elf_map;
+}
+
+int eh_elf_init_local(unw_addr_space_t local_as) {
+    if(!eh_elf_enabled || mmap_is_prepared())
+        return 0;
+    memory_map_t* map = as_memory_map(local_as);
+    if(map == NULL)
+        return -1;
+    // The vDSO is left to DWARF if this fails
+    builtin_init_local();
+    return mmap_init_local(map);
 }
 
-int eh_elf_init_pid(pid_t pid) {
+int eh_elf_prepare_local(unw_addr_space_t local_as) {
+    int ret = mmap_prepare_local();
+    if(ret < 0)
+        return ret;
+    builtin_init_local();
+    _prepared_as = local_as;
+    return 0;
+}
+
+int eh_elf_init_pid(unw_addr_space_t as, pid_t pid) {
     Debug(3, "Init with pid\n");
-    return mmap_init_pid(pid);
+    if(!eh_elf_enabled)
+        return 0;
+    memory_map_t* map = as_memory_map(as);
+    if(map == NULL)
+        return -1;
+    return mmap_init_pid(map, pid);
 }
 
-int eh_elf_init_mmap(unw_mmap_entry_t* entries, size_t count) {
+int eh_elf_init_mmap(unw_addr_space_t as,
+        unw_mmap_entry_t* entries, size_t count)
+{
     Debug(3, "Init with mmap\n");
-    return mmap_init_mmap(entries, count);
+    if(!eh_elf_enabled)
+        return 0;
+    memory_map_t* map = as_memory_map(as);
+    if(map == NULL)
+        return -1;
+    return mmap_init_mmap(map, entries, count);
+}
+
+void eh_elf_clear(unw_addr_space_t as) {
+    mmap_destroy(as->eh_elf_map);
+    as->eh_elf_map = NULL;
+}
+
+int eh_elf_known_mapping(uintptr_t addr, size_t len,
+        uintptr_t* beg_ip, uintptr_t* end_ip)
+{
+    int ret = 0;
+    mmap_prepared_read_begin();
+    mmap_entry_t* entry = mmap_get_prepared_entry(addr);
+    if(entry != NULL && addr + len <= entry->end_ip) {
+        *beg_ip = entry->beg_ip;
+        *end_ip = entry->end_ip;
+        ret = 1;
+    }
+    mmap_prepared_read_end();
+    return ret;
+}
+
+void unw_eh_elf_get_stats(unw_eh_elf_stats_t* stats) {
+    *stats = _stats;
 }
 
-void eh_elf_clear() {
-    mmap_clear();
+void eh_elf_count_raw_step() {
+    ++_stats.steps;
 }
 
-static struct {
+typedef struct {
     struct cursor* cursor;
     int last_rc;
     uintptr_t cur_rsp;
-} _fetch_state;
+} fetch_state_t;
+
+/// `fetchw_here` gets no context from the eh_elf function: pass it through a
+/// per-thread state, saved and restored around each call in case a signal
+/// handler unwinds while this thread was already doing so.
+static __thread fetch_state_t _fetch_state;
 
 static uintptr_t fetchw_here(uintptr_t addr) {
     uintptr_t out;
@@ -94,7 +170,29 @@ inline void set_dwarf_loc_ifdef(
         *dest_reg = of_eh_elf_loc(eh_elf_loc, flags, flag_id);
 }
 
-int eh_elf_step_cursor(struct cursor *cursor) {
+static int step_cursor(struct cursor *cursor, int local);
+static int step_sigreturn(struct cursor *cursor);
+
+int eh_elf_step_cursor(struct cursor *cursor, int local) {
+    ++_stats.steps;
+    if(!eh_elf_enabled) {
+        ++_stats.fallbacks;
+        return -1;
+    }
+
+    // The prepared memory map entry of the frame is in use throughout
+    int prepared = cursor->dwarf.as == _prepared_as;
+    if(prepared)
+        mmap_prepared_read_begin();
+    int ret = step_cursor(cursor, local);
+    if(prepared)
+        mmap_prepared_read_end();
+    if(ret < 0)
+        ++_stats.fallbacks;
+    return ret;
+}
+
+static int step_cursor(struct cursor *cursor, int local) {
     uintptr_t ip = cursor->dwarf.ip;
 #ifdef DEBUG
     {
@@ -106,20 +204,8 @@ int eh_elf_step_cursor(struct cursor *cursor) {
     }
 #endif
 
-    // Retrieve memory map entry
-    mmap_entry_t* mmap_entry = mmap_get_entry(ip);
-    if(mmap_entry == NULL) {
-        Debug(3, "No such mmap entry :(\n");
-        return -1;
-    }
-
-    Debug(5, "In memory map entry %lx-%lx (%s) - off %lx, ip %lx%s\n",
-            mmap_entry->beg_ip,
-            mmap_entry->end_ip,
-            mmap_entry->object_name,
-            mmap_entry->offset,
-            ip - mmap_entry->offset,
-            mmap_entry->eh_elf == NULL ? " [MISSING EH_ELF]" : "");
+    if(local && builtin_is_sigreturn(ip))
+        return step_sigreturn(cursor);
 
     // Setup an eh_elf context
     unwind_context_t eh_elf_context;
@@ -130,31 +216,73 @@ int eh_elf_step_cursor(struct cursor *cursor) {
     dwarf_get(&cursor->dwarf,
             cursor->dwarf.loc[UNW_X86_64_RBX], &eh_elf_context.rbx);
 
+    eh_elf_context.flags = 0;
+
     // Set _fetch_state before passing fetchw_here
+    fetch_state_t saved_fetch_state = _fetch_state;
     _fetch_state.cursor = cursor;
     _fetch_state.last_rc = 0;
     _fetch_state.cur_rsp = cursor->dwarf.cfa;
 
-    Debug(4, "Unwinding in mmap entry %s at position 0x%lx (sp=%016lx, bp=%016lx)\n",
-            mmap_entry->object_name,
-            ip - mmap_entry->offset,
-            eh_elf_context.rsp,
-            eh_elf_context.rbp
-            );
+    // Neither the code registered by a JIT of this process nor its vDSO have
+    // a memory map entry
+    mmap_entry_t* mmap_entry = NULL;
+    if(!local || !(jit_step(eh_elf_context, fetchw_here, &eh_elf_context)
+                || builtin_step(eh_elf_context, fetchw_here,
+                    &eh_elf_context)))
+    {
+        // Retrieve memory map entry
+        if(cursor->dwarf.as == _prepared_as && mmap_is_prepared())
+            mmap_entry = mmap_get_prepared_entry(ip);
+        else
+            mmap_entry = mmap_get_entry(cursor->dwarf.as->eh_elf_map, ip);
+        if(mmap_entry == NULL) {
+            Debug(3, "No such mmap entry :(\n");
+            _fetch_state = saved_fetch_state;
+            return -1;
+        }
 
-    eh_elf_context.flags = 0;
-    // Call fde_func
-    eh_elf_context = mmap_entry->fde_func(
-            eh_elf_context,
-            ip - mmap_entry->offset,
-            fetchw_here);
+        Debug(5, "In memory map entry %lx-%lx (%s) - off %lx, ip %lx%s\n",
+                mmap_entry->beg_ip,
+                mmap_entry->end_ip,
+                mmap_entry->object_name,
+                mmap_entry->offset,
+                ip - mmap_entry->offset,
+                mmap_entry->eh_elf == NULL ? " [MISSING EH_ELF]" : "");
+        if(mmap_entry->fde_func == NULL) {
+            _fetch_state = saved_fetch_state;
+            if(local && builtin_check_sigreturn(ip, mmap_entry->end_ip))
+                return step_sigreturn(cursor);
+            return -1;
+        }
+
+        Debug(4, "Unwinding in mmap entry %s at position 0x%lx (sp=%016lx, bp=%016lx)\n",
+                mmap_entry->object_name,
+                ip - mmap_entry->offset,
+                eh_elf_context.rsp,
+                eh_elf_context.rbp
+                );
+
+        // Call fde_func
+        eh_elf_context = mmap_entry->fde_func(
+                eh_elf_context,
+                ip - mmap_entry->offset,
+                fetchw_here);
+    }
+
+    int fetch_rc = _fetch_state.last_rc;
+    _fetch_state = saved_fetch_state;
 
-    if(_fetch_state.last_rc != 0) {
+    if(fetch_rc != 0) {
         // access_mem error
         return -4;
     }
 
     if(((eh_elf_context.flags & (1u << UNWF_ERROR))) != 0) {
+        // The signal trampoline's CFI is beyond eh_elf
+        if(local && mmap_entry != NULL
+                && builtin_check_sigreturn(ip, mmap_entry->end_ip))
+            return step_sigreturn(cursor);
         // Error, somehow
         Debug(3, "eh_elf unwinding FAILED (fl=%02x), IP=0x%016lx\n",
                 eh_elf_context.flags, ip);
@@ -177,8 +305,8 @@ int eh_elf_step_cursor(struct cursor *cursor) {
             eh_elf_context.rsp,
             eh_elf_context.rip);
     Debug(3, "MMAP: %s %lx\n",
-            mmap_entry->object_name,
-            ip - mmap_entry->offset);
+            mmap_entry ? mmap_entry->object_name : "[jit]",
+            mmap_entry ? ip - mmap_entry->offset : ip);
 
     // Push back the data into libunwind's structures
 
@@ -199,7 +327,10 @@ int eh_elf_step_cursor(struct cursor *cursor) {
             eh_elf_context.rbx,
             eh_elf_context.flags,
             UNWF_RBX);
-    cursor->dwarf.use_prev_instr = 0;
+    // As after a DWARF step: the new frame is a caller, whose IP is a
+    // return address, and whose proc info is still to be looked up
+    cursor->dwarf.use_prev_instr = 1;
+    cursor->dwarf.pi_valid = 0;
 
     cursor->frame_info.frame_type = UNW_X86_64_FRAME_GUESSED;
     cursor->frame_info.cfa_reg_rsp = 0;
@@ -228,3 +359,54 @@ int eh_elf_step_cursor(struct cursor *cursor) {
 
     return 1;
 }
+
+/// Step the cursor out of the signal trampoline, restoring every register from
+/// the ucontext at its stack pointer, as DWARF would through the trampoline's
+/// CFI.
+static int step_sigreturn(struct cursor *cursor) {
+    static const int offsets[UNW_X86_64_RIP + 1] = {
+        [UNW_X86_64_RAX] = UC_MCONTEXT_GREGS_RAX,
+        [UNW_X86_64_RDX] = UC_MCONTEXT_GREGS_RDX,
+        [UNW_X86_64_RCX] = UC_MCONTEXT_GREGS_RCX,
+        [UNW_X86_64_RBX] = UC_MCONTEXT_GREGS_RBX,
+        [UNW_X86_64_RSI] = UC_MCONTEXT_GREGS_RSI,
+        [UNW_X86_64_RDI] = UC_MCONTEXT_GREGS_RDI,
+        [UNW_X86_64_RBP] = UC_MCONTEXT_GREGS_RBP,
+        [UNW_X86_64_RSP] = UC_MCONTEXT_GREGS_RSP,
+        [UNW_X86_64_R8] = UC_MCONTEXT_GREGS_R8,
+        [UNW_X86_64_R9] = UC_MCONTEXT_GREGS_R9,
+        [UNW_X86_64_R10] = UC_MCONTEXT_GREGS_R10,
+        [UNW_X86_64_R11] = UC_MCONTEXT_GREGS_R11,
+        [UNW_X86_64_R12] = UC_MCONTEXT_GREGS_R12,
+        [UNW_X86_64_R13] = UC_MCONTEXT_GREGS_R13,
+        [UNW_X86_64_R14] = UC_MCONTEXT_GREGS_R14,
+        [UNW_X86_64_R15] = UC_MCONTEXT_GREGS_R15,
+        [UNW_X86_64_RIP] = UC_MCONTEXT_GREGS_RIP,
+    };
+    uintptr_t sc_addr = cursor->dwarf.cfa;
+    unw_word_t rsp, rip;
+    int ret;
+
+    Debug(3, "Signal frame at ip %lx, ucontext at %lx\n",
+            cursor->dwarf.ip, sc_addr);
+
+    for(int reg = 0; reg < DWARF_NUM_PRESERVED_REGS; ++reg)
+        cursor->dwarf.loc[reg] = reg <= UNW_X86_64_RIP
+            ? DWARF_LOC(sc_addr + offsets[reg], 0) : DWARF_NULL_LOC;
+    if((ret = dwarf_get(&cursor->dwarf, cursor->dwarf.loc[UNW_X86_64_RSP],
+                    &rsp)) < 0
+            || (ret = dwarf_get(&cursor->dwarf,
+                    cursor->dwarf.loc[UNW_X86_64_RIP], &rip)) < 0)
+        return ret;
+
+    cursor->sigcontext_format = X86_64_SCF_LINUX_RT_SIGFRAME;
+    cursor->sigcontext_addr = sc_addr;
+    cursor->frame_info.frame_type = UNW_X86_64_FRAME_SIGRETURN;
+    cursor->frame_info.cfa_reg_offset = 0;
+    // The interrupted ip is not a return address
+    cursor->dwarf.use_prev_instr = 0;
+    cursor->dwarf.pi_valid = 0;
+    cursor->dwarf.cfa = rsp;
+    cursor->dwarf.ip = rip;
+    return rip != 0;
+}
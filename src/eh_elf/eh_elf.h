@@ -17,27 +17,55 @@
 #include <sys/types.h>
 #include "libunwind_i.h"
 
-/** Initialize everything for local memory analysis
+/// Whether eh_elf is used at all, as set by the UNW_EH_ELF environment
+/// variable: when 0, every frame is left to DWARF.
+extern int eh_elf_enabled;
+
+/** Initialize everything for local memory analysis through `local_as`
+ * @return 0 on success, or a negative value upon failure
+ **/
+int eh_elf_init_local(unw_addr_space_t local_as);
+
+/** Prepare everything for local memory analysis ahead of time, so that
+ * `eh_elf_init_local` then has nothing left to do and `eh_elf_step_cursor` on
+ * `local_as` neither allocates, locks nor calls into libc: both become safe to
+ * use from a signal handler. Call again to account for newly loaded objects.
  * @return 0 on success, or a negative value upon failure
  **/
-int eh_elf_init_local();
+int eh_elf_prepare_local(unw_addr_space_t local_as);
 
-/** Initialize everything for the remote analysis of the process of given PID
+/** Initialize everything for the remote analysis, through `as`, of the process
+ * of given PID. Each address space has its own memory map, but the eh_elf
+ * objects are shared by all of them.
  * @return 0 on success, or a negative value upon failure
  **/
-int eh_elf_init_pid(pid_t pid);
+int eh_elf_init_pid(unw_addr_space_t as, pid_t pid);
 
-/** Initialize everything with the provided memory map
+/** Initialize everything for `as` with the provided memory map
  * @return 0 on success, or a negative value upon failure
  **/
-int eh_elf_init_mmap(unw_mmap_entry_t* entries, size_t count);
+int eh_elf_init_mmap(unw_addr_space_t as,
+        unw_mmap_entry_t* entries, size_t count);
+
+/// Cleanup everything that was allocated by eh_elf_init_* for `as`
+void eh_elf_clear(unw_addr_space_t as);
+
+/** Whether [addr, addr + len) lies within an object of the local memory map
+ * prepared by `eh_elf_prepare_local`, whose region is then stored to
+ * [*beg_ip, *end_ip). The map is a snapshot: the object may have been
+ * unmapped since. This is async-signal-safe.
+ **/
+int eh_elf_known_mapping(uintptr_t addr, size_t len,
+        uintptr_t* beg_ip, uintptr_t* end_ip);
 
-/// Cleanup everything that was allocated by eh_elf_init_*
-void eh_elf_clear();
+/// Account for a frame unwound by `unw_eh_elf_backtrace` without a cursor
+void eh_elf_count_raw_step();
 
-/** Step the cursor using eh_elf mechanisms.
+/** Step the cursor using eh_elf mechanisms. If `local`, the cursor unwinds
+ * the calling process, and JIT regions registered with
+ * `unw_eh_elf_register_jit` are looked up first.
  *
  * @return a positive value upon success, 0 if the frame before this unwinding
  * was the last one, or a negative value upon failure.
  **/
-int eh_elf_step_cursor(struct cursor *cursor);
+int eh_elf_step_cursor(struct cursor *cursor, int local);
@@ -0,0 +1,256 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+/* Unwind rules registered at runtime for JIT-compiled code, which has no ELF
+ * object hence no eh_elf. The registered regions are published as immutable
+ * snapshots: unwinding threads only ever read the current one, while each
+ * registration replaces it. Former snapshots and cancelled regions are
+ * retired, and unmapped by whichever thread, registering or unwinding, sees no
+ * unwinding thread left reading them. */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+
+/// Head of the snapshots and regions, which are mapped on their own so as to
+/// be released from a signal handler
+typedef struct jit_block {
+    struct unw_retired retired;     ///< Must be first
+    size_t mem_size;
+} jit_block_t;
+
+typedef struct jit_region {
+    jit_block_t block;              ///< Must be first
+    uintptr_t beg_ip, end_ip;
+    size_t count;
+    unw_eh_elf_jit_rule_t rules[];
+} jit_region_t;
+
+/// The registered regions, sorted by ascending ip range
+typedef struct jit_snapshot {
+    jit_block_t block;              ///< Must be first
+    size_t size;
+    jit_region_t* regions[];
+} jit_snapshot_t;
+
+static define_lock(_jit_lock);
+/// Snapshot read by unwinding threads
+static jit_snapshot_t* volatile _jit_map = NULL;
+/// Threads currently reading `_jit_map`, and the snapshots and regions it no
+/// longer holds
+static struct unw_retire_list _jit_retire;
+
+/// Index of the first region of `map` ending after `ip`
+static size_t jit_search(const jit_snapshot_t* map, uintptr_t ip) {
+    size_t low = 0, high = map->size;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(map->regions[mid]->end_ip <= ip)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/// A snapshot or a region of `mem_size` bytes
+static void* jit_alloc(size_t mem_size) {
+    jit_block_t* block;
+    GET_MEMORY(block, mem_size);
+    if(block != NULL)
+        block->mem_size = mem_size;
+    return block;
+}
+
+static void jit_free(struct unw_retired* retired) {
+    jit_block_t* block = (jit_block_t*) retired;
+    munmap(block, block->mem_size);
+}
+
+/// Replace `_jit_map` with `fresh`, and retire the former one with `region`,
+/// if any. Called with `_jit_lock` held.
+static void jit_publish(jit_snapshot_t* fresh, jit_region_t* region) {
+    jit_snapshot_t* former = _jit_map;
+
+    _jit_map = fresh;
+    if(former != NULL)
+        retire_object(&_jit_retire, &former->block.retired, jit_free);
+    if(region != NULL)
+        retire_object(&_jit_retire, &region->block.retired, jit_free);
+}
+
+/// A copy of the current snapshot with room for `extra` more regions
+static jit_snapshot_t* jit_copy(size_t extra) {
+    size_t size = _jit_map ? _jit_map->size : 0;
+    jit_snapshot_t* map = jit_alloc(sizeof(jit_snapshot_t)
+            + (size + extra) * sizeof(jit_region_t*));
+    if(map == NULL)
+        return NULL;
+    map->size = size;
+    if(size != 0)
+        memcpy(map->regions, _jit_map->regions, size * sizeof(jit_region_t*));
+    return map;
+}
+
+int eh_elf_register_jit(unw_word_t start, unw_word_t end,
+        const unw_eh_elf_jit_rule_t* rules, size_t count)
+{
+    intrmask_t saved_mask;
+    int ret = 0;
+
+    if(start >= end || count == 0)
+        return -UNW_EINVAL;
+    for(size_t id = 0; id < count; ++id) {
+        if(rules[id].offset >= end - start
+                || (id > 0 && rules[id].offset <= rules[id - 1].offset)
+                || (rules[id].cfa_reg != UNW_TDEP_SP
+                    && rules[id].cfa_reg != UNW_TDEP_BP))
+            return -UNW_EINVAL;
+    }
+
+    jit_region_t* region = jit_alloc(sizeof(jit_region_t)
+            + count * sizeof(unw_eh_elf_jit_rule_t));
+    if(region == NULL)
+        return -UNW_ENOMEM;
+    region->beg_ip = start;
+    region->end_ip = end;
+    region->count = count;
+    memcpy(region->rules, rules, count * sizeof(unw_eh_elf_jit_rule_t));
+
+    lock_acquire(&_jit_lock, saved_mask);
+
+    jit_snapshot_t* map = jit_copy(1);
+    if(map == NULL) {
+        ret = -UNW_ENOMEM;
+        goto out;
+    }
+
+    size_t pos = jit_search(map, start);
+    if(pos < map->size && map->regions[pos]->beg_ip < end) {
+        Debug(2, "JIT region %lx-%lx overlaps %lx-%lx\n", start, end,
+                map->regions[pos]->beg_ip, map->regions[pos]->end_ip);
+        jit_free(&map->block.retired);
+        ret = -UNW_EINVAL;
+        goto out;
+    }
+    memmove(&map->regions[pos + 1], &map->regions[pos],
+            (map->size - pos) * sizeof(jit_region_t*));
+    map->regions[pos] = region;
+    ++map->size;
+
+    Debug(3, "Registered JIT region %lx-%lx with %lu rules\n",
+            start, end, count);
+    jit_publish(map, NULL);
+
+out:
+    lock_release(&_jit_lock, saved_mask);
+    if(ret < 0)
+        jit_free(&region->block.retired);
+    return ret;
+}
+
+int eh_elf_cancel_jit(unw_word_t start) {
+    intrmask_t saved_mask;
+    int ret = 0;
+
+    lock_acquire(&_jit_lock, saved_mask);
+
+    jit_snapshot_t* map = _jit_map;
+    size_t pos = map ? jit_search(map, start) : 0;
+    if(map == NULL || pos == map->size
+            || map->regions[pos]->beg_ip != start) {
+        ret = -UNW_EINVAL;
+        goto out;
+    }
+
+    jit_region_t* region = map->regions[pos];
+    map = jit_copy(0);
+    if(map == NULL) {
+        ret = -UNW_ENOMEM;
+        goto out;
+    }
+    memmove(&map->regions[pos], &map->regions[pos + 1],
+            (map->size - pos - 1) * sizeof(jit_region_t*));
+    --map->size;
+
+    Debug(3, "Cancelled JIT region %lx-%lx\n", region->beg_ip, region->end_ip);
+    jit_publish(map, region);
+
+out:
+    lock_release(&_jit_lock, saved_mask);
+    return ret;
+}
+
+HIDDEN unwind_context_t jit_apply_rules(const unw_eh_elf_jit_rule_t* rules,
+        size_t count, uintptr_t offset, unwind_context_t context,
+        deref_func_t deref)
+{
+    unwind_context_t next = { .flags = 0 };
+
+    // Last rule starting at or before `offset`
+    size_t low = 0, high = count;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        if(rules[mid].offset <= offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if(low == 0) {
+        next.flags = 1u << UNWF_ERROR;
+        return next;
+    }
+    const unw_eh_elf_jit_rule_t* rule = &rules[low - 1];
+
+    uintptr_t cfa = rule->cfa_reg == UNW_TDEP_BP ? context.rbp : context.rsp;
+    cfa += rule->cfa_offset;
+
+    next.flags = (1u << UNWF_RIP) | (1u << UNWF_RSP);
+    next.rip = deref(cfa + rule->ra_offset);
+    next.rsp = cfa;
+    if(rule->bp_offset != 0) {
+        next.rbp = deref(cfa + rule->bp_offset);
+        next.flags |= 1u << UNWF_RBP;
+    }
+    if(rule->bx_offset != 0) {
+        next.rbx = deref(cfa + rule->bx_offset);
+        next.flags |= 1u << UNWF_RBX;
+    }
+    return next;
+}
+
+HIDDEN int jit_step(unwind_context_t context, deref_func_t deref,
+        unwind_context_t* next)
+{
+    int found = 0;
+
+    // Nothing was ever registered: spare the atomic operations
+    if(_jit_map == NULL)
+        return 0;
+
+    retire_read_begin(&_jit_retire);
+    jit_snapshot_t* map = _jit_map;
+    if(map != NULL) {
+        size_t pos = jit_search(map, context.rip);
+        if(pos < map->size && map->regions[pos]->beg_ip <= context.rip) {
+            jit_region_t* region = map->regions[pos];
+            *next = jit_apply_rules(region->rules, region->count,
+                    context.rip - region->beg_ip, context, deref);
+            found = 1;
+        }
+    }
+    retire_read_end(&_jit_retire);
+    return found;
+}
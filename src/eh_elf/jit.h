@@ -0,0 +1,47 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+#pragma once
+
+#include "libunwind_i.h"
+#include "context_struct.h"
+
+/** Register `count` unwind rules for the JIT-compiled code in [start, end),
+ * on behalf of `unw_eh_elf_register_jit`.
+ * @return 0 upon success, or a negative UNW_E* value.
+ **/
+int eh_elf_register_jit(unw_word_t start, unw_word_t end,
+        const unw_eh_elf_jit_rule_t* rules, size_t count);
+
+/** Cancel the rules registered for the JIT region starting at `start`, on
+ * behalf of `unw_eh_elf_cancel_jit`.
+ * @return 0 upon success, or a negative UNW_E* value.
+ **/
+int eh_elf_cancel_jit(unw_word_t start);
+
+/** Unwind `context` through the rules registered with `unw_eh_elf_register_jit`
+ * for the region containing its rip, the same way as an eh_elf function would.
+ * This is async-signal-safe: it neither allocates, locks nor calls into libc.
+ * @return 1 if `*next` was set, or 0 if no registered region contains rip.
+ **/
+int jit_step(unwind_context_t context, deref_func_t deref,
+        unwind_context_t* next);
+
+/** Unwind `context` through the last of the `count` `rules`, sorted by
+ * ascending offset, that starts at or before `offset`.
+ * @return the caller's context, flagged with UNWF_ERROR if no rule applies.
+ **/
+unwind_context_t jit_apply_rules(const unw_eh_elf_jit_rule_t* rules,
+        size_t count, uintptr_t offset, unwind_context_t context,
+        deref_func_t deref);
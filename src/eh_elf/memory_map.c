@@ -4,23 +4,95 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <link.h>
+#include <stddef.h>
 #include "libunwind_i.h"
-
-static mmap_entry_t* _memory_map = NULL;
-static size_t _memory_map_size = 0;
-static int _mmap_init_done = 0;
-static dl_obj_list_t* _dl_obj_list = NULL;
+#include "os-linux.h"
+#include "mempool.h"
+
+#ifdef PROCMAP_QUERY
+/// Only executable, file-backed regions are in the scope of eh_elf
+# define MMAP_QUERY_FLAGS \
+    (PROCMAP_QUERY_VMA_EXECUTABLE | PROCMAP_QUERY_FILE_BACKED_VMA)
+#else
+# define MMAP_QUERY_FLAGS 0
+#endif
+
+/// A memory map built once and for all by `mmap_prepare_local`. Its header
+/// comes from `_snapshot_pool`, its entries and object names are stored in a
+/// single block of `mem_size` bytes obtained with GET_MEMORY; none of it is
+/// ever touched by malloc.
+typedef struct {
+    struct unw_retired retired;     ///< Must be first
+    mmap_entry_t* entries;
+    size_t size;
+    size_t mem_size;
+} mmap_snapshot_t;
+
+static define_lock(_snapshot_lock);
+static struct mempool _snapshot_pool;
+static int _snapshot_pool_init = 0;
+/// Snapshot read by signal handlers, published last and read only once per
+/// lookup
+static mmap_snapshot_t* volatile _prepared_map = NULL;
+/// Lookups of `_prepared_map`, and the snapshots it no longer holds
+static struct unw_retire_list _prepared_retire;
+/// Snapshots no lookup can reach any more. Releasing their eh_elf objects
+/// may dlclose them, so it is left to the next `mmap_prepare_local` rather
+/// than done by a lookup, which may be in a signal handler.
+static struct unw_retired* volatile _dead_maps = NULL;
 
 /// Init the memory map with a given /proc/XX/ argument
-int mmap_init_procdir(const char* procdir);
+static int mmap_init_procdir(memory_map_t* map, const char* procdir);
+
+/// Read all executable, file-backed regions listed in /proc/XX/maps into a
+/// freshly allocated array, sorted by ascending ip range
+static int mmap_read_procdir(const char* procdir,
+        mmap_entry_t** out_entries, size_t* out_count);
+
+/// Same as `mmap_read_procdir`, enumerating the regions through PROCMAP_QUERY
+static int mmap_read_query(pid_t pid,
+        mmap_entry_t** out_entries, size_t* out_count);
+
+/** Init an empty memory map, filled lazily on lookup through the
+ * PROCMAP_QUERY ioctl.
+ * @returns 0 upon success, or a negative value if the running kernel cannot
+ * answer such queries.
+ **/
+static int mmap_init_query(memory_map_t* map, pid_t pid);
+
+/// Find the entry containing `ip` in `table`, which may be NULL
+static mmap_entry_t* mmap_lazy_lookup(mmap_lazy_table_t* table, uintptr_t ip);
+
+/// Query the kernel for the region containing `ip` and insert it into the
+/// memory map.
+static mmap_entry_t* mmap_query_entry(memory_map_t* map, uintptr_t ip);
+
+/// Open the eh_elfs of the entries of `fresh`, then make it the contents of
+/// `map`
+static int mmap_init_entries(memory_map_t* map, memory_map_t* fresh);
+
+/// Replace the contents of `map` with `fresh`, releasing its former entries
+/// only after `fresh` got hold of its eh_elf objects
+static void mmap_replace(memory_map_t* map, memory_map_t* fresh);
+
+/// Take a reference to the eh_elf object of `entry`
+static void mmap_acquire_eh_elf(mmap_entry_t* entry);
 
 /// Reorder the entries in `entries` by increasing (non-overlapping)
 /// memory region
 static int mmap_order_entries(mmap_entry_t* entries, size_t count);
 
-/// `dlopen`s the corresponding eh_elf for each entry in `entries`.
+/** Get the corresponding eh_elf for each entry in `entries`. Entries with no
+ * eh_elf are kept, with a NULL `fde_func`: their frames fall back to DWARF.
+ * @returns 0 upon success, or a negative value upon failure.
+ **/
 static int mmap_dlopen_eh_elfs(mmap_entry_t* entries, size_t count);
 
+/// Release the eh_elf objects and names of `count` entries
+static void mmap_free_entries(mmap_entry_t* entries, size_t count);
+
 static int compare_mmap_entry(const void* _e1, const void* _e2) {
     // We can't return e1->beg_ip - e2->beg_ip because of int overflows
     const mmap_entry_t *e1 = _e1,
@@ -32,22 +104,237 @@ static int compare_mmap_entry(const void* _e1, const void* _e2) {
     return 0;
 }
 
-int mmap_init_local() {
-    return mmap_init_procdir("/proc/self/");
+memory_map_t* mmap_create() {
+    memory_map_t* map = (memory_map_t*) calloc(1, sizeof(memory_map_t));
+    if(map != NULL) {
+        map->procmap_fd = -1;
+        lock_init(&map->lazy_lock);
+    }
+    return map;
+}
+
+void mmap_destroy(memory_map_t* map) {
+    if(map == NULL)
+        return;
+    mmap_clear(map);
+    free(map);
+}
+
+static int mmap_local_generation_cb(struct dl_phdr_info* info, size_t size,
+        void* data)
+{
+    if(size < offsetof(struct dl_phdr_info, dlpi_subs)
+            + sizeof(info->dlpi_subs))
+        return -1;
+    // Both only ever grow
+    *(unsigned long long*) data = info->dlpi_adds + info->dlpi_subs;
+    return 1;
+}
+
+int mmap_init_local(memory_map_t* map) {
+    unsigned long long generation = 0;
+    intrmask_t saved_mask;
+
+    // As in dwarf_find_proc_info: a signal handler unwinding must not find
+    // the loader lock held by the code it interrupted
+    SIGPROCMASK(SIG_SETMASK, &unwi_full_mask, &saved_mask);
+    int known = dl_iterate_phdr(mmap_local_generation_cb, &generation) > 0;
+    SIGPROCMASK(SIG_SETMASK, &saved_mask, NULL);
+
+    // Nothing was loaded nor unloaded since the memory map was read
+    if(known && map->init_done && map->procmap_fd < 0
+            && map->local_generation == generation)
+        return 0;
+
+    // Not lazily: unw_step must not allocate nor dlopen in a signal handler
+    memory_map_t fresh = {
+        .entries = NULL, .size = 0, .init_done = 0, .procmap_fd = -1 };
+
+    if(mmap_read_query(getpid(), &fresh.entries, &fresh.size) < 0
+            && mmap_read_procdir("/proc/self/",
+                &fresh.entries, &fresh.size) < 0)
+    {
+        mmap_clear(map);
+        return -1;
+    }
+    if(mmap_init_entries(map, &fresh) < 0)
+        return -1;
+    map->local_generation = known ? generation : 0;
+    return 0;
 }
 
 
-int mmap_init_pid(pid_t pid) {
+int mmap_init_pid(memory_map_t* map, pid_t pid) {
+    if(mmap_init_query(map, pid) == 0)
+        return 0;
+
     char procdir[64];
     sprintf(procdir, "/proc/%d/", pid);
-    return mmap_init_procdir(procdir);
+    return mmap_init_procdir(map, procdir);
+}
+
+static int mmap_init_query(memory_map_t* map, pid_t pid) {
+    int fd = maps_query_open(pid);
+    if(fd < 0)
+        return -1;
+
+    // Probe the kernel: this fails with -1 if PROCMAP_QUERY is unknown
+    if(maps_query(fd, 0, 0, NULL, NULL, NULL, NULL, NULL, 0) < 0) {
+        Debug(3, "PROCMAP_QUERY unsupported, parsing maps instead\n");
+        close(fd);
+        return -1;
+    }
+
+    Debug(3, "Lazy memory map through PROCMAP_QUERY\n");
+    memory_map_t fresh = {
+        .entries = NULL, .size = 0, .init_done = 1, .procmap_fd = fd };
+    mmap_replace(map, &fresh);
+    return 0;
+}
+
+static mmap_entry_t* mmap_lazy_lookup(mmap_lazy_table_t* table, uintptr_t ip)
+{
+    if(table == NULL)
+        return NULL;
+
+    size_t low = 0, high = table->size;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        mmap_entry_t* entry = table->entries[mid];
+        if(ip < entry->beg_ip)
+            high = mid;
+        else if(ip >= entry->end_ip)
+            low = mid + 1;
+        else
+            return entry;
+    }
+    return NULL;
+}
+
+static void mmap_free_lazy_table(struct unw_retired* retired) {
+    free(retired);
+}
+
+static mmap_entry_t* mmap_query_entry(memory_map_t* map, uintptr_t ip) {
+    unsigned long beg_ip, end_ip, offset = 0, inode = 0;
+    char path[PATH_MAX];
+    mmap_lazy_table_t* fresh = NULL;
+    intrmask_t saved_mask;
+    int found;
+
+    lock_acquire(&map->lazy_lock, saved_mask);
+
+    // Another thread may have resolved it in the meantime
+    mmap_lazy_table_t* table = map->lazy;
+    mmap_entry_t* entry = mmap_lazy_lookup(table, ip);
+    if(entry != NULL)
+        goto out;
+
+    found = maps_query(map->procmap_fd, ip, MMAP_QUERY_FLAGS,
+                &beg_ip, &end_ip, &offset, &inode, path, sizeof(path));
+    if(found < 0)
+        goto out;
+    if(found == 0) {
+        // Remember the range up to the next region of interest as empty
+        beg_ip = ip & ~((unsigned long) getpagesize() - 1);
+        end_ip = ~0UL;
+#ifdef PROCMAP_QUERY
+        unsigned long next_ip;
+        if(maps_query(map->procmap_fd, ip,
+                    MMAP_QUERY_FLAGS | PROCMAP_QUERY_COVERING_OR_NEXT_VMA,
+                    &next_ip, NULL, NULL, NULL, NULL, 0) > 0)
+            end_ip = next_ip;
+#endif
+    }
+    uintptr_t load_offset = beg_ip - offset;
+
+    // Keep the entries sorted by ascending, non-overlapping ip ranges
+    size_t size = table != NULL ? table->size : 0;
+    size_t pos = 0;
+    while(pos < size && table->entries[pos]->beg_ip <= ip)
+        ++pos;
+    if(pos > 0 && table->entries[pos - 1]->end_ip > beg_ip)
+        beg_ip = table->entries[pos - 1]->end_ip;
+    if(pos < size && table->entries[pos]->beg_ip < end_ip)
+        end_ip = table->entries[pos]->beg_ip;
+
+    entry = (mmap_entry_t*) calloc(1, sizeof(mmap_entry_t));
+    fresh = (mmap_lazy_table_t*) malloc(sizeof(mmap_lazy_table_t)
+            + (size + 1) * sizeof(mmap_entry_t*));
+    if(entry == NULL || fresh == NULL
+            || (found && (entry->object_name = strdup(path)) == NULL))
+        goto fail;
+
+    entry->offset = load_offset;
+    entry->beg_ip = beg_ip;
+    entry->end_ip = end_ip;
+    entry->inode = inode;
+
+    // A missing eh_elf is remembered as such, to avoid querying again: the
+    // entry then has a NULL `fde_func`, and even `object` if that failed
+    if(found)
+        mmap_acquire_eh_elf(entry);
+
+    for(size_t id = 0; id < size; ++id)
+        fresh->entries[id < pos ? id : id + 1] = table->entries[id];
+    fresh->entries[pos] = entry;
+    fresh->size = size + 1;
+    entry->id = pos;
+
+    // Lookups read the table without locking: publish it once complete, and
+    // free the one it replaces once they are done with it
+    __sync_synchronize();
+    map->lazy = fresh;
+    if(table != NULL)
+        retire_object(&map->lazy_retire, &table->retired,
+                mmap_free_lazy_table);
+
+    Debug(4, "Queried mmap entry %016lx-%016lx %s\n",
+            entry->beg_ip, entry->end_ip,
+            found ? entry->object_name : "[none]");
+    goto out;
+
+fail:
+    if(entry != NULL)
+        free(entry->object_name);
+    free(entry);
+    free(fresh);
+    entry = NULL;
+out:
+    lock_release(&map->lazy_lock, saved_mask);
+    return entry;
+}
+
+static int mmap_init_entries(memory_map_t* map, memory_map_t* fresh) {
+    if(mmap_dlopen_eh_elfs(fresh->entries, fresh->size) < 0) {
+        mmap_free_entries(fresh->entries, fresh->size);
+        mmap_clear(map);
+        return -4;
+    }
+
+    fresh->init_done = 1;
+    mmap_replace(map, fresh);
+    return 0;
 }
 
-int mmap_init_procdir(const char* procdir) {
+static int mmap_init_procdir(memory_map_t* map, const char* procdir) {
     // This function reads /proc/pid/maps and deduces the memory map
+    memory_map_t fresh = {
+        .entries = NULL, .size = 0, .init_done = 0, .procmap_fd = -1 };
+
+    int rc = mmap_read_procdir(procdir, &fresh.entries, &fresh.size);
+    if(rc < 0) {
+        mmap_clear(map);
+        return rc;
+    }
 
-    mmap_clear();
+    // dlopen corresponding eh_elf objects
+    return mmap_init_entries(map, &fresh);
+}
 
+static int mmap_read_procdir(const char* procdir,
+        mmap_entry_t** out_entries, size_t* out_count)
+{
     // Open the mmap file
     char map_path[128];
     sprintf(map_path, "%s/maps", procdir);
@@ -64,8 +351,15 @@ int mmap_init_procdir(const char* procdir) {
         }
     }
     rewind(map_handle);
-    _memory_map = (mmap_entry_t*) calloc(nb_entries, sizeof(mmap_entry_t));
-    _memory_map_size = nb_entries;
+    mmap_entry_t* entries =
+        (mmap_entry_t*) calloc(nb_entries + 1, sizeof(mmap_entry_t));
+    char* line = malloc(512 * sizeof(char));
+    if(entries == NULL || line == NULL) {
+        free(entries);
+        free(line);
+        fclose(map_handle);
+        return -1;
+    }
 
     // Read all lines
     uintptr_t ip_beg, ip_end, offset, inode;
@@ -73,7 +367,6 @@ int mmap_init_procdir(const char* procdir) {
     char path[256];
     int cur_entry = 0;
     int pos_before_path;
-    char* line = malloc(512 * sizeof(char));
     size_t line_size = 512;
     while(getline(&line, &line_size, map_handle) >= 0)
     {
@@ -82,7 +375,9 @@ int mmap_init_procdir(const char* procdir) {
                 &ip_beg, &ip_end, &is_x, &offset, &inode, &pos_before_path);
         sscanf(line + pos_before_path, "%s", path);
         if(cur_entry >= nb_entries) {
-            mmap_clear();
+            mmap_free_entries(entries, cur_entry);
+            free(line);
+            fclose(map_handle);
             return -2; // Bad entry count, somehow
         }
 
@@ -91,45 +386,115 @@ int mmap_init_procdir(const char* procdir) {
         if(is_x != 'x') // Not executable, out of our scope
             continue;
 
-        _memory_map[cur_entry].id = cur_entry;
-        _memory_map[cur_entry].offset = ip_beg - offset;
-        _memory_map[cur_entry].beg_ip = ip_beg;
-        _memory_map[cur_entry].end_ip = ip_end;
-        _memory_map[cur_entry].object_name =
+        entries[cur_entry].id = cur_entry;
+        entries[cur_entry].offset = ip_beg - offset;
+        entries[cur_entry].beg_ip = ip_beg;
+        entries[cur_entry].end_ip = ip_end;
+        entries[cur_entry].inode = inode;
+        entries[cur_entry].object_name =
             (char*) malloc(sizeof(char) * (strlen(path) + 1));
-        strcpy(_memory_map[cur_entry].object_name, path);
+        if(entries[cur_entry].object_name == NULL) {
+            mmap_free_entries(entries, cur_entry);
+            free(line);
+            fclose(map_handle);
+            return -1;
+        }
+        strcpy(entries[cur_entry].object_name, path);
 
         cur_entry++;
     }
     free(line);
+    fclose(map_handle);
 
-    // Shrink _memory_map to only use up the number of relevant entries
-    assert(_memory_map_size >= (size_t)cur_entry);
-    _memory_map_size = cur_entry; // Because of skipped entries
-    _memory_map = (mmap_entry_t*)
-        realloc(_memory_map, _memory_map_size * sizeof(mmap_entry_t));
+    // Shrink the entries to only use up the number of relevant entries
+    assert(nb_entries >= cur_entry);
+    mmap_entry_t* shrunk = (mmap_entry_t*)
+        realloc(entries, (cur_entry + 1) * sizeof(mmap_entry_t));
+    if(shrunk != NULL)
+        entries = shrunk;
+    *out_entries = entries;
+    *out_count = cur_entry; // Because of skipped entries
 
     // Ensure the entries are sorted by ascending ip range
-    if(mmap_order_entries(_memory_map, _memory_map_size) < 0)
+    if(mmap_order_entries(entries, cur_entry) < 0)
         return -3;
 
-    // dlopen corresponding eh_elf objects
-    if(mmap_dlopen_eh_elfs(_memory_map, _memory_map_size) < 0)
-        return -4;
+    return 0;
+}
 
-    _mmap_init_done = 1;
+static int mmap_read_query(pid_t pid,
+        mmap_entry_t** out_entries, size_t* out_count)
+{
+#ifdef PROCMAP_QUERY
+    int fd = maps_query_open(pid);
+    if(fd < 0)
+        return -1;
 
+    mmap_entry_t* entries = NULL;
+    size_t count = 0, capacity = 0;
+    unsigned long beg_ip, end_ip = 0, offset, inode;
+    char path[PATH_MAX];
+    int rc;
+
+    // Regions come in ascending order, each query starting past the last one
+    while((rc = maps_query(fd, end_ip,
+                    MMAP_QUERY_FLAGS | PROCMAP_QUERY_COVERING_OR_NEXT_VMA,
+                    &beg_ip, &end_ip, &offset, &inode,
+                    path, sizeof(path))) > 0)
+    {
+        if(count == capacity) {
+            size_t new_capacity = capacity == 0 ? 16 : 2 * capacity;
+            mmap_entry_t* new_entries = (mmap_entry_t*)
+                realloc(entries, new_capacity * sizeof(mmap_entry_t));
+            if(new_entries == NULL) {
+                rc = -1;
+                break;
+            }
+            entries = new_entries;
+            capacity = new_capacity;
+        }
+        memset(&entries[count], 0, sizeof(mmap_entry_t));
+        entries[count].id = count;
+        entries[count].offset = beg_ip - offset;
+        entries[count].beg_ip = beg_ip;
+        entries[count].end_ip = end_ip;
+        entries[count].inode = inode;
+        entries[count].object_name = (char*) malloc(strlen(path) + 1);
+        if(entries[count].object_name == NULL) {
+            rc = -1;
+            break;
+        }
+        strcpy(entries[count].object_name, path);
+        ++count;
+    }
+    close(fd);
+
+    if(rc < 0) {
+        mmap_free_entries(entries, count);
+        return -1;
+    }
+
+    *out_entries = entries;
+    *out_count = count;
     return 0;
+#else
+    return -1;
+#endif
 }
 
-int mmap_init_mmap(unw_mmap_entry_t* entries, size_t count) {
+int mmap_init_mmap(memory_map_t* map,
+        unw_mmap_entry_t* entries, size_t count)
+{
     Debug(3, "Start reading mmap (entries=%016lx)\n", (uintptr_t)entries);
     Debug(3, "%lu entries\n", count);
 
-    mmap_clear();
-
-    _memory_map = (mmap_entry_t*) calloc(count, sizeof(mmap_entry_t));
-    _memory_map_size = count;
+    memory_map_t fresh = {
+        .entries = NULL, .size = 0, .init_done = 0, .procmap_fd = -1 };
+    fresh.entries = (mmap_entry_t*) calloc(count + 1, sizeof(mmap_entry_t));
+    if(fresh.entries == NULL) {
+        mmap_clear(map);
+        return -1;
+    }
 
     int mmap_pos = 0;
     for(int pos=0; pos < (int)count; ++pos) {
@@ -143,28 +508,36 @@ int mmap_init_mmap(unw_mmap_entry_t* entries, size_t count) {
                 entries[pos].end_ip,
                 entries[pos].object_name);
 
-        _memory_map[mmap_pos].id = pos;
-        _memory_map[mmap_pos].offset = entries[pos].offset;
-        _memory_map[mmap_pos].beg_ip = entries[pos].beg_ip;
-        _memory_map[mmap_pos].end_ip = entries[pos].end_ip;
-        _memory_map[mmap_pos].object_name =
+        fresh.entries[mmap_pos].id = pos;
+        fresh.entries[mmap_pos].offset = entries[pos].offset;
+        fresh.entries[mmap_pos].beg_ip = entries[pos].beg_ip;
+        fresh.entries[mmap_pos].end_ip = entries[pos].end_ip;
+        fresh.entries[mmap_pos].object_name =
             malloc(strlen(entries[pos].object_name) + 1);
-        strcpy(_memory_map[mmap_pos].object_name, entries[pos].object_name);
+        if(fresh.entries[mmap_pos].object_name == NULL) {
+            mmap_free_entries(fresh.entries, mmap_pos);
+            mmap_clear(map);
+            return -1;
+        }
+        strcpy(fresh.entries[mmap_pos].object_name, entries[pos].object_name);
 
         ++mmap_pos;
     }
 
     // Shrink memory map
-    _memory_map_size = mmap_pos;
-    _memory_map = (mmap_entry_t*)
-        realloc(_memory_map, _memory_map_size * sizeof(mmap_entry_t));
-
-    if(mmap_order_entries(_memory_map, _memory_map_size) < 0)
-        return -3;
-    if(mmap_dlopen_eh_elfs(_memory_map, _memory_map_size) < 0)
+    fresh.size = mmap_pos;
+    mmap_entry_t* shrunk = (mmap_entry_t*)
+        realloc(fresh.entries, (fresh.size + 1) * sizeof(mmap_entry_t));
+    if(shrunk != NULL)
+        fresh.entries = shrunk;
+
+    if(mmap_order_entries(fresh.entries, fresh.size) < 0) {
+        mmap_free_entries(fresh.entries, fresh.size);
+        mmap_clear(map);
+        return -4;
+    }
+    if(mmap_init_entries(map, &fresh) < 0)
         return -4;
-
-    _mmap_init_done = 1;
     Debug(3, "Init complete\n");
     return 0;
 }
@@ -178,95 +551,70 @@ static int mmap_order_entries(mmap_entry_t* entries, size_t count) {
     return 0;
 }
 
-/// `dlopen` a new list entry, or fetch it
-static dl_obj_list_t* mmap_dlopen_eh_elf(const char* obj_name) {
-    dl_obj_list_t *cur_elt = _dl_obj_list;
-
-    while(cur_elt != NULL) {
-        if(strcmp(cur_elt->object_name, obj_name) == 0) {
-            Debug(4, "Reusing previous eh_elf %s\n", obj_name);
-            return cur_elt;
-        }
-        cur_elt = cur_elt->next;
-    }
-
-    // Wasn't previously opened
-    // Open the DL object
-    dl_obj_list_t* new_elt = malloc(sizeof(dl_obj_list_t));
-    new_elt->object_name = malloc(sizeof(char) * (strlen(obj_name) + 1));
-    new_elt->next = NULL;
-    strcpy(new_elt->object_name, obj_name);
-
-    char eh_elf_path[256];
-    char *obj_name_cpy = malloc(strlen(obj_name) + 1);
-    strcpy(obj_name_cpy, obj_name);
-    char* obj_basename = basename(obj_name_cpy);
-    sprintf(eh_elf_path, "%s.eh_elf.so", obj_basename);
-    new_elt->eh_elf = dlopen(eh_elf_path, RTLD_LAZY);
-    free(obj_name_cpy);
-    if(new_elt->eh_elf == NULL) {
-        // Failed, cleanup everything
-        Debug(3, "Could not open eh_elf.so %s\n", eh_elf_path);
-        free(new_elt->object_name);
-        free(new_elt);
-        return NULL;
-    }
-
-    // Find the fde function
-    new_elt->fde_func =
-        (_fde_func_with_deref_t) (dlsym(new_elt->eh_elf, "_eh_elf"));
-    if(new_elt->fde_func == NULL) {
-        // Failed, cleanup everything
-        Debug(3, "Could not find _eh_elf in %s\n", eh_elf_path);
-        free(new_elt->object_name);
-        dlclose(new_elt->eh_elf);
-        free(new_elt);
-        return NULL;
-    }
-
-    char opened_file[256];
-    dlinfo(new_elt->eh_elf, RTLD_DI_ORIGIN, opened_file);
-    Debug(4, "Opened %s/%s\n", opened_file, eh_elf_path);
-
-    // Linking, prepending
-    new_elt->next = _dl_obj_list;
-    _dl_obj_list = new_elt;
-
-    return new_elt;
+static void mmap_acquire_eh_elf(mmap_entry_t* entry) {
+    entry->object = obj_cache_acquire(entry->object_name, entry->inode);
+    entry->eh_elf = entry->object ? entry->object->eh_elf : NULL;
+    entry->fde_func = entry->object ? entry->object->fde_func : NULL;
 }
 
 /// `dlopen` the needed eh_elf objects.
 static int mmap_dlopen_eh_elfs(mmap_entry_t* entries, size_t count) {
     for(size_t id = 0; id < count; ++id) {
-        dl_obj_list_t* eh_elf_elt =
-            mmap_dlopen_eh_elf(entries[id].object_name);
-        if(eh_elf_elt == NULL)
+        mmap_acquire_eh_elf(&entries[id]);
+        if(entries[id].object == NULL)
             return -1;
-        entries[id].eh_elf = eh_elf_elt->eh_elf;
-        entries[id].fde_func = eh_elf_elt->fde_func;
+        if(entries[id].fde_func == NULL)
+            Debug(3, "No eh_elf for %s\n", entries[id].object_name);
     }
     return 0;
 }
 
-void mmap_clear() {
-    _mmap_init_done = 0;
-//    dl_obj_list_t* dl_obj_list = _dl_obj_list;
+static void mmap_free_entries(mmap_entry_t* entries, size_t count) {
+    for(size_t pos = 0; pos < count; ++pos) {
+        obj_cache_release(entries[pos].object);
+        free(entries[pos].object_name);
+    }
+    free(entries);
+}
+
+static void mmap_replace(memory_map_t* map, memory_map_t* fresh) {
+    // Everything moves over but the lock
+    memory_map_t former = *map;
+    map->entries = fresh->entries;
+    map->size = fresh->size;
+    map->procmap_fd = fresh->procmap_fd;
+    map->lazy = fresh->lazy;
+    map->lazy_retire.retired = NULL;
+    map->init_done = fresh->init_done;
+    mmap_clear(&former);
+}
 
-    if(_memory_map != NULL) {
-        for(size_t pos=0; pos < _memory_map_size; ++pos) {
-            free(_memory_map[pos].object_name);
+void mmap_clear(memory_map_t* map) {
+    map->init_done = 0;
+
+    if(map->entries != NULL) {
+        mmap_free_entries(map->entries, map->size);
+        map->entries = NULL;
+    }
+    map->size = 0;
+
+    if(map->lazy != NULL) {
+        mmap_lazy_table_t* table = map->lazy;
+        for(size_t pos = 0; pos < table->size; ++pos) {
+            obj_cache_release(table->entries[pos]->object);
+            free(table->entries[pos]->object_name);
+            free(table->entries[pos]);
         }
-        free(_memory_map);
+        free(table);
+        map->lazy = NULL;
+    }
+    // Nothing reads the memory map while it is cleared
+    retire_release(&map->lazy_retire, map->lazy_retire.state >> 32);
+
+    if(map->procmap_fd >= 0) {
+        close(map->procmap_fd);
+        map->procmap_fd = -1;
     }
-//    while(dl_obj_list != NULL) {
-//        dlclose(dl_obj_list->eh_elf);
-//        free(dl_obj_list->object_name);
-//
-//        dl_obj_list_t* prev = dl_obj_list;
-//        dl_obj_list = dl_obj_list->next;
-//        free(prev);
-//    }
-//    _dl_obj_list = NULL;
 }
 
 static int bsearch_compar_mmap_entry(const void* vkey, const void* vmmap_elt) {
@@ -280,18 +628,151 @@ static int bsearch_compar_mmap_entry(const void* vkey, const void* vmmap_elt) {
     return 1;
 }
 
-mmap_entry_t* mmap_get_entry(uintptr_t ip) {
+mmap_entry_t* mmap_get_entry(memory_map_t* map, uintptr_t ip) {
     // Perform a binary search to find the requested ip
 
     Debug(3, "Getting mmap entry %016lx\n", ip);
-    if(!_mmap_init_done) {
+    if(map == NULL || !map->init_done) {
         Debug(1, "Mmap access before init! Aborting\n");
         return NULL;
     }
+    if(map->procmap_fd >= 0) {
+        retire_read_begin(&map->lazy_retire);
+        mmap_entry_t* entry = mmap_lazy_lookup(map->lazy, ip);
+        retire_read_end(&map->lazy_retire);
+        if(entry == NULL)
+            entry = mmap_query_entry(map, ip);
+        // Ranges with no region of interest are not entries to callers
+        return entry != NULL && entry->object_name != NULL ? entry : NULL;
+    }
     return bsearch(
             (void*)&ip,
-            (void*)_memory_map,
-            _memory_map_size,
+            (void*)map->entries,
+            map->size,
             sizeof(mmap_entry_t),
             bsearch_compar_mmap_entry);
 }
+
+/// Hand a snapshot that no lookup holds to `mmap_free_dead_snapshots`
+static void mmap_bury_snapshot(struct unw_retired* retired) {
+    struct unw_retired* head;
+    do {
+        head = _dead_maps;
+        retired->next = head;
+    } while(!cmpxchg_ptr((void*) &_dead_maps, head, retired));
+}
+
+/// Release the snapshots buried so far. Called with `_snapshot_lock` held.
+static void mmap_free_dead_snapshots() {
+    struct unw_retired* dead = __sync_lock_test_and_set(&_dead_maps, NULL);
+    while(dead != NULL) {
+        mmap_snapshot_t* snapshot = (mmap_snapshot_t*) dead;
+        dead = dead->next;
+        for(size_t pos = 0; pos < snapshot->size; ++pos)
+            obj_cache_release(snapshot->entries[pos].object);
+        munmap(snapshot->entries, snapshot->mem_size);
+        mempool_free(&_snapshot_pool, snapshot);
+    }
+}
+
+int mmap_prepare_local() {
+    intrmask_t saved_mask;
+    mmap_entry_t* entries;
+    size_t count;
+    int rc = 0;
+
+    lock_acquire(&_snapshot_lock, saved_mask);
+
+    if(!_snapshot_pool_init) {
+        mempool_init(&_snapshot_pool, sizeof(mmap_snapshot_t), 0);
+        _snapshot_pool_init = 1;
+    }
+
+    if(mmap_read_query(getpid(), &entries, &count) < 0
+            && mmap_read_procdir("/proc/self/", &entries, &count) < 0)
+    {
+        rc = -1;
+        goto out;
+    }
+
+    // Lay out the entries, then the object names, in a single block
+    size_t mem_size = count * sizeof(mmap_entry_t);
+    for(size_t pos = 0; pos < count; ++pos)
+        mem_size += strlen(entries[pos].object_name) + 1;
+
+    mmap_snapshot_t* snapshot = mempool_alloc(&_snapshot_pool);
+    if(snapshot == NULL) {
+        rc = -2;
+        goto out_free;
+    }
+    GET_MEMORY(snapshot->entries, mem_size);
+    if(snapshot->entries == NULL) {
+        mempool_free(&_snapshot_pool, snapshot);
+        rc = -2;
+        goto out_free;
+    }
+    snapshot->size = count;
+    snapshot->mem_size = mem_size;
+
+    char* names = (char*) &snapshot->entries[count];
+    for(size_t pos = 0; pos < count; ++pos) {
+        mmap_entry_t* entry = &snapshot->entries[pos];
+        *entry = entries[pos];
+
+        // Missing eh_elfs simply fall back to DWARF at unwinding time
+        mmap_acquire_eh_elf(entry);
+
+        strcpy(names, entry->object_name);
+        entry->object_name = names;
+        names += strlen(names) + 1;
+    }
+
+    // Publish only once the snapshot is complete. The one it replaces may
+    // still be in use by an interrupted unwinding: retire it.
+    mmap_snapshot_t* former = _prepared_map;
+    __sync_synchronize();
+    _prepared_map = snapshot;
+    if(former != NULL)
+        retire_object(&_prepared_retire, &former->retired, mmap_bury_snapshot);
+    mmap_free_dead_snapshots();
+
+    Debug(3, "Prepared memory map with %lu entries\n", count);
+
+out_free:
+    mmap_free_entries(entries, count);
+out:
+    lock_release(&_snapshot_lock, saved_mask);
+    return rc;
+}
+
+int mmap_is_prepared() {
+    return _prepared_map != NULL;
+}
+
+void mmap_prepared_read_begin() {
+    retire_read_begin(&_prepared_retire);
+}
+
+void mmap_prepared_read_end() {
+    retire_read_end(&_prepared_retire);
+}
+
+mmap_entry_t* mmap_get_prepared_entry(uintptr_t ip) {
+    // No bsearch here: this must not call into libc
+    mmap_snapshot_t* snapshot = _prepared_map;
+    if(snapshot == NULL)
+        return NULL;
+
+    size_t low = 0, high = snapshot->size;
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+        mmap_entry_t* entry = &snapshot->entries[mid];
+        if(ip < entry->beg_ip)
+            high = mid;
+        else if(ip >= entry->end_ip)
+            low = mid + 1;
+        else
+            return entry;
+    }
+    return NULL;
+}
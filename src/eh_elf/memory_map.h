@@ -17,20 +17,12 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <dlfcn.h>
+#include <pthread.h>
 
 #include "libunwind.h"
+#include "retire.h"
 #include "context_struct.h"
-
-/// A type representing a dlopen handle
-typedef void* dl_obj_t;
-
-/// A linked list of dl_obj_t
-typedef struct dl_obj_list {
-   char* object_name;       ///< Name of the object mapped here
-   dl_obj_t eh_elf;         ///< Corresponding eh_elf file, dlopen'd
-   _fde_func_with_deref_t fde_func; ///< Fde deref function, directly
-   struct dl_obj_list* next;     ///< Next item in the list
-} dl_obj_list_t;
+#include "object_cache.h"
 
 /// A structure containing the informations gathererd about a line in the
 /// memory map
@@ -39,30 +31,102 @@ typedef struct {
    uintptr_t offset;  ///< Total offset: ip + offset = ip in original ELF file
    char* object_name; ///< Name of the object mapped here
    uintptr_t beg_ip, end_ip; ///< Start and end IP of this object in memory
+   unsigned long inode; ///< Inode of the object mapped here, 0 if unknown
+   eh_elf_object_t* object; ///< Reference to the shared eh_elf object
    dl_obj_t eh_elf;   ///< Corresponding eh_elf file, dlopen'd
    _fde_func_with_deref_t fde_func; ///< Fde deref function, directly
 } mmap_entry_t;
 
-/// Dealloc all allocated memory and reset internal state
-void mmap_clear();
+/** The entries resolved so far in a memory map filled lazily. A table is
+ * never modified once published: each new entry comes with a new table, and
+ * the table it replaces is retired, to be freed once no lookup reads it.
+ * Ranges known to hold no executable, file-backed region are entries too,
+ * with a NULL `object` and `object_name`, so that they are only queried once.
+ **/
+typedef struct mmap_lazy_table {
+   struct unw_retired retired;      ///< Must be first
+   size_t size;                     ///< Number of entries
+   mmap_entry_t* entries[];         ///< Sorted by ascending ip range
+} mmap_lazy_table_t;
+
+/** The memory map of one process, as seen by one address space. Its entries
+ * hold references to eh_elf objects shared with every other memory map.
+ **/
+typedef struct memory_map {
+   mmap_entry_t* entries; ///< Entries, sorted by ascending ip range
+   size_t size;           ///< Number of entries
+   int init_done;         ///< Whether one of the `mmap_init_*` succeeded
+   /// Descriptor on /proc/XX/maps when the memory map is filled lazily
+   /// through PROCMAP_QUERY, or -1 when it was read entirely at init.
+   int procmap_fd;
+   /// For the local process, the count of objects loaded and unloaded when
+   /// the memory map was read
+   unsigned long long local_generation;
+   /// Entries resolved so far when filled lazily, read without locking
+   mmap_lazy_table_t* volatile lazy;
+   struct unw_retire_list lazy_retire; ///< Tables `lazy` replaced
+   pthread_mutex_t lazy_lock; ///< Serializes the insertions into `lazy`
+} memory_map_t;
+
+/// Allocate a new, empty memory map
+memory_map_t* mmap_create();
+
+/// Clear `map`, then free it
+void mmap_destroy(memory_map_t* map);
 
-/** Init the memory map for the local process
+/// Dealloc all allocated memory and reset `map`
+void mmap_clear(memory_map_t* map);
+
+/** Init the memory map for the local process. It is read entirely here, with
+ * every eh_elf opened, as `unw_step` may run in a signal handler: looking an
+ * entry up must neither allocate nor `dlopen` then. It is only read again
+ * once objects were loaded or unloaded since.
  * @returns 0 upon success, or a negative value upon failure.
  **/
-int mmap_init_local();
+int mmap_init_local(memory_map_t* map);
 
-/** Init the memory map for a remote process with the given pid
+/** Init the memory map for a remote process with the given pid. When the
+ * kernel supports PROCMAP_QUERY, it is filled lazily by `mmap_get_entry`.
  * @returns 0 upon success, or a negative value upon failure.
  **/
-int mmap_init_pid(pid_t pid);
+int mmap_init_pid(memory_map_t* map, pid_t pid);
 
 /** Init the memory map from a provided memory map
  * @returns 0 upon success, or a negative value upon failure.
  **/
-int mmap_init_mmap(unw_mmap_entry_t* entries, size_t count);
+int mmap_init_mmap(memory_map_t* map, unw_mmap_entry_t* entries, size_t count);
+
+/** Get the `mmap_entry_t` corresponding to the given IP. In a memory map
+ * filled lazily, entries are resolved here, the first time an IP falls into
+ * them; their `fde_func` is NULL if no eh_elf could be found. Concurrent
+ * lookups are safe.
+ * @return a pointer to the corresponding memory map entry, or NULL upon
+ * failure.
+ **/
+mmap_entry_t* mmap_get_entry(memory_map_t* map, uintptr_t ip);
+
+/** Build a memory map of the local process once and for all, with every
+ * eh_elf opened ahead of time, for use by `mmap_get_prepared_entry`. Calling
+ * this again rebuilds it, eg. after `dlopen`; the map it replaces is released
+ * by the first call after every lookup that could reach it has ended.
+ * @returns 0 upon success, or a negative value upon failure.
+ **/
+int mmap_prepare_local();
+
+/// Whether `mmap_prepare_local` was successfully called
+int mmap_is_prepared();
+
+/** Bracket lookups through `mmap_get_prepared_entry` and the use of the entries
+ * they return, which stay valid until the matching `mmap_prepared_read_end`.
+ * Brackets may nest, and are async-signal-safe.
+ **/
+void mmap_prepared_read_begin();
+void mmap_prepared_read_end();
 
-/** Get the `mmap_entry_t` corresponding to the given IP
+/** Get the `mmap_entry_t` corresponding to the given IP in the prepared local
+ * memory map, between `mmap_prepared_read_begin` and `mmap_prepared_read_end`.
+ * This is async-signal-safe: it neither allocates, locks nor calls into libc.
  * @return a pointer to the corresponding memory map entry, or NULL upon
  * failure.
  **/
-mmap_entry_t* mmap_get_entry(uintptr_t ip);
+mmap_entry_t* mmap_get_prepared_entry(uintptr_t ip);
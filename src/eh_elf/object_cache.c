@@ -0,0 +1,324 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+
+#include "object_cache.h"
+#include <elf.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "libunwind_i.h"
+
+/// Number of buckets of each hash table
+#define OBJ_CACHE_BUCKETS 256
+
+/// Number of unused objects kept open before the oldest one is closed
+#define OBJ_CACHE_MAX_IDLE 256
+
+static define_lock(_obj_cache_lock);
+/// Paths objects were found under, by hash of the path and inode
+static eh_elf_object_name_t* _by_name[OBJ_CACHE_BUCKETS];
+/// Objects that have a build-id, by hash of their build-id
+static eh_elf_object_t* _by_id[OBJ_CACHE_BUCKETS];
+/// Unused objects, most recently released first
+static eh_elf_object_t* _idle_list = NULL;
+static size_t _idle_count = 0;
+
+/// FNV-1a hash of `size` bytes at `data`, mixed with `seed`
+static size_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    for(size_t pos = 0; pos < size; ++pos) {
+        hash ^= bytes[pos];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash % OBJ_CACHE_BUCKETS;
+}
+
+/** Read the GNU build-id note of the ELF file at `path` into `build_id`.
+ * @returns its size, or 0 if there is no such note or the file cannot be
+ * read.
+ **/
+static size_t obj_read_build_id(const char* path, uint8_t* build_id) {
+    struct elf_image ei;
+    size_t size;
+
+    if(elf_map_image(&ei, path) < 0)
+        return 0;
+    size = elf_w(get_build_id)(&ei, build_id, OBJ_BUILD_ID_MAX);
+    munmap(ei.image, ei.size);
+    return size;
+}
+
+/// `dlopen` the eh_elf of `obj`, leaving it NULL if there is none
+static void obj_open_eh_elf(eh_elf_object_t* obj) {
+    char eh_elf_path[PATH_MAX];
+    char *obj_name_cpy = malloc(strlen(obj->object_name) + 1);
+    if(obj_name_cpy == NULL)
+        return;
+    strcpy(obj_name_cpy, obj->object_name);
+    snprintf(eh_elf_path, sizeof(eh_elf_path),
+            "%s.eh_elf.so", basename(obj_name_cpy));
+    free(obj_name_cpy);
+
+    obj->eh_elf = dlopen(eh_elf_path, RTLD_LAZY);
+    if(obj->eh_elf == NULL) {
+        Debug(3, "Could not open eh_elf.so %s\n", eh_elf_path);
+        return;
+    }
+
+    // Find the fde function
+    obj->fde_func =
+        (_fde_func_with_deref_t) (dlsym(obj->eh_elf, "_eh_elf"));
+    if(obj->fde_func == NULL) {
+        Debug(3, "Could not find _eh_elf in %s\n", eh_elf_path);
+        dlclose(obj->eh_elf);
+        obj->eh_elf = NULL;
+        return;
+    }
+
+    char opened_file[PATH_MAX];
+    dlinfo(obj->eh_elf, RTLD_DI_ORIGIN, opened_file);
+    Debug(4, "Opened %s/%s\n", opened_file, eh_elf_path);
+}
+
+/// Create an object for the ELF object `object_name`, opening its eh_elf
+static eh_elf_object_t* obj_create(const char* object_name,
+        unsigned long inode, const uint8_t* build_id, size_t build_id_size)
+{
+    eh_elf_object_t* obj =
+        (eh_elf_object_t*) calloc(1, sizeof(eh_elf_object_t));
+    if(obj == NULL)
+        return NULL;
+    obj->object_name = (char*) malloc(strlen(object_name) + 1);
+    if(obj->object_name == NULL) {
+        free(obj);
+        return NULL;
+    }
+    strcpy(obj->object_name, object_name);
+    obj->inode = inode;
+    memcpy(obj->build_id, build_id, build_id_size);
+    obj->build_id_size = build_id_size;
+    obj_open_eh_elf(obj);
+    return obj;
+}
+
+/// Close `obj` and free it, together with its names
+static void obj_destroy(eh_elf_object_t* obj) {
+    while(obj->names != NULL) {
+        eh_elf_object_name_t* name = obj->names;
+        obj->names = name->next_of_obj;
+        free(name->path);
+        free(name);
+    }
+    if(obj->eh_elf != NULL)
+        dlclose(obj->eh_elf);
+    free(obj->object_name);
+    free(obj);
+}
+
+/// Remove `obj` from `*bucket`, linked through the `next` field at `offset`
+static void obj_unlink(eh_elf_object_t** bucket, eh_elf_object_t* obj,
+        size_t offset)
+{
+    while(*bucket != NULL) {
+        eh_elf_object_t** next =
+            (eh_elf_object_t**) ((char*) *bucket + offset);
+        if(*bucket == obj) {
+            *bucket = *next;
+            return;
+        }
+        bucket = next;
+    }
+}
+
+/// Find the object found under `path` and `inode`, whose hash is `name_hash`
+static eh_elf_object_t* obj_find_by_name(const char* path,
+        unsigned long inode, size_t name_hash)
+{
+    eh_elf_object_name_t* name = _by_name[name_hash];
+    for(; name != NULL; name = name->next_in_bucket) {
+        if(name->inode == inode && strcmp(name->path, path) == 0)
+            return name->obj;
+    }
+    return NULL;
+}
+
+/// Find the object with the build-id `build_id`, if it is not empty
+static eh_elf_object_t* obj_find_by_id(const uint8_t* build_id,
+        size_t build_id_size)
+{
+    if(build_id_size == 0)
+        return NULL;
+
+    eh_elf_object_t* obj = _by_id[hash_bytes(build_id, build_id_size, 0)];
+    for(; obj != NULL; obj = obj->next_by_id) {
+        if(obj->build_id_size == build_id_size
+                && memcmp(obj->build_id, build_id, build_id_size) == 0)
+            return obj;
+    }
+    return NULL;
+}
+
+/** Record that `obj` is found under `path` and `inode`, whose hash is
+ * `name_hash`, for the next lookups of this path not to read the file.
+ * Failing to is harmless: the object is then found by build-id again.
+ **/
+static void obj_add_name(eh_elf_object_t* obj, const char* path,
+        unsigned long inode, size_t name_hash)
+{
+    eh_elf_object_name_t* name =
+        (eh_elf_object_name_t*) malloc(sizeof(eh_elf_object_name_t));
+    if(name == NULL)
+        return;
+    name->path = (char*) malloc(strlen(path) + 1);
+    if(name->path == NULL) {
+        free(name);
+        return;
+    }
+    strcpy(name->path, path);
+    name->inode = inode;
+    name->obj = obj;
+    name->next_of_obj = obj->names;
+    obj->names = name;
+    name->next_in_bucket = _by_name[name_hash];
+    _by_name[name_hash] = name;
+}
+
+/// Close the oldest unused object
+static void obj_evict_idle() {
+    eh_elf_object_t** last = &_idle_list;
+    while((*last)->next_idle != NULL)
+        last = &(*last)->next_idle;
+    eh_elf_object_t* obj = *last;
+    *last = NULL;
+    --_idle_count;
+
+    Debug(4, "Closing unused eh_elf for %s\n", obj->object_name);
+    for(eh_elf_object_name_t* name = obj->names; name != NULL;
+            name = name->next_of_obj)
+    {
+        eh_elf_object_name_t** bucket = &_by_name[hash_bytes(name->path,
+                strlen(name->path), name->inode)];
+        while(*bucket != name)
+            bucket = &(*bucket)->next_in_bucket;
+        *bucket = name->next_in_bucket;
+    }
+    if(obj->build_id_size > 0)
+        obj_unlink(&_by_id[hash_bytes(obj->build_id, obj->build_id_size, 0)],
+                obj, offsetof(eh_elf_object_t, next_by_id));
+    obj_destroy(obj);
+}
+
+/// Take a reference to `obj`, which is in the cache
+static eh_elf_object_t* obj_take(eh_elf_object_t* obj) {
+    if(obj->refcount == 0) {
+        // Unused since its last release: take it back from the idle list
+        obj_unlink(&_idle_list, obj, offsetof(eh_elf_object_t, next_idle));
+        obj->next_idle = NULL;
+        --_idle_count;
+    }
+    ++obj->refcount;
+    return obj;
+}
+
+eh_elf_object_t* obj_cache_acquire(const char* object_name,
+        unsigned long inode)
+{
+    intrmask_t saved_mask;
+    eh_elf_object_t *obj, *fresh;
+    uint8_t build_id[OBJ_BUILD_ID_MAX];
+    size_t build_id_size;
+    struct stat st;
+
+    if(inode == 0 && stat(object_name, &st) == 0)
+        inode = st.st_ino;
+    size_t name_hash = hash_bytes(object_name, strlen(object_name), inode);
+
+    // This very file was already seen: no need to read its build-id
+    lock_acquire(&_obj_cache_lock, saved_mask);
+    obj = obj_find_by_name(object_name, inode, name_hash);
+    if(obj != NULL)
+        goto found;
+    lock_release(&_obj_cache_lock, saved_mask);
+
+    // Files are read and eh_elfs opened without the lock held. Another
+    // thread may meanwhile do the same for the same object: the first one
+    // to insert its object wins.
+    build_id_size = obj_read_build_id(object_name, build_id);
+
+    // Another path to, or copy of, a known object
+    lock_acquire(&_obj_cache_lock, saved_mask);
+    obj = obj_find_by_id(build_id, build_id_size);
+    if(obj != NULL)
+        goto alias;
+    lock_release(&_obj_cache_lock, saved_mask);
+
+    fresh = obj_create(object_name, inode, build_id, build_id_size);
+    if(fresh == NULL)
+        return NULL;
+
+    lock_acquire(&_obj_cache_lock, saved_mask);
+    obj = obj_find_by_name(object_name, inode, name_hash);
+    if(obj == NULL && (obj = obj_find_by_id(build_id, build_id_size)))
+        obj_add_name(obj, object_name, inode, name_hash);
+    if(obj != NULL) {
+        // Another thread was faster: close ours once we hold the other one
+        obj_take(obj);
+        lock_release(&_obj_cache_lock, saved_mask);
+        obj_destroy(fresh);
+        return obj;
+    }
+
+    obj = fresh;
+    obj_add_name(obj, object_name, inode, name_hash);
+    if(build_id_size > 0) {
+        size_t id_hash = hash_bytes(build_id, build_id_size, 0);
+        obj->next_by_id = _by_id[id_hash];
+        _by_id[id_hash] = obj;
+    }
+    Debug(4, "New eh_elf object for %s\n", object_name);
+    goto take;
+
+alias:
+    obj_add_name(obj, object_name, inode, name_hash);
+found:
+    Debug(4, "Reusing eh_elf object %s for %s\n",
+            obj->object_name, object_name);
+take:
+    obj_take(obj);
+    lock_release(&_obj_cache_lock, saved_mask);
+    return obj;
+}
+
+void obj_cache_release(eh_elf_object_t* obj) {
+    intrmask_t saved_mask;
+
+    if(obj == NULL)
+        return;
+
+    lock_acquire(&_obj_cache_lock, saved_mask);
+    assert(obj->refcount > 0);
+    if(--obj->refcount == 0) {
+        obj->next_idle = _idle_list;
+        _idle_list = obj;
+        if(++_idle_count > OBJ_CACHE_MAX_IDLE)
+            obj_evict_idle();
+    }
+    lock_release(&_obj_cache_lock, saved_mask);
+}
@@ -0,0 +1,71 @@
+/********** Libunwind -- eh_elf flavour **********
+ * This is the eh_elf version of libunwind, made for academic purposes.
+ *
+ * Théophile Bastian <theophile.bastian@ens.fr> <contact+github@tobast.fr>
+ *************************************************
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ ************************************************/
+
+
+#pragma once
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <dlfcn.h>
+
+#include "context_struct.h"
+
+/// A type representing a dlopen handle
+typedef void* dl_obj_t;
+
+/// Longest build-id we keep: a SHA-1 is 20 bytes, leave room for others
+#define OBJ_BUILD_ID_MAX 32
+
+struct eh_elf_object;
+
+/// A path and inode under which an eh_elf object was found
+typedef struct eh_elf_object_name {
+    char* path;
+    unsigned long inode;
+    struct eh_elf_object* obj;                   ///< Object found there
+    struct eh_elf_object_name* next_in_bucket;   ///< Next in `path` bucket
+    struct eh_elf_object_name* next_of_obj;      ///< Next name of `obj`
+} eh_elf_object_name_t;
+
+/** An eh_elf object, shared by every memory map, of every address space, that
+ * maps the ELF object it was generated from. Objects are identified by the
+ * build-id of this ELF object, or by its path and inode when it has none.
+ **/
+typedef struct eh_elf_object {
+    uint8_t build_id[OBJ_BUILD_ID_MAX]; ///< Build-id of the original object
+    size_t build_id_size;    ///< Size of `build_id`, 0 if there is none
+    char* object_name;       ///< Path of the object first found with this id
+    unsigned long inode;     ///< Inode of `object_name`
+    dl_obj_t eh_elf;         ///< Corresponding eh_elf file, dlopen'd, or NULL
+    _fde_func_with_deref_t fde_func; ///< Fde deref function, or NULL
+
+    unsigned refcount;       ///< Number of memory map entries using this
+    eh_elf_object_name_t* names;         ///< Paths it was found under
+    struct eh_elf_object* next_by_id;    ///< Next in `build_id` bucket
+    struct eh_elf_object* next_idle;     ///< Next unused object, if unused
+} eh_elf_object_t;
+
+/** Get a reference to the eh_elf object for the ELF object `object_name`, as
+ * mapped from `inode` (0 if unknown), opening it if no memory map uses it yet.
+ * An object with no eh_elf is returned as well, with a NULL `fde_func`, so
+ * that it is not looked for again.
+ * @return the object, or NULL upon allocation failure.
+ **/
+eh_elf_object_t* obj_cache_acquire(const char* object_name,
+        unsigned long inode);
+
+/** Release a reference obtained through `obj_cache_acquire`. Unused objects
+ * are kept open for a while, in case another address space maps them soon.
+ **/
+void obj_cache_release(eh_elf_object_t* obj);
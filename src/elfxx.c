@@ -178,6 +178,54 @@ elf_w (get_load_offset) (struct elf_image *ei, unsigned long segbase,
   return offset;
 }
 
+/* Copy the GNU build-id of EI to ID and return its size, or 0 if there
+   is none.  */
+
+HIDDEN size_t
+elf_w (get_build_id) (struct elf_image *ei, uint8_t *id, size_t id_max)
+{
+  Elf_W (Ehdr) *ehdr = ei->image;
+  Elf_W (Phdr) *phdr;
+  Elf_W (Nhdr) *nhdr;
+  size_t pos, end, name_pos, desc_pos, next_pos;
+  char *notes;
+  int i;
+
+  if (ehdr->e_phoff > ei->size
+      || ehdr->e_phnum > (ei->size - ehdr->e_phoff) / sizeof (Elf_W (Phdr)))
+    return 0;
+
+  phdr = (Elf_W (Phdr) *) ((char *) ei->image + ehdr->e_phoff);
+  for (i = 0; i < ehdr->e_phnum; ++i)
+    {
+      if (phdr[i].p_type != PT_NOTE || phdr[i].p_offset > ei->size
+          || phdr[i].p_filesz > ei->size - phdr[i].p_offset)
+        continue;
+
+      /* Each note is a name and a descriptor, both padded to 4 bytes.  */
+      notes = (char *) ei->image + phdr[i].p_offset;
+      end = phdr[i].p_filesz;
+      for (pos = 0; end - pos >= sizeof (Elf_W (Nhdr)); pos = next_pos)
+        {
+          nhdr = (Elf_W (Nhdr) *) (notes + pos);
+          name_pos = pos + sizeof (Elf_W (Nhdr));
+          desc_pos = name_pos + ((nhdr->n_namesz + 3) & ~3UL);
+          next_pos = desc_pos + ((nhdr->n_descsz + 3) & ~3UL);
+          if (next_pos > end || next_pos <= pos)
+            break;
+
+          if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4
+              && memcmp (notes + name_pos, "GNU", 4) == 0
+              && nhdr->n_descsz > 0 && nhdr->n_descsz <= id_max)
+            {
+              memcpy (id, notes + desc_pos, nhdr->n_descsz);
+              return nhdr->n_descsz;
+            }
+        }
+    }
+  return 0;
+}
+
 #if HAVE_LZMA
 static size_t
 xz_uncompressed_size (uint8_t *compressed, size_t length)
@@ -211,16 +259,58 @@ xz_uncompressed_size (uint8_t *compressed, size_t length)
   return ret;
 }
 
+/* Decompressed MiniDebugInfo is kept for the most recently used objects,
+   together with an index of its function symbols sorted by address, so
+   that symbolizing every frame of a stripped binary does not decompress
+   and scan the whole symbol table again.  Entries are keyed by the
+   object's build-id or, if it has none, by the identity of the file it
+   was mapped from, since the image itself is mapped afresh for each
+   lookup.  The MiniDebugInfo of an image that has neither is extracted
+   into mdi_scratch and dropped after the lookup.  */
+
+#define MDI_CACHE_SIZE  8
+#define MDI_ID_MAX      32
+#define MDI_KEY_MAX     (1 + sizeof (uint64_t) + MDI_ID_MAX)
+
+/* Function descriptors are read through the address space, so on these
+   targets the entry points are not known when the index is built.  */
+#if defined(UNW_TARGET_PPC32) || defined(UNW_TARGET_PPC64)
+# define MDI_SORTED_SYMBOLS     0
+#else
+# define MDI_SORTED_SYMBOLS     1
+#endif
+
+struct mdi_symbol
+  {
+    Elf_W (Addr) value;         /* st_value, not relocated */
+    const char *name;
+    unsigned int order;         /* symbol table order, to break ties */
+    unsigned int abs;           /* SHN_ABS, not relocated either */
+  };
+
+struct mdi_cache_entry
+  {
+    uint8_t key[MDI_KEY_MAX];
+    size_t key_len;
+    unsigned long last_use;     /* 0 if the entry is free */
+    struct elf_image image;     /* image.image is NULL if extraction failed */
+    struct mdi_symbol *syms;    /* relocatable symbols first, then SHN_ABS */
+    size_t nsyms, nabs;
+  };
+
+static define_lock (mdi_cache_lock);
+static struct mdi_cache_entry mdi_cache[MDI_CACHE_SIZE];
+static struct mdi_cache_entry mdi_scratch;
+static unsigned long mdi_cache_clock;
+
 static int
-elf_w (extract_minidebuginfo) (struct elf_image *ei, struct elf_image *mdi)
+elf_w (find_minidebuginfo) (struct elf_image *ei, uint8_t **compressed,
+                            size_t *compressed_len)
 {
   Elf_W (Ehdr) *ehdr = ei->image;
   Elf_W (Shdr) *shdr;
   char *strtab;
   int i;
-  uint8_t *compressed = NULL;
-  uint64_t memlimit = UINT64_MAX; /* no memory limit */
-  size_t compressed_len, uncompressed_len;
 
   if (!elf_w (valid_object) (ei))
     return 0;
@@ -247,17 +337,24 @@ elf_w (extract_minidebuginfo) (struct elf_image *ei, struct elf_image *mdi)
 
           Debug (16, "found .gnu_debugdata at 0x%lx\n",
                  (unsigned long) shdr->sh_offset);
-          compressed = ((uint8_t *) ei->image) + shdr->sh_offset;
-          compressed_len = shdr->sh_size;
-          break;
+          *compressed = ((uint8_t *) ei->image) + shdr->sh_offset;
+          *compressed_len = shdr->sh_size;
+          return 1;
         }
 
       shdr = (Elf_W (Shdr) *) (((char *) shdr) + ehdr->e_shentsize);
     }
 
   /* not found */
-  if (!compressed)
-    return 0;
+  return 0;
+}
+
+static int
+elf_w (extract_minidebuginfo) (uint8_t *compressed, size_t compressed_len,
+                               struct elf_image *mdi)
+{
+  uint64_t memlimit = UINT64_MAX; /* no memory limit */
+  size_t uncompressed_len;
 
   uncompressed_len = xz_uncompressed_size (compressed, compressed_len);
   if (uncompressed_len == 0)
@@ -287,18 +384,283 @@ elf_w (extract_minidebuginfo) (struct elf_image *ei, struct elf_image *mdi)
 
   return 1;
 }
+
+/* Store the cache key of the MiniDebugInfo of EI in KEY and return its
+   length, or 0 if EI cannot be told apart from another object.  */
+
+static size_t
+elf_w (mdi_cache_key) (struct elf_image *ei, size_t compressed_len,
+                       uint8_t *key)
+{
+  uint64_t len = compressed_len, id[4];
+  size_t id_len;
+
+  memcpy (key + 1, &len, sizeof (len));
+  id_len = elf_w (get_build_id) (ei, key + 1 + sizeof (len), MDI_ID_MAX);
+  if (id_len > 0)
+    {
+      key[0] = 'B';
+      return 1 + sizeof (len) + id_len;
+    }
+
+  if (ei->ino != 0)
+    {
+      /* The file the image was mapped from, as it was then.  */
+      id[0] = ei->dev;
+      id[1] = ei->ino;
+      id[2] = ei->mtime;
+      id[3] = ei->size;
+      key[0] = 'F';
+      memcpy (key + 1 + sizeof (len), id, sizeof (id));
+      return 1 + sizeof (len) + sizeof (id);
+    }
+
+  /* An image not backed by a file, such as a core file segment, may be
+     unmapped and another one mapped at its address.  */
+  return 0;
+}
+
+/* Store the function symbols of MDI in SYMS, if it is not NULL, and
+   return how many there are.  */
+
+static size_t
+elf_w (collect_symbols) (struct elf_image *mdi, struct mdi_symbol *syms)
+{
+  Elf_W (Ehdr) *ehdr = mdi->image;
+  Elf_W (Sym) *sym, *symtab, *symtab_end;
+  Elf_W (Shdr) *shdr;
+  size_t n = 0;
+  char *strtab;
+  int i;
+
+  shdr = elf_w (section_table) (mdi);
+  if (!shdr)
+    return 0;
+
+  for (i = 0; i < ehdr->e_shnum; ++i)
+    {
+      if ((shdr->sh_type == SHT_SYMTAB || shdr->sh_type == SHT_DYNSYM)
+          && shdr->sh_entsize >= sizeof (Elf_W (Sym))
+          && shdr->sh_offset + shdr->sh_size <= mdi->size
+          && (strtab = elf_w (string_table) (mdi, shdr->sh_link)) != NULL)
+        {
+          symtab = (Elf_W (Sym) *) ((char *) mdi->image + shdr->sh_offset);
+          symtab_end = (Elf_W (Sym) *) ((char *) symtab + shdr->sh_size);
+
+          for (sym = symtab;
+               sym < symtab_end;
+               sym = (Elf_W (Sym) *) ((char *) sym + shdr->sh_entsize))
+            if (ELF_W (ST_TYPE) (sym->st_info) == STT_FUNC
+                && sym->st_shndx != SHN_UNDEF)
+              {
+                if (syms)
+                  {
+                    syms[n].value = sym->st_value;
+                    syms[n].name = strtab + sym->st_name;
+                    syms[n].order = n;
+                    syms[n].abs = (sym->st_shndx == SHN_ABS);
+                  }
+                ++n;
+              }
+        }
+      shdr = (Elf_W (Shdr) *) (((char *) shdr) + ehdr->e_shentsize);
+    }
+  return n;
+}
+
+static int
+mdi_symbol_compare (const void *a, const void *b)
+{
+  const struct mdi_symbol *sa = a, *sb = b;
+
+  if (sa->abs != sb->abs)
+    return sa->abs < sb->abs ? -1 : 1;
+  if (sa->value != sb->value)
+    return sa->value < sb->value ? -1 : 1;
+  return sa->order < sb->order ? -1 : (sa->order > sb->order);
+}
+
+static void
+elf_w (index_symbols) (struct mdi_cache_entry *e)
+{
+  size_t n, i;
+
+  e->syms = NULL;
+  e->nsyms = e->nabs = 0;
+  if (!MDI_SORTED_SYMBOLS || !elf_w (valid_object) (&e->image))
+    return;
+
+  n = elf_w (collect_symbols) (&e->image, NULL);
+  if (n == 0)
+    return;
+  GET_MEMORY (e->syms, n * sizeof (*e->syms));
+  if (!e->syms)
+    return;
+
+  e->nsyms = elf_w (collect_symbols) (&e->image, e->syms);
+  qsort (e->syms, e->nsyms, sizeof (*e->syms), mdi_symbol_compare);
+  for (i = 0; i < e->nsyms; ++i)
+    e->nabs += e->syms[i].abs;
+  Debug (15, "indexed %lu function symbols\n", (unsigned long) e->nsyms);
+}
+
+static void
+elf_w (mdi_cache_evict) (struct mdi_cache_entry *e)
+{
+  if (e->syms)
+    munmap (e->syms, e->nsyms * sizeof (*e->syms));
+  if (e->image.image)
+    munmap (e->image.image, e->image.size);
+  memset (e, 0, sizeof (*e));
+}
+
+/* Return the cache entry for the MiniDebugInfo of EI, decompressing it
+   if needed, or NULL if EI has none.  The entry is mdi_scratch if EI
+   cannot be cached.  Must be called with mdi_cache_lock held.  */
+
+static struct mdi_cache_entry *
+elf_w (mdi_cache_get) (struct elf_image *ei)
+{
+  struct mdi_cache_entry *e, *victim = &mdi_cache[0];
+  uint8_t key[MDI_KEY_MAX], *compressed;
+  size_t key_len, compressed_len;
+  int i;
+
+  if (!elf_w (find_minidebuginfo) (ei, &compressed, &compressed_len))
+    return NULL;
+  key_len = elf_w (mdi_cache_key) (ei, compressed_len, key);
+  if (key_len == 0)
+    victim = &mdi_scratch;
+
+  for (i = 0; key_len > 0 && i < MDI_CACHE_SIZE; ++i)
+    {
+      e = &mdi_cache[i];
+      if (e->last_use && e->key_len == key_len
+          && memcmp (e->key, key, key_len) == 0)
+        {
+          e->last_use = ++mdi_cache_clock;
+          return e->image.image ? e : NULL;
+        }
+      if (e->last_use < victim->last_use)
+        victim = e;
+    }
+
+  e = victim;
+  elf_w (mdi_cache_evict) (e);
+  memcpy (e->key, key, key_len);
+  e->key_len = key_len;
+  e->last_use = ++mdi_cache_clock;
+
+  /* A failure is remembered too, so as not to retry it for every frame.  */
+  if (!elf_w (extract_minidebuginfo) (compressed, compressed_len, &e->image))
+    {
+      e->image.image = NULL;
+      return NULL;
+    }
+  elf_w (index_symbols) (e);
+  return e;
+}
+
+/* Return the symbol in SYMS[LO, HI) closest to TARGET without being
+   above it, or NULL if there is none.  */
+
+static struct mdi_symbol *
+mdi_search (struct mdi_symbol *syms, size_t lo, size_t hi, Elf_W (Addr) target)
+{
+  size_t first = lo, mid;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (syms[mid].value <= target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  if (lo == first)
+    return NULL;
+
+  /* Same as a linear scan: the first of several aliases wins.  */
+  --lo;
+  while (lo > first && syms[lo - 1].value == syms[lo].value)
+    --lo;
+  return &syms[lo];
+}
+
+static int
+elf_w (lookup_indexed_symbol) (struct mdi_cache_entry *e, unw_word_t ip,
+                               Elf_W (Addr) load_offset,
+                               char *buf, size_t buf_len,
+                               Elf_W (Addr) *min_dist)
+{
+  struct mdi_symbol *sym, *best = NULL;
+  Elf_W (Addr) dist;
+  size_t nrel = e->nsyms - e->nabs;
+
+  sym = mdi_search (e->syms, 0, nrel, ip - load_offset);
+  if (sym && (dist = ip - load_offset - sym->value) < *min_dist)
+    {
+      *min_dist = dist;
+      best = sym;
+    }
+  sym = mdi_search (e->syms, nrel, e->nsyms, ip);
+  if (sym && (dist = ip - sym->value) < *min_dist)
+    {
+      *min_dist = dist;
+      best = sym;
+    }
+  if (!best)
+    return -UNW_ENOINFO;
+
+  strncpy (buf, best->name, buf_len);
+  buf[buf_len - 1] = '\0';
+  return strlen (best->name) >= buf_len ? -UNW_ENOMEM : 0;
+}
+
+static int
+elf_w (lookup_minidebuginfo) (unw_addr_space_t as,
+                              unw_word_t ip, struct elf_image *ei,
+                              Elf_W (Addr) load_offset,
+                              char *buf, size_t buf_len,
+                              Elf_W (Addr) *min_dist)
+{
+  struct mdi_cache_entry *e;
+  sigset_t all, saved;
+  int ret = -UNW_ENOINFO;
+
+  /* A signal handler looking up a name must not find the lock taken by
+     the code it interrupted.  This file is also built into
+     libunwind-ptrace and -coredump, which have no unwi_full_mask.  */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &saved);
+  mutex_lock (&mdi_cache_lock);
+  e = elf_w (mdi_cache_get) (ei);
+  if (e && e->syms)
+    ret = elf_w (lookup_indexed_symbol) (e, ip, load_offset, buf, buf_len,
+                                         min_dist);
+  else if (e)
+    ret = elf_w (lookup_symbol) (as, ip, &e->image, load_offset, buf,
+                                 buf_len, min_dist);
+  if (mdi_scratch.last_use)
+    elf_w (mdi_cache_evict) (&mdi_scratch);
+  mutex_unlock (&mdi_cache_lock);
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+  return ret;
+}
 #else
 static int
-elf_w (extract_minidebuginfo) (struct elf_image *ei, struct elf_image *mdi)
+elf_w (lookup_minidebuginfo) (unw_addr_space_t as,
+                              unw_word_t ip, struct elf_image *ei,
+                              Elf_W (Addr) load_offset,
+                              char *buf, size_t buf_len,
+                              Elf_W (Addr) *min_dist)
 {
-  return 0;
+  return -UNW_ENOINFO;
 }
 #endif /* !HAVE_LZMA */
 
 /* Find the ELF image that contains IP and return the "closest"
-   procedure name, if there is one.  With some caching, this could be
-   sped up greatly, but until an application materializes that's
-   sensitive to the performance of this routine, why bother...  */
+   procedure name, if there is one.  */
 
 HIDDEN int
 elf_w (get_proc_name_in_image) (unw_addr_space_t as, struct elf_image *ei,
@@ -316,19 +678,13 @@ elf_w (get_proc_name_in_image) (unw_addr_space_t as, struct elf_image *ei,
 
   /* If the ELF image has MiniDebugInfo embedded in it, look up the symbol in
      there as well and replace the previously found if it is closer. */
-  struct elf_image mdi;
-  if (elf_w (extract_minidebuginfo) (ei, &mdi))
-    {
-      int ret_mdi = elf_w (lookup_symbol) (as, ip, &mdi, load_offset, buf,
-                                           buf_len, &min_dist);
+  int ret_mdi = elf_w (lookup_minidebuginfo) (as, ip, ei, load_offset, buf,
+                                              buf_len, &min_dist);
 
-      /* Closer symbol was found (possibly truncated). */
-      if (ret_mdi == 0 || ret_mdi == -UNW_ENOMEM)
-        {
-          ret = ret_mdi;
-        }
-
-      munmap (mdi.image, mdi.size);
+  /* Closer symbol was found (possibly truncated). */
+  if (ret_mdi == 0 || ret_mdi == -UNW_ENOMEM)
+    {
+      ret = ret_mdi;
     }
 
   if (min_dist >= ei->size)
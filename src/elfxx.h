@@ -47,6 +47,9 @@ extern int elf_w (get_proc_name) (unw_addr_space_t as,
                                   char *buf, size_t len,
                                   unw_word_t *offp);
 
+extern size_t elf_w (get_build_id) (struct elf_image *ei,
+                                    uint8_t *id, size_t id_max);
+
 extern int elf_w (get_proc_name_in_image) (unw_addr_space_t as,
                                            struct elf_image *ei,
                                            unsigned long segbase,
@@ -83,6 +86,9 @@ elf_map_image (struct elf_image *ei, const char *path)
     }
 
   ei->size = stat.st_size;
+  ei->dev = stat.st_dev;
+  ei->ino = stat.st_ino;
+  ei->mtime = stat.st_mtime;
   ei->image = mmap (NULL, ei->size, PROT_READ, MAP_PRIVATE, fd, 0);
   close (fd);
   if (ei->image == MAP_FAILED)
@@ -0,0 +1,78 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "libunwind_i.h"
+
+/* Step C on from frame N, filling BUFFER up to SIZE frames, and return
+   how many it then holds.  *RET is set to what unw_step() last returned.  */
+static int
+step_frames (unw_cursor_t *c, void **buffer, int n, int size, int *ret)
+{
+  unw_word_t ip;
+
+  *ret = 0;
+  while (n < size && (*ret = unw_step (c)) > 0)
+    {
+      if (unw_get_reg (c, UNW_REG_IP, &ip) < 0)
+        break;
+      buffer[n++] = (void *) (uintptr_t) ip;
+    }
+  return n;
+}
+
+/* Fill BUFFER with the addresses of at most SIZE frames, from the one
+   of CURSOR upwards, and return how many.  CURSOR itself is left as
+   it is.  */
+PROTECTED int
+unw_backtrace_remote (unw_cursor_t *cursor, void **buffer, int size)
+{
+  unw_cursor_t c = *cursor;
+  unw_word_t ip;
+  int n, traced, ret;
+
+  if (size <= 0 || unw_get_reg (&c, UNW_REG_IP, &ip) < 0)
+    return 0;
+  buffer[0] = (void *) (uintptr_t) ip;
+
+  /* Trace as far as the frames cached for the address space allow,
+     then step on from the frame where tracing stopped.  */
+  n = size - 1;
+  if (n == 0 || tdep_trace_remote (&c, buffer + 1, &n) >= 0)
+    return n + 1;
+  traced = n + 1;
+  n = step_frames (&c, buffer, traced, size, &ret);
+
+  /* Tracing only knows a few registers of the frames it went through.
+     Should stepping on have needed another one, step up to the frame
+     where tracing stopped again, with all of them, and go on from
+     there.  */
+  if (ret < 0 && traced > 1)
+    {
+      c = *cursor;
+      for (n = 1; n < traced && unw_step (&c) > 0; ++n)
+        continue;
+      if (n == traced)
+        n = step_frames (&c, buffer, traced, size, &ret);
+    }
+  return n;
+}
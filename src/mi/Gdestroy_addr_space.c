@@ -29,6 +29,40 @@ PROTECTED void
 unw_destroy_addr_space (unw_addr_space_t as)
 {
 #ifndef UNW_LOCAL_ONLY
+# if !UNW_TARGET_IA64
+  struct unw_remote_table *t, *next;
+# endif
+
+# ifdef tdep_destroy_addr_space
+  tdep_destroy_addr_space (as);
+# endif
+  if (as->dyn_index)
+    {
+      free (as->dyn_index->entries);
+      free (as->dyn_index);
+    }
+# if !UNW_TARGET_IA64
+  for (t = as->remote_tables; t; t = next)
+    {
+      next = t->next;
+      if (t->map_size)
+        {
+          munmap (t, t->map_size);
+          continue;
+        }
+      free (t->table);
+      free (t->index);
+      free (t);
+    }
+  /* flushed ones, now that nobody is looking them up */
+  retire_release (&as->table_retire, as->table_retire.state >> 32);
+  if (as->cie_cache)
+    munmap (as->cie_cache, sizeof (*as->cie_cache));
+  if (as->expr_cache)
+    munmap (as->expr_cache, sizeof (*as->expr_cache));
+  if (as->global_cache.cfi)
+    munmap (as->global_cache.cfi, sizeof (*as->global_cache.cfi));
+# endif
 # if UNW_DEBUG
   memset (as, 0, sizeof (*as));
 # endif
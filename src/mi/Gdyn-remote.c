@@ -24,6 +24,7 @@ OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "libunwind_i.h"
 #include "remote.h"
@@ -200,14 +201,348 @@ intern_dyn_info (unw_addr_space_t as, unw_accessors_t *a,
   return ret;
 }
 
+/* Read the start and end address of the entry at ADDR in the remote
+   list and the address of the entry following it.  */
+
+static int
+fetch_entry_range (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
+                   unw_word_t *next_addr, unw_word_t *start_ip,
+                   unw_word_t *end_ip, void *arg)
+{
+  int ret;
+
+  if ((ret = fetchw (as, a, &addr, next_addr, arg)) < 0)
+    return ret;
+
+  addr += WSIZE;        /* skip over prev_addr */
+
+  if ((ret = fetchw (as, a, &addr, start_ip, arg)) < 0
+      || (ret = fetchw (as, a, &addr, end_ip, arg)) < 0)
+    return ret;
+  return 0;
+}
+
+static int
+entry_compare (const void *l, const void *r)
+{
+  const struct unw_dyn_remote_entry *a = l, *b = r;
+
+  if (a->start_ip != b->start_ip)
+    return a->start_ip < b->start_ip ? -1 : 1;
+  return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static int
+word_compare (const void *l, const void *r)
+{
+  const unw_word_t *a = l, *b = r;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
+static int
+index_reserve (struct unw_dyn_remote_index *index, size_t size)
+{
+  struct unw_dyn_remote_entry *entries;
+  size_t alloc;
+
+  if (size <= index->alloc)
+    return 0;
+
+  alloc = index->alloc ? 2 * index->alloc : 256;
+  while (alloc < size)
+    alloc *= 2;
+
+  entries = realloc (index->entries, alloc * sizeof (*entries));
+  if (!entries)
+    return -UNW_ENOMEM;
+  index->entries = entries;
+  index->alloc = alloc;
+  return 0;
+}
+
+/* Walk up to COUNT entries from the head of the remote list and append
+   them to the index.  The head of the list is the most recently
+   registered entry, so it gets the largest sequence number.  */
+
+static int
+index_append (unw_addr_space_t as, unw_accessors_t *a,
+              struct unw_dyn_remote_index *index, unw_word_t first,
+              unw_word_t count, void *arg)
+{
+  struct unw_dyn_remote_entry *e;
+  unw_word_t addr, next_addr, n = 0;
+  size_t i, base = index->size;
+  int ret;
+
+  for (addr = first; addr != 0 && n < count; addr = next_addr)
+    {
+      if ((ret = index_reserve (index, index->size + 1)) < 0)
+        return ret;
+
+      e = index->entries + index->size;
+      if ((ret = fetch_entry_range (as, a, addr, &next_addr, &e->start_ip,
+                                    &e->end_ip, arg)) < 0)
+        return ret;
+      e->addr = addr;
+      ++index->size;
+      ++n;
+    }
+
+  for (i = base; i < index->size; ++i)
+    index->entries[i].seq = index->next_seq + (index->size - i);
+  index->next_seq += n;
+  return 0;
+}
+
+/* Drop the entries before SIZE whose remote address is one of the COUNT
+   (sorted) ones in ADDRS, and return the number of those left.  */
+
+static size_t
+index_remove (struct unw_dyn_remote_index *index, unw_word_t *addrs,
+              size_t count, size_t size)
+{
+  size_t i, j;
+
+  for (i = j = 0; i < size; ++i)
+    if (!bsearch (&index->entries[i].addr, addrs, count, sizeof (*addrs),
+                  word_compare))
+      index->entries[j++] = index->entries[i];
+
+  memmove (index->entries + j, index->entries + size,
+           (index->size - size) * sizeof (*index->entries));
+  index->size -= size - j;
+  return j;
+}
+
+/* Merge the sorted entries from POS to the end of the index into the
+   sorted ones before POS.  */
+
+static void
+index_merge (struct unw_dyn_remote_index *index, size_t pos)
+{
+  struct unw_dyn_remote_entry *e = index->entries, *tmp;
+  size_t i = pos, j = index->size - pos, k = index->size;
+
+  if (j == 0)
+    return;
+
+  /* Move the new entries out of the way and merge from the back.  */
+  tmp = malloc (j * sizeof (*tmp));
+  if (!tmp)
+    {
+      qsort (e, index->size, sizeof (*e), entry_compare);
+      return;
+    }
+  memcpy (tmp, e + pos, j * sizeof (*tmp));
+
+  while (j > 0)
+    if (i > 0 && entry_compare (e + i - 1, tmp + j - 1) > 0)
+      e[--k] = e[--i];
+    else
+      e[--k] = tmp[--j];
+  free (tmp);
+}
+
+static void
+index_finish (struct unw_dyn_remote_index *index)
+{
+  unw_word_t max_end = 0;
+  size_t i;
+
+  for (i = 0; i < index->size; ++i)
+    {
+      if (index->entries[i].end_ip > max_end)
+        max_end = index->entries[i].end_ip;
+      index->entries[i].max_end = max_end;
+    }
+}
+
+static int
+index_reload (unw_addr_space_t as, unw_accessors_t *a,
+              struct unw_dyn_remote_index *index, unw_word_t first, void *arg)
+{
+  int ret;
+
+  index->size = 0;
+  if ((ret = index_append (as, a, index, first, ~(unw_word_t) 0, arg)) < 0)
+    return ret;
+
+  qsort (index->entries, index->size, sizeof (*index->entries),
+         entry_compare);
+  index_finish (index);
+  return 0;
+}
+
+/* Bring the index up to date with NCANCEL cancellations, recorded in
+   the log at CANCEL_LOG, and NREGISTER registrations, which are at the
+   head of the list.  Entries cancelled since are found in the log, so
+   only the new entries need to be read.  */
+
+static int
+index_update (unw_addr_space_t as, unw_accessors_t *a,
+              struct unw_dyn_remote_index *index, unw_word_t first,
+              unw_word_t cancel_log, unw_word_t ncancel,
+              unw_word_t nregister, void *arg)
+{
+  unw_word_t addr, *addrs;
+  size_t i, n = 0, size = index->size;
+  int ret;
+
+  /* If some of the new entries were cancelled already, we end up reading
+     entries we know about, hence those get removed too.  */
+  if ((ret = index_append (as, a, index, first, nregister, arg)) < 0)
+    return ret;
+
+  addrs = malloc ((ncancel + index->size - size) * sizeof (*addrs));
+  if (!addrs)
+    return -UNW_ENOMEM;
+
+  for (i = 0; i < ncancel; ++i)
+    {
+      addr = cancel_log + ((index->cancel_count + i) % UNW_DYN_CANCEL_LOG_SIZE)
+                          * WSIZE;
+      if ((ret = fetchw (as, a, &addr, addrs + n++, arg)) < 0)
+        {
+          free (addrs);
+          return ret;
+        }
+    }
+  for (i = size; i < index->size; ++i)
+    addrs[n++] = index->entries[i].addr;
+
+  qsort (addrs, n, sizeof (*addrs), word_compare);
+  size = index_remove (index, addrs, n, size);
+  free (addrs);
+
+  qsort (index->entries + size, index->size - size, sizeof (*index->entries),
+         entry_compare);
+  index_merge (index, size);
+  index_finish (index);
+  return 0;
+}
+/* Bring the index of the list at LIST_ADDR up to date.  The generation
+   number tells whether anything changed since the last call and, with
+   the cancellation log of version 1 lists, what changed.  */
+
+static int
+dyn_remote_sync (unw_addr_space_t as, unw_accessors_t *a,
+                 unw_word_t list_addr, void *arg)
+{
+  struct unw_dyn_remote_index *index = as->dyn_index;
+  unw_word_t addr, first, cancel_count, ncancel, nchange;
+  int32_t version, gen1, gen2;
+  int ret, incremental;
+
+  if (!index)
+    {
+      index = calloc (1, sizeof (*index));
+      if (!index)
+        return -UNW_ENOMEM;
+      as->dyn_index = index;
+    }
+
+  do
+    {
+      addr = list_addr;
+      if ((ret = fetch32 (as, a, &addr, &version, arg)) < 0
+          || (ret = fetch32 (as, a, &addr, &gen1, arg)) < 0)
+        return ret;
+
+      if (index->list_addr == list_addr
+          && index->generation == (uint32_t) gen1)
+        return 0;       /* up to date */
+
+      cancel_count = 0;
+      if ((ret = fetchw (as, a, &addr, &first, arg)) < 0
+          || (version >= 1
+              && (ret = fetchw (as, a, &addr, &cancel_count, arg)) < 0))
+        return ret;
+
+      nchange = (uint32_t) gen1 - index->generation;
+      ncancel = cancel_count - index->cancel_count;
+      incremental = (index->list_addr == list_addr
+                     && version >= 1 && index->version >= 1
+                     && ncancel <= UNW_DYN_CANCEL_LOG_SIZE
+                     && ncancel <= nchange);
+
+      Debug (3, "generation %u -> %u, %s update\n", index->generation,
+             (uint32_t) gen1, incremental ? "incremental" : "full");
+
+      /* Until this update is known to be consistent, the next one must
+         start over.  */
+      index->list_addr = 0;
+
+      if (incremental)
+        ret = index_update (as, a, index, first, addr, ncancel,
+                            nchange - ncancel, arg);
+      else
+        ret = index_reload (as, a, index, first, arg);
+      if (ret < 0)
+        return ret;
+
+      addr = list_addr + 4;
+      if ((ret = fetch32 (as, a, &addr, &gen2, arg)) < 0)
+        return ret;
+    }
+  while (gen1 != gen2);
+
+  index->list_addr = list_addr;
+  index->version = version;
+  index->generation = gen1;
+  index->cancel_count = cancel_count;
+  return 0;
+}
+
+/* Find the entry covering IP which was registered last.  */
+
+static struct unw_dyn_remote_entry *
+index_lookup (struct unw_dyn_remote_index *index, unw_word_t ip)
+{
+  struct unw_dyn_remote_entry *e = index->entries, *best = NULL;
+  size_t lo = 0, hi = index->size, mid;
+
+  /* Find the first entry starting after IP...  */
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (e[mid].start_ip <= ip)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  /* ...then look at the ones before it which may still cover IP.  */
+  while (lo > 0 && e[lo - 1].max_end > ip)
+    {
+      --lo;
+      if (ip < e[lo].end_ip && (!best || e[lo].seq > best->seq))
+        best = e + lo;
+    }
+  return best;
+}
+
+static void
+dyn_remote_free_index (unw_addr_space_t as)
+{
+  if (!as->dyn_index)
+    return;
+
+  free (as->dyn_index->entries);
+  free (as->dyn_index);
+  as->dyn_index = NULL;
+}
+
 HIDDEN int
 unwi_dyn_remote_find_proc_info (unw_addr_space_t as, unw_word_t ip,
                                 unw_proc_info_t *pi,
                                 int need_unwind_info, void *arg)
 {
   unw_accessors_t *a = unw_get_accessors (as);
-  unw_word_t dyn_list_addr, addr, next_addr, gen1, gen2, start_ip, end_ip;
+  unw_word_t dyn_list_addr, addr;
+  struct unw_dyn_remote_entry *e;
   unw_dyn_info_t *di = NULL;
+  int32_t gen1, gen2;
   int ret;
 
   if (as->dyn_info_list_addr)
@@ -222,63 +557,57 @@ unwi_dyn_remote_find_proc_info (unw_addr_space_t as, unw_word_t ip,
 
   do
     {
-      addr = dyn_list_addr;
-
       ret = -UNW_ENOINFO;
 
-      if (fetchw (as, a, &addr, &gen1, arg) < 0
-          || fetchw (as, a, &addr, &next_addr, arg) < 0)
-        return ret;
+      if (dyn_remote_sync (as, a, dyn_list_addr, arg) < 0)
+        break;
+      gen1 = as->dyn_index->generation;
 
-      for (addr = next_addr; addr != 0; addr = next_addr)
+      e = index_lookup (as->dyn_index, ip);
+      if (e)
         {
-          if (fetchw (as, a, &addr, &next_addr, arg) < 0)
-            goto recheck;       /* only fail if generation # didn't change */
-
-          addr += WSIZE;        /* skip over prev_addr */
-
-          if (fetchw (as, a, &addr, &start_ip, arg) < 0
-              || fetchw (as, a, &addr, &end_ip, arg) < 0)
-            goto recheck;       /* only fail if generation # didn't change */
-
-          if (ip >= start_ip && ip < end_ip)
+          if (!di && !(di = calloc (1, sizeof (*di))))
             {
-              if (!di)
-                di = calloc (1, sizeof (*di));
+              ret = -UNW_ENOMEM;
+              break;
+            }
 
-              di->start_ip = start_ip;
-              di->end_ip = end_ip;
+          di->start_ip = e->start_ip;
+          di->end_ip = e->end_ip;
 
-              if (fetchw (as, a, &addr, &di->gp, arg) < 0
-                  || fetch32 (as, a, &addr, &di->format, arg) < 0)
-                goto recheck;   /* only fail if generation # didn't change */
+          addr = e->addr + 4 * WSIZE;   /* skip over next, prev, start & end */
 
-              addr += 4;        /* skip over padding */
+          if (fetchw (as, a, &addr, &di->gp, arg) < 0
+              || fetch32 (as, a, &addr, &di->format, arg) < 0)
+            goto recheck;       /* only fail if generation # didn't change */
 
-              if (need_unwind_info
-                  && intern_dyn_info (as, a, &addr, di, arg) < 0)
-                goto recheck;   /* only fail if generation # didn't change */
+          addr += 4;    /* skip over padding */
 
-              if (unwi_extract_dynamic_proc_info (as, ip, pi, di,
-                                                  need_unwind_info, arg) < 0)
-                {
-                  free_dyn_info (di);
-                  goto recheck; /* only fail if generation # didn't change */
-                }
-              ret = 0;  /* OK, found it */
-              break;
+          if (need_unwind_info
+              && intern_dyn_info (as, a, &addr, di, arg) < 0)
+            goto recheck;       /* only fail if generation # didn't change */
+
+          if (unwi_extract_dynamic_proc_info (as, ip, pi, di,
+                                              need_unwind_info, arg) < 0)
+            {
+              free_dyn_info (di);
+              goto recheck;     /* only fail if generation # didn't change */
             }
+          ret = 0;      /* OK, found it */
         }
 
       /* Re-check generation number to ensure the data we have is
          consistent.  */
     recheck:
-      addr = dyn_list_addr;
-      if (fetchw (as, a, &addr, &gen2, arg) < 0)
-        return ret;
+      addr = dyn_list_addr + 4;
+      if (fetch32 (as, a, &addr, &gen2, arg) < 0)
+        break;
     }
   while (gen1 != gen2);
 
+  if (as->caching_policy == UNW_CACHE_NONE)
+    dyn_remote_free_index (as);
+
   if (ret < 0 && di)
     free (di);
 
@@ -303,6 +632,7 @@ unwi_dyn_remote_put_unwind_info (unw_addr_space_t as, unw_proc_info_t *pi,
 HIDDEN int
 unwi_dyn_validate_cache (unw_addr_space_t as, void *arg)
 {
+  struct unw_dyn_remote_index *index;
   unw_word_t addr, gen;
   unw_accessors_t *a;
 
@@ -320,7 +650,11 @@ unwi_dyn_validate_cache (unw_addr_space_t as, void *arg)
   if (gen == as->dyn_generation)
     return 1;
 
+  /* The index of the list is brought up to date on its own.  */
+  index = as->dyn_index;
+  as->dyn_index = NULL;
   unw_flush_cache (as, 0, 0);
+  as->dyn_index = index;
   as->dyn_generation = gen;
   return -1;
 }
@@ -40,22 +40,20 @@ static inline int
 local_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
                       int need_unwind_info, void *arg)
 {
-  unw_dyn_info_list_t *list;
   unw_dyn_info_t *di;
 
 #ifndef UNW_LOCAL_ONLY
-# pragma weak _U_dyn_info_list_addr
-  if (!_U_dyn_info_list_addr)
+# pragma weak _U_dyn_info_list_lookup
+  if (!_U_dyn_info_list_lookup)
     return -UNW_ENOINFO;
 #endif
 
-  // Access the `_U_dyn_info_list` from `LOCAL_ONLY` library, i.e. libunwind.so.
-  list = (unw_dyn_info_list_t *) (uintptr_t) _U_dyn_info_list_addr ();
-  for (di = list->first; di; di = di->next)
-    if (ip >= di->start_ip && ip < di->end_ip)
-      return unwi_extract_dynamic_proc_info (as, ip, pi, di, need_unwind_info,
-                                             arg);
-  return -UNW_ENOINFO;
+  // Search the `_U_dyn_info_list` of the `LOCAL_ONLY` library, i.e. libunwind.so.
+  di = _U_dyn_info_list_lookup (ip);
+  if (!di)
+    return -UNW_ENOINFO;
+  return unwi_extract_dynamic_proc_info (as, ip, pi, di, need_unwind_info,
+                                         arg);
 }
 
 #endif /* !UNW_REMOTE_ONLY */
@@ -39,6 +39,12 @@ _U_dyn_cancel (unw_dyn_info_t *di)
 
     if (di->next)
       di->next->prev = di->prev;
+
+    _U_dyn_info_list.cancelled[_U_dyn_info_list.cancel_count
+                               % UNW_DYN_CANCEL_LOG_SIZE] = di;
+    ++_U_dyn_info_list.cancel_count;
+
+    unwi_dyn_index_remove (di);
   }
   mutex_unlock (&_U_dyn_info_list_lock);
 
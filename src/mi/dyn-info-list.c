@@ -24,11 +24,338 @@ OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
+#include "mempool.h"
 
-HIDDEN unw_dyn_info_list_t _U_dyn_info_list;
+#pragma weak pthread_rwlock_tryrdlock
+#pragma weak pthread_rwlock_wrlock
+#pragma weak pthread_rwlock_unlock
+
+HIDDEN unw_dyn_info_list_t _U_dyn_info_list =
+  {
+    .version = UNW_DYN_INFO_LIST_VERSION
+  };
+
+/* An AVL tree of the registered entries, ordered by start address and
+   augmented with the largest end address in each subtree, so that
+   _U_dyn_info_list_lookup() does not have to walk the whole list when
+   tens of thousands of entries are registered.  The tree is only
+   modified with _U_dyn_info_list_lock held, which serialises the
+   registrations, and dyn_index_lock write-locked, which lets lookups
+   from any number of threads share the tree.  While it is out of sync
+   with the list (i.e., before the first registration and after running
+   out of memory), lookups fall back to walking the list.  */
+
+struct dyn_node
+  {
+    struct dyn_node *left;
+    struct dyn_node *right;
+    unw_dyn_info_t *di;
+    unw_word_t start_ip;
+    unw_word_t end_ip;
+    unw_word_t max_end;         /* largest end_ip in this subtree */
+    unw_word_t seq;             /* the latest registration wins */
+    int height;
+  };
+
+static struct mempool dyn_node_pool;
+static int dyn_node_pool_ready;
+static struct dyn_node *dyn_root;
+static unw_word_t dyn_seq;
+static int dyn_index_valid;
+static volatile int dyn_index_busy;
+static pthread_rwlock_t dyn_index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static inline void
+dyn_index_write_lock (void)
+{
+  if (pthread_rwlock_wrlock != NULL)
+    pthread_rwlock_wrlock (&dyn_index_lock);
+  dyn_index_busy = 1;
+}
+
+static inline void
+dyn_index_write_unlock (void)
+{
+  dyn_index_busy = 0;
+  if (pthread_rwlock_unlock != NULL)
+    pthread_rwlock_unlock (&dyn_index_lock);
+}
+
+static inline int
+node_height (struct dyn_node *n)
+{
+  return n ? n->height : 0;
+}
+
+static void
+node_update (struct dyn_node *n)
+{
+  int hl = node_height (n->left), hr = node_height (n->right);
+
+  n->height = (hl > hr ? hl : hr) + 1;
+  n->max_end = n->end_ip;
+  if (n->left && n->left->max_end > n->max_end)
+    n->max_end = n->left->max_end;
+  if (n->right && n->right->max_end > n->max_end)
+    n->max_end = n->right->max_end;
+}
+
+static struct dyn_node *
+rotate_right (struct dyn_node *n)
+{
+  struct dyn_node *l = n->left;
+
+  n->left = l->right;
+  l->right = n;
+  node_update (n);
+  node_update (l);
+  return l;
+}
+
+static struct dyn_node *
+rotate_left (struct dyn_node *n)
+{
+  struct dyn_node *r = n->right;
+
+  n->right = r->left;
+  r->left = n;
+  node_update (n);
+  node_update (r);
+  return r;
+}
+
+static struct dyn_node *
+rebalance (struct dyn_node *n)
+{
+  int balance;
+
+  node_update (n);
+  balance = node_height (n->left) - node_height (n->right);
+  if (balance > 1)
+    {
+      if (node_height (n->left->left) < node_height (n->left->right))
+        n->left = rotate_left (n->left);
+      return rotate_right (n);
+    }
+  if (balance < -1)
+    {
+      if (node_height (n->right->right) < node_height (n->right->left))
+        n->right = rotate_right (n->right);
+      return rotate_left (n);
+    }
+  return n;
+}
+
+/* Nodes are ordered by start address, then by the address of their
+   unw_dyn_info_t, which makes every key unique.  */
+
+static inline int
+node_compare (struct dyn_node *n, unw_word_t start_ip, unw_dyn_info_t *di)
+{
+  if (start_ip != n->start_ip)
+    return start_ip < n->start_ip ? -1 : 1;
+  if (di != n->di)
+    return (uintptr_t) di < (uintptr_t) n->di ? -1 : 1;
+  return 0;
+}
+
+static struct dyn_node *
+tree_insert (struct dyn_node *n, struct dyn_node *node)
+{
+  if (!n)
+    return node;
+
+  if (node_compare (n, node->start_ip, node->di) < 0)
+    n->left = tree_insert (n->left, node);
+  else
+    n->right = tree_insert (n->right, node);
+  return rebalance (n);
+}
+
+static struct dyn_node *
+tree_remove_min (struct dyn_node *n, struct dyn_node **min)
+{
+  if (!n->left)
+    {
+      *min = n;
+      return n->right;
+    }
+  n->left = tree_remove_min (n->left, min);
+  return rebalance (n);
+}
+
+static struct dyn_node *
+tree_remove (struct dyn_node *n, unw_word_t start_ip, unw_dyn_info_t *di,
+             struct dyn_node **found)
+{
+  struct dyn_node *min;
+  int cmp;
+
+  if (!n)
+    return NULL;
+
+  cmp = node_compare (n, start_ip, di);
+  if (cmp < 0)
+    n->left = tree_remove (n->left, start_ip, di, found);
+  else if (cmp > 0)
+    n->right = tree_remove (n->right, start_ip, di, found);
+  else
+    {
+      *found = n;
+      if (!n->right)
+        return n->left;
+      n->right = tree_remove_min (n->right, &min);
+      min->left = n->left;
+      min->right = n->right;
+      n = min;
+    }
+  return rebalance (n);
+}
+
+static void
+tree_free (struct dyn_node *n)
+{
+  if (!n)
+    return;
+  tree_free (n->left);
+  tree_free (n->right);
+  mempool_free (&dyn_node_pool, n);
+}
+
+/* Find the node covering IP which was registered last.  Subtrees which
+   end at or before IP are skipped, so for non-overlapping entries this
+   follows a single path down the tree.  */
+
+static void
+tree_lookup (struct dyn_node *n, unw_word_t ip, struct dyn_node **best)
+{
+  if (!n || n->max_end <= ip)
+    return;
+
+  tree_lookup (n->left, ip, best);
+  if (n->start_ip <= ip)
+    {
+      if (ip < n->end_ip && (!*best || n->seq > (*best)->seq))
+        *best = n;
+      tree_lookup (n->right, ip, best);
+    }
+}
+
+static int
+dyn_index_add (unw_dyn_info_t *di)
+{
+  struct dyn_node *node;
+
+  if (!dyn_node_pool_ready)
+    {
+      mempool_init (&dyn_node_pool, sizeof (struct dyn_node), 0);
+      dyn_node_pool_ready = 1;
+    }
+
+  node = mempool_alloc (&dyn_node_pool);
+  if (!node)
+    return -UNW_ENOMEM;
+
+  node->left = node->right = NULL;
+  node->di = di;
+  node->start_ip = di->start_ip;
+  node->end_ip = di->end_ip;
+  node->seq = ++dyn_seq;
+  node->height = 1;
+  node->max_end = di->end_ip;
+  dyn_root = tree_insert (dyn_root, node);
+  return 0;
+}
+
+/* Build the tree from scratch.  The list is walked backwards so that the
+   entries at its head, which used to take precedence, get the largest
+   sequence numbers.  */
+
+static void
+dyn_index_rebuild (void)
+{
+  unw_dyn_info_t *di, *last = NULL;
+
+  tree_free (dyn_root);
+  dyn_root = NULL;
+
+  for (di = _U_dyn_info_list.first; di; di = di->next)
+    last = di;
+
+  dyn_index_valid = 1;
+  for (di = last; di; di = di->prev)
+    if (dyn_index_add (di) < 0)
+      {
+        Debug (1, "out of memory, falling back to walking the list\n");
+        dyn_index_valid = 0;
+        return;
+      }
+}
+
+HIDDEN void
+unwi_dyn_index_insert (unw_dyn_info_t *di)
+{
+  dyn_index_write_lock ();
+  if (!dyn_index_valid)
+    dyn_index_rebuild ();
+  else if (dyn_index_add (di) < 0)
+    dyn_index_valid = 0;
+  dyn_index_write_unlock ();
+}
+
+HIDDEN void
+unwi_dyn_index_remove (unw_dyn_info_t *di)
+{
+  struct dyn_node *node = NULL;
+
+  if (!dyn_index_valid)
+    return;     /* the next registration rebuilds the tree */
+
+  dyn_index_write_lock ();
+  dyn_root = tree_remove (dyn_root, di->start_ip, di, &node);
+  if (node)
+    mempool_free (&dyn_node_pool, node);
+  else
+    /* DI's start address changed while it was registered.  */
+    dyn_index_rebuild ();
+  dyn_index_write_unlock ();
+}
 
 PROTECTED unw_word_t
 _U_dyn_info_list_addr (void)
 {
   return (unw_word_t) (uintptr_t) &_U_dyn_info_list;
 }
+
+/* Return the registered entry covering IP, if any.  Lookups only share
+   the tree, so they do not wait for each other.  This may be called
+   from a signal handler which interrupted _U_dyn_register() or
+   _U_dyn_cancel(), hence a write lock is never waited for: the list is
+   walked instead.  */
+
+PROTECTED unw_dyn_info_t *
+_U_dyn_info_list_lookup (unw_word_t ip)
+{
+  struct dyn_node *best = NULL;
+  unw_dyn_info_t *di;
+
+  if (pthread_rwlock_tryrdlock == NULL
+      || pthread_rwlock_tryrdlock (&dyn_index_lock) == 0)
+    {
+      if (dyn_index_valid && !dyn_index_busy)
+        {
+          tree_lookup (dyn_root, ip, &best);
+          di = best ? best->di : NULL;
+          if (pthread_rwlock_unlock != NULL)
+            pthread_rwlock_unlock (&dyn_index_lock);
+          return di;
+        }
+      if (pthread_rwlock_unlock != NULL)
+        pthread_rwlock_unlock (&dyn_index_lock);
+    }
+
+  for (di = _U_dyn_info_list.first; di; di = di->next)
+    if (ip >= di->start_ip && ip < di->end_ip)
+      return di;
+  return NULL;
+}
@@ -39,6 +39,8 @@ _U_dyn_register (unw_dyn_info_t *di)
     if (di->next)
             di->next->prev = di;
     _U_dyn_info_list.first = di;
+
+    unwi_dyn_index_insert (di);
   }
   mutex_unlock (&_U_dyn_info_list_lock);
 }
@@ -25,24 +25,69 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
 
+#if !UNW_TARGET_IA64
+/* Free a search-table record of Gfind_proc_info-lsb.c once no lookup
+   can be using it.  */
+static void
+release_table (struct unw_retired *obj)
+{
+  struct unw_remote_table *t = (struct unw_remote_table *) obj;
+
+  if (t->map_size)
+    {
+      munmap (t, t->map_size);
+      return;
+    }
+  free (t->table);
+  free (t->index);
+  free (t);
+}
+#endif
+
 PROTECTED void
 unw_flush_cache (unw_addr_space_t as, unw_word_t lo, unw_word_t hi)
 {
 #if !UNW_TARGET_IA64
-  struct unw_debug_frame_list *w = as->debug_frames;
+  struct unw_debug_frame_list *w = as->debug_frames, *next;
+  struct unw_debug_frame_index *index, *prev;
+  struct unw_remote_table *t, *next_t;
 #endif
 
   /* clear dyn_info_list_addr cache: */
   as->dyn_info_list_addr = 0;
 
+  if (as->dyn_index)
+    {
+      free (as->dyn_index->entries);
+      free (as->dyn_index);
+      as->dyn_index = NULL;
+    }
+
 #if !UNW_TARGET_IA64
-  for (; w; w = w->next)
+  for (; w; w = next)
     {
-      if (w->index)
-        free (w->index);
-      free (w->debug_frame);
+      next = w->next;
+      for (index = w->index; index; index = prev)
+        {
+          prev = index->prev;
+          free (index);
+        }
+      if (w->debug_frame_map)
+        munmap (w->debug_frame_map, w->debug_frame_map_size);
+      free (w->index_file);
+      free (w);
     }
   as->debug_frames = NULL;
+
+  t = __sync_lock_test_and_set (&as->remote_tables, NULL);
+  for (; t; t = next_t)
+    {
+      next_t = t->next;
+      retire_object (&as->table_retire, &t->retired, release_table);
+    }
+
+  /* The CIE and expression caches go with the generation number,
+     below.  */
 #endif
 
   /* This lets us flush caches lazily.  The implementation currently
@@ -26,6 +26,12 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
 
+#pragma weak pthread_once
+#pragma weak pthread_key_create
+#pragma weak pthread_key_delete
+#pragma weak pthread_getspecific
+#pragma weak pthread_setspecific
+
 /* From GCC docs: ``Gcc also provides a target specific macro
  * __BIGGEST_ALIGNMENT__, which is the largest alignment ever used for any data
  * type on the target machine you are compiling for.'' */
@@ -80,6 +86,55 @@ sos_alloc (size_t size)
   return &sos_memory[pos];
 }
 
+/* Per-thread magazines.  A magazine caches up to MAGAZINE_SIZE free
+   objects of one pool for one thread; it is refilled from and drained
+   to the shared free-list MAGAZINE_BATCH objects at a time, so that
+   most allocations take neither the pool lock nor a signal-mask system
+   call.  A thread only touches its own magazines, so the only hazard is
+   a signal handler allocating in the middle of an update: the handler
+   sees BUSY set and goes to the shared free-list instead.
+
+   The magazines of a thread are allocated on its first use of a pool,
+   rather than as TLS, which every thread would pay for.  When the
+   thread exits, they go back to their pools.
+
+   That first use may be in a signal handler, where pthread_setspecific
+   is only safe as long as it does not allocate.  The key is therefore
+   created when the library is loaded, so that it is among the first
+   ones, whose values glibc keeps in the thread descriptor itself.  The
+   magazines are set up with signals blocked, so that a handler never
+   sees them half-registered.  */
+
+#define MAGAZINE_SIZE   32
+#define MAGAZINE_BATCH  (MAGAZINE_SIZE / 2)
+#define MAX_MAGAZINES   16
+
+/* Keep the compiler from moving magazine updates across BUSY changes.  */
+#define compiler_barrier()      asm volatile ("" ::: "memory")
+
+struct magazines
+  {
+    volatile sig_atomic_t busy;
+    struct
+      {
+        struct object *head;
+        unsigned int count;
+      }
+    mag[MAX_MAGAZINES];
+  };
+
+static struct mempool *magazine_pool[MAX_MAGAZINES];
+static unsigned int num_magazines;
+static define_lock (magazine_lock);
+static pthread_once_t magazine_once = PTHREAD_ONCE_INIT;
+static pthread_key_t magazine_key;
+static int magazine_key_ok;
+static struct mempool magazines_pool;
+
+/* Stands for the magazines of an exited thread: always busy, so that
+   what its remaining destructors free goes to the shared free-lists.  */
+static struct magazines exited_magazines = { 1 };
+
 /* Must be called while holding the mempool lock. */
 
 static void
@@ -123,8 +178,52 @@ expand (struct mempool *pool)
   add_memory (pool, mem, size, pool->obj_size);
 }
 
-HIDDEN void
-mempool_init (struct mempool *pool, size_t obj_size, size_t reserve)
+/* Must be called while holding the mempool lock. */
+
+static struct object *
+take_object (struct mempool *pool)
+{
+  struct object *obj;
+
+  if (pool->num_free <= pool->reserve)
+    expand (pool);
+
+  assert (pool->num_free > 0);
+
+  --pool->num_free;
+  obj = pool->free_list;
+  pool->free_list = obj->next;
+  return obj;
+}
+
+static void *
+pool_alloc (struct mempool *pool)
+{
+  intrmask_t saved_mask;
+  struct object *obj;
+
+  lock_acquire (&pool->lock, saved_mask);
+  {
+    obj = take_object (pool);
+  }
+  lock_release (&pool->lock, saved_mask);
+  return obj;
+}
+
+static void
+pool_free (struct mempool *pool, void *object)
+{
+  intrmask_t saved_mask;
+
+  lock_acquire (&pool->lock, saved_mask);
+  {
+    free_object (pool, object);
+  }
+  lock_release (&pool->lock, saved_mask);
+}
+
+static void
+pool_init (struct mempool *pool, size_t obj_size, size_t reserve)
 {
   if (pg_size == 0)
     pg_size = getpagesize ();
@@ -146,39 +245,218 @@ mempool_init (struct mempool *pool, size_t obj_size, size_t reserve)
   pool->obj_size = obj_size;
   pool->reserve = reserve;
   pool->chunk_size = UNW_ALIGN(2*reserve*obj_size, pg_size);
+  pool->magazine = -1;
 
   expand (pool);
 }
 
-HIDDEN void *
-mempool_alloc (struct mempool *pool)
+/* Give the magazines of an exiting thread back.  */
+static void
+magazine_destroy (void *arg)
+{
+  struct magazines *m = arg;
+  struct object *obj;
+  intrmask_t saved_mask;
+  unsigned int i;
+
+  if (m != &exited_magazines)
+    {
+      for (i = 0; i < num_magazines; ++i)
+        {
+          if (!m->mag[i].head)
+            continue;
+          lock_acquire (&magazine_pool[i]->lock, saved_mask);
+          while ((obj = m->mag[i].head))
+            {
+              m->mag[i].head = obj->next;
+              free_object (magazine_pool[i], obj);
+            }
+          lock_release (&magazine_pool[i]->lock, saved_mask);
+        }
+      pool_free (&magazines_pool, m);
+    }
+  pthread_setspecific (magazine_key, &exited_magazines);
+}
+
+static void __attribute__((constructor))
+magazine_key_init (void)
+{
+  if (pthread_key_create != NULL)
+    magazine_key_ok = pthread_key_create (&magazine_key, magazine_destroy) == 0;
+}
+
+/* Do not leave the destructor of a dlclose'd library to exiting
+   threads.  Their magazines are unmapped with it anyway.  */
+static void __attribute__((destructor))
+magazine_key_fini (void)
+{
+  if (magazine_key_ok && pthread_key_delete != NULL)
+    {
+      magazine_key_ok = 0;
+      pthread_key_delete (magazine_key);
+    }
+}
+
+static void
+magazine_init_once (void)
+{
+  pool_init (&magazines_pool, sizeof (struct magazines), 0);
+}
+
+/* Give POOL a slot in the magazines.  Without a way to drain them when
+   threads exit, or once all slots are taken, the pool does without.  */
+static void
+magazine_attach (struct mempool *pool)
+{
+  intrmask_t saved_mask;
+
+  if (pthread_once == NULL || !magazine_key_ok)
+    return;
+  pthread_once (&magazine_once, magazine_init_once);
+
+  lock_acquire (&magazine_lock, saved_mask);
+  if (num_magazines < MAX_MAGAZINES)
+    {
+      magazine_pool[num_magazines] = pool;
+      pool->magazine = num_magazines++;
+    }
+  lock_release (&magazine_lock, saved_mask);
+}
+
+/* Claim the magazines of the calling thread, or return NULL if they are
+   being updated by the code this signal handler interrupted, or if the
+   thread or the process is exiting.  */
+static struct magazines *
+magazine_get (void)
+{
+  struct magazines *m;
+  intrmask_t saved_mask;
+
+  if (unlikely (!magazine_key_ok))
+    return NULL;
+  if (unlikely (!(m = pthread_getspecific (magazine_key))))
+    {
+      lock_acquire (&magazine_lock, saved_mask);
+      /* A signal handler may have beaten us to it.  */
+      if (!(m = pthread_getspecific (magazine_key)))
+        {
+          m = pool_alloc (&magazines_pool);
+          memset (m, 0, sizeof (*m));
+          if (pthread_setspecific (magazine_key, m) != 0)
+            {
+              pool_free (&magazines_pool, m);
+              m = NULL;
+            }
+        }
+      lock_release (&magazine_lock, saved_mask);
+      if (!m)
+        return NULL;
+    }
+
+  if (m->busy)
+    return NULL;
+  m->busy = 1;
+  compiler_barrier ();
+  return m;
+}
+
+static inline void
+magazine_put (struct magazines *m)
+{
+  compiler_barrier ();
+  m->busy = 0;
+}
+
+static void
+magazine_refill (struct mempool *pool, struct magazines *m, int slot)
 {
   intrmask_t saved_mask;
   struct object *obj;
+  unsigned int n;
 
   lock_acquire (&pool->lock, saved_mask);
   {
-    if (pool->num_free <= pool->reserve)
-      expand (pool);
-
-    assert (pool->num_free > 0);
-
-    --pool->num_free;
-    obj = pool->free_list;
-    pool->free_list = obj->next;
+    /* Only grow the pool for the first object: the others must not eat
+       into the reserve.  */
+    obj = take_object (pool);
+    obj->next = m->mag[slot].head;
+    m->mag[slot].head = obj;
+    for (n = 1; n < MAGAZINE_BATCH && pool->num_free > pool->reserve; ++n)
+      {
+        --pool->num_free;
+        obj = pool->free_list;
+        pool->free_list = obj->next;
+        obj->next = m->mag[slot].head;
+        m->mag[slot].head = obj;
+      }
   }
   lock_release (&pool->lock, saved_mask);
-  return obj;
+  m->mag[slot].count += n;
 }
 
-HIDDEN void
-mempool_free (struct mempool *pool, void *object)
+static void
+magazine_drain (struct mempool *pool, struct magazines *m, int slot)
 {
   intrmask_t saved_mask;
+  struct object *obj;
+  unsigned int n;
 
   lock_acquire (&pool->lock, saved_mask);
   {
-    free_object (pool, object);
+    for (n = 0; n < MAGAZINE_BATCH; ++n)
+      {
+        obj = m->mag[slot].head;
+        m->mag[slot].head = obj->next;
+        free_object (pool, obj);
+      }
   }
   lock_release (&pool->lock, saved_mask);
+  m->mag[slot].count -= n;
+}
+
+HIDDEN void
+mempool_init (struct mempool *pool, size_t obj_size, size_t reserve)
+{
+  pool_init (pool, obj_size, reserve);
+  magazine_attach (pool);
+}
+
+HIDDEN void *
+mempool_alloc (struct mempool *pool)
+{
+  struct magazines *m;
+  struct object *obj;
+  int slot = pool->magazine;
+
+  if (slot < 0 || !(m = magazine_get ()))
+    return pool_alloc (pool);
+
+  if (!m->mag[slot].head)
+    magazine_refill (pool, m, slot);
+  obj = m->mag[slot].head;
+  m->mag[slot].head = obj->next;
+  --m->mag[slot].count;
+  magazine_put (m);
+  return obj;
+}
+
+HIDDEN void
+mempool_free (struct mempool *pool, void *object)
+{
+  struct magazines *m;
+  struct object *obj = object;
+  int slot = pool->magazine;
+
+  if (slot < 0 || !(m = magazine_get ()))
+    {
+      pool_free (pool, object);
+      return;
+    }
+
+  if (m->mag[slot].count >= MAGAZINE_SIZE)
+    magazine_drain (pool, m, slot);
+  obj->next = m->mag[slot].head;
+  m->mag[slot].head = obj;
+  ++m->mag[slot].count;
+  magazine_put (m);
 }
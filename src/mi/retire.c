@@ -0,0 +1,75 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "libunwind_i.h"
+#include "retire.h"
+
+/* The retired objects are a lock-free stack: pushed by retire_object(),
+   taken all at once by retire_release(), which pushes back those that
+   are too recent to release.  */
+
+static void
+push (struct unw_retire_list *list, struct unw_retired *obj)
+{
+  struct unw_retired *head;
+
+  do
+    {
+      head = list->retired;
+      obj->next = head;
+    }
+  while (!cmpxchg_ptr ((void *) &list->retired, head, obj));
+}
+
+HIDDEN void
+retire_object (struct unw_retire_list *list, struct unw_retired *obj,
+               void (*release) (struct unw_retired *))
+{
+  uint64_t state;
+
+  obj->release = release;
+  state = __sync_add_and_fetch (&list->state, (uint64_t) 1 << 32);
+  obj->seq = state >> 32;
+  push (list, obj);
+
+  /* The readers may have all left before OBJ was on the list, with
+     nobody to release it.  */
+  state = __sync_fetch_and_add (&list->state, 0);
+  if ((uint32_t) state == 0)
+    retire_release (list, state >> 32);
+}
+
+HIDDEN void
+retire_release (struct unw_retire_list *list, uint32_t seq)
+{
+  struct unw_retired *obj, *next;
+
+  obj = __sync_lock_test_and_set (&list->retired, NULL);
+  for (; obj; obj = next)
+    {
+      next = obj->next;
+      /* retired before the reader count was seen at zero? */
+      if ((int32_t) (obj->seq - seq) <= 0)
+        (*obj->release) (obj);
+      else
+        push (list, obj);
+    }
+}
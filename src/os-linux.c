@@ -34,30 +34,15 @@ tdep_get_elf_image (struct elf_image *ei, pid_t pid, unw_word_t ip,
                     unsigned long *segbase, unsigned long *mapoff,
                     char *path, size_t pathlen)
 {
-  struct map_iterator mi;
-  int found = 0, rc;
+  char map_path[PATH_MAX];
   unsigned long hi;
 
-  if (maps_init (&mi, pid) < 0)
+  if (!maps_find (pid, ip, segbase, &hi, mapoff, map_path, sizeof (map_path)))
     return -1;
 
-  while (maps_next (&mi, segbase, &hi, mapoff))
-    if (ip >= *segbase && ip < hi)
-      {
-        found = 1;
-        break;
-      }
-
-  if (!found)
-    {
-      maps_close (&mi);
-      return -1;
-    }
   if (path)
     {
-      strncpy(path, mi.path, pathlen);
+      strncpy(path, map_path, pathlen);
     }
-  rc = elf_map_image (ei, mi.path);
-  maps_close (&mi);
-  return rc;
+  return elf_map_image (ei, map_path);
 }
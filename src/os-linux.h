@@ -27,6 +27,51 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #ifndef os_linux_h
 #define os_linux_h
 
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_IOCTL_H
+# include <sys/ioctl.h>
+#endif
+#ifdef HAVE_LINUX_FS_H
+# include <linux/fs.h>
+#endif
+
+#if defined(HAVE_SYS_IOCTL_H) && !defined(PROCMAP_QUERY)
+/* PROCMAP_QUERY was introduced with Linux 6.11.  Its ABI is stable, so
+   provide it ourselves when building against older kernel headers; the
+   ioctl simply fails with ENOTTY on kernels which do not know it.  */
+enum procmap_query_flags
+  {
+    PROCMAP_QUERY_VMA_READABLE          = 0x01,
+    PROCMAP_QUERY_VMA_WRITABLE          = 0x02,
+    PROCMAP_QUERY_VMA_EXECUTABLE        = 0x04,
+    PROCMAP_QUERY_VMA_SHARED            = 0x08,
+    PROCMAP_QUERY_COVERING_OR_NEXT_VMA  = 0x10,
+    PROCMAP_QUERY_FILE_BACKED_VMA       = 0x20,
+  };
+
+struct procmap_query
+  {
+    uint64_t size;
+    uint64_t query_flags;       /* in */
+    uint64_t query_addr;        /* in */
+    uint64_t vma_start;         /* out */
+    uint64_t vma_end;           /* out */
+    uint64_t vma_flags;         /* out */
+    uint64_t vma_page_size;     /* out */
+    uint64_t vma_offset;        /* out */
+    uint64_t inode;             /* out */
+    uint32_t dev_major;         /* out */
+    uint32_t dev_minor;         /* out */
+    uint32_t vma_name_size;     /* in/out */
+    uint32_t build_id_size;     /* in/out */
+    uint64_t vma_name_addr;     /* in */
+    uint64_t build_id_addr;     /* in */
+  };
+
+# define PROCMAP_QUERY  _IOWR ('f', 17, struct procmap_query)
+#endif
+
 struct map_iterator
   {
     off_t offset;
@@ -62,15 +107,25 @@ ltoa (char *buf, long val)
   return buf + len;
 }
 
-static inline int
-maps_init (struct map_iterator *mi, pid_t pid)
+#define MAPS_PATH_SIZE  sizeof ("/proc/0123456789/maps")
+
+static inline void
+maps_path (char *path, pid_t pid)
 {
-  char path[sizeof ("/proc/0123456789/maps")], *cp;
+  char *cp;
 
   memcpy (path, "/proc/", 6);
   cp = ltoa (path + 6, pid);
-  assert (cp + 6 < path + sizeof (path));
+  assert (cp + 6 < path + MAPS_PATH_SIZE);
   memcpy (cp, "/maps", 6);
+}
+
+static inline int
+maps_init (struct map_iterator *mi, pid_t pid)
+{
+  char path[MAPS_PATH_SIZE], *cp;
+
+  maps_path (path, pid);
 
   mi->fd = open (path, O_RDONLY);
   if (mi->fd >= 0)
@@ -294,4 +349,98 @@ maps_close (struct map_iterator *mi)
     }
 }
 
+/* Open /proc/PID/maps for use with maps_query().  Returns the file
+   descriptor, or -1 on failure.  */
+static inline int
+maps_query_open (pid_t pid)
+{
+  char path[MAPS_PATH_SIZE];
+
+  maps_path (path, pid);
+  return open (path, O_RDONLY | O_CLOEXEC);
+}
+
+/* Ask the kernel for the mapping which contains IP, without reading the
+   whole text of /proc/PID/maps.  FLAGS is a set of PROCMAP_QUERY_*
+   filters the mapping must satisfy.  If PATH is non-NULL, the name of
+   the mapping is stored there (empty for anonymous mappings).
+
+   Returns 1 if a matching mapping was found, 0 if there is none, and -1
+   if the kernel does not support PROCMAP_QUERY, in which case the
+   caller has to fall back to maps_init()/maps_next().  */
+static inline int
+maps_query (int fd, unsigned long ip, unsigned long flags,
+            unsigned long *low, unsigned long *high, unsigned long *offset,
+            unsigned long *inode, char *path, size_t pathlen)
+{
+#ifdef PROCMAP_QUERY
+  struct procmap_query q;
+
+  memset (&q, 0, sizeof (q));
+  q.size = sizeof (q);
+  q.query_flags = flags;
+  q.query_addr = ip;
+  if (path && pathlen > 0)
+    {
+      q.vma_name_addr = (uintptr_t) path;
+      q.vma_name_size = pathlen;
+    }
+
+  if (ioctl (fd, PROCMAP_QUERY, &q) < 0)
+    return (errno == ENOENT) ? 0 : -1;
+
+  if (path && pathlen > 0 && q.vma_name_size == 0)
+    path[0] = '\0';
+  if (low)
+    *low = q.vma_start;
+  if (high)
+    *high = q.vma_end;
+  if (offset)
+    *offset = q.vma_offset;
+  if (inode)
+    *inode = q.inode;
+  return 1;
+#else
+  return -1;
+#endif
+}
+
+/* Find the mapping of process PID which contains IP, through
+   PROCMAP_QUERY when available and by scanning /proc/PID/maps
+   otherwise.  Returns 1 if found, 0 if not.  */
+static inline int
+maps_find (pid_t pid, unsigned long ip, unsigned long *low,
+           unsigned long *high, unsigned long *offset,
+           char *path, size_t pathlen)
+{
+  struct map_iterator mi;
+  int fd, found = 0;
+
+  if ((fd = maps_query_open (pid)) >= 0)
+    {
+      found = maps_query (fd, ip, 0, low, high, offset, NULL, path, pathlen);
+      close (fd);
+      if (found >= 0)
+        return found;
+      found = 0;
+    }
+
+  if (maps_init (&mi, pid) < 0)
+    return 0;
+
+  while (maps_next (&mi, low, high, offset))
+    if (ip >= *low && ip < *high)
+      {
+        if (path && pathlen > 0)
+          {
+            strncpy (path, mi.path, pathlen - 1);
+            path[pathlen - 1] = '\0';
+          }
+        found = 1;
+        break;
+      }
+  maps_close (&mi);
+  return found;
+}
+
 #endif /* os_linux_h */
@@ -33,12 +33,22 @@ _UPT_access_fpreg (unw_addr_space_t as, unw_regnum_t reg, unw_fpreg_t *val,
 {
   unw_word_t *wp = (unw_word_t *) val;
   struct UPT_info *ui = arg;
+#if !UPT_REGS_CACHE
   pid_t pid = ui->pid;
+#endif
   int i;
 
   if ((unsigned) reg >= ARRAY_SIZE (_UPT_reg_offset))
     return -UNW_EBADREG;
 
+#if UPT_REGS_CACHE
+  for (i = 0; i < (int) (sizeof (*val) / sizeof (wp[i])); ++i)
+    if (write ? _UPT_poke_user (ui, _UPT_reg_offset[reg] + i * sizeof(wp[i]),
+                                wp[i]) < 0
+        : _UPT_peek_user (ui, _UPT_reg_offset[reg] + i * sizeof(wp[i]),
+                          &wp[i]) < 0)
+      return -UNW_EBADREG;
+#else
   errno = 0;
   if (write)
     for (i = 0; i < (int) (sizeof (*val) / sizeof (wp[i])); ++i)
@@ -64,6 +74,7 @@ _UPT_access_fpreg (unw_addr_space_t as, unw_regnum_t reg, unw_fpreg_t *val,
         if (errno)
           return -UNW_EBADREG;
       }
+#endif
   return 0;
 }
 #elif HAVE_DECL_PT_GETFPREGS
@@ -24,6 +24,10 @@ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
 OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
+#include <string.h>
+
+#include <sys/uio.h>
+
 #include "_UPT_internal.h"
 
 #if HAVE_DECL_PTRACE_POKEDATA || HAVE_TTRACE
@@ -62,6 +66,55 @@ _UPT_access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
     }
   return 0;
 }
+
+/* Read the whole range with a single process_vm_readv(), or word by word
+   when the kernel does not let us.  */
+int
+_UPT_access_mem_range (unw_addr_space_t as, unw_word_t addr, void *buf,
+                       size_t len, void *arg)
+{
+  struct UPT_info *ui = arg;
+  unw_word_t word, val;
+  size_t off, n;
+  int ret;
+
+  if (!ui)
+        return -UNW_EINVAL;
+
+#ifdef HAVE_PROCESS_VM_READV
+  struct iovec local, remote;
+  ssize_t nread;
+
+  local.iov_base = buf;
+  local.iov_len = len;
+  remote.iov_base = (void *) (uintptr_t) addr;
+  remote.iov_len = len;
+  nread = process_vm_readv (ui->pid, &local, 1, &remote, 1, 0);
+  if (nread == (ssize_t) len)
+    {
+      Debug (16, "mem[%lx..%lx] read\n", (long) addr, (long) (addr + len));
+      return 0;
+    }
+  if (nread >= 0 || (errno != ENOSYS && errno != EPERM))
+    {
+      Debug (16, "mem[%lx..%lx] -> invalid\n", (long) addr,
+             (long) (addr + len));
+      return -UNW_EINVAL;
+    }
+#endif
+
+  for (word = addr & -sizeof (word); word < addr + len; word += sizeof (word))
+    {
+      if ((ret = _UPT_access_mem (as, word, &val, 0, arg)) < 0)
+        return ret;
+      off = word < addr ? addr - word : 0;
+      n = sizeof (val) - off;
+      if (word + off + n > addr + len)
+        n = addr + len - word - off;
+      memcpy ((char *) buf + (word + off - addr), (char *) &val + off, n);
+    }
+  return 0;
+}
 #elif HAVE_DECL_PT_IO
 int
 _UPT_access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
@@ -85,6 +138,25 @@ _UPT_access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
      Debug (16, "mem[%lx] -> %lx\n", (long) addr, (long) *val);
   return 0;
 }
+
+int
+_UPT_access_mem_range (unw_addr_space_t as, unw_word_t addr, void *buf,
+                       size_t len, void *arg)
+{
+  struct UPT_info *ui = arg;
+  if (!ui)
+        return -UNW_EINVAL;
+  pid_t pid = ui->pid;
+  struct ptrace_io_desc iod;
+
+  iod.piod_offs = (void *)addr;
+  iod.piod_addr = buf;
+  iod.piod_len = len;
+  iod.piod_op = PIOD_READ_D;
+  if (ptrace(PT_IO, pid, (caddr_t)&iod, 0) == -1 || iod.piod_len != len)
+    return -UNW_EINVAL;
+  return 0;
+}
 #else
 #error Fix me
 #endif
@@ -40,7 +40,9 @@ _UPT_access_reg (unw_addr_space_t as, unw_regnum_t reg, unw_word_t *val,
                  int write, void *arg)
 {
   struct UPT_info *ui = arg;
+#if !UPT_REGS_CACHE
   pid_t pid = ui->pid;
+#endif
 
 #if UNW_DEBUG
   Debug(16, "using pokeuser: reg: %s [%u], val: %lx, write: %d\n", unw_regname(reg), (unsigned) reg, (long) val, write);
@@ -234,7 +236,14 @@ _UPT_access_reg (unw_addr_space_t as, unw_regnum_t reg, unw_word_t *val,
       goto badreg;
     }
 
-#ifdef HAVE_TTRACE
+#if UPT_REGS_CACHE
+  if (write ? _UPT_poke_user (ui, _UPT_reg_offset[reg], *val) < 0
+      : _UPT_peek_user (ui, _UPT_reg_offset[reg], val) < 0)
+    {
+      Debug (2, "ptrace failure\n");
+      goto badreg;
+    }
+#elif defined(HAVE_TTRACE)
 #       warning No support for ttrace() yet.
 #else
   errno = 0;
@@ -40,5 +40,7 @@ PROTECTED unw_accessors_t _UPT_accessors =
         .init_data              = {
             .get_pid            = _UPT_get_pid
         }
-    }
+    },
+    .access_mem_range           = _UPT_access_mem_range,
+    .begin_unwind               = _UPT_begin_unwind
   };
@@ -14,6 +14,7 @@
 
 #include "_UPT_internal.h"
 
+/// Returns the PID of the child, for eh_elf to read its memory map.
 int _UPT_get_pid(void* arg) {
     struct UPT_info *ui = arg;
     return ui->pid;
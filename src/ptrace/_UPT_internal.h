@@ -48,12 +48,38 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
 
+/* On Linux/x86, the PTRACE_PEEKUSER offsets index a struct user, which
+   starts with the general registers and holds the FP state further on.
+   Both can be read in one go with PTRACE_GETREGSET and kept until the
+   child runs again.  Only x86_64's unw_init_remote() calls
+   _UPT_begin_unwind(), which forgets them when a new unwind starts, so
+   the cache is limited to that target.  */
+#if HAVE_DECL_PTRACE_GETREGSET && defined(__linux__) \
+    && defined(UNW_TARGET_X86_64)
+# define UPT_REGS_CACHE 1
+# include <sys/user.h>
+#endif
+
 struct UPT_info
   {
     pid_t pid;          /* the process-id of the child we're unwinding */
     struct elf_dyn_info edi;
+#if UPT_REGS_CACHE
+    int regs_valid;     /* regs holds the child's general registers */
+    int fpregs_valid;   /* fpregs holds its FP state */
+    struct user_regs_struct regs;
+    struct user_fpregs_struct fpregs;
+#endif
   };
 
 extern const int _UPT_reg_offset[UNW_REG_LAST + 1];
 
+#if UPT_REGS_CACHE
+extern int _UPT_peek_user (struct UPT_info *ui, size_t offset,
+                           unw_word_t *val);
+extern int _UPT_poke_user (struct UPT_info *ui, size_t offset,
+                           unw_word_t val);
+extern void _UPT_flush_regs (struct UPT_info *ui);
+#endif
+
 #endif /* _UPT_internal_h */
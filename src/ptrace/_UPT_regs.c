@@ -0,0 +1,150 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "_UPT_internal.h"
+
+#if UPT_REGS_CACHE
+
+#include <elf.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/* Cache of the child's registers.  The general registers are all read by
+   a single PTRACE_GETREGSET the first time one of them is needed, the FP
+   state only if an FP register is.  Writes go through to the child and
+   update the cached copy.  Everything is forgotten as soon as the child
+   may have run: on _UPT_resume(), and from _UPT_begin_unwind(), which
+   unw_init_remote() calls at the start of every unwind, since the caller
+   may have resumed the child itself in between.  */
+
+#define FPREGS_OFFSET   offsetof (struct user, i387)
+
+/* Read the register set `type' of the child into `buf'.  If the kernel
+   does not return exactly the layout we expect (no PTRACE_GETREGSET, or
+   a 32-bit child of a 64-bit tracer), the caller uses PTRACE_PEEKUSER.  */
+static int
+get_regset (pid_t pid, int type, void *buf, size_t size)
+{
+  struct iovec iov;
+
+  iov.iov_base = buf;
+  iov.iov_len = size;
+  if (ptrace (PTRACE_GETREGSET, pid, (void *) (long) type, &iov) == -1)
+    {
+      Debug (2, "PTRACE_GETREGSET %d failed: %s\n", type, strerror (errno));
+      return -1;
+    }
+  if (iov.iov_len != size)
+    {
+      Debug (2, "PTRACE_GETREGSET %d returned %zu bytes, not %zu\n", type,
+             iov.iov_len, size);
+      return -1;
+    }
+  return 0;
+}
+
+/* Return where the word at PTRACE_PEEKUSER offset `offset' is cached,
+   reading its register set if needed, or NULL if it is not cached.  */
+static unw_word_t *
+cached_word (struct UPT_info *ui, size_t offset)
+{
+  if (offset % sizeof (unw_word_t) != 0)
+    return NULL;
+
+  if (offset + sizeof (unw_word_t) <= sizeof (ui->regs))
+    {
+      if (!ui->regs_valid)
+        {
+          if (get_regset (ui->pid, NT_PRSTATUS, &ui->regs,
+                          sizeof (ui->regs)) < 0)
+            return NULL;
+          ui->regs_valid = 1;
+        }
+      return (unw_word_t *) ((char *) &ui->regs + offset);
+    }
+
+  if (offset >= FPREGS_OFFSET
+      && offset - FPREGS_OFFSET + sizeof (unw_word_t) <= sizeof (ui->fpregs))
+    {
+      if (!ui->fpregs_valid)
+        {
+          if (get_regset (ui->pid, NT_PRFPREG, &ui->fpregs,
+                          sizeof (ui->fpregs)) < 0)
+            return NULL;
+          ui->fpregs_valid = 1;
+        }
+      return (unw_word_t *) ((char *) &ui->fpregs + offset - FPREGS_OFFSET);
+    }
+
+  return NULL;
+}
+
+/* PTRACE_PEEKUSER, served from the cache when possible.  Returns -1 with
+   errno set on failure.  */
+HIDDEN int
+_UPT_peek_user (struct UPT_info *ui, size_t offset, unw_word_t *val)
+{
+  unw_word_t *word = cached_word (ui, offset);
+
+  if (word)
+    {
+      *val = *word;
+      return 0;
+    }
+
+  errno = 0;
+  *val = ptrace (PTRACE_PEEKUSER, ui->pid, offset, 0);
+  return errno ? -1 : 0;
+}
+
+/* PTRACE_POKEUSER, keeping the cache up to date.  */
+HIDDEN int
+_UPT_poke_user (struct UPT_info *ui, size_t offset, unw_word_t val)
+{
+  unw_word_t *word;
+
+  errno = 0;
+  ptrace (PTRACE_POKEUSER, ui->pid, offset, val);
+  if (errno)
+    return -1;
+
+  /* Update the cached copy, without fetching a register set for it.  */
+  if ((offset + sizeof (unw_word_t) <= sizeof (ui->regs) && ui->regs_valid)
+      || (offset >= FPREGS_OFFSET && ui->fpregs_valid))
+    {
+      word = cached_word (ui, offset);
+      if (word)
+        *word = val;
+    }
+  return 0;
+}
+
+HIDDEN void
+_UPT_flush_regs (struct UPT_info *ui)
+{
+  ui->regs_valid = 0;
+  ui->fpregs_valid = 0;
+}
+
+#endif /* UPT_REGS_CACHE */
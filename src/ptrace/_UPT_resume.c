@@ -30,6 +30,9 @@ _UPT_resume (unw_addr_space_t as, unw_cursor_t *c, void *arg)
 {
   struct UPT_info *ui = arg;
 
+#if UPT_REGS_CACHE
+  _UPT_flush_regs (ui);
+#endif
 #ifdef HAVE_TTRACE
 # warning No support for ttrace() yet.
 #elif HAVE_DECL_PTRACE_CONT
@@ -38,3 +41,13 @@ _UPT_resume (unw_addr_space_t as, unw_cursor_t *c, void *arg)
   return ptrace(PT_CONTINUE, ui->pid, (caddr_t)1, 0);
 #endif
 }
+
+void
+_UPT_begin_unwind (unw_addr_space_t as, void *arg)
+{
+#if UPT_REGS_CACHE
+  /* The caller may have resumed the child with its own ptrace() calls
+     since the previous unwind.  */
+  _UPT_flush_regs ((struct UPT_info *) arg);
+#endif
+}
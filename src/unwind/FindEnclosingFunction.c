@@ -28,11 +28,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 PROTECTED void *
 _Unwind_FindEnclosingFunction (void *ip)
 {
-  unw_proc_info_t pi;
+  struct _Unwind_Proc_Info pi;
 
-  if (unw_get_proc_info_by_ip (unw_local_addr_space,
-                               (unw_word_t) (uintptr_t) ip, &pi, 0)
-      < 0)
+  if (_Unwind_GetProcInfo (NULL, (unw_word_t) (uintptr_t) ip, &pi) < 0)
     return NULL;
 
   return (void *) (uintptr_t) pi.start_ip;
@@ -44,7 +44,7 @@ _Unwind_ForcedUnwind (struct _Unwind_Exception *exception_object,
   exception_object->private_1 = (unsigned long) stop;
   exception_object->private_2 = (unsigned long) stop_parameter;
 
-  return _Unwind_Phase2 (exception_object, &context);
+  return _Unwind_Phase2 (exception_object, &context, NULL);
 }
 
 _Unwind_Reason_Code __libunwind_Unwind_ForcedUnwind (struct _Unwind_Exception*,
@@ -28,10 +28,12 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 PROTECTED unsigned long
 _Unwind_GetLanguageSpecificData (struct _Unwind_Context *context)
 {
-  unw_proc_info_t pi;
+  struct _Unwind_Proc_Info pi;
+  unw_word_t ip;
 
-  pi.lsda = 0;
-  unw_get_proc_info (&context->cursor, &pi);
+  if (unw_get_reg (&context->cursor, UNW_REG_IP, &ip) < 0
+      || _Unwind_GetProcInfo (&context->cursor, ip, &pi) < 0)
+    return 0;
   return pi.lsda;
 }
 
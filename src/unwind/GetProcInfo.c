@@ -0,0 +1,148 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+#include <link.h>
+#include <stddef.h>
+
+#include "unwind-internal.h"
+
+/* Direct-mapped cache of the unwind info of the functions seen by the
+   _Unwind_*() routines.  A slot covers a small window of IPs, and holds
+   the function found for the last of them that was looked up.  The
+   cache is emptied when unw_flush_cache() is called and whenever an
+   object is loaded or unloaded, as the dynamic loader counts them: a
+   library loaded where a closed one was must not get its handlers.
+   Without these counts, nothing is cached.  */
+
+#define PI_CACHE_LOG_SIZE       8
+#define PI_CACHE_SIZE           (1 << PI_CACHE_LOG_SIZE)
+
+static struct
+  {
+    unsigned long generation;
+    unsigned long long dl_generation;
+    struct _Unwind_Proc_Info slots[PI_CACHE_SIZE];
+  }
+pi_cache;
+
+static define_lock (pi_cache_lock);
+
+static inline struct _Unwind_Proc_Info *
+pi_cache_slot (unw_word_t ip)
+{
+  unw_word_t key = ip >> 4;
+
+  return &pi_cache.slots[(key ^ (key >> PI_CACHE_LOG_SIZE))
+                         & (PI_CACHE_SIZE - 1)];
+}
+
+/* Depending on the frame, IP is looked up either as is or as IP - 1.
+   Only use the info of functions that contain both.  */
+static inline int
+pi_covers (struct _Unwind_Proc_Info *pi, unw_word_t ip)
+{
+  return pi->start_ip < ip && ip < pi->end_ip;
+}
+
+static int
+pi_dl_generation_cb (struct dl_phdr_info *info, size_t size, void *data)
+{
+  if (size < offsetof (struct dl_phdr_info, dlpi_subs)
+             + sizeof (info->dlpi_subs))
+    return -1;
+  /* both only ever grow */
+  *(unsigned long long *) data = info->dlpi_adds + info->dlpi_subs;
+  return 1;
+}
+
+/* Set *DL_GENERATION to the number of objects loaded and unloaded so
+   far.  Returns 0 if it is not known.  */
+static inline int
+pi_dl_generation (unsigned long long *dl_generation)
+{
+  return dl_iterate_phdr (pi_dl_generation_cb, dl_generation) > 0;
+}
+
+/* Empty the cache if unw_flush_cache() was called, or objects were
+   loaded or unloaded, since it was filled.  */
+static inline void
+pi_cache_validate (unw_addr_space_t as, unsigned long long dl_generation)
+{
+  unsigned long generation = atomic_read (&as->cache_generation);
+
+  if (pi_cache.generation != generation
+      || pi_cache.dl_generation != dl_generation)
+    {
+      memset (pi_cache.slots, 0, sizeof (pi_cache.slots));
+      pi_cache.generation = generation;
+      pi_cache.dl_generation = dl_generation;
+    }
+}
+
+HIDDEN int
+_Unwind_GetProcInfo (unw_cursor_t *cursor, unw_word_t ip,
+                     struct _Unwind_Proc_Info *pi)
+{
+  unw_addr_space_t as = unw_local_addr_space;
+  struct _Unwind_Proc_Info *slot;
+  unsigned long long dl_generation;
+  unw_proc_info_t info;
+  intrmask_t saved_mask;
+  int cache, ret;
+
+  cache = (as->caching_policy != UNW_CACHE_NONE
+           && pi_dl_generation (&dl_generation));
+  if (cache)
+    {
+      lock_acquire (&pi_cache_lock, saved_mask);
+      pi_cache_validate (as, dl_generation);
+      slot = pi_cache_slot (ip);
+      if (pi_covers (slot, ip))
+        {
+          *pi = *slot;
+          lock_release (&pi_cache_lock, saved_mask);
+          return 0;
+        }
+      lock_release (&pi_cache_lock, saved_mask);
+    }
+
+  if (cursor)
+    ret = unw_get_proc_info (cursor, &info);
+  else
+    ret = unw_get_proc_info_by_ip (as, ip, &info, NULL);
+  if (ret < 0)
+    return ret;
+
+  pi->start_ip = info.start_ip;
+  pi->end_ip = info.end_ip;
+  pi->handler = info.handler;
+  pi->lsda = info.lsda;
+
+  if (cache && pi_covers (pi, ip))
+    {
+      lock_acquire (&pi_cache_lock, saved_mask);
+      pi_cache_validate (as, dl_generation);
+      *pi_cache_slot (ip) = *pi;
+      lock_release (&pi_cache_lock, saved_mask);
+    }
+  return 0;
+}
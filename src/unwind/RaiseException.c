@@ -30,9 +30,11 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
 {
   uint64_t exception_class = exception_object->exception_class;
   _Unwind_Personality_Fn personality;
+  struct _Unwind_Search_Record record;
   struct _Unwind_Context context;
+  struct _Unwind_Proc_Info pi;
+  unw_cursor_t first_frame;
   _Unwind_Reason_Code reason;
-  unw_proc_info_t pi;
   unw_context_t uc;
   unw_word_t ip;
   int ret;
@@ -42,6 +44,12 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
   if (_Unwind_InitContext (&context, &uc) < 0)
     return _URC_FATAL_PHASE1_ERROR;
 
+  /* Keep the cursor on the first frame for the cleanup phase, rather
+     than initializing it all over again.  It is copied back to the same
+     place, so the copy is as good as the original.  */
+  first_frame = context.cursor;
+  record.nframes = 0;
+
   /* Phase 1 (search phase) */
 
   while (1)
@@ -57,8 +65,10 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
             return _URC_FATAL_PHASE1_ERROR;
         }
 
-      if (unw_get_proc_info (&context.cursor, &pi) < 0)
+      if (unw_get_reg (&context.cursor, UNW_REG_IP, &ip) < 0
+          || _Unwind_GetProcInfo (&context.cursor, ip, &pi) < 0)
         return _URC_FATAL_PHASE1_ERROR;
+      _Unwind_RecordFrame (&record, &context, ip, &pi);
 
       personality = (_Unwind_Personality_Fn) (uintptr_t) pi.handler;
       if (personality)
@@ -84,18 +94,15 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
      that IP.  If this weren't true, we'd have to track the tuple
      (IP,SP,BSP) to uniquely identify the stack frame that's handling
      the exception.  */
-  if (unw_get_reg (&context.cursor, UNW_REG_IP, &ip) < 0)
-    return _URC_FATAL_PHASE1_ERROR;
   exception_object->private_1 = 0;      /* clear "stop" pointer */
   exception_object->private_2 = ip;     /* save frame marker */
 
   Debug (1, "found handler for IP=%lx; entering cleanup phase\n", (long) ip);
 
   /* Reset the cursor to the first frame: */
-  if (unw_init_local (&context.cursor, &uc) < 0)
-    return _URC_FATAL_PHASE1_ERROR;
+  context.cursor = first_frame;
 
-  return _Unwind_Phase2 (exception_object, &context);
+  return _Unwind_Phase2 (exception_object, &context, &record);
 }
 
 _Unwind_Reason_Code
@@ -34,7 +34,7 @@ _Unwind_Resume (struct _Unwind_Exception *exception_object)
   if (_Unwind_InitContext (&context, &uc) < 0)
     abort ();
 
-  _Unwind_Phase2 (exception_object, &context);
+  _Unwind_Phase2 (exception_object, &context, NULL);
   abort ();
 }
 
@@ -36,7 +36,7 @@ _Unwind_Resume_or_Rethrow (struct _Unwind_Exception *exception_object)
       if (_Unwind_InitContext (&context, &uc) < 0)
         return _URC_FATAL_PHASE2_ERROR;
 
-      return _Unwind_Phase2 (exception_object, &context);
+      return _Unwind_Phase2 (exception_object, &context, NULL);
     }
   else
     return _Unwind_RaiseException (exception_object);
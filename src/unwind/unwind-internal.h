@@ -46,6 +46,34 @@ struct _Unwind_Context {
   int end_of_stack;     /* set to 1 if the end of stack was reached */
 };
 
+/* The unwind info the _Unwind_*() routines use.  */
+struct _Unwind_Proc_Info {
+  unw_word_t start_ip;
+  unw_word_t end_ip;
+  unw_word_t handler;   /* personality routine */
+  unw_word_t lsda;
+};
+
+/* Get the unwind info of IP, through CURSOR if it is not NULL.  The info
+   of the functions seen before comes from a cache shared by all of the
+   _Unwind_*() routines.  Returns a negative value if there is none.  */
+extern int _Unwind_GetProcInfo (unw_cursor_t *cursor, unw_word_t ip,
+                                struct _Unwind_Proc_Info *pi);
+
+/* The search phase records the first frames it walks through, so that
+   the cleanup phase, which walks through the same frames again, does
+   not have to look their unwind info up a second time.  */
+#define _U_RECORDED_FRAMES      16
+
+struct _Unwind_Search_Record {
+  unsigned int nframes;
+  struct {
+    unw_word_t ip;
+    unw_word_t sp;
+    struct _Unwind_Proc_Info pi;
+  } frames[_U_RECORDED_FRAMES];
+};
+
 /* This must be a macro because unw_getcontext() must be invoked from
    the callee, even if optimization (and hence inlining) is turned
    off.  The macro arguments MUST NOT have any side-effects. */
@@ -54,18 +82,61 @@ struct _Unwind_Context {
    ((unw_getcontext (uc) < 0 || unw_init_local (&(context)->cursor, uc) < 0) \
     ? -1 : 0))
 
+/* Record the unwind info PI of the current frame, at IP, if there is
+   room.  */
+static inline void
+_Unwind_RecordFrame (struct _Unwind_Search_Record *record,
+                     struct _Unwind_Context *context, unw_word_t ip,
+                     struct _Unwind_Proc_Info *pi)
+{
+  unsigned int n = record->nframes;
+
+  if (n >= _U_RECORDED_FRAMES
+      || unw_get_reg (&context->cursor, UNW_REG_SP, &record->frames[n].sp) < 0)
+    return;
+  record->frames[n].ip = ip;
+  record->frames[n].pi = *pi;
+  record->nframes = n + 1;
+}
+
+/* Get the unwind info of the current frame, at IP, which is the FRAME-th
+   one since the start of the cleanup phase.  Use what the search phase
+   recorded when it went through the same frame.  */
+static inline int
+_Unwind_GetRecordedProcInfo (struct _Unwind_Search_Record *record,
+                             unsigned int frame,
+                             struct _Unwind_Context *context, unw_word_t ip,
+                             struct _Unwind_Proc_Info *pi)
+{
+  unw_word_t sp;
+
+  if (record && frame < record->nframes
+      && ip == record->frames[frame].ip
+      && unw_get_reg (&context->cursor, UNW_REG_SP, &sp) >= 0
+      && sp == record->frames[frame].sp)
+    {
+      *pi = record->frames[frame].pi;
+      return 0;
+    }
+  return _Unwind_GetProcInfo (&context->cursor, ip, pi);
+}
+
+/* RECORD holds the frames seen by the search phase, or is NULL if there
+   was none.  */
 static _Unwind_Reason_Code ALWAYS_INLINE
 _Unwind_Phase2 (struct _Unwind_Exception *exception_object,
-                struct _Unwind_Context *context)
+                struct _Unwind_Context *context,
+                struct _Unwind_Search_Record *record)
 {
   _Unwind_Stop_Fn stop = (_Unwind_Stop_Fn) exception_object->private_1;
   uint64_t exception_class = exception_object->exception_class;
   void *stop_parameter = (void *) exception_object->private_2;
   _Unwind_Personality_Fn personality;
+  struct _Unwind_Proc_Info pi;
   _Unwind_Reason_Code reason;
   _Unwind_Action actions;
-  unw_proc_info_t pi;
   unw_word_t ip;
+  unsigned int frame = 0;
   int ret;
 
   actions = _UA_CLEANUP_PHASE;
@@ -100,20 +171,16 @@ _Unwind_Phase2 (struct _Unwind_Exception *exception_object,
         }
 
       if (context->end_of_stack
-          || unw_get_proc_info (&context->cursor, &pi) < 0)
+          || unw_get_reg (&context->cursor, UNW_REG_IP, &ip) < 0
+          || _Unwind_GetRecordedProcInfo (record, frame++, context, ip,
+                                          &pi) < 0)
         return _URC_FATAL_PHASE2_ERROR;
 
       personality = (_Unwind_Personality_Fn) (uintptr_t) pi.handler;
       if (personality)
         {
-          if (!stop)
-            {
-              if (unw_get_reg (&context->cursor, UNW_REG_IP, &ip) < 0)
-                return _URC_FATAL_PHASE2_ERROR;
-
-              if ((unsigned long) stop_parameter == ip)
-                actions |= _UA_HANDLER_FRAME;
-            }
+          if (!stop && (unsigned long) stop_parameter == ip)
+            actions |= _UA_HANDLER_FRAME;
 
           reason = (*personality) (_U_VERSION, actions, exception_class,
                                    exception_object, context);
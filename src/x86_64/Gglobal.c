@@ -28,9 +28,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include "config.h"
 #include "unwind_i.h"
 #include "dwarf_i.h"
+#include "../eh_elf/eh_elf.h"
 
 HIDDEN define_lock (x86_64_lock);
 HIDDEN int tdep_init_done;
+HIDDEN int x86_64_shared_trace_cache;
 
 /* See comments for svr4_dbx_register_map[] in gcc/config/i386/i386.c.  */
 
@@ -86,6 +88,20 @@ tdep_init (void)
       /* another thread else beat us to it... */
       goto out;
 
+    /* read eh_elf setting: 0 leaves every frame to DWARF */
+    const char* str = getenv ("UNW_EH_ELF");
+    if (str)
+      {
+        eh_elf_enabled = atoi (str);
+      }
+
+    /* read fast trace setting: 1 shares the frame cache among threads */
+    str = getenv ("UNW_SHARED_TRACE_CACHE");
+    if (str)
+      {
+        x86_64_shared_trace_cache = atoi (str);
+      }
+
     mi_init ();
 
     dwarf_init ();
@@ -35,6 +35,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include <sys/mman.h>
 
 #include "unwind_i.h"
+#include "../eh_elf/eh_elf.h"
 
 #ifdef UNW_REMOTE_ONLY
 
@@ -106,50 +107,96 @@ tdep_init_mem_validate (void)
     }
 }
 
-/* Cache of already validated addresses */
-#define NLGA 4
-static unw_word_t last_good_addr[NLGA];
-static int lga_victim;
+/* Validate [LO, HI) in one go, whatever its size: msync() fails if any
+   page in it is not mapped.  */
+static int
+range_validate (unw_word_t lo, unw_word_t hi)
+{
+  return msync ((void *) lo, hi - lo, MS_ASYNC);
+}
+
+/* Cache of already validated address ranges.  It is per thread, like
+   the trace cache, so that unwinding threads do not race on it.  */
+#define NLGA 8
+struct lga_cache
+  {
+    struct
+      {
+        unw_word_t lo, hi;
+      }
+    range[NLGA];
+    int victim;
+  };
+
+static __thread struct lga_cache lga_cache;
+
+/* Stack addresses up to this far above our own stack pointer are
+   validated together with everything below them, in a single syscall.  */
+#define STACK_SPAN      (256 * PAGE_SIZE)
+
+static void
+lga_insert (struct lga_cache *cache, unw_word_t lo, unw_word_t hi)
+{
+  int i;
+
+  /* Grow the range we overlap or touch, typically while walking up the
+     stack.  */
+  for (i = 0; i < NLGA; i++)
+    if (cache->range[i].hi && cache->range[i].lo <= hi
+        && lo <= cache->range[i].hi)
+      {
+        if (lo < cache->range[i].lo)
+          cache->range[i].lo = lo;
+        if (hi > cache->range[i].hi)
+          cache->range[i].hi = hi;
+        return;
+      }
+
+  i = cache->victim;
+  cache->range[i].lo = lo;
+  cache->range[i].hi = hi;
+  cache->victim = (i + 1) % NLGA;
+}
 
 static int
 validate_mem (unw_word_t addr)
 {
-  int i, victim;
-  size_t len;
-
-  if (PAGE_START(addr + sizeof (unw_word_t) - 1) == PAGE_START(addr))
-    len = PAGE_SIZE;
-  else
-    len = PAGE_SIZE * 2;
+  struct lga_cache *cache = &lga_cache;
+  unw_word_t lo, hi, sp;
+  uintptr_t obj_lo, obj_hi;
+  int i;
 
-  addr = PAGE_START(addr);
+  lo = PAGE_START(addr);
+  hi = PAGE_START(addr + sizeof (unw_word_t) - 1) + PAGE_SIZE;
 
-  if (addr == 0)
+  if (lo == 0)
     return -1;
 
   for (i = 0; i < NLGA; i++)
     {
-      if (last_good_addr[i] && (addr == last_good_addr[i]))
+      if (cache->range[i].lo <= lo && hi <= cache->range[i].hi)
         return 0;
     }
 
-  if (mem_validate_func ((void *) addr, len) == -1)
-    return -1;
-
-  victim = lga_victim;
-  for (i = 0; i < NLGA; i++) {
-    if (!last_good_addr[victim]) {
-      last_good_addr[victim++] = addr;
-      return 0;
+  /* Our stack is mapped contiguously up from our stack pointer: validate
+     everything in between at once, for the frames above to hit the
+     cache.  Likewise for whole objects of the memory map eh_elf
+     prepared, which must still be validated: they may have been
+     unmapped since.  */
+  sp = PAGE_START((unw_word_t) __builtin_frame_address (0));
+  if (sp <= lo && hi - sp <= STACK_SPAN && range_validate (sp, hi) == 0)
+    lo = sp;
+  else if (eh_elf_known_mapping (addr, sizeof (unw_word_t), &obj_lo, &obj_hi)
+           && range_validate (PAGE_START(obj_lo),
+                              PAGE_START(obj_hi + PAGE_SIZE - 1)) == 0)
+    {
+      lo = PAGE_START(obj_lo);
+      hi = PAGE_START(obj_hi + PAGE_SIZE - 1);
     }
-    victim = (victim + 1) % NLGA;
-  }
-
-  /* All slots full. Evict the victim. */
-  last_good_addr[victim] = addr;
-  victim = (victim + 1) % NLGA;
-  lga_victim = victim;
+  else if (mem_validate_func ((void *) lo, hi - lo) == -1)
+    return -1;
 
+  lga_insert (cache, lo, hi);
   return 0;
 }
 
@@ -177,6 +224,24 @@ access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val, int write,
   return 0;
 }
 
+static int
+access_mem_range (unw_addr_space_t as, unw_word_t addr, void *buf, size_t len,
+                  void *arg)
+{
+  const struct cursor *c = (const struct cursor *)arg;
+  unw_word_t page;
+
+  if (likely (c != NULL) && unlikely (c->validate))
+    for (page = PAGE_START(addr); page < addr + len; page += PAGE_SIZE)
+      if (unlikely (validate_mem (page > addr ? page : addr)))
+        {
+          Debug (16, "mem[%016lx..%016lx] -> invalid\n", addr, addr + len);
+          return -1;
+        }
+  memcpy (buf, (void *) addr, len);
+  return 0;
+}
+
 static int
 access_reg (unw_addr_space_t as, unw_regnum_t reg, unw_word_t *val, int write,
             void *arg)
@@ -261,10 +326,10 @@ x86_64_local_addr_space_init (void)
   local_addr_space.acc.access_fpreg = access_fpreg;
   local_addr_space.acc.resume = x86_64_local_resume;
   local_addr_space.acc.get_proc_name = get_static_proc_name;
+  local_addr_space.acc.access_mem_range = access_mem_range;
   unw_flush_cache (&local_addr_space, 0, 0);
 
-  memset (last_good_addr, 0, sizeof (unw_word_t) * NLGA);
-  lga_victim = 0;
+  memset (&lga_cache, 0, sizeof (lga_cache));
 }
 
 #endif /* !UNW_REMOTE_ONLY */
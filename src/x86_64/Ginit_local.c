@@ -27,6 +27,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "unwind_i.h"
 #include "../eh_elf/eh_elf.h"
+#include "../eh_elf/jit.h"
 #include "init.h"
 
 #ifdef UNW_REMOTE_ONLY
@@ -37,6 +38,25 @@ unw_init_local (unw_cursor_t *cursor, ucontext_t *uc)
   return -UNW_EINVAL;
 }
 
+PROTECTED int
+unw_eh_elf_prepare_local (void)
+{
+  return -UNW_EINVAL;
+}
+
+PROTECTED int
+unw_eh_elf_register_jit (unw_word_t start, unw_word_t end,
+                         const unw_eh_elf_jit_rule_t *rules, size_t count)
+{
+  return -UNW_EINVAL;
+}
+
+PROTECTED int
+unw_eh_elf_cancel_jit (unw_word_t start)
+{
+  return -UNW_EINVAL;
+}
+
 #else /* !UNW_REMOTE_ONLY */
 
 PROTECTED int
@@ -47,7 +67,7 @@ unw_init_local (unw_cursor_t *cursor, ucontext_t *uc)
   if (unlikely (!tdep_init_done))
     tdep_init ();
 
-  eh_elf_init_local();
+  eh_elf_init_local(unw_local_addr_space);
 
   Debug (1, "(cursor=%p)\n", c);
 
@@ -58,4 +78,30 @@ unw_init_local (unw_cursor_t *cursor, ucontext_t *uc)
   return common_init (c, 1);
 }
 
+PROTECTED int
+unw_eh_elf_prepare_local (void)
+{
+  if (unlikely (!tdep_init_done))
+    tdep_init ();
+
+  Debug (1, "preparing eh_elf for signal-safe local unwinding\n");
+
+  if (eh_elf_prepare_local (unw_local_addr_space) < 0)
+    return -UNW_EUNSPEC;
+  return 0;
+}
+
+PROTECTED int
+unw_eh_elf_register_jit (unw_word_t start, unw_word_t end,
+                         const unw_eh_elf_jit_rule_t *rules, size_t count)
+{
+  return eh_elf_register_jit (start, end, rules, count);
+}
+
+PROTECTED int
+unw_eh_elf_cancel_jit (unw_word_t start)
+{
+  return eh_elf_cancel_jit (start);
+}
+
 #endif /* !UNW_REMOTE_ONLY */
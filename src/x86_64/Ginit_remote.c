@@ -47,9 +47,12 @@ unw_init_remote (unw_cursor_t *cursor, unw_addr_space_t as, void *as_arg)
   init_id++;
   Debug (1, "(init_id=%d, cursor=%p)\n", init_id, c);
 
+  if (as->acc.begin_unwind)
+    as->acc.begin_unwind (as, as_arg);
+
   switch(eh_elf_acc->init_mode) {
       case UNW_EH_ELF_INIT_PID:
-          ret = eh_elf_init_pid(eh_elf_acc->init_data.get_pid(as_arg));
+          ret = eh_elf_init_pid(as, eh_elf_acc->init_data.get_pid(as_arg));
           if(ret < 0)
               return ret;
           break;
@@ -57,7 +60,7 @@ unw_init_remote (unw_cursor_t *cursor, unw_addr_space_t as, void *as_arg)
           unw_mmap_entry_t* entries;
           size_t entries_count;
           eh_elf_acc->init_data.get_mmap(&entries, &entries_count, as_arg);
-          ret = eh_elf_init_mmap(entries, entries_count);
+          ret = eh_elf_init_mmap(as, entries, entries_count);
           free(entries);
           if(ret < 0)
               return ret;
@@ -48,7 +48,7 @@ tdep_fetch_frame (struct dwarf_cursor *dw, unw_word_t ip, int need_unwind_info)
 }
 
 HIDDEN void
-tdep_cache_frame (struct dwarf_cursor *dw, struct dwarf_reg_state *rs)
+tdep_cache_frame (struct dwarf_cursor *dw, struct dwarf_compact_rs *rs)
 {
   struct cursor *c = (struct cursor *) dw;
   rs->signal_frame = c->sigcontext_format;
@@ -58,7 +58,7 @@ tdep_cache_frame (struct dwarf_cursor *dw, struct dwarf_reg_state *rs)
 }
 
 HIDDEN void
-tdep_reuse_frame (struct dwarf_cursor *dw, struct dwarf_reg_state *rs)
+tdep_reuse_frame (struct dwarf_cursor *dw, struct dwarf_compact_rs *rs)
 {
   struct cursor *c = (struct cursor *) dw;
   c->sigcontext_format = rs->signal_frame;
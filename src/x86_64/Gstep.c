@@ -107,7 +107,7 @@ unw_step (unw_cursor_t *cursor)
   c->sigcontext_format = X86_64_SCF_NONE;
 
   // Try eh_elf based unwinding...
-  ret = eh_elf_step_cursor(c);
+  ret = eh_elf_step_cursor(c, c->dwarf.as == unw_local_addr_space);
 
   if(ret < 0) {
       UnwDebug(2, "eh_elf unwinding failed (%d), falling back\n", ret);
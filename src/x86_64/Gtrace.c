@@ -35,15 +35,47 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 /* Initial hash table size. Table expands by 2 bits (times four). */
 #define HASH_MIN_BITS 14
 
-typedef struct
+/* Size of the per-thread front of the shared frame cache. */
+#define FRONT_BITS 8
+
+/* Marks a shared cache slot which a thread is still filling in. */
+#define SLOT_CLAIMED (~(uint64_t) 0)
+
+/* Initial hash table size of the cache of a remote address space. */
+#define REMOTE_HASH_BITS 10
+
+/* What a frame cache is used for. */
+typedef enum
+{
+  TRACE_CACHE_PRIVATE,  /* Whole cache of a thread. */
+  TRACE_CACHE_FRONT,    /* Front of the shared cache, for a thread. */
+  TRACE_CACHE_SHARED,   /* Shared cache, behind the fronts. */
+  TRACE_CACHE_REMOTE    /* Cache of a remote address space. */
+} unw_trace_cache_kind_t;
+
+typedef struct unw_trace_cache
 {
   unw_tdep_frame_t *frames;
+  unw_trace_cache_kind_t kind;
   size_t log_size;
   size_t used;
   size_t dtor_count;  /* Counts how many times our destructor has already
                          been called. */
+  unw_word_t generation;  /* Remote caches: generation of the address
+                             space the frames were found in. */
+  pthread_mutex_t lock;   /* Remote caches: serialises the traces. */
 } unw_trace_cache_t;
 
+/* Registers of a frame as tracing knows them. */
+typedef struct
+{
+  unw_word_t rip;
+  unw_word_t cfa;
+  unw_word_t rsp;
+  unw_word_t rbp;
+  int use_prev_instr;
+} unw_trace_regs_t;
+
 static const unw_tdep_frame_t empty_frame = { 0, UNW_X86_64_FRAME_OTHER, -1, -1, 0, -1, -1 };
 static define_lock (trace_init_lock);
 static pthread_once_t trace_cache_once = PTHREAD_ONCE_INIT;
@@ -53,6 +85,18 @@ static struct mempool trace_cache_pool;
 static __thread  unw_trace_cache_t *tls_cache;
 static __thread  int tls_cache_destroyed;
 
+/* With UNW_SHARED_TRACE_CACHE=1, the frames are cached in a single
+   table for all threads, each of which keeps a small direct-mapped
+   front cache instead of a table of its own.  Slots of the shared table
+   are written once, and published by storing their address last, so
+   readers never wait.  When the table fills up, a larger one holding
+   the same frames replaces it; threads may still be reading the old
+   one, so it is never freed. */
+static unw_trace_cache_t *volatile shared_cache;
+
+static unw_trace_cache_t *trace_cache_alloc (size_t log_size,
+                                             unw_trace_cache_kind_t kind);
+
 /* Free memory for a thread's trace cache. */
 static void
 trace_cache_free (void *arg)
@@ -79,6 +123,8 @@ trace_cache_init_once (void)
 {
   pthread_key_create (&trace_cache_key, &trace_cache_free);
   mempool_init (&trace_cache_pool, sizeof (unw_trace_cache_t), 0);
+  if (x86_64_shared_trace_cache)
+    shared_cache = trace_cache_alloc (HASH_MIN_BITS, TRACE_CACHE_SHARED);
   trace_cache_once_happen = 1;
 }
 
@@ -97,43 +143,58 @@ trace_cache_buckets (size_t n)
 }
 
 /* Allocate and initialise hash table for frame cache lookups.
-   Returns the cache initialised with (1u << HASH_LOW_BITS) hash
+   Returns the cache of KIND initialised with (1u << LOG_SIZE) hash
    buckets, or NULL if there was a memory allocation problem. */
 static unw_trace_cache_t *
-trace_cache_create (void)
+trace_cache_alloc (size_t log_size, unw_trace_cache_kind_t kind)
 {
   unw_trace_cache_t *cache;
 
-  if (tls_cache_destroyed)
-  {
-    /* The current thread is in the process of exiting. Don't recreate
-       cache, as we wouldn't have another chance to free it. */
-    Debug(5, "refusing to reallocate cache: "
-             "thread-locals are being deallocated\n");
-    return NULL;
-  }
-
   if (! (cache = mempool_alloc(&trace_cache_pool)))
   {
     Debug(5, "failed to allocate cache\n");
     return NULL;
   }
 
-  if (! (cache->frames = trace_cache_buckets(1u << HASH_MIN_BITS)))
+  if (! (cache->frames = trace_cache_buckets(1u << log_size)))
   {
     Debug(5, "failed to allocate buckets\n");
     mempool_free(&trace_cache_pool, cache);
     return NULL;
   }
 
-  cache->log_size = HASH_MIN_BITS;
+  cache->kind = kind;
+  cache->log_size = log_size;
   cache->used = 0;
   cache->dtor_count = 0;
-  tls_cache_destroyed = 0;  /* Paranoia: should already be 0. */
   Debug(5, "allocated cache %p\n", cache);
   return cache;
 }
 
+/* Allocate the frame cache of the current thread: the whole cache, or
+   only its front if the cache is shared. */
+static unw_trace_cache_t *
+trace_cache_create (void)
+{
+  unw_trace_cache_t *cache;
+
+  if (tls_cache_destroyed)
+  {
+    /* The current thread is in the process of exiting. Don't recreate
+       cache, as we wouldn't have another chance to free it. */
+    Debug(5, "refusing to reallocate cache: "
+             "thread-locals are being deallocated\n");
+    return NULL;
+  }
+
+  if (shared_cache)
+    cache = trace_cache_alloc (FRONT_BITS, TRACE_CACHE_FRONT);
+  else
+    cache = trace_cache_alloc (HASH_MIN_BITS, TRACE_CACHE_PRIVATE);
+  tls_cache_destroyed = 0;  /* Paranoia: should already be 0. */
+  return cache;
+}
+
 /* Expand the hash table in the frame cache if possible. This always
    quadruples the hash size, and clears all previous frame entries. */
 static int
@@ -167,7 +228,7 @@ trace_cache_get_unthreaded (void)
   if (! global_cache)
   {
     mempool_init (&trace_cache_pool, sizeof (unw_trace_cache_t), 0);
-    global_cache = trace_cache_create ();
+    global_cache = trace_cache_alloc (HASH_MIN_BITS, TRACE_CACHE_PRIVATE);
   }
   cache = global_cache;
   lock_release (&trace_init_lock, saved_mask);
@@ -202,6 +263,112 @@ trace_cache_get (void)
   }
 }
 
+#ifndef UNW_LOCAL_ONLY
+
+/* Get the frame cache of the remote address space AS, shared by all
+   the threads tracing it.  Create it if there is none.  Frames are
+   looked up by their address in AS, so the cache must be emptied
+   whenever unw_flush_cache() says the code of AS changed; that is done
+   by trace_cache_lock_remote(). */
+static unw_trace_cache_t *
+trace_cache_get_remote (unw_addr_space_t as)
+{
+  unw_trace_cache_t *cache = as->trace_cache;
+
+  if (likely (cache != NULL))
+    return cache;
+
+  GET_MEMORY (cache, sizeof (*cache));
+  if (! cache)
+    return NULL;
+
+  if (! (cache->frames = trace_cache_buckets (1u << REMOTE_HASH_BITS)))
+  {
+    munmap (cache, sizeof (*cache));
+    return NULL;
+  }
+  cache->kind = TRACE_CACHE_REMOTE;
+  cache->log_size = REMOTE_HASH_BITS;
+  cache->used = 0;
+  cache->generation = atomic_read (&as->cache_generation);
+  lock_init (&cache->lock);
+
+  if (! cmpxchg_ptr (&as->trace_cache, NULL, cache))
+  {
+    /* another thread was faster */
+    munmap (cache->frames,
+            (1u << cache->log_size) * sizeof (unw_tdep_frame_t));
+    munmap (cache, sizeof (*cache));
+    cache = as->trace_cache;
+  }
+  Debug (5, "using remote cache %p\n", cache);
+  return cache;
+}
+
+/* Lock the remote frame CACHE of AS, and empty it if AS was flushed
+   since the frames in it were found. */
+static void
+trace_cache_lock_remote (unw_addr_space_t as, unw_trace_cache_t *cache,
+                         intrmask_t *saved_maskp)
+{
+  size_t i;
+
+  lock_acquire (&cache->lock, *saved_maskp);
+  if (cache->generation != atomic_read (&as->cache_generation))
+  {
+    Debug (5, "flushing remote cache %p\n", cache);
+    for (i = 0; i < (1u << cache->log_size); ++i)
+      cache->frames[i] = empty_frame;
+    cache->used = 0;
+    cache->generation = atomic_read (&as->cache_generation);
+  }
+}
+
+/* Free the frame cache of the remote address space AS, if any. */
+HIDDEN void
+x86_64_trace_cache_free (unw_addr_space_t as)
+{
+  unw_trace_cache_t *cache = as->trace_cache;
+
+  if (! cache)
+    return;
+  as->trace_cache = NULL;
+  munmap (cache->frames, (1u << cache->log_size) * sizeof (unw_tdep_frame_t));
+  munmap (cache, sizeof (*cache));
+}
+
+/* Perform one step of the remote cursor C from the frame at RIP, whose
+   RBP and RSP are RBP and RSP.  Unlike the registers of the local
+   context, those of the target must not be written: the values are
+   given to DWARF as such instead.  The step is always done by DWARF,
+   which stashes the frame, even where eh_elf could do it.  Returns as
+   unw_step() does. */
+static int
+trace_step_remote (struct cursor *c,
+                   unw_word_t rip,
+                   unw_word_t rbp,
+                   unw_word_t rsp)
+{
+  struct dwarf_cursor *d = &c->dwarf;
+  int i, ret;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+    d->loc[i] = DWARF_NULL_LOC;
+  d->loc[UNW_X86_64_RIP] = DWARF_VAL_LOC (d, rip);
+  d->loc[UNW_X86_64_RBP] = DWARF_VAL_LOC (d, rbp);
+  d->loc[UNW_X86_64_RSP] = DWARF_VAL_LOC (d, rsp);
+  c->sigcontext_format = X86_64_SCF_NONE;
+
+  /* The end of the call chain is marked as unw_step() marks it. */
+  if ((ret = dwarf_step (d)) > 0
+      && (DWARF_IS_NULL_LOC (d->loc[UNW_X86_64_RBP])
+          || DWARF_IS_NULL_LOC (d->loc[d->ret_addr_column])))
+    ret = 0;
+  return ret;
+}
+
+#endif /* !UNW_LOCAL_ONLY */
+
 /* Initialise frame properties for address cache slot F at address
    RIP using current CFA, RBP and RSP values.  Modifies CURSOR to
    that location, performs one unw_step(), and fills F with what
@@ -234,19 +401,30 @@ trace_init_addr (unw_tdep_frame_t *f,
   /* Reinitialise cursor to this instruction - but undo next/prev RIP
      adjustment because unw_step will redo it - and force RIP, RBP
      RSP into register locations (=~ ucontext we keep), then set
-     their desired values. Then perform the step. */
+     their desired values; remote cursors are given the values
+     directly instead. Then perform the step. */
   d->ip = rip + d->use_prev_instr;
   d->cfa = cfa;
-  d->loc[UNW_X86_64_RIP] = DWARF_REG_LOC (d, UNW_X86_64_RIP);
-  d->loc[UNW_X86_64_RBP] = DWARF_REG_LOC (d, UNW_X86_64_RBP);
-  d->loc[UNW_X86_64_RSP] = DWARF_REG_LOC (d, UNW_X86_64_RSP);
   c->frame_info = *f;
 
-  if (likely(dwarf_put (d, d->loc[UNW_X86_64_RIP], rip) >= 0)
-      && likely(dwarf_put (d, d->loc[UNW_X86_64_RBP], rbp) >= 0)
-      && likely(dwarf_put (d, d->loc[UNW_X86_64_RSP], rsp) >= 0)
-      && likely((ret = unw_step (cursor)) >= 0))
-    *f = c->frame_info;
+#ifndef UNW_LOCAL_ONLY
+  if (d->as != unw_local_addr_space)
+  {
+    if (likely((ret = trace_step_remote (c, rip, rbp, rsp)) >= 0))
+      *f = c->frame_info;
+  }
+  else
+#endif
+  {
+    d->loc[UNW_X86_64_RIP] = DWARF_REG_LOC (d, UNW_X86_64_RIP);
+    d->loc[UNW_X86_64_RBP] = DWARF_REG_LOC (d, UNW_X86_64_RBP);
+    d->loc[UNW_X86_64_RSP] = DWARF_REG_LOC (d, UNW_X86_64_RSP);
+    if (likely(dwarf_put (d, d->loc[UNW_X86_64_RIP], rip) >= 0)
+        && likely(dwarf_put (d, d->loc[UNW_X86_64_RBP], rbp) >= 0)
+        && likely(dwarf_put (d, d->loc[UNW_X86_64_RSP], rsp) >= 0)
+        && likely((ret = unw_step (cursor)) >= 0))
+      *f = c->frame_info;
+  }
 
   /* If unw_step() stopped voluntarily, remember that, even if it
      otherwise could not determine anything useful.  This avoids
@@ -330,7 +508,176 @@ trace_lookup (unw_cursor_t *cursor,
   return trace_init_addr (frame, cursor, cfa, rip, rbp, rsp);
 }
 
-/* Fast stack backtrace for x86-64.
+/* Look up RIP in the shared frame cache.  Returns the slot which
+   describes RIP, or NULL if it is not there (yet). */
+static const unw_tdep_frame_t *
+shared_lookup (unw_trace_cache_t *cache, unw_word_t rip)
+{
+  uint64_t i, addr;
+  uint64_t cache_size = 1u << cache->log_size;
+  uint64_t slot = ((rip * 0x9e3779b97f4a7c16) >> 43) & (cache_size-1);
+  volatile unw_tdep_frame_t *frame;
+
+  for (i = 0; i < 16; ++i)
+  {
+    frame = &cache->frames[slot];
+    addr = frame->virtual_address;
+    if (likely(addr == rip))
+      return (const unw_tdep_frame_t *) frame;
+    if (! addr)
+      break;
+    if (++slot >= cache_size)
+      slot -= cache_size;
+  }
+  return NULL;
+}
+
+/* Copy the frames published in the shared frame cache OLD to BIGGER,
+   which no other thread sees yet.  Slots still being filled in are
+   skipped; their frames are looked up again on the next miss. */
+static void
+shared_copy (unw_trace_cache_t *old, unw_trace_cache_t *bigger)
+{
+  uint64_t i, j, addr, slot;
+  uint64_t old_size = 1u << old->log_size;
+  uint64_t cache_size = 1u << bigger->log_size;
+  unw_tdep_frame_t *frame;
+
+  for (i = 0; i < old_size; ++i)
+  {
+    addr = ((volatile unw_tdep_frame_t *) &old->frames[i])->virtual_address;
+    if (! addr || addr == SLOT_CLAIMED)
+      continue;
+    __sync_synchronize ();
+
+    slot = ((addr * 0x9e3779b97f4a7c16) >> 43) & (cache_size-1);
+    for (j = 0; j < 16; ++j)
+    {
+      frame = &bigger->frames[slot];
+      if (! frame->virtual_address)
+      {
+        *frame = old->frames[i];
+        frame->virtual_address = addr;
+        ++bigger->used;
+        break;
+      }
+      if (++slot >= cache_size)
+        slot -= cache_size;
+    }
+  }
+}
+
+/* Publish F in the shared frame cache.  A slot is claimed by swapping
+   its address from zero, and the address of F is stored last, once the
+   rest of the slot is filled in. */
+static void
+shared_insert (const unw_tdep_frame_t *f)
+{
+  unw_trace_cache_t *cache, *bigger;
+  uint64_t i, addr, cache_size, slot;
+  unw_tdep_frame_t *frame, entry;
+
+  while ((cache = shared_cache))
+  {
+    cache_size = 1u << cache->log_size;
+    slot = ((f->virtual_address * 0x9e3779b97f4a7c16) >> 43) & (cache_size-1);
+
+    for (i = 0; i < 16 && cache->used < cache_size / 2; ++i)
+    {
+      frame = &cache->frames[slot];
+      addr = ((volatile unw_tdep_frame_t *) frame)->virtual_address;
+
+      /* Another thread got there first. */
+      if (addr == f->virtual_address)
+        return;
+
+      if (! addr
+          && __sync_bool_compare_and_swap (&frame->virtual_address,
+                                           0, SLOT_CLAIMED))
+      {
+        entry = *f;
+        entry.virtual_address = SLOT_CLAIMED;
+        *frame = entry;
+        __sync_synchronize ();
+        ((volatile unw_tdep_frame_t *) frame)->virtual_address =
+          f->virtual_address;
+        fetch_and_add1 (&cache->used);
+        return;
+      }
+
+      if (++slot >= cache_size)
+        slot -= cache_size;
+    }
+
+    /* Half full, or too many collisions: replace the table with one
+       four times larger, holding the frames learned so far.  Threads
+       may still be reading the old table, with no way to tell when they
+       are done, so it is never freed; as each table is four times the
+       size of the previous one, all the old ones together take less
+       than a third of the memory of the current one. */
+    if (unlikely(! (bigger = trace_cache_alloc (cache->log_size + 2,
+                                                TRACE_CACHE_SHARED))))
+      return;
+    shared_copy (cache, bigger);
+    if (! cmpxchg_ptr ((void *) &shared_cache, cache, bigger))
+    {
+      munmap (bigger->frames,
+              (1u << bigger->log_size) * sizeof (unw_tdep_frame_t));
+      mempool_free (&trace_cache_pool, bigger);
+    }
+    else
+      Debug (5, "replaced shared cache %p with %p, keeping %lu frames\n",
+             cache, bigger, bigger->used);
+  }
+}
+
+/* Store F in the front cache slot FRAME.  The address goes last, for
+   a signal handler tracing in the middle not to match a partial slot. */
+static unw_tdep_frame_t *
+front_fill (unw_tdep_frame_t *frame, const unw_tdep_frame_t *f)
+{
+  unw_tdep_frame_t entry = *f;
+
+  entry.virtual_address = 0;
+  ((volatile unw_tdep_frame_t *) frame)->virtual_address = 0;
+  *frame = entry;
+  asm volatile ("" ::: "memory");
+  ((volatile unw_tdep_frame_t *) frame)->virtual_address = f->virtual_address;
+  return frame;
+}
+
+/* Like trace_lookup(), for a thread whose FRONT cache sits in front of
+   the shared frame cache.  Frames missing from both are published in
+   the shared cache for the other threads. */
+static unw_tdep_frame_t *
+front_lookup (unw_cursor_t *cursor,
+              unw_trace_cache_t *front,
+              unw_word_t cfa,
+              unw_word_t rip,
+              unw_word_t rbp,
+              unw_word_t rsp)
+{
+  uint64_t slot = ((rip * 0x9e3779b97f4a7c16) >> 43)
+                  & ((1u << front->log_size) - 1);
+  unw_tdep_frame_t *frame = &front->frames[slot];
+  const unw_tdep_frame_t *shared;
+  unw_tdep_frame_t f;
+
+  if (likely(frame->virtual_address == rip))
+    return frame;
+
+  if ((shared = shared_lookup (shared_cache, rip)))
+  {
+    Debug (4, "found address in shared cache\n");
+    return front_fill (frame, shared);
+  }
+
+  trace_init_addr (&f, cursor, cfa, rip, rbp, rsp);
+  shared_insert (&f);
+  return front_fill (frame, &f);
+}
+
+/* Fast stack backtrace for x86-64, tdep_trace().
 
    This is used by backtrace() implementation to accelerate frequent
    queries for current stack, without any desire to unwind. It fills
@@ -340,6 +687,10 @@ trace_lookup (unw_cursor_t *cursor,
    stored into BUFFER. Uses an internal thread-specific cache to
    accelerate queries.
 
+   Remote cursors use a cache of their address space instead, which
+   the threads tracing it share, and which unw_flush_cache() empties.
+   Their address space must cache, or -UNW_ENOINFO is returned.
+
    The caller should fall back to a unw_step() loop if this function
    fails by returning -UNW_ESTOPUNWIND, meaning the routine hit a
    stack frame that is too complex to be traced in the fast path.
@@ -369,6 +720,8 @@ trace_lookup (unw_cursor_t *cursor,
    The function returns a negative value for errors, -UNW_ESTOPUNWIND
    if tracing stopped because of an unusual frame unwind info.  The
    BUFFER and *SIZE reflect tracing progress up to the error frame.
+   If STOP is not NULL, it is then set to the registers that tracing
+   knew of that frame, the last one in BUFFER or that of CURSOR.
 
    Callers of this function would normally look like this:
 
@@ -393,8 +746,9 @@ trace_lookup (unw_cursor_t *cursor,
        }
      }
 */
-HIDDEN int
-tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
+static int
+trace_stack (unw_cursor_t *cursor, void **buffer, int *size,
+             unw_trace_regs_t *stop)
 {
   struct cursor *c = (struct cursor *) cursor;
   struct dwarf_cursor *d = &c->dwarf;
@@ -403,6 +757,10 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
   int maxdepth = 0;
   int depth = 0;
   int ret;
+#ifndef UNW_LOCAL_ONLY
+  int remote = (d->as != unw_local_addr_space);
+  intrmask_t saved_mask;
+#endif
 
   /* Check input parametres. */
   if (unlikely(! cursor || ! buffer || ! size || (maxdepth = *size) <= 0))
@@ -414,14 +772,37 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
   d->stash_frames = 1;
 
   /* Determine initial register values. These are direct access safe
-     because we know they come from the initial machine context. */
+     because we know they come from the initial machine context, or
+     the registers of the remote target. */
   rip = d->ip;
   rsp = cfa = d->cfa;
-  ACCESS_MEM_FAST(ret, 0, d, DWARF_GET_LOC(d->loc[UNW_X86_64_RBP]), rbp);
-  assert(ret == 0);
+  ret = dwarf_get (d, d->loc[UNW_X86_64_RBP], &rbp);
+  if (unlikely(ret < 0))
+  {
+    Debug (1, "returning %d, cannot read initial rbp\n", ret);
+    *size = 0;
+    d->stash_frames = 0;
+    return ret;
+  }
 
-  /* Get frame cache. */
-  if (unlikely(! (cache = trace_cache_get())))
+  /* Get frame cache.  Remote address spaces have theirs, which is only
+     used if they cache. */
+#ifndef UNW_LOCAL_ONLY
+  if (remote)
+  {
+    if (unlikely(d->as->caching_policy == UNW_CACHE_NONE))
+    {
+      Debug (1, "returning %d, address space not caching\n", -UNW_ENOINFO);
+      *size = 0;
+      d->stash_frames = 0;
+      return -UNW_ENOINFO;
+    }
+    cache = trace_cache_get_remote (d->as);
+  }
+  else
+#endif
+    cache = trace_cache_get();
+  if (unlikely(! cache))
   {
     Debug (1, "returning %d, cannot get trace cache\n", -UNW_ENOMEM);
     *size = 0;
@@ -429,12 +810,26 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     return -UNW_ENOMEM;
   }
 
+#ifndef UNW_LOCAL_ONLY
+  if (remote)
+    trace_cache_lock_remote (d->as, cache, &saved_mask);
+#endif
+
   /* Trace the stack upwards, starting from current RIP.  Adjust
      the RIP address for previous/next instruction as the main
      unwinding logic would also do.  We undo this before calling
      back into unw_step(). */
   while (depth < maxdepth)
   {
+    if (stop)
+    {
+      stop->rip = rip;
+      stop->cfa = cfa;
+      stop->rsp = rsp;
+      stop->rbp = rbp;
+      stop->use_prev_instr = d->use_prev_instr;
+    }
+
     rip -= d->use_prev_instr;
     Debug (2, "depth %d cfa 0x%lx rip 0x%lx rsp 0x%lx rbp 0x%lx\n",
            depth, cfa, rip, rsp, rbp);
@@ -444,7 +839,11 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
        decide this frame cannot be handled in fast trace mode.  We
        cache negative results too to prevent unnecessary dwarf parsing
        for common failures. */
-    unw_tdep_frame_t *f = trace_lookup (cursor, cache, cfa, rip, rbp, rsp);
+    unw_tdep_frame_t *f;
+    if (cache->kind == TRACE_CACHE_FRONT)
+      f = front_lookup (cursor, cache, cfa, rip, rbp, rsp);
+    else
+      f = trace_lookup (cursor, cache, cfa, rip, rbp, rsp);
 
     /* If we don't have information for this frame, give up. */
     if (unlikely(! f))
@@ -525,9 +924,57 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     buffer[depth++] = (void *) (rip - d->use_prev_instr);
   }
 
+#ifndef UNW_LOCAL_ONLY
+  if (remote)
+    lock_release (&cache->lock, saved_mask);
+#endif
+
 #if UNW_DEBUG
   Debug (1, "returning %d, depth %d\n", ret, depth);
 #endif
   *size = depth;
   return ret;
 }
+
+HIDDEN int
+tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
+{
+  return trace_stack (cursor, buffer, size, NULL);
+}
+
+#ifndef UNW_LOCAL_ONLY
+/* Trace the remote CURSOR as tdep_trace() does.  If tracing fails,
+   leave CURSOR at the frame where it stopped rather than wherever the
+   trace left it, for unw_step() to take over from there.  As in the
+   steps of the trace itself, only RIP, RSP and RBP are known in that
+   frame, unless it is the one CURSOR was at. */
+HIDDEN int
+tdep_trace_remote (unw_cursor_t *cursor, void **buffer, int *size)
+{
+  struct cursor *c = (struct cursor *) cursor;
+  struct dwarf_cursor *d = &c->dwarf;
+  struct cursor start = *c;
+  unw_trace_regs_t stop;
+  int i, ret;
+
+  ret = trace_stack (cursor, buffer, size, &stop);
+  if (ret >= 0)
+    return ret;
+  *c = start;
+  if (*size == 0)
+    return ret;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+    d->loc[i] = DWARF_NULL_LOC;
+  d->loc[UNW_X86_64_RIP] = DWARF_VAL_LOC (d, stop.rip);
+  d->loc[UNW_X86_64_RBP] = DWARF_VAL_LOC (d, stop.rbp);
+  d->loc[UNW_X86_64_RSP] = DWARF_VAL_LOC (d, stop.rsp);
+  d->ip = stop.rip;
+  d->cfa = stop.cfa;
+  d->use_prev_instr = stop.use_prev_instr;
+  d->pi_valid = 0;
+  c->sigcontext_format = X86_64_SCF_NONE;
+  c->frame_info.frame_type = UNW_X86_64_FRAME_OTHER;
+  return ret;
+}
+#endif /* !UNW_LOCAL_ONLY */
@@ -0,0 +1,197 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure the cost of registering many regions of dynamically generated
+   code with _U_dyn_register() and of looking them up, both in the local
+   address space and through an address space which reads the list the
+   way a remote unwinder does.
+
+   usage: Gperf-dyn [regions [lookups]]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(args...)							  \
+	do { fprintf (stderr, args); exit (-1); } while (0)
+
+#define REGION_SIZE	64
+#define CODE_BASE	0x10000000
+#define NCHANGES	16	/* must not exceed UNW_DYN_CANCEL_LOG_SIZE */
+
+extern unw_word_t _U_dyn_info_list_addr (void);
+
+static long nregions = 100000;
+static long nlookups = 1000000;
+static unw_dyn_info_t *di;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+/* Accessors reading our own memory, so that looking up the dynamic
+   unwind info goes through the same code as for a remote process.  */
+
+static int
+find_proc_info (unw_addr_space_t as UNUSED, unw_word_t ip UNUSED,
+		unw_proc_info_t *pi UNUSED, int need_unwind_info UNUSED,
+		void *arg UNUSED)
+{
+  return -UNW_ENOINFO;
+}
+
+static void
+put_unwind_info (unw_addr_space_t as UNUSED, unw_proc_info_t *pi UNUSED,
+		 void *arg UNUSED)
+{
+}
+
+static int
+get_dyn_info_list_addr (unw_addr_space_t as UNUSED, unw_word_t *dilap,
+			void *arg UNUSED)
+{
+  *dilap = _U_dyn_info_list_addr ();
+  return 0;
+}
+
+static int
+access_mem (unw_addr_space_t as UNUSED, unw_word_t addr, unw_word_t *val,
+	    int write, void *arg UNUSED)
+{
+  if (write)
+    return -UNW_EREADONLYREG;
+  *val = *(unw_word_t *) (uintptr_t) addr;
+  return 0;
+}
+
+static unw_accessors_t accessors =
+  {
+    .find_proc_info = find_proc_info,
+    .put_unwind_info = put_unwind_info,
+    .get_dyn_info_list_addr = get_dyn_info_list_addr,
+    .access_mem = access_mem
+  };
+
+static void
+register_regions (long first, long last)
+{
+  long i;
+
+  for (i = first; i < last; ++i)
+    {
+      di[i].start_ip = CODE_BASE + i * REGION_SIZE;
+      di[i].end_ip = di[i].start_ip + REGION_SIZE;
+      di[i].format = UNW_INFO_FORMAT_DYNAMIC;
+      _U_dyn_register (di + i);
+    }
+}
+
+static double
+measure_lookups (unw_addr_space_t as, const char *label)
+{
+  unw_proc_info_t pi;
+  double start, stop;
+  unw_word_t ip;
+  long i, r;
+
+  start = gettime ();
+  for (i = 0; i < nlookups; ++i)
+    {
+      r = (i * 7919) % nregions;
+      ip = CODE_BASE + r * REGION_SIZE + REGION_SIZE / 2;
+      if (unw_get_proc_info_by_ip (as, ip, &pi, NULL) < 0
+	  || pi.start_ip != di[r].start_ip)
+	panic ("%s: lookup of %lx failed\n", label, (long) ip);
+    }
+  stop = gettime ();
+
+  printf ("%s: %9.3f nsec/lookup\n", label, 1e9 * (stop - start) / nlookups);
+  return stop - start;
+}
+
+int
+main (int argc, char **argv)
+{
+  unw_proc_info_t pi;
+  unw_addr_space_t as;
+  double start, stop;
+  long i;
+
+  if (argc > 1)
+    {
+      nregions = atol (argv[1]);
+      if (argc > 2)
+	nlookups = atol (argv[2]);
+    }
+  if (nregions < NCHANGES)
+    panic ("need at least %d regions\n", NCHANGES);
+
+  di = calloc (nregions + NCHANGES, sizeof (*di));
+  if (!di)
+    panic ("out of memory\n");
+
+  start = gettime ();
+  register_regions (0, nregions);
+  stop = gettime ();
+  printf ("_U_dyn_register      : %9.3f nsec/region (%ld regions)\n",
+	  1e9 * (stop - start) / nregions, nregions);
+
+  measure_lookups (unw_local_addr_space, "local lookup         ");
+
+  as = unw_create_addr_space (&accessors, 0);
+  if (!as)
+    panic ("unw_create_addr_space() failed\n");
+  unw_set_caching_policy (as, UNW_CACHE_GLOBAL);
+
+  start = gettime ();
+  if (unw_get_proc_info_by_ip (as, CODE_BASE, &pi, NULL) < 0)
+    panic ("first remote lookup failed\n");
+  stop = gettime ();
+  printf ("remote first lookup  : %9.3f msec\n", 1e3 * (stop - start));
+
+  measure_lookups (as, "remote lookup        ");
+
+  /* Replace a few regions, as a JIT recompiling code would.  */
+  for (i = 0; i < NCHANGES; ++i)
+    _U_dyn_cancel (di + i * (nregions / NCHANGES));
+  register_regions (nregions, nregions + NCHANGES);
+
+  start = gettime ();
+  if (unw_get_proc_info_by_ip (as, CODE_BASE + nregions * REGION_SIZE, &pi,
+			       NULL) < 0)
+    panic ("remote lookup after update failed\n");
+  stop = gettime ();
+  printf ("remote after %d changes: %9.3f msec\n", 2 * NCHANGES,
+	  1e3 * (stop - start));
+
+  unw_destroy_addr_space (as);
+  return 0;
+}
@@ -0,0 +1,198 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure unw_get_proc_info_by_ip() on the functions of each library
+   loaded in the process, that is mostly the search of its .eh_frame_hdr
+   table.  The libraries named on the command line are loaded first, to
+   measure large tables; by default, the C++ and math libraries are.
+   Each function is looked up at its start, picked at random in the
+   table, and must be found there.  Each library gets `iterations'
+   passes over NSAMPLES functions.
+
+   usage: Gperf-lookup [iterations [library...]]  */
+
+#include <dlfcn.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libunwind.h>
+
+#include <sys/time.h>
+
+#define panic(args...)							  \
+	do { fprintf (stderr, args); exit (-1); } while (0)
+
+#define NSAMPLES	(1 << 16)
+
+struct eh_frame_hdr
+  {
+    unsigned char version;
+    unsigned char eh_frame_ptr_enc;
+    unsigned char fde_count_enc;
+    unsigned char table_enc;
+    int32_t eh_frame_ptr;
+    uint32_t fde_count;
+    struct
+      {
+	int32_t start_ip_offset;
+	int32_t fde_offset;
+      }
+    table[];
+  };
+
+#define DW_EH_PE_udata4		0x03
+#define DW_EH_PE_sdata4		0x0b
+#define DW_EH_PE_datarel	0x30
+
+#define MAX_OBJECTS	64
+
+static const char *default_libs[] = { "libstdc++.so.6", "libm.so.6" };
+
+static long iterations = 20;
+static unw_word_t samples[NSAMPLES];
+
+static struct object
+  {
+    const char *name;
+    const struct eh_frame_hdr *hdr;
+  }
+objects[MAX_OBJECTS];
+static int nobjects;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+/* The search table of the object INFO describes, or NULL.  */
+static const struct eh_frame_hdr *
+get_table (struct dl_phdr_info *info)
+{
+  const struct eh_frame_hdr *hdr;
+  int i;
+
+  for (i = 0; i < info->dlpi_phnum; ++i)
+    if (info->dlpi_phdr[i].p_type == PT_GNU_EH_FRAME)
+      {
+	hdr = (void *) (info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+	if (hdr->version == 1
+	    && (hdr->eh_frame_ptr_enc & 0x0f) == DW_EH_PE_sdata4
+	    && hdr->fde_count_enc == DW_EH_PE_udata4
+	    && hdr->table_enc == (DW_EH_PE_datarel | DW_EH_PE_sdata4)
+	    && hdr->fde_count > 0)
+	  return hdr;
+      }
+  return NULL;
+}
+
+static int
+object_callback (struct dl_phdr_info *info, size_t size, void *arg)
+{
+  const struct eh_frame_hdr *hdr = get_table (info);
+
+  if (hdr && nobjects < MAX_OBJECTS)
+    {
+      objects[nobjects].name = info->dlpi_name[0] ? info->dlpi_name
+						   : "(main program)";
+      objects[nobjects].hdr = hdr;
+      ++nobjects;
+    }
+  return 0;
+}
+
+static void
+measure (const struct object *obj)
+{
+  const struct eh_frame_hdr *hdr = obj->hdr;
+  unw_proc_info_t pi;
+  long i, j, found = 0;
+  double start, stop, best = 0;
+
+  for (i = 0; i < NSAMPLES; ++i)
+    samples[i] = (unw_word_t) hdr
+		 + hdr->table[((size_t) rand () * RAND_MAX + rand ())
+			      % hdr->fde_count].start_ip_offset;
+
+  /* The first pass makes sure the samples are found where they should,
+     and sets up whatever is done once per table.  */
+  for (i = 0; i < NSAMPLES; ++i)
+    {
+      if (unw_get_proc_info_by_ip (unw_local_addr_space, samples[i], &pi,
+				   NULL) < 0)
+	continue;	/* e.g., an empty FDE */
+      if (pi.start_ip != samples[i])
+	panic ("%s: IP 0x%lx found in the procedure at 0x%lx\n", obj->name,
+	       (long) samples[i], (long) pi.start_ip);
+      ++found;
+    }
+  if (found < NSAMPLES / 2)
+    panic ("%s: only found %ld of %d procedures\n", obj->name, found,
+	   NSAMPLES);
+
+  /* The best of the passes, the others were disturbed.  */
+  for (j = 0; j < iterations; ++j)
+    {
+      start = gettime ();
+      for (i = 0; i < NSAMPLES; ++i)
+	unw_get_proc_info_by_ip (unw_local_addr_space, samples[i], &pi, NULL);
+      stop = gettime ();
+      if (j == 0 || stop - start < best)
+	best = stop - start;
+    }
+
+  printf ("%9.3f nsec/lookup, %7u FDEs in %s\n", 1e9 * best / NSAMPLES,
+	  hdr->fde_count, obj->name);
+}
+
+int
+main (int argc, char **argv)
+{
+  int k;
+
+  if (argc > 1)
+    iterations = atol (argv[1]);
+
+  if (argc > 2)
+    {
+      for (k = 2; k < argc; ++k)
+	if (!dlopen (argv[k], RTLD_NOW))
+	  panic ("%s\n", dlerror ());
+    }
+  else
+    for (k = 0; k < (int) (sizeof (default_libs) / sizeof (default_libs[0]));
+	 ++k)
+      dlopen (default_libs[k], RTLD_NOW);
+
+  dl_iterate_phdr (object_callback, NULL);
+  if (nobjects == 0)
+    panic ("no .eh_frame_hdr search table found\n");
+
+  srand (1);
+  for (k = 0; k < nobjects; ++k)
+    measure (&objects[k]);
+  return 0;
+}
@@ -0,0 +1,140 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure the memory pools from one thread and then from several at
+   once.  With caching disabled, every unw_step() parses the DWARF
+   unwind info of its frame into a descriptor allocated from a memory
+   pool, and frees it again at the next step.
+
+   usage: Gperf-mempool [threads [iterations]]  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(args...)							  \
+	do { fprintf (stderr, args); exit (-1); } while (0)
+
+#define DEPTH		16
+
+static int nthreads = 4;
+static long iterations = 20000;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static long NOINLINE
+run_steps (void)
+{
+  unw_cursor_t c;
+  unw_context_t uc;
+  long i, nsteps = 0;
+  int ret;
+
+  for (i = 0; i < iterations; ++i)
+    {
+      unw_getcontext (&uc);
+      if (unw_init_local (&c, &uc) < 0)
+	panic ("unw_init_local() failed\n");
+      while ((ret = unw_step (&c)) > 0)
+	++nsteps;
+      if (ret < 0)
+	panic ("unw_step() returned %d\n", ret);
+    }
+  return nsteps;
+}
+
+static long NOINLINE
+recurse (int depth)
+{
+  volatile int level = depth;   /* keeps the call from becoming a jump */
+  long ret;
+
+  if (depth > 0)
+    ret = recurse (depth - 1);
+  else
+    ret = run_steps ();
+  return ret + level - depth;
+}
+
+static void *
+worker (void *arg)
+{
+  *(long *) arg = recurse (DEPTH);
+  return NULL;
+}
+
+static void
+measure (int n)
+{
+  pthread_t threads[n];
+  long nsteps[n], total = 0;
+  double start, stop;
+  int i;
+
+  start = gettime ();
+  for (i = 0; i < n; ++i)
+    pthread_create (&threads[i], NULL, worker, &nsteps[i]);
+  for (i = 0; i < n; ++i)
+    {
+      pthread_join (threads[i], NULL);
+      total += nsteps[i];
+    }
+  stop = gettime ();
+
+  printf ("uncached unw_step, %2d thread%s: %9.3f nsec/step (%ld steps)\n",
+	  n, n > 1 ? "s" : " ", 1e9 * (stop - start) / total, total);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1)
+    {
+      nthreads = atoi (argv[1]);
+      if (argc > 2)
+	iterations = atol (argv[2]);
+    }
+  if (nthreads < 1)
+    panic ("need at least one thread\n");
+
+  /* Unwinding from several threads needs the prepared memory map.  */
+  if (unw_eh_elf_prepare_local () < 0)
+    panic ("unw_eh_elf_prepare_local() failed\n");
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+
+  measure (1);
+  if (nthreads > 1)
+    measure (nthreads);
+  return 0;
+}
@@ -92,21 +92,31 @@ static int f1 (int, int, double *);
 static int NOINLINE
 g1 (int level, int maxlevel, double *step)
 {
+  int ret;
+
   if (level == maxlevel)
     return measure_unwind (maxlevel, step);
-  else
-    /* defeat last-call/sibcall optimization */
-    return f1 (level + 1, maxlevel, step) + level;
+
+  ret = f1 (level + 1, maxlevel, step);
+  /* defeat last-call/sibcall optimization, and the conversion of the
+     recursion into a loop */
+  dummy += level;
+  return ret;
 }
 
 static int NOINLINE
 f1 (int level, int maxlevel, double *step)
 {
+  int ret;
+
   if (level == maxlevel)
     return measure_unwind (maxlevel, step);
-  else
-    /* defeat last-call/sibcall optimization */
-    return g1 (level + 1, maxlevel, step) + level;
+
+  ret = g1 (level + 1, maxlevel, step);
+  /* defeat last-call/sibcall optimization, and the conversion of the
+     recursion into a loop */
+  dummy += level;
+  return ret;
 }
 
 static void
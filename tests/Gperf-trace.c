@@ -39,6 +39,7 @@ long dummy;
 
 static long iterations = 10000;
 static int maxlevel = 100;
+static int use_eh_elf_backtrace;
 
 #define KB	1024
 #define MB	(1024*1024)
@@ -60,9 +61,16 @@ measure_unwind (int maxlevel, double *step)
   double stop, start;
   int level = 0;
   void *buffer[128];
+  unw_context_t uc;
 
   start = gettime ();
-  level = unw_backtrace(buffer, 128);
+  if (use_eh_elf_backtrace)
+    {
+      unw_getcontext (&uc);
+      level = unw_eh_elf_backtrace (&uc, buffer, 128);
+    }
+  else
+    level = unw_backtrace(buffer, 128);
   stop = gettime ();
 
   if (level <= maxlevel)
@@ -244,5 +252,8 @@ main (int argc, char **argv)
   unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_PER_THREAD);
   doit ("per-thread cache");
 
+  use_eh_elf_backtrace = 1;
+  doit ("eh_elf raw regs ");
+
   return 0;
 }
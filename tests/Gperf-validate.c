@@ -0,0 +1,175 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure backtraces whose memory accesses are validated, with one
+   thread and then with several at once.  The return sites in recurse()
+   get eh_elf rules, the way a JIT registers them for its code: eh_elf
+   frames are guessed, so the backtrace validates every access from
+   there on.  Each frame is large, so that a backtrace spans many pages
+   of stack.
+
+   usage: Gperf-validate [threads [iterations]]  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(args...)							  \
+	do { fprintf (stderr, args); exit (-1); } while (0)
+
+#define DEPTH		64
+#define FRAME_SIZE	1024
+
+static int nthreads = 4;
+static long iterations = 20000;
+
+/* While probing, collect the return addresses into recurse().  */
+static int probing;
+static unw_word_t ra_lo = ~(unw_word_t) 0, ra_hi;
+
+static const unw_eh_elf_jit_rule_t frame_rule =
+  {
+    .offset = 0, .cfa_reg = UNW_TDEP_BP, .cfa_offset = 16, .ra_offset = -8,
+    .bp_offset = -16
+  };
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void
+note_return_address (unw_word_t ra)
+{
+  if (ra < ra_lo)
+    ra_lo = ra;
+  if (ra > ra_hi)
+    ra_hi = ra;
+}
+
+static long NOINLINE
+run_backtraces (void)
+{
+  void *buffer[128];
+  long i, nframes = 0;
+  int n;
+
+  if (probing)
+    {
+      note_return_address ((unw_word_t) __builtin_return_address (0));
+      return 0;
+    }
+
+  for (i = 0; i < iterations; ++i)
+    {
+      n = unw_backtrace (buffer, 128);
+      if (n < DEPTH)
+	panic ("Unwound only %d levels, expected at least %d levels\n",
+	       n, DEPTH);
+      nframes += n;
+    }
+  return nframes;
+}
+
+/* The rule above needs a frame pointer.  */
+static long NOINLINE __attribute__ ((optimize ("no-omit-frame-pointer")))
+recurse (int depth, int top)
+{
+  volatile char frame[FRAME_SIZE];
+  long ret;
+
+  if (probing && depth < top)
+    note_return_address ((unw_word_t) __builtin_return_address (0));
+
+  frame[0] = depth;
+  if (depth > 0)
+    ret = recurse (depth - 1, top);
+  else
+    ret = run_backtraces ();
+  return ret + frame[0] - depth;
+}
+
+static void *
+worker (void *arg)
+{
+  *(long *) arg = recurse (DEPTH, DEPTH);
+  return NULL;
+}
+
+static void
+measure (int n)
+{
+  pthread_t threads[n];
+  long nframes[n], total = 0;
+  double start, stop;
+  int i;
+
+  start = gettime ();
+  for (i = 0; i < n; ++i)
+    pthread_create (&threads[i], NULL, worker, &nframes[i]);
+  for (i = 0; i < n; ++i)
+    {
+      pthread_join (threads[i], NULL);
+      total += nframes[i];
+    }
+  stop = gettime ();
+
+  printf ("validated backtrace, %2d thread%s: %9.3f nsec/frame "
+	  "(%ld frames)\n", n, n > 1 ? "s" : " ",
+	  1e9 * (stop - start) / total, total);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1)
+    {
+      nthreads = atoi (argv[1]);
+      if (argc > 2)
+	iterations = atol (argv[2]);
+    }
+  if (nthreads < 1)
+    panic ("need at least one thread\n");
+
+  if (unw_eh_elf_prepare_local () < 0)
+    panic ("unw_eh_elf_prepare_local() failed\n");
+
+  probing = 1;
+  recurse (1, 1);
+  probing = 0;
+  if (unw_eh_elf_register_jit (ra_lo - 1, ra_hi + 1, &frame_rule, 1) < 0)
+    panic ("unw_eh_elf_register_jit() failed\n");
+
+  measure (1);
+  if (nthreads > 1)
+    measure (nthreads);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Unwind through the frames of x64-test-dwarf-expressions.S, whose
+   caller's %rbx is described by a DW_CFA_expression.  The expression
+   is evaluated decoded from the expression cache, the first time and
+   once cached, and from memory when it is too long to be decoded; all
+   must find the same %rbx, before and after unw_flush_cache().  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libunwind.h>
+
+#define EXPR_MAGIC	0x5a5a1234
+
+typedef void (*expr_fn_t) (void);
+typedef void (*expr_inner_t) (expr_fn_t);
+
+extern void expr_outer (expr_fn_t fn, expr_inner_t inner);
+extern void expr_inner_short (expr_fn_t fn);
+extern void expr_inner_long (expr_fn_t fn);
+
+int verbose;
+int num_errors;
+unw_word_t inner_start;
+unw_word_t rbx;
+
+static void
+check_rbx (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  int ret;
+
+  rbx = 0;
+  unw_getcontext (&uc);
+  if ((ret = unw_init_local (&cursor, &uc)) < 0)
+    {
+      fprintf (stderr, "unw_init_local() failed: %d\n", ret);
+      ++num_errors;
+      return;
+    }
+
+  /* Into the inner function, then out of it with its expression.  */
+  if ((ret = unw_step (&cursor)) <= 0
+      || (ret = unw_get_proc_info (&cursor, &pi)) < 0
+      || pi.start_ip != inner_start)
+    {
+      fprintf (stderr, "did not step into the inner frame: %d\n", ret);
+      ++num_errors;
+      return;
+    }
+  if ((ret = unw_step (&cursor)) <= 0
+      || (ret = unw_get_reg (&cursor, UNW_X86_64_RBX, &rbx)) < 0)
+    {
+      fprintf (stderr, "did not step out of the inner frame: %d\n", ret);
+      ++num_errors;
+    }
+}
+
+static void
+check (const char *name, expr_inner_t inner)
+{
+  inner_start = (unw_word_t) inner;
+  expr_outer (check_rbx, inner);
+  if (verbose)
+    printf ("%s: rbx=0x%lx\n", name, (long) rbx);
+  if (rbx != EXPR_MAGIC)
+    {
+      fprintf (stderr, "%s: rbx is 0x%lx instead of 0x%lx\n",
+	       name, (long) rbx, (long) EXPR_MAGIC);
+      ++num_errors;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  int i;
+
+  verbose = (argc > 1);
+
+  for (i = 0; i < 3; ++i)
+    {
+      if (i == 2)
+	unw_flush_cache (unw_local_addr_space, 0, 0);
+      check ("decoded", expr_inner_short);
+      check ("from memory", expr_inner_long);
+    }
+
+  if (num_errors > 0)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", num_errors);
+      exit (-1);
+    }
+  if (verbose)
+    printf ("SUCCESS.\n");
+  return 0;
+}
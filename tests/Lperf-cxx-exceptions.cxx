@@ -0,0 +1,131 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Measure the throughput of C++ exceptions thrown through a number of
+   frames, with libunwind as the unwinder, when none of the frames have
+   anything to clean up, and when they all have a destructor to run.
+   Based on Ltest-cxx-exceptions.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <libunwind.h>
+#include "compiler.h"
+
+#define panic(args...)				\
+	{ fprintf (stderr, args); exit (-1); }
+
+static long iterations = 100000;
+static int maxlevel = 10;
+
+struct Test
+{
+  public: // --- ctor/dtor ---
+    Test() { ++counter_; }
+    ~Test() { -- counter_; }
+    Test(const Test&) { ++counter_; }
+
+  public: // --- static members ---
+    static int counter_;
+};
+
+int Test::counter_ = 0;
+
+static inline double
+gettime (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static int NOINLINE
+plain_thrower (int level)
+{
+  volatile int ret;
+
+  if (level == 0)
+    throw level;
+  ret = plain_thrower (level - 1);
+  return ret + 1;
+}
+
+// The destructor keeps the recursion from being a tail call
+static int NOINLINE
+cleanup_thrower (int level)
+{
+  Test t;
+
+  if (level == 0)
+    throw level;
+  return cleanup_thrower (level - 1) + 1;
+}
+
+static double
+doit (int (*thrower) (int), long count)
+{
+  double start, stop;
+  long i;
+
+  start = gettime ();
+  for (i = 0; i < count; ++i)
+    {
+      try {
+        thrower (maxlevel);
+      } catch (int) {
+      }
+    }
+  stop = gettime ();
+
+  if (Test::counter_ != 0)
+    panic ("Counter non-zero\n");
+  return (stop - start) / count;
+}
+
+int
+main (int argc, char **argv)
+{
+  double first, avg;
+  int i;
+
+  if (argc > 1)
+    {
+      iterations = atol (argv[1]);
+      if (argc > 2)
+        maxlevel = atol (argv[2]);
+    }
+  if (iterations <= 0 || maxlevel < 0)
+    panic ("usage: %s [iterations [depth]]\n", argv[0]);
+
+  for (i = 0; i < 2; ++i)
+    {
+      first = doit (i ? cleanup_thrower : plain_thrower, 1);
+      avg = doit (i ? cleanup_thrower : plain_thrower, iterations);
+
+      printf ("throw through %d frames%s: 1st=%9.3f avg=%9.3f nsec "
+              "(%9.3f nsec/frame)\n", maxlevel + 1,
+              i ? " with destructors" : "", 1e9*first, 1e9*avg,
+              1e9*avg/(maxlevel + 1));
+    }
+  return 0;
+}
@@ -0,0 +1,96 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Throw an exception in a shared object, close it, open another one at
+   the same address, and throw again in it: the handler and LSDA of the
+   first object must not be used for the second one, which has its
+   LSDA elsewhere (see cxx-dlclose-dso.cxx).  */
+
+#include <dlfcn.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#define panic(args...)				\
+	{ fprintf (stderr, args); exit (-1); }
+
+typedef int (*dso_catch_t) (int);
+
+static int verbose;
+
+/* Load PATH, check that its dso_catch() catches what it throws, and
+   return the base address it was loaded at.  */
+static unsigned long
+throw_in (const char *path, int round)
+{
+  struct link_map *map;
+  dso_catch_t dso_catch;
+  unsigned long base;
+  void *handle;
+  int ret;
+
+  if (!(handle = dlopen (path, RTLD_NOW | RTLD_LOCAL)))
+    panic ("cannot load %s: %s\n", path, dlerror ());
+  if (!(dso_catch = (dso_catch_t) dlsym (handle, "dso_catch"))
+      || dlinfo (handle, RTLD_DI_LINKMAP, &map) < 0)
+    panic ("cannot look up dso_catch() in %s\n", path);
+  base = map->l_addr;
+
+  ret = dso_catch (round);
+  if (verbose)
+    printf ("%s at 0x%lx: dso_catch (%d) = %d\n", path, base, round, ret);
+  if (ret != round + 1)
+    panic ("%s: dso_catch (%d) returned %d\n", path, round, ret);
+
+  dlclose (handle);
+  return base;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  unsigned long base_a, base_b;
+  Dl_info info;
+
+  verbose = (argc > 1);
+
+  /* Only meaningful if the C++ runtime throws through libunwind.  */
+  if (!dladdr (dlsym (RTLD_DEFAULT, "_Unwind_RaiseException"), &info)
+      || !strstr (info.dli_fname, "libunwind"))
+    {
+      printf ("_Unwind_RaiseException() is not libunwind's, skipping\n");
+      return 77;
+    }
+
+  base_a = throw_in (DSO_DIR "/libcxx-dlclose-a.so", 1);
+  base_b = throw_in (DSO_DIR "/libcxx-dlclose-b.so", 2);
+  if (verbose && base_a != base_b)
+    printf ("the objects were not loaded at the same address\n");
+  throw_in (DSO_DIR "/libcxx-dlclose-a.so", 3);
+
+  if (verbose)
+    printf ("SUCCESS\n");
+  return 0;
+}
@@ -0,0 +1,1401 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Compare the eh_elf unwinder with the DWARF one.  Each run unwinds a
+   stack of the given depth, every fourth frame of which goes through one
+   of the given number of copies of libbench-dso, and prints the result as
+   a JSON object on a single line.  Whether eh_elf is used is controlled by
+   the UNW_EH_ELF environment variable, see run-bench for the full matrix.
+
+   usage: bench-unwind MODE [-d depth] [-n dsos -l libbench-dso.so -t dir]
+			    [-S sites] [-c core] [-s samples [-k count] [-b]]
+			    [-T msecs] [-N] [-- command...]
+
+   -N turns the caching of unwind info off in the remote modes, so that
+   every step looks its procedure up again.
+
+   -S spreads the frames outside libbench-dso over the given number of
+   distinct call sites, up to MAX_SITES, rather than a single one.  Each
+   call site is a register state of its own to the DWARF unwinder, so
+   this measures how steps slow down once there are more than its cache
+   holds.
+
+   MODE is one of
+     local-step		 unw_init_local() and unw_step() to the end
+     local-backtrace	 unw_backtrace()
+     local-eh-elf-backtrace unw_eh_elf_backtrace()
+     ptrace		 unw_step() through a stopped child with libunwind-ptrace;
+			 also counts the syscalls it makes per unwind to read
+			 the child
+     replay		 unw_step() through a recorded stack sample, with the
+			 memory map given through UNW_EH_ELF_INIT_MMAP; with
+			 -s, through each sample of the given file in turn,
+			 or with -b, unw_backtrace_remote() instead
+     record		 write -k stack samples of the command, or else of a
+			 busy child at the given depth, to the file given
+			 with -s (for the replay mode)
+     crash		 dump core at the given depth (for the coredump mode)
+     coredump		 unw_step() through the core given with -c
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "compiler.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+
+#include <libunwind.h>
+#include <libunwind-coredump.h>
+#include <libunwind-ptrace.h>
+
+#define panic(args...)							\
+	do { fprintf (stderr, args); exit (-1); } while (0)
+
+#define MAX_DSOS	1024
+#define MAX_FRAMES	65536
+#define MAX_SITES	1024
+#define MIN_UNWINDS	10
+
+typedef int (*bench_dso_call_t) (int (*) (int, void *), int, void *);
+
+static int depth = 64;
+static int ndsos;
+static int nsites;
+static const char *dso_path;
+static const char *dso_dir;
+static const char *core_path;
+static const char *samples_path;
+static int nsamples = 200;
+static int use_backtrace;
+static char **command;
+static uint64_t bench_ns = 200 * 1000000ULL;
+static unw_caching_policy_t caching = UNW_CACHE_GLOBAL;
+
+static bench_dso_call_t dso_call[MAX_DSOS];
+static void *frames[MAX_FRAMES];
+
+/* What to do once the stack is `depth' frames deep.  */
+static int (*bottom) (void);
+
+struct measure
+  {
+    const char *bench;
+    long unwinds;		/* not counting the first one */
+    long frames;
+    uint64_t start_ns;
+    uint64_t first_init_ns;
+    uint64_t init_ns;
+    uint64_t unwind_ns;
+    int has_init;		/* the init is measured apart */
+    int any_depth;		/* the unwinds are of various depths */
+    int first_frames;		/* 0 until the first unwind */
+    long truncated;		/* unwinds which did not reach the end */
+    long syscalls;		/* at the end of the first unwind */
+    unw_eh_elf_stats_t stats;
+  };
+
+static struct measure m;
+static long rss_start_kb;
+
+/* Calls to ptrace() and process_vm_readv(), libunwind-ptrace's
+   included: these definitions interpose the C library's.  */
+static long syscalls;
+
+long
+ptrace (enum __ptrace_request request, ...)
+{
+  static long (*real_ptrace) (enum __ptrace_request, pid_t, void *, void *);
+  va_list ap;
+  pid_t pid;
+  void *addr, *data;
+
+  va_start (ap, request);
+  pid = va_arg (ap, pid_t);
+  addr = va_arg (ap, void *);
+  data = va_arg (ap, void *);
+  va_end (ap);
+
+  if (!real_ptrace)
+    real_ptrace = dlsym (RTLD_NEXT, "ptrace");
+  ++syscalls;
+  return real_ptrace (request, pid, addr, data);
+}
+
+ssize_t
+process_vm_readv (pid_t pid, const struct iovec *local_iov,
+		  unsigned long liovcnt, const struct iovec *remote_iov,
+		  unsigned long riovcnt, unsigned long flags)
+{
+  static ssize_t (*real_readv) (pid_t, const struct iovec *, unsigned long,
+				const struct iovec *, unsigned long,
+				unsigned long);
+
+  if (!real_readv)
+    real_readv = dlsym (RTLD_NEXT, "process_vm_readv");
+  ++syscalls;
+  return real_readv (pid, local_iov, liovcnt, remote_iov, riovcnt, flags);
+}
+
+static inline uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static long
+rss_kb (void)
+{
+  long size, resident = 0;
+  FILE *f = fopen ("/proc/self/statm", "r");
+
+  if (f)
+    {
+      if (fscanf (f, "%ld %ld", &size, &resident) != 2)
+	resident = 0;
+      fclose (f);
+    }
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static void
+measure_start (const char *bench, int has_init)
+{
+  memset (&m, 0, sizeof (m));
+  m.bench = bench;
+  m.has_init = has_init;
+  unw_eh_elf_get_stats (&m.stats);
+  m.start_ns = now_ns ();
+}
+
+/* Account for one unwind of `n' frames.  The first one also warms up the
+   caches, so only its init time is kept.  Returns nonzero once enough
+   unwinds were measured.  */
+static int
+measure_one (uint64_t init_ns, uint64_t unwind_ns, int n)
+{
+  if (n <= 1 && !m.any_depth)
+    panic ("FAILURE: %s only unwound %d frames\n", m.bench, n);
+
+  if (m.first_frames == 0)
+    {
+      m.first_init_ns = init_ns;
+      m.first_frames = n;
+      m.syscalls = syscalls;
+      m.start_ns = now_ns ();
+      return 0;
+    }
+  if (n != m.first_frames && !m.any_depth)
+    panic ("FAILURE: %s unwound %d frames, then %d\n",
+	   m.bench, m.first_frames, n);
+
+  m.init_ns += init_ns;
+  m.unwind_ns += unwind_ns;
+  m.frames += n;
+  ++m.unwinds;
+  return m.unwinds >= MIN_UNWINDS && now_ns () - m.start_ns >= bench_ns;
+}
+
+static void
+print_double (const char *name, double val, int valid)
+{
+  if (valid)
+    printf (", \"%s\": %.2f", name, val);
+  else
+    printf (", \"%s\": null", name);
+}
+
+static void
+measure_print (void)
+{
+  unw_eh_elf_stats_t stats;
+  struct rusage usage;
+  const char *env = getenv ("UNW_EH_ELF");
+  unsigned long steps;
+
+  unw_eh_elf_get_stats (&stats);
+  steps = stats.steps - m.stats.steps;
+  getrusage (RUSAGE_SELF, &usage);
+
+  printf ("{\"bench\": \"%s\", \"eh_elf\": %s, \"depth\": %d, \"dsos\": %d",
+	  m.bench, env && atoi (env) == 0 ? "false" : "true", depth, ndsos);
+  printf (", \"sites\": %d", nsites);
+  printf (", \"cache\": %s", caching == UNW_CACHE_NONE ? "false" : "true");
+  printf (", \"unwinds\": %ld, \"frames\": %ld", m.unwinds,
+	  m.frames / m.unwinds);
+  print_double ("unwinds_per_sec",
+		1e9 * m.unwinds / (m.init_ns + m.unwind_ns), 1);
+  print_double ("ns_per_frame", (double) m.unwind_ns / m.frames, 1);
+  print_double ("init_ns", (double) m.init_ns / m.unwinds, m.has_init);
+  print_double ("first_init_ns", m.first_init_ns, m.has_init);
+  print_double ("fallback_rate",
+		(double) (stats.fallbacks - m.stats.fallbacks) / steps,
+		steps > 0);
+  print_double ("syscalls",
+		(double) (syscalls - m.syscalls) / m.unwinds,
+		strcmp (m.bench, "ptrace") == 0);
+  print_double ("truncated", (double) m.truncated / m.unwinds, m.any_depth);
+  printf (", \"max_rss_kb\": %ld, \"rss_delta_kb\": %ld}\n",
+	  usage.ru_maxrss, rss_kb () - rss_start_kb);
+}
+
+/* Stack building.  */
+
+static int recurse (int level, void *arg);
+
+/* One call to recurse() per case, each with a different constant after
+   it, so that the compiler cannot merge the calls into one.  */
+#define SITE(i)								\
+	case (i):							\
+	  ret = recurse (level - 1, NULL);				\
+	  __asm__ __volatile__ ("" : : "i" (i));			\
+	  break;
+#define SITES_4(i)	SITE (i) SITE ((i) + 1) SITE ((i) + 2) SITE ((i) + 3)
+#define SITES_16(i)	SITES_4 (i) SITES_4 ((i) + 4) SITES_4 ((i) + 8)	\
+			SITES_4 ((i) + 12)
+#define SITES_64(i)	SITES_16 (i) SITES_16 ((i) + 16)		\
+			SITES_16 ((i) + 32) SITES_16 ((i) + 48)
+#define SITES_256(i)	SITES_64 (i) SITES_64 ((i) + 64)		\
+			SITES_64 ((i) + 128) SITES_64 ((i) + 192)
+
+/* Recurse from call site SITE of MAX_SITES.  */
+static int NOINLINE
+recurse_from (int level, int site)
+{
+  volatile int ret = 0;
+
+  switch (site)
+    {
+      SITES_256 (0)
+      SITES_256 (256)
+      SITES_256 (512)
+      SITES_256 (768)
+    }
+  return ret + 1;
+}
+
+static int NOINLINE
+recurse (int level, void *arg UNUSED)
+{
+  volatile int ret;
+
+  if (level <= 0)
+    return bottom ();
+
+  if (ndsos > 0 && level % 4 == 0)
+    ret = dso_call[(level / 4) % ndsos] (recurse, level - 1, NULL);
+  else if (nsites > 0)
+    ret = recurse_from (level, level % nsites);
+  else
+    ret = recurse (level - 1, NULL);
+  return ret + 1;
+}
+
+static void
+copy_file (const char *from, const char *to)
+{
+  char buf[65536];
+  ssize_t len;
+  int in, out;
+
+  in = open (from, O_RDONLY);
+  if (in < 0)
+    panic ("FAILURE: cannot open %s\n", from);
+  out = open (to, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  if (out < 0)
+    panic ("FAILURE: cannot create %s\n", to);
+  while ((len = read (in, buf, sizeof (buf))) > 0)
+    if (write (out, buf, len) != len)
+      panic ("FAILURE: cannot write %s\n", to);
+  close (in);
+  close (out);
+}
+
+/* Load `ndsos' distinct copies of the benchmark object.  */
+static void
+load_dsos (void)
+{
+  char path[PATH_MAX];
+  void *handle;
+  int i;
+
+  if (ndsos == 0)
+    return;
+  if (!dso_path || !dso_dir)
+    panic ("FAILURE: -n needs both -l and -t\n");
+
+  for (i = 0; i < ndsos; ++i)
+    {
+      snprintf (path, sizeof (path), "%s/libbench-dso-%d.so", dso_dir, i);
+      copy_file (dso_path, path);
+      handle = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+      if (!handle)
+	panic ("FAILURE: %s\n", dlerror ());
+      dso_call[i] = (bench_dso_call_t) dlsym (handle, "bench_dso_call");
+      if (!dso_call[i])
+	panic ("FAILURE: %s\n", dlerror ());
+    }
+}
+
+/* Unwinding through a cursor, the same way for every address space.  */
+
+static void
+unwind_remote (unw_addr_space_t as, void *arg)
+{
+  unw_cursor_t cursor;
+  uint64_t start, init;
+  int n, ret;
+
+  do
+    {
+      start = now_ns ();
+      if ((ret = unw_init_remote (&cursor, as, arg)) < 0)
+	panic ("FAILURE: unw_init_remote() returned %d\n", ret);
+      init = now_ns ();
+      n = 1;
+      while ((ret = unw_step (&cursor)) > 0)
+	++n;
+      if (ret < 0)
+	panic ("FAILURE: unw_step() returned %d\n", ret);
+    }
+  while (!measure_one (init - start, now_ns () - init, n));
+}
+
+/* Local unwinding.  */
+
+static int
+local_step (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  uint64_t start, init;
+  int n, ret;
+
+  measure_start ("local-step", 1);
+  do
+    {
+      start = now_ns ();
+      unw_getcontext (&uc);
+      if ((ret = unw_init_local (&cursor, &uc)) < 0)
+	panic ("FAILURE: unw_init_local() returned %d\n", ret);
+      init = now_ns ();
+      n = 1;
+      while ((ret = unw_step (&cursor)) > 0)
+	++n;
+      if (ret < 0)
+	panic ("FAILURE: unw_step() returned %d\n", ret);
+    }
+  while (!measure_one (init - start, now_ns () - init, n));
+  return 0;
+}
+
+static int
+local_backtrace (void)
+{
+  uint64_t start;
+  int n;
+
+  measure_start ("local-backtrace", 0);
+  do
+    {
+      start = now_ns ();
+      n = unw_backtrace (frames, MAX_FRAMES);
+    }
+  while (!measure_one (0, now_ns () - start, n));
+  return 0;
+}
+
+static int
+local_eh_elf_backtrace (void)
+{
+  unw_context_t uc;
+  uint64_t start;
+  int n;
+
+  measure_start ("local-eh-elf-backtrace", 0);
+  do
+    {
+      start = now_ns ();
+      unw_getcontext (&uc);
+      n = unw_eh_elf_backtrace (&uc, frames, MAX_FRAMES);
+    }
+  while (!measure_one (0, now_ns () - start, n));
+  return 0;
+}
+
+static void
+bench_local (int (*fn) (void))
+{
+  bottom = fn;
+  recurse (depth, NULL);
+}
+
+/* Remote unwinding of a stopped child.  */
+
+static int
+stop_child (void)
+{
+  raise (SIGSTOP);
+  _exit (0);
+}
+
+static void
+bench_ptrace (void)
+{
+  unw_addr_space_t as;
+  void *ui;
+  pid_t pid;
+  int status;
+
+  pid = fork ();
+  if (pid < 0)
+    panic ("FAILURE: fork() failed\n");
+  if (pid == 0)
+    {
+      if (ptrace (PTRACE_TRACEME, 0, 0, 0) < 0)
+	_exit (1);
+      bottom = stop_child;
+      recurse (depth, NULL);
+      _exit (0);
+    }
+
+  if (waitpid (pid, &status, 0) < 0 || !WIFSTOPPED (status))
+    panic ("FAILURE: the child did not stop\n");
+
+  as = unw_create_addr_space (&_UPT_accessors, 0);
+  if (!as)
+    panic ("FAILURE: unw_create_addr_space() failed\n");
+  unw_set_caching_policy (as, caching);
+  ui = _UPT_create (pid);
+
+  measure_start ("ptrace", 1);
+  unwind_remote (as, ui);
+
+  _UPT_destroy (ui);
+  unw_destroy_addr_space (as);
+  kill (pid, SIGKILL);
+  waitpid (pid, &status, 0);
+}
+
+/* Unwinding of a core dump.  */
+
+static int
+crash (void)
+{
+  abort ();
+}
+
+static void
+bench_crash (void)
+{
+  struct rlimit rl;
+
+  if (getrlimit (RLIMIT_CORE, &rl) == 0)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit (RLIMIT_CORE, &rl);
+    }
+  bottom = crash;
+  recurse (depth, NULL);
+}
+
+static void
+bench_coredump (void)
+{
+  unw_addr_space_t as;
+  struct UCD_info *ui;
+
+  if (!core_path)
+    panic ("FAILURE: coredump needs -c\n");
+
+  as = unw_create_addr_space (&_UCD_accessors, 0);
+  if (!as)
+    panic ("FAILURE: unw_create_addr_space() failed\n");
+  unw_set_caching_policy (as, caching);
+  ui = _UCD_create (core_path);
+  if (!ui)
+    panic ("FAILURE: cannot load %s\n", core_path);
+
+  measure_start ("coredump", 1);
+  unwind_remote (as, ui);
+
+  _UCD_destroy (ui);
+  unw_destroy_addr_space (as);
+}
+
+/* Replay of a stack sample, the way a sampling profiler records them: the
+   registers, a copy of the stack from the stack pointer up, and the memory
+   map.  Everything else is read from the objects mapped in this process,
+   which are the same ones, or for samples of other processes, from the
+   object files mapped in them, which must not have changed since.  */
+
+/* What an object file of a sampled process has at the addresses of one
+   of its mappings, with the .eh_frame_hdr table of the object.  */
+struct sample_image
+  {
+    const char *data;		/* the file, from the mapping's offset */
+    size_t size;
+    unw_dyn_info_t di;		/* format -1 if there is no table */
+  };
+
+struct sample
+  {
+    ucontext_t uc;
+    unw_word_t stack_start;
+    size_t stack_size;
+    char *stack;
+    unw_mmap_entry_t *maps;
+    size_t nmaps;
+    struct sample_image *images; /* one per map, NULL in this process */
+  };
+
+static struct sample sample;
+
+/* A file of samples, as the record mode writes them, is the header, the
+   maps, then the samples, all in the byte order of the machine.  Paths
+   and stacks are padded to 8 bytes, for everything to stay aligned.  */
+
+#define SAMPLE_FILE_MAGIC	"UNWSMPL1"
+
+struct sample_file_header
+  {
+    char magic[8];
+    uint32_t nmaps;
+    uint32_t nsamples;
+  };
+
+struct sample_file_map		/* followed by the path */
+  {
+    uint64_t start, end, offset;
+    uint32_t path_len;		/* with its final null */
+    uint32_t reserved;
+  };
+
+struct sample_file_sample	/* followed by the stack */
+  {
+    uint64_t regs[UNW_X86_64_RIP + 1];
+    uint64_t stack_start;
+    uint32_t stack_size;
+    uint32_t reserved;
+  };
+
+#define SAMPLE_PAD(len)		(((len) + 7) & ~(size_t) 7)
+#define SAMPLE_STACK_MAX	65536
+
+#define DW_EH_PE_udata4		0x03
+#define DW_EH_PE_sdata4		0x0b
+#define DW_EH_PE_datarel	0x30
+
+/* libunwind's search of the .eh_frame_hdr tables of remote processes,
+   which libunwind-ptrace and libunwind-coredump use as well.  */
+extern int UNW_OBJ (dwarf_search_unwind_table) (unw_addr_space_t, unw_word_t,
+						  unw_dyn_info_t *,
+						  unw_proc_info_t *, int,
+						  void *);
+
+static const int sample_gregs[] =
+  {
+    [UNW_X86_64_RAX] = REG_RAX, [UNW_X86_64_RDX] = REG_RDX,
+    [UNW_X86_64_RCX] = REG_RCX, [UNW_X86_64_RBX] = REG_RBX,
+    [UNW_X86_64_RSI] = REG_RSI, [UNW_X86_64_RDI] = REG_RDI,
+    [UNW_X86_64_RBP] = REG_RBP, [UNW_X86_64_RSP] = REG_RSP,
+    [UNW_X86_64_R8] = REG_R8, [UNW_X86_64_R9] = REG_R9,
+    [UNW_X86_64_R10] = REG_R10, [UNW_X86_64_R11] = REG_R11,
+    [UNW_X86_64_R12] = REG_R12, [UNW_X86_64_R13] = REG_R13,
+    [UNW_X86_64_R14] = REG_R14, [UNW_X86_64_R15] = REG_R15,
+    [UNW_X86_64_RIP] = REG_RIP
+  };
+
+/* Read the file-backed mappings of this process, and the end of its
+   stack.  */
+static unw_word_t
+read_maps (void)
+{
+  unsigned long start, end, offset;
+  unw_word_t stack_end = 0;
+  char line[PATH_MAX + 128], path[PATH_MAX];
+  size_t capacity = 0;
+  FILE *f;
+
+  f = fopen ("/proc/self/maps", "r");
+  if (!f)
+    panic ("FAILURE: cannot read /proc/self/maps\n");
+  while (fgets (line, sizeof (line), f))
+    {
+      path[0] = '\0';
+      if (sscanf (line, "%lx-%lx %*s %lx %*s %*s %s",
+		  &start, &end, &offset, path) < 3)
+	continue;
+      if (strcmp (path, "[stack]") == 0)
+	stack_end = end;
+      if (path[0] != '/')
+	continue;
+
+      if (sample.nmaps == capacity)
+	{
+	  capacity = capacity ? 2 * capacity : 64;
+	  sample.maps = realloc (sample.maps, capacity * sizeof (*sample.maps));
+	  if (!sample.maps)
+	    panic ("FAILURE: out of memory\n");
+	}
+      sample.maps[sample.nmaps].offset = start - offset;
+      sample.maps[sample.nmaps].object_name = strdup (path);
+      sample.maps[sample.nmaps].beg_ip = start;
+      sample.maps[sample.nmaps].end_ip = end;
+      ++sample.nmaps;
+    }
+  fclose (f);
+  return stack_end;
+}
+
+static int
+record_sample (void)
+{
+  unw_word_t stack_end;
+
+  unw_getcontext (&sample.uc);
+  /* Everything above the stack pointer stays as it is until we return.  */
+  sample.stack_start = sample.uc.uc_mcontext.gregs[REG_RSP];
+  stack_end = read_maps ();
+  if (stack_end <= sample.stack_start)
+    panic ("FAILURE: cannot find the stack\n");
+
+  sample.stack_size = stack_end - sample.stack_start;
+  sample.stack = malloc (sample.stack_size);
+  if (!sample.stack)
+    panic ("FAILURE: out of memory\n");
+  memcpy (sample.stack, (void *) sample.stack_start, sample.stack_size);
+  return 0;
+}
+
+/* Read LEN bytes at ADDR in the sampled process S.  */
+static int
+replay_read (struct sample *s, unw_word_t addr, void *buf, size_t len)
+{
+  const struct sample_image *image;
+  size_t i;
+
+  if (addr >= s->stack_start && addr + len <= s->stack_start + s->stack_size)
+    {
+      memcpy (buf, s->stack + (addr - s->stack_start), len);
+      return 0;
+    }
+  for (i = 0; i < s->nmaps; ++i)
+    if (addr >= s->maps[i].beg_ip && addr + len <= s->maps[i].end_ip)
+      {
+	if (!s->images)
+	  {
+	    memcpy (buf, (void *) addr, len);
+	    return 0;
+	  }
+	image = &s->images[i];
+	if (addr - s->maps[i].beg_ip + len > image->size)
+	  break;		/* past the end of the file */
+	memcpy (buf, image->data + (addr - s->maps[i].beg_ip), len);
+	return 0;
+      }
+  return -UNW_EINVAL;
+}
+
+static int
+replay_access_mem (unw_addr_space_t as UNUSED, unw_word_t addr,
+		   unw_word_t *val, int write, void *arg)
+{
+  if (write)
+    return -UNW_EINVAL;
+  return replay_read (arg, addr, val, sizeof (*val));
+}
+
+static int
+replay_access_mem_range (unw_addr_space_t as UNUSED, unw_word_t addr,
+			 void *buf, size_t len, void *arg)
+{
+  return replay_read (arg, addr, buf, len);
+}
+
+static int
+replay_access_reg (unw_addr_space_t as UNUSED, unw_regnum_t reg,
+		   unw_word_t *val, int write, void *arg)
+{
+  struct sample *s = arg;
+
+  if (write || reg < 0 || reg > UNW_X86_64_RIP)
+    return -UNW_EBADREG;
+  *val = s->uc.uc_mcontext.gregs[sample_gregs[reg]];
+  return 0;
+}
+
+static void
+replay_get_mmap (unw_mmap_entry_t **entries, size_t *count, void *arg)
+{
+  struct sample *s = arg;
+
+  *entries = malloc (s->nmaps * sizeof (**entries));
+  memcpy (*entries, s->maps, s->nmaps * sizeof (**entries));
+  *count = s->nmaps;
+}
+
+/* The unwind info of samples of other processes is looked up in the
+   .eh_frame_hdr tables of their object files.  */
+static int
+replay_find_proc_info (unw_addr_space_t as, unw_word_t ip,
+		       unw_proc_info_t *pi, int need_unwind_info, void *arg)
+{
+  struct sample *s = arg;
+  size_t i;
+
+  for (i = 0; i < s->nmaps; ++i)
+    if (ip >= s->maps[i].beg_ip && ip < s->maps[i].end_ip)
+      {
+	if (s->images[i].di.format == -1)
+	  break;
+	return UNW_OBJ (dwarf_search_unwind_table) (as, ip, &s->images[i].di,
+						    pi, need_unwind_info, arg);
+      }
+  return -UNW_ENOINFO;
+}
+
+static void
+replay_put_unwind_info (unw_addr_space_t as UNUSED,
+			unw_proc_info_t *pi UNUSED, void *arg UNUSED)
+{
+}
+
+static int
+replay_get_dyn_info_list_addr (unw_addr_space_t as UNUSED,
+			       unw_word_t *dyn_info_list_addr UNUSED,
+			       void *arg UNUSED)
+{
+  return -UNW_ENOINFO;
+}
+
+/* Map the object file PATH, unless it was already for one of the first
+   N maps of S.  */
+static const char *
+map_object (struct sample *s, size_t n, const char *path, size_t *sizep)
+{
+  struct stat st;
+  void *data;
+  size_t i;
+  int fd;
+
+  for (i = 0; i < n; ++i)
+    if (strcmp (s->maps[i].object_name, path) == 0)
+      {
+	*sizep = s->images[i].size + (s->maps[i].beg_ip - s->maps[i].offset);
+	return s->images[i].data - (s->maps[i].beg_ip - s->maps[i].offset);
+      }
+
+  if ((fd = open (path, O_RDONLY)) < 0 || fstat (fd, &st) < 0)
+    panic ("FAILURE: cannot open %s\n", path);
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    panic ("FAILURE: cannot map %s\n", path);
+  close (fd);
+  *sizep = st.st_size;
+  return data;
+}
+
+/* Find the .eh_frame_hdr table of the object FILE of SIZE bytes, mapped
+   at [START, END) from OFFSET, for IMAGE.  */
+static void
+find_table (struct sample_image *image, const char *file, size_t size,
+	    unw_word_t start, unw_word_t end, unw_word_t offset)
+{
+  const ElfW(Ehdr) *ehdr = (const ElfW(Ehdr) *) file;
+  const ElfW(Phdr) *phdr, *load = NULL, *hdr = NULL;
+  const unsigned char *table;
+  unw_word_t bias;
+  int i;
+
+  image->di.format = -1;
+  if (size < sizeof (*ehdr) || memcmp (ehdr->e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr->e_phoff + ehdr->e_phnum * sizeof (*phdr) > size)
+    return;
+
+  phdr = (const ElfW(Phdr) *) (file + ehdr->e_phoff);
+  for (i = 0; i < ehdr->e_phnum; ++i)
+    if (phdr[i].p_type == PT_LOAD && phdr[i].p_offset <= offset
+	&& offset < phdr[i].p_offset + phdr[i].p_filesz)
+      load = &phdr[i];
+    else if (phdr[i].p_type == PT_GNU_EH_FRAME)
+      hdr = &phdr[i];
+  if (!load || !hdr || hdr->p_offset + 12 > size)
+    return;
+
+  /* The usual table: version 1, a 4-byte entry count, then the entries
+     as pairs of 4-byte offsets from the table.  */
+  table = (const unsigned char *) file + hdr->p_offset;
+  if (table[0] != 1 || table[2] != DW_EH_PE_udata4
+      || table[3] != (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+    return;
+
+  bias = start - (load->p_vaddr + (offset - load->p_offset));
+  image->di.format = UNW_INFO_FORMAT_REMOTE_TABLE;
+  image->di.start_ip = start;
+  image->di.end_ip = end;
+  image->di.u.rti.segbase = bias + hdr->p_vaddr;
+  image->di.u.rti.table_data = bias + hdr->p_vaddr + 12;
+  image->di.u.rti.table_len = *(const uint32_t *) (table + 8)
+			      * 8 / sizeof (unw_word_t);
+}
+
+/* Read the samples of the file at samples_path, and the object files
+   they need.  Returns them, and their number in *NP.  */
+static struct sample *
+read_samples (int *np)
+{
+  const struct sample_file_header *header;
+  const struct sample_file_map *map;
+  const struct sample_file_sample *rec;
+  struct sample maps, *samples;
+  const char *p, *end, *file;
+  struct stat st;
+  size_t i, size;
+  int fd, n, reg;
+
+  if ((fd = open (samples_path, O_RDONLY)) < 0 || fstat (fd, &st) < 0)
+    panic ("FAILURE: cannot open %s\n", samples_path);
+  p = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    panic ("FAILURE: cannot map %s\n", samples_path);
+  close (fd);
+  end = p + st.st_size;
+
+  header = (const struct sample_file_header *) p;
+  if ((size_t) st.st_size < sizeof (*header)
+      || memcmp (header->magic, SAMPLE_FILE_MAGIC, sizeof (header->magic)))
+    panic ("FAILURE: %s is not a sample file\n", samples_path);
+  p += sizeof (*header);
+
+  /* Every map and sample takes at least its fixed part: do not believe
+     counts that the file cannot hold.  */
+  if (header->nmaps > (size_t) (end - p) / sizeof (*map)
+      || header->nsamples > (size_t) (end - p) / sizeof (*rec))
+    panic ("FAILURE: %s is truncated\n", samples_path);
+
+  memset (&maps, 0, sizeof (maps));
+  maps.nmaps = header->nmaps;
+  maps.maps = calloc (maps.nmaps, sizeof (*maps.maps));
+  maps.images = calloc (maps.nmaps, sizeof (*maps.images));
+  samples = calloc (header->nsamples, sizeof (*samples));
+  if (!maps.maps || !maps.images || !samples)
+    panic ("FAILURE: out of memory\n");
+
+  for (i = 0; i < maps.nmaps; ++i)
+    {
+      map = (const struct sample_file_map *) p;
+      if ((size_t) (end - p) < sizeof (*map)
+	  || (size_t) (end - p) - sizeof (*map) < SAMPLE_PAD (map->path_len))
+	panic ("FAILURE: %s is truncated\n", samples_path);
+      if (map->path_len == 0 || ((char *) (map + 1))[map->path_len - 1])
+	panic ("FAILURE: %s is corrupt\n", samples_path);
+      p += sizeof (*map) + SAMPLE_PAD (map->path_len);
+      maps.maps[i].object_name = (char *) (map + 1);
+      maps.maps[i].beg_ip = map->start;
+      maps.maps[i].end_ip = map->end;
+      maps.maps[i].offset = map->start - map->offset;
+
+      file = map_object (&maps, i, maps.maps[i].object_name, &size);
+      maps.images[i].data = file + map->offset;
+      maps.images[i].size = map->offset < size ? size - map->offset : 0;
+      find_table (&maps.images[i], file, size, map->start, map->end,
+		  map->offset);
+    }
+
+  for (n = 0; n < (int) header->nsamples; ++n)
+    {
+      rec = (const struct sample_file_sample *) p;
+      if ((size_t) (end - p) < sizeof (*rec)
+	  || (size_t) (end - p) - sizeof (*rec) < SAMPLE_PAD (rec->stack_size))
+	panic ("FAILURE: %s is truncated\n", samples_path);
+      p += sizeof (*rec) + SAMPLE_PAD (rec->stack_size);
+      samples[n] = maps;
+      for (reg = 0; reg <= UNW_X86_64_RIP; ++reg)
+	samples[n].uc.uc_mcontext.gregs[sample_gregs[reg]] = rec->regs[reg];
+      samples[n].stack_start = rec->stack_start;
+      samples[n].stack_size = rec->stack_size;
+      samples[n].stack = (char *) (rec + 1);
+    }
+  *np = n;
+  return samples;
+}
+
+/* Unwind sample S through AS, and return how many frames it has, or
+   minus that many if its stack copy ended first.  */
+static int
+unwind_sample (unw_addr_space_t as, struct sample *s, uint64_t *init_ns,
+	       uint64_t *unwind_ns)
+{
+  unw_cursor_t cursor;
+  uint64_t start, init;
+  int n, ret;
+
+  start = now_ns ();
+  if ((ret = unw_init_remote (&cursor, as, s)) < 0)
+    panic ("FAILURE: unw_init_remote() returned %d\n", ret);
+  init = now_ns ();
+  if (use_backtrace)
+    n = ret = unw_backtrace_remote (&cursor, frames, MAX_FRAMES);
+  else
+    {
+      n = 1;
+      while ((ret = unw_step (&cursor)) > 0)
+	++n;
+    }
+  *unwind_ns = now_ns () - init;
+  *init_ns = init - start;
+  return ret < 0 ? -n : n;
+}
+
+static void
+bench_replay_samples (void)
+{
+  unw_accessors_t acc;
+  unw_addr_space_t as;
+  struct sample *samples;
+  uint64_t init_ns, unwind_ns;
+  int i, n, nframes;
+
+  samples = read_samples (&n);
+  if (n == 0)
+    panic ("FAILURE: no samples in %s\n", samples_path);
+
+  memset (&acc, 0, sizeof (acc));
+  acc.find_proc_info = replay_find_proc_info;
+  acc.put_unwind_info = replay_put_unwind_info;
+  acc.get_dyn_info_list_addr = replay_get_dyn_info_list_addr;
+  acc.access_mem = replay_access_mem;
+  acc.access_mem_range = replay_access_mem_range;
+  acc.access_reg = replay_access_reg;
+  acc.eh_elf_init.init_mode = UNW_EH_ELF_INIT_MMAP;
+  acc.eh_elf_init.init_data.get_mmap = replay_get_mmap;
+
+  as = unw_create_addr_space (&acc, 0);
+  if (!as)
+    panic ("FAILURE: unw_create_addr_space() failed\n");
+  unw_set_caching_policy (as, caching);
+
+  /* A first pass over the samples warms the caches up.  */
+  for (i = 0; i < n; ++i)
+    unwind_sample (as, &samples[i], &init_ns, &unwind_ns);
+
+  measure_start (use_backtrace ? "replay-samples-backtrace"
+		 : "replay-samples", 1);
+  m.any_depth = 1;
+  i = 0;
+  do
+    {
+      nframes = unwind_sample (as, &samples[i], &init_ns, &unwind_ns);
+      if (nframes < 0 && m.first_frames)
+	++m.truncated;
+      i = (i + 1) % n;
+    }
+  while (!measure_one (init_ns, unwind_ns, abs (nframes)));
+
+  unw_destroy_addr_space (as);
+}
+
+static void
+bench_replay (void)
+{
+  unw_accessors_t acc;
+  unw_addr_space_t as;
+
+  if (samples_path)
+    {
+      bench_replay_samples ();
+      return;
+    }
+
+  bottom = record_sample;
+  recurse (depth, NULL);
+
+  /* Find the unwind info the same way as local unwinding does.  */
+  acc = *unw_get_accessors (unw_local_addr_space);
+  acc.access_mem = replay_access_mem;
+  acc.access_reg = replay_access_reg;
+  acc.access_fpreg = NULL;
+  acc.resume = NULL;
+  acc.eh_elf_init.init_mode = UNW_EH_ELF_INIT_MMAP;
+  acc.eh_elf_init.init_data.get_mmap = replay_get_mmap;
+
+  as = unw_create_addr_space (&acc, 0);
+  if (!as)
+    panic ("FAILURE: unw_create_addr_space() failed\n");
+  unw_set_caching_policy (as, caching);
+
+  measure_start ("replay", 1);
+  unwind_remote (as, &sample);
+
+  unw_destroy_addr_space (as);
+}
+
+/* Recording of stack samples of another process, for the replay mode:
+   it is interrupted about every millisecond, and its registers, the top of
+   its stack and its file mappings are taken down.  */
+
+struct recorded_sample
+  {
+    struct sample_file_sample rec;
+    char *stack;
+  };
+
+struct recorded_map
+  {
+    struct sample_file_map map;
+    char *path;
+  };
+
+static struct recorded_map *recorded_maps;
+static size_t nrecorded_maps;
+
+static int
+compare_ints (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/* The work of the child sampled by default.  */
+static int
+spin (void)
+{
+  char buf[32];
+  int v[64], i;
+
+  for (;;)
+    {
+      for (i = 0; i < 64; ++i)
+	v[i] = rand ();
+      qsort (v, 64, sizeof (v[0]), compare_ints);
+      snprintf (buf, sizeof (buf), "%g", (double) v[0]);
+    }
+  return 0;
+}
+
+/* Add the file mappings of PID not recorded yet.  Returns the end of the
+   mapping at SP, or 0.  */
+static unw_word_t
+record_maps (pid_t pid, unw_word_t sp)
+{
+  unsigned long start, end, offset;
+  unw_word_t stack_end = 0;
+  char line[PATH_MAX + 128], path[PATH_MAX];
+  size_t i, capacity = nrecorded_maps;
+  struct recorded_map *r;
+  FILE *f;
+
+  snprintf (path, sizeof (path), "/proc/%d/maps", (int) pid);
+  f = fopen (path, "r");
+  if (!f)
+    panic ("FAILURE: cannot read %s\n", path);
+  while (fgets (line, sizeof (line), f))
+    {
+      path[0] = '\0';
+      if (sscanf (line, "%lx-%lx %*s %lx %*s %*s %s",
+		  &start, &end, &offset, path) < 3)
+	continue;
+      if (sp >= start && sp < end)
+	stack_end = end;
+      if (path[0] != '/')
+	continue;
+
+      for (i = 0; i < nrecorded_maps; ++i)
+	{
+	  r = &recorded_maps[i];
+	  if (r->map.start == start && r->map.end == end
+	      && r->map.offset == offset && strcmp (r->path, path) == 0)
+	    break;
+	}
+      if (i < nrecorded_maps)
+	continue;
+
+      if (nrecorded_maps == capacity)
+	{
+	  capacity = capacity ? 2 * capacity : 64;
+	  recorded_maps = realloc (recorded_maps,
+				   capacity * sizeof (*recorded_maps));
+	  if (!recorded_maps)
+	    panic ("FAILURE: out of memory\n");
+	}
+      r = &recorded_maps[nrecorded_maps++];
+      memset (&r->map, 0, sizeof (r->map));
+      r->map.start = start;
+      r->map.end = end;
+      r->map.offset = offset;
+      r->map.path_len = strlen (path) + 1;
+      r->path = strdup (path);
+    }
+  fclose (f);
+  return stack_end;
+}
+
+/* Take a sample of the stopped child PID into S.  Returns 0 on success.  */
+static int
+record_one (pid_t pid, struct recorded_sample *s)
+{
+  static const int ureg[] =
+    {
+      [UNW_X86_64_RAX] = offsetof (struct user_regs_struct, rax),
+      [UNW_X86_64_RDX] = offsetof (struct user_regs_struct, rdx),
+      [UNW_X86_64_RCX] = offsetof (struct user_regs_struct, rcx),
+      [UNW_X86_64_RBX] = offsetof (struct user_regs_struct, rbx),
+      [UNW_X86_64_RSI] = offsetof (struct user_regs_struct, rsi),
+      [UNW_X86_64_RDI] = offsetof (struct user_regs_struct, rdi),
+      [UNW_X86_64_RBP] = offsetof (struct user_regs_struct, rbp),
+      [UNW_X86_64_RSP] = offsetof (struct user_regs_struct, rsp),
+      [UNW_X86_64_R8] = offsetof (struct user_regs_struct, r8),
+      [UNW_X86_64_R9] = offsetof (struct user_regs_struct, r9),
+      [UNW_X86_64_R10] = offsetof (struct user_regs_struct, r10),
+      [UNW_X86_64_R11] = offsetof (struct user_regs_struct, r11),
+      [UNW_X86_64_R12] = offsetof (struct user_regs_struct, r12),
+      [UNW_X86_64_R13] = offsetof (struct user_regs_struct, r13),
+      [UNW_X86_64_R14] = offsetof (struct user_regs_struct, r14),
+      [UNW_X86_64_R15] = offsetof (struct user_regs_struct, r15),
+      [UNW_X86_64_RIP] = offsetof (struct user_regs_struct, rip)
+    };
+  struct user_regs_struct regs;
+  struct iovec local, remote;
+  unw_word_t sp, stack_end;
+  int reg;
+
+  if (ptrace (PTRACE_GETREGS, pid, 0, &regs) < 0)
+    return -1;
+  memset (&s->rec, 0, sizeof (s->rec));
+  for (reg = 0; reg <= UNW_X86_64_RIP; ++reg)
+    s->rec.regs[reg] = *(unsigned long long *) ((char *) &regs + ureg[reg]);
+
+  sp = regs.rsp;
+  stack_end = record_maps (pid, sp);
+  if (stack_end <= sp)
+    return -1;
+  s->rec.stack_start = sp;
+  s->rec.stack_size = stack_end - sp < SAMPLE_STACK_MAX
+		      ? stack_end - sp : SAMPLE_STACK_MAX;
+  s->stack = calloc (1, SAMPLE_PAD (s->rec.stack_size));
+  if (!s->stack)
+    panic ("FAILURE: out of memory\n");
+
+  local.iov_base = s->stack;
+  local.iov_len = s->rec.stack_size;
+  remote.iov_base = (void *) sp;
+  remote.iov_len = s->rec.stack_size;
+  if (process_vm_readv (pid, &local, 1, &remote, 1, 0)
+      != (ssize_t) s->rec.stack_size)
+    {
+      free (s->stack);
+      return -1;
+    }
+  return 0;
+}
+
+static void
+write_samples (const struct recorded_sample *samples, int n)
+{
+  static const char zeros[8];
+  struct sample_file_header header;
+  size_t i;
+  FILE *f;
+  int k;
+
+  f = fopen (samples_path, "w");
+  if (!f)
+    panic ("FAILURE: cannot create %s\n", samples_path);
+
+  memcpy (header.magic, SAMPLE_FILE_MAGIC, sizeof (header.magic));
+  header.nmaps = nrecorded_maps;
+  header.nsamples = n;
+  fwrite (&header, sizeof (header), 1, f);
+  for (i = 0; i < nrecorded_maps; ++i)
+    {
+      fwrite (&recorded_maps[i].map, sizeof (recorded_maps[i].map), 1, f);
+      fwrite (recorded_maps[i].path, recorded_maps[i].map.path_len, 1, f);
+      fwrite (zeros, SAMPLE_PAD (recorded_maps[i].map.path_len)
+		     - recorded_maps[i].map.path_len, 1, f);
+    }
+  for (k = 0; k < n; ++k)
+    {
+      fwrite (&samples[k].rec, sizeof (samples[k].rec), 1, f);
+      fwrite (samples[k].stack, SAMPLE_PAD (samples[k].rec.stack_size), 1, f);
+    }
+  if (fclose (f) != 0)
+    panic ("FAILURE: cannot write %s\n", samples_path);
+}
+
+static void
+bench_record (void)
+{
+  struct recorded_sample *samples;
+  int n = 0, status, sig, fds[2];
+  pid_t pid;
+  char go;
+
+  if (!samples_path)
+    panic ("FAILURE: record needs -s\n");
+  samples = calloc (nsamples, sizeof (*samples));
+  if (!samples)
+    panic ("FAILURE: out of memory\n");
+
+  /* The child is seized rather than traced from its start: seized, it
+     does not stop at its exec, where being interrupted as well would keep
+     it stopped.  It waits on the pipe until then.  */
+  if (pipe (fds) < 0)
+    panic ("FAILURE: pipe() failed\n");
+  pid = fork ();
+  if (pid < 0)
+    panic ("FAILURE: fork() failed\n");
+  if (pid == 0)
+    {
+      close (fds[1]);
+      if (read (fds[0], &go, 1) != 0)
+	_exit (1);
+      close (fds[0]);
+      if (command)
+	{
+	  execvp (command[0], command);
+	  _exit (1);
+	}
+      bottom = spin;
+      recurse (depth, NULL);
+      _exit (0);
+    }
+  close (fds[0]);
+  if (ptrace (PTRACE_SEIZE, pid, 0, PTRACE_O_EXITKILL) < 0)
+    panic ("FAILURE: cannot seize the child\n");
+  close (fds[1]);
+
+  while (n < nsamples)
+    {
+      usleep (1000);
+      ptrace (PTRACE_INTERRUPT, pid, 0, 0);
+      if (waitpid (pid, &status, 0) < 0 || !WIFSTOPPED (status))
+	break;
+
+      /* Signals of the child's own go through.  */
+      sig = WSTOPSIG (status);
+      if (status >> 16 == PTRACE_EVENT_STOP)
+	{
+	  if (record_one (pid, &samples[n]) == 0)
+	    ++n;
+	  sig = 0;
+	}
+      ptrace (PTRACE_CONT, pid, 0, sig);
+    }
+  if (n < nsamples)
+    panic ("FAILURE: the child ended after %d samples\n", n);
+
+  kill (pid, SIGKILL);
+  waitpid (pid, &status, 0);
+  write_samples (samples, n);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *mode;
+  int opt;
+
+  rss_start_kb = rss_kb ();
+
+  while ((opt = getopt (argc, argv, "bc:d:k:l:n:Ns:S:t:T:")) != -1)
+    switch (opt)
+      {
+      case 'b': use_backtrace = 1; break;
+      case 'c': core_path = optarg; break;
+      case 'd': depth = atoi (optarg); break;
+      case 'k': nsamples = atoi (optarg); break;
+      case 'l': dso_path = optarg; break;
+      case 'n': ndsos = atoi (optarg); break;
+      case 'N': caching = UNW_CACHE_NONE; break;
+      case 's': samples_path = optarg; break;
+      case 'S': nsites = atoi (optarg); break;
+      case 't': dso_dir = optarg; break;
+      case 'T': bench_ns = atol (optarg) * 1000000ULL; break;
+      default:
+	panic ("usage: %s MODE [-d depth] [-n dsos -l dso -t dir] "
+	       "[-S sites] [-c core] [-s samples [-k count] [-b]] "
+	       "[-T msecs] [-N] [-- command...]\n", argv[0]);
+      }
+  if (optind >= argc)
+    panic ("usage: %s MODE [options]\n", argv[0]);
+  mode = argv[optind];
+  if (optind + 1 < argc)
+    command = argv + optind + 1;
+  if (depth < 0 || depth > MAX_FRAMES / 2 || ndsos < 0 || ndsos > MAX_DSOS
+      || nsites < 0 || nsites > MAX_SITES || nsamples <= 0)
+    panic ("FAILURE: bad depth, number of objects, of sites or of "
+	   "samples\n");
+
+  if (strcmp (mode, "coredump") != 0 && !command)
+    load_dsos ();
+
+  if (strcmp (mode, "local-step") == 0)
+    bench_local (local_step);
+  else if (strcmp (mode, "local-backtrace") == 0)
+    bench_local (local_backtrace);
+  else if (strcmp (mode, "local-eh-elf-backtrace") == 0)
+    bench_local (local_eh_elf_backtrace);
+  else if (strcmp (mode, "ptrace") == 0)
+    bench_ptrace ();
+  else if (strcmp (mode, "replay") == 0)
+    bench_replay ();
+  else if (strcmp (mode, "record") == 0)
+    {
+      bench_record ();
+      return 0;
+    }
+  else if (strcmp (mode, "crash") == 0)
+    bench_crash ();
+  else if (strcmp (mode, "coredump") == 0)
+    bench_coredump ();
+  else
+    panic ("FAILURE: unknown mode %s\n", mode);
+
+  measure_print ();
+  return 0;
+}
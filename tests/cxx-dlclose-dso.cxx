@@ -0,0 +1,56 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Shared object for Ltest-cxx-dlclose, built twice.  The second copy
+   has a function in front of dso_catch() in the source, but in a text
+   section laid out after it: the code of dso_catch() is at the same
+   offset in both copies, and its LSDA is not.  */
+
+#ifdef SHIFT_LSDA
+extern "C" __attribute__ ((noinline, section (".text.shift"))) int
+dso_shift (int x)
+{
+  try
+    {
+      if (x)
+        throw (long) x;
+    }
+  catch (long)
+    {
+      return 1;
+    }
+  return 0;
+}
+#endif
+
+extern "C" int
+dso_catch (int x)
+{
+  try
+    {
+      throw x;
+    }
+  catch (int v)
+    {
+      return v + 1;
+    }
+  return -1;
+}
@@ -0,0 +1,276 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that the CIEs of an address space are parsed once, and again
+   after unw_flush_cache().  The remote "process" is an image of two
+   FDEs sharing a CIE, searched through a remote table.  Once the first
+   FDE has been looked up, looking up the second must not read the CIE.
+   The image is then reloaded at the same address with a different
+   personality routine in its CIE: after unw_flush_cache(), the CIE
+   must be read again, and the new personality routine found.  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#define IMAGE_BASE	0x100000
+#define CIE_OFFSET	0x00
+#define CIE_SIZE	32
+#define FDE_OFFSET(i)	(CIE_SIZE + (i) * 32)
+#define TABLE_OFFSET	0x100
+#define TEXT_START	(IMAGE_BASE + 0x1000)
+#define TEXT_SIZE	0x100
+
+#define PERSONALITY_1	0x11111111
+#define PERSONALITY_2	0x22222222
+
+int errors;
+int verbose;
+unsigned long cie_reads;
+
+/* The words of the image, so that every access_mem() is aligned.  */
+union
+  {
+    uint8_t bytes[512];
+    unw_word_t words[512 / sizeof (unw_word_t)];
+  }
+image;
+
+unw_dyn_info_t di;
+
+/* libunwind's search of remote .eh_frame_hdr tables */
+extern int UNW_OBJ (dwarf_search_unwind_table) (unw_addr_space_t, unw_word_t,
+                                                unw_dyn_info_t *,
+                                                unw_proc_info_t *, int,
+                                                void *);
+
+#define check(cond, args...)				\
+	if (!(cond))					\
+	  {						\
+	    ++errors;					\
+	    fprintf (stderr, args);			\
+	  }
+
+static void
+put (size_t *off, const void *val, size_t size)
+{
+  memcpy (image.bytes + *off, val, size);
+  *off += size;
+}
+
+static void
+put_u8 (size_t *off, uint8_t val)
+{
+  put (off, &val, 1);
+}
+
+static void
+put_u32 (size_t *off, uint32_t val)
+{
+  put (off, &val, 4);
+}
+
+static void
+put_u64 (size_t *off, uint64_t val)
+{
+  put (off, &val, 8);
+}
+
+/* Lay out the CIE, the FDEs and their search table, little-endian, as
+   if the object had been loaded at IMAGE_BASE.  */
+static void
+load_image (uint64_t personality)
+{
+  static const uint8_t cfa_rules[] =
+    {
+      0x0c, 0x07, 0x08,         /* DW_CFA_def_cfa rsp, 8 */
+      0x90, 0x01                /* DW_CFA_offset rip, cfa-8 */
+    };
+  size_t off = CIE_OFFSET, start;
+  int32_t entry;
+  int i;
+
+  memset (&image, 0, sizeof (image));
+
+  put_u32 (&off, CIE_SIZE - 4);
+  put_u32 (&off, 0);            /* CIE id */
+  put_u8 (&off, 1);             /* version */
+  put (&off, "zPR", 4);
+  put_u8 (&off, 1);             /* code alignment factor */
+  put_u8 (&off, 0x78);          /* data alignment factor: -8 */
+  put_u8 (&off, 16);            /* return address column */
+  put_u8 (&off, 10);            /* augmentation size */
+  put_u8 (&off, 0x00);          /* DW_EH_PE_absptr */
+  put_u64 (&off, personality);
+  put_u8 (&off, 0x00);          /* FDE pointer encoding */
+  put (&off, cfa_rules, sizeof (cfa_rules));
+
+  for (i = 0; i < 2; ++i)
+    {
+      off = FDE_OFFSET (i);
+      put_u32 (&off, 28);
+      put_u32 (&off, off - CIE_OFFSET);
+      put_u64 (&off, TEXT_START + i * TEXT_SIZE);
+      put_u64 (&off, TEXT_SIZE);
+      put_u8 (&off, 0);         /* augmentation size, then DW_CFA_nop */
+    }
+
+  off = TABLE_OFFSET;
+  for (i = 0; i < 2; ++i)
+    {
+      start = TEXT_START + i * TEXT_SIZE - IMAGE_BASE;
+      entry = start;
+      put (&off, &entry, 4);
+      entry = FDE_OFFSET (i);
+      put (&off, &entry, 4);
+    }
+
+  memset (&di, 0, sizeof (di));
+  di.format = UNW_INFO_FORMAT_REMOTE_TABLE;
+  di.start_ip = TEXT_START;
+  di.end_ip = TEXT_START + 2 * TEXT_SIZE;
+  di.u.rti.segbase = IMAGE_BASE;
+  di.u.rti.table_data = IMAGE_BASE + TABLE_OFFSET;
+  di.u.rti.table_len = 2 * 8 / sizeof (unw_word_t);
+}
+
+static int
+find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
+                int need_unwind_info, void *arg)
+{
+  if (ip < di.start_ip || ip >= di.end_ip)
+    return -UNW_ENOINFO;
+  return UNW_OBJ (dwarf_search_unwind_table) (as, ip, &di, pi,
+                                              need_unwind_info, arg);
+}
+
+static void
+put_unwind_info (unw_addr_space_t as UNUSED, unw_proc_info_t *pi UNUSED,
+                 void *arg UNUSED)
+{
+}
+
+static int
+get_dyn_info_list_addr (unw_addr_space_t as UNUSED,
+                        unw_word_t *dilap UNUSED, void *arg UNUSED)
+{
+  return -UNW_ENOINFO;
+}
+
+static int
+access_mem (unw_addr_space_t as UNUSED, unw_word_t addr, unw_word_t *valp,
+            int write, void *arg UNUSED)
+{
+  unw_word_t off = addr - IMAGE_BASE;
+
+  if (write || addr < IMAGE_BASE || off >= sizeof (image)
+      || off % sizeof (unw_word_t))
+    return -UNW_EINVAL;
+  if (off >= CIE_OFFSET && off < CIE_OFFSET + CIE_SIZE)
+    ++cie_reads;
+  *valp = image.words[off / sizeof (unw_word_t)];
+  return 0;
+}
+
+static int
+access_reg (unw_addr_space_t as UNUSED, unw_regnum_t regnum UNUSED,
+            unw_word_t *valp UNUSED, int write UNUSED, void *arg UNUSED)
+{
+  return -UNW_EBADREG;
+}
+
+static void
+lookup (unw_addr_space_t as, int fde, unw_word_t personality,
+        int expect_cie_reads)
+{
+  unw_proc_info_t pi;
+  int ret;
+
+  cie_reads = 0;
+  memset (&pi, 0, sizeof (pi));
+  ret = unw_get_proc_info_by_ip (as, TEXT_START + fde * TEXT_SIZE + 0x10,
+                                 &pi, NULL);
+  if (verbose)
+    printf ("FDE %d: ret=%d, handler=0x%lx, %lu CIE reads\n",
+            fde, ret, (long) pi.handler, cie_reads);
+
+  check (ret == 0, "FDE %d: lookup failed with %d\n", fde, ret);
+  check (pi.handler == personality,
+         "FDE %d: personality 0x%lx instead of 0x%lx\n",
+         fde, (long) pi.handler, (long) personality);
+  check (expect_cie_reads ? cie_reads > 0 : cie_reads == 0,
+         "FDE %d: %lu CIE reads, expected %s\n", fde, cie_reads,
+         expect_cie_reads ? "some" : "none");
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  unw_accessors_t acc;
+  unw_addr_space_t as;
+
+  verbose = (argc > 1);
+
+  memset (&acc, 0, sizeof (acc));
+  acc.find_proc_info = find_proc_info;
+  acc.put_unwind_info = put_unwind_info;
+  acc.get_dyn_info_list_addr = get_dyn_info_list_addr;
+  acc.access_mem = access_mem;
+  acc.access_reg = access_reg;
+
+  as = unw_create_addr_space (&acc, 0);
+  if (!as)
+    {
+      fprintf (stderr, "unw_create_addr_space() failed\n");
+      return -1;
+    }
+
+  load_image (PERSONALITY_1);
+  lookup (as, 0, PERSONALITY_1, 1);
+  lookup (as, 1, PERSONALITY_1, 0);
+  lookup (as, 0, PERSONALITY_1, 0);
+
+  /* Another object at the same address: stale until the flush.  */
+  load_image (PERSONALITY_2);
+  lookup (as, 1, PERSONALITY_1, 0);
+  unw_flush_cache (as, 0, 0);
+  lookup (as, 1, PERSONALITY_2, 1);
+  lookup (as, 0, PERSONALITY_2, 0);
+
+  unw_destroy_addr_space (as);
+
+  if (errors)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", errors);
+      return -1;
+    }
+  if (verbose)
+    printf ("SUCCESS\n");
+  return 0;
+}
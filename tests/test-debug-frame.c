@@ -0,0 +1,397 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* The CFI of this file goes to .debug_frame only, so that libunwind
+   can only find it there, and covers 4096 functions, so that their
+   index is built in several steps.  Check that:
+
+   - unw_step() goes through a frame described in .debug_frame;
+   - a lookup of an early function does not index the whole section,
+     and later lookups extend the index and find their function;
+   - the complete index is saved to UNW_DEBUG_FRAME_INDEX_DIR, and is
+     loaded instead of scanning the section once the descriptors are
+     dropped by unw_flush_cache(): an entry altered in the saved index
+     shows in the lookups;
+   - a saved index for another version of the object, or a corrupt
+     one, is ignored.
+
+   Only meaningful when libunwind is configured with
+   --enable-debug-frame; skipped otherwise.  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "compiler.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#ifdef CONFIG_DEBUG_FRAME
+
+/* Must come before any function.  */
+__asm__ (".cfi_sections .debug_frame");
+
+#define NFNS	4096
+
+#define FN(n)	static NOINLINE int df_fn_##n (int x) { return x * 0x##n + 1; }
+#define FN16(p)	FN(p##0) FN(p##1) FN(p##2) FN(p##3) FN(p##4) FN(p##5)	\
+		FN(p##6) FN(p##7) FN(p##8) FN(p##9) FN(p##a) FN(p##b)	\
+		FN(p##c) FN(p##d) FN(p##e) FN(p##f)
+#define FN256(p) FN16(p##0) FN16(p##1) FN16(p##2) FN16(p##3)		\
+		FN16(p##4) FN16(p##5) FN16(p##6) FN16(p##7)		\
+		FN16(p##8) FN16(p##9) FN16(p##a) FN16(p##b)		\
+		FN16(p##c) FN16(p##d) FN16(p##e) FN16(p##f)
+
+FN256(0) FN256(1) FN256(2) FN256(3) FN256(4) FN256(5) FN256(6) FN256(7)
+FN256(8) FN256(9) FN256(a) FN256(b) FN256(c) FN256(d) FN256(e) FN256(f)
+
+#undef FN
+#define FN(n)	df_fn_##n,
+
+static int (*const fns[NFNS]) (int) =
+  {
+    FN256(0) FN256(1) FN256(2) FN256(3) FN256(4) FN256(5) FN256(6)
+    FN256(7) FN256(8) FN256(9) FN256(a) FN256(b) FN256(c) FN256(d)
+    FN256(e) FN256(f)
+  };
+
+/* Header of a saved index, as libunwind writes it, followed by COUNT
+   entries.  */
+struct dfi_header
+  {
+    char magic[8];
+    uint64_t key;
+    uint64_t debug_frame_size;
+    uint64_t count;
+  };
+
+struct dfi_entry
+  {
+    int32_t start_ip_offset;
+    int32_t fde_offset;
+  };
+
+int verbose;
+int num_errors;
+char index_dir[] = "/tmp/test-debug-frame.XXXXXX";
+unw_word_t segbase;
+
+#define check(cond, args...)			\
+	if (!(cond))				\
+	  {					\
+	    ++num_errors;			\
+	    fprintf (stderr, args);		\
+	  }
+
+static int
+find_segbase (struct dl_phdr_info *info, size_t size UNUSED, void *ptr)
+{
+  unw_word_t addr = (uintptr_t) ptr;
+  int n;
+
+  for (n = 0; n < info->dlpi_phnum; ++n)
+    if (info->dlpi_phdr[n].p_type == PT_LOAD
+        && addr >= info->dlpi_addr + info->dlpi_phdr[n].p_vaddr
+        && addr < (info->dlpi_addr + info->dlpi_phdr[n].p_vaddr
+                   + info->dlpi_phdr[n].p_memsz))
+      {
+        segbase = info->dlpi_addr;
+        return 1;
+      }
+  return 0;
+}
+
+/* Whether IP is found in the function starting at START.  */
+static int
+lookup (unw_word_t ip, unw_word_t start)
+{
+  unw_proc_info_t pi;
+  int ret;
+
+  memset (&pi, 0, sizeof (pi));
+  ret = unw_get_proc_info_by_ip (unw_local_addr_space, ip, &pi, NULL);
+  if (verbose)
+    printf ("ip=0x%lx: ret=%d, start_ip=0x%lx, expected 0x%lx\n",
+            (long) ip, ret, (long) pi.start_ip, (long) start);
+  return ret == 0 && pi.start_ip == start
+         && (pi.flags & UNW_PI_FLAG_DEBUG_FRAME);
+}
+
+static int
+lookup_fn (int i)
+{
+  return lookup ((uintptr_t) fns[i], (uintptr_t) fns[i]);
+}
+
+/* The path of the saved index, or NULL.  */
+static char *
+find_index (void)
+{
+  static char path[sizeof (index_dir) + 256];
+  struct dirent *d;
+  size_t len;
+  DIR *dir;
+  int found = 0;
+
+  if (!(dir = opendir (index_dir)))
+    return NULL;
+  while (!found && (d = readdir (dir)))
+    {
+      len = strlen (d->d_name);
+      if (len > 4 && strcmp (d->d_name + len - 4, ".dfi") == 0
+          && len < 256)
+        {
+          snprintf (path, sizeof (path), "%s/%s", index_dir, d->d_name);
+          found = 1;
+        }
+    }
+  closedir (dir);
+  return found ? path : NULL;
+}
+
+static char *
+read_file (const char *path, size_t *size)
+{
+  struct stat st;
+  char *buf;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY)) < 0 || fstat (fd, &st) < 0)
+    return NULL;
+  buf = malloc (st.st_size);
+  if (buf && read (fd, buf, st.st_size) != st.st_size)
+    {
+      free (buf);
+      buf = NULL;
+    }
+  close (fd);
+  *size = st.st_size;
+  return buf;
+}
+
+static void
+write_file (const char *path, const char *buf, size_t size)
+{
+  int fd;
+
+  if ((fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0
+      || write (fd, buf, size) != (ssize_t) size)
+    {
+      fprintf (stderr, "cannot write %s\n", path);
+      exit (-1);
+    }
+  close (fd);
+}
+
+/* The saved entry of function I.  */
+static struct dfi_entry *
+find_entry (char *buf, int i)
+{
+  struct dfi_header *hdr = (struct dfi_header *) buf;
+  struct dfi_entry *e = (struct dfi_entry *) (hdr + 1);
+  int32_t start = (uintptr_t) fns[i] - segbase;
+  uint64_t j;
+
+  for (j = 0; j < hdr->count; ++j)
+    if (e[j].start_ip_offset == start)
+      return &e[j];
+  fprintf (stderr, "function %d is not in the saved index\n", i);
+  exit (-1);
+}
+
+/* Replace the saved index with its copy BUF of SIZE bytes, and drop
+   the loaded one.  */
+static void
+replace_index (const char *path, const char *buf, size_t size)
+{
+  write_file (path, buf, size);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+}
+
+static NOINLINE void
+check_step (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  int ret;
+
+  unw_getcontext (&uc);
+  if ((ret = unw_init_local (&cursor, &uc)) < 0)
+    {
+      fprintf (stderr, "unw_init_local() failed: %d\n", ret);
+      ++num_errors;
+      return;
+    }
+  ret = unw_step (&cursor);
+  check (ret > 0, "unw_step() out of check_step() returned %d\n", ret);
+  if (ret <= 0)
+    return;
+  ret = unw_get_proc_info (&cursor, &pi);
+  check (ret == 0 && (pi.flags & UNW_PI_FLAG_DEBUG_FRAME),
+         "stepped into a frame not described by .debug_frame\n");
+  ret = unw_step (&cursor);
+  check (ret > 0, "unw_step() out of the caller returned %d\n", ret);
+}
+
+static NOINLINE int
+call_check_step (void (*fn) (void))
+{
+  fn ();
+  return 1;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  struct dfi_entry *a, *b;
+  struct dfi_header *hdr;
+  char *path, *orig, *buf;
+  size_t size;
+  int i, ok;
+
+  verbose = (argc > 1);
+
+  if (!mkdtemp (index_dir))
+    {
+      perror ("mkdtemp");
+      return -1;
+    }
+  dl_iterate_phdr (find_segbase, (void *) fns[0]);
+
+  /* Unwind through the frames of this file, before indexes are saved:
+     stepping into main() indexes the whole section.  */
+  call_check_step (check_step);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  setenv ("UNW_DEBUG_FRAME_INDEX_DIR", index_dir, 1);
+
+  /* The first lookup indexes only the start of the section.  */
+  check (lookup_fn (0), "lookup of the first function failed\n");
+  check (!find_index (), "the index was saved after the first lookup\n");
+
+  /* Further lookups extend the index until they find their function.  */
+  for (i = NFNS - 1, ok = 1; i >= 0; i -= 97)
+    ok &= lookup_fn (i);
+  check (ok, "lookups extending the index failed\n");
+
+  /* Code without an FDE makes the index complete, which saves it.  */
+  lookup ((uintptr_t) fns, 0);
+  path = find_index ();
+  check (path, "the complete index was not saved\n");
+  if (!path || !(orig = read_file (path, &size)))
+    goto out;
+  hdr = (struct dfi_header *) orig;
+  check (size == sizeof (*hdr) + hdr->count * sizeof (struct dfi_entry)
+         && hdr->count >= NFNS, "the saved index is %zd bytes\n", size);
+
+  /* Another run loads the saved index: swap the FDEs of two functions
+     in it, and they are not found any more.  */
+  buf = malloc (size);
+  memcpy (buf, orig, size);
+  a = find_entry (buf, 10);
+  b = find_entry (buf, 11);
+  i = a->fde_offset;
+  a->fde_offset = b->fde_offset;
+  b->fde_offset = i;
+  replace_index (path, buf, size);
+  check (!lookup_fn (10) && !lookup_fn (11) && lookup_fn (12),
+         "the saved index was not used\n");
+
+  /* The same, saved for another version of the object, is ignored.  */
+  ((struct dfi_header *) buf)->key ^= 1;
+  replace_index (path, buf, size);
+  check (lookup_fn (10) && lookup_fn (11),
+         "an index with another key was used\n");
+
+  memcpy (buf, orig, size);
+  find_entry (buf, 10)->fde_offset = b->fde_offset;
+  ((struct dfi_header *) buf)->debug_frame_size += 8;
+  replace_index (path, buf, size);
+  check (lookup_fn (10), "an index of another size was used\n");
+
+  /* So are corrupt indexes: out of order,  */
+  memcpy (buf, orig, size);
+  a = find_entry (buf, 11);
+  a->fde_offset = find_entry (buf, 12)->fde_offset;
+  a->start_ip_offset = 0;
+  replace_index (path, buf, size);
+  check (lookup_fn (11), "an index out of order was used\n");
+
+  /* with an FDE out of the section,  */
+  memcpy (buf, orig, size);
+  find_entry (buf, 10)->fde_offset = INT32_MAX;
+  find_entry (buf, 11)->fde_offset = find_entry (buf, 12)->fde_offset;
+  replace_index (path, buf, size);
+  check (lookup_fn (10) && lookup_fn (11),
+         "an index with an FDE out of the section was used\n");
+
+  /* or truncated.  */
+  memcpy (buf, orig, size);
+  find_entry (buf, 11)->fde_offset = find_entry (buf, 12)->fde_offset;
+  replace_index (path, buf, size - sizeof (struct dfi_entry));
+  check (lookup_fn (11), "a truncated index was used\n");
+
+  /* The index as saved is used again.  */
+  replace_index (path, orig, size);
+  for (i = 0, ok = 1; i < NFNS; i += 61)
+    ok &= lookup_fn (i);
+  check (ok, "lookups through the saved index failed\n");
+
+  free (buf);
+  free (orig);
+
+ out:
+  if ((path = find_index ()))
+    unlink (path);
+  rmdir (index_dir);
+
+  if (num_errors > 0)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", num_errors);
+      exit (-1);
+    }
+  if (verbose)
+    printf ("SUCCESS.\n");
+  return 0;
+}
+
+#else /* !CONFIG_DEBUG_FRAME */
+
+int
+main (void)
+{
+  /* .debug_frame is not loaded without --enable-debug-frame */
+  return 77;
+}
+
+#endif /* !CONFIG_DEBUG_FRAME */
@@ -0,0 +1,222 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Unwind from a SIGPROF handler firing at a high frequency while the
+   main program keeps calling into malloc, the way a sampling profiler
+   does, after preparing eh_elf with unw_eh_elf_prepare_local(), which
+   another thread keeps calling again meanwhile.  The unwinder must
+   neither allocate nor deadlock, and must not leave the signal frame,
+   which eh_elf always knows how to step, to DWARF.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "compiler.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#define NSIGNALS	1000
+#define WATCHDOG_SECS	60
+
+struct itimerval interval =
+  {
+    .it_interval = { .tv_sec = 0, .tv_usec = 100 },
+    .it_value    = { .tv_sec = 0, .tv_usec = 100 }
+  };
+
+int verbose;
+volatile sig_atomic_t nerrors;
+volatile sig_atomic_t nallocs;
+volatile sig_atomic_t nfallbacks;
+volatile sig_atomic_t sigcount;
+__thread volatile sig_atomic_t in_handler;
+
+void *
+malloc (size_t s)
+{
+  static void * (*func)(size_t);
+
+  if (!func)
+    func = (void *(*)(size_t)) dlsym (RTLD_NEXT, "malloc");
+
+  if (in_handler)
+    ++nallocs;
+  return func (s);
+}
+
+void *
+realloc (void *p, size_t s)
+{
+  static void * (*func)(void *, size_t);
+
+  if (!func)
+    func = (void *(*)(void *, size_t)) dlsym (RTLD_NEXT, "realloc");
+
+  if (in_handler)
+    ++nallocs;
+  return func (p, s);
+}
+
+static void
+do_backtrace (void)
+{
+  unw_eh_elf_stats_t start, before, after;
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int ret, depth = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    {
+      ++nerrors;
+      return;
+    }
+
+  unw_eh_elf_get_stats (&start);
+  do
+    {
+      unw_eh_elf_get_stats (&before);
+      ret = unw_step (&cursor);
+      unw_eh_elf_get_stats (&after);
+      if (ret < 0)
+	++nerrors;
+      /* Landing in the interrupted frame means this step went through
+	 the signal trampoline.  */
+      if (ret > 0 && unw_is_signal_frame (&cursor) > 0
+	  && after.fallbacks != before.fallbacks)
+	++nfallbacks;
+      if (depth++ > 100)
+	{
+	  ++nerrors;
+	  break;
+	}
+    }
+  while (ret > 0);
+
+  /* Every step must have gone through eh_elf first.  */
+  if (after.steps - start.steps != (unsigned long) depth)
+    ++nerrors;
+}
+
+static void
+sighandler (int signal UNUSED)
+{
+  in_handler = 1;
+  do_backtrace ();
+  in_handler = 0;
+  ++sigcount;
+}
+
+/* Replace the prepared memory map under the handlers' feet.  */
+static void *
+preparer (void *arg UNUSED)
+{
+  while (sigcount < NSIGNALS)
+    if (unw_eh_elf_prepare_local () < 0)
+      ++nerrors;
+  return NULL;
+}
+
+static long NOINLINE
+churn (int depth)
+{
+  long sum = 0;
+  char *p;
+
+  if (depth > 0)
+    return churn (depth - 1) + 1;
+
+  p = malloc (64 + (sigcount % 512));
+  if (p)
+    {
+      memset (p, sigcount & 0xff, 64);
+      sum = p[0];
+    }
+  free (p);
+  return sum;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  struct sigaction act;
+  pthread_t thread;
+  long i = 0;
+
+  if (argc > 1)
+    verbose = 1;
+
+  if (unw_eh_elf_prepare_local () < 0)
+    {
+      fprintf (stderr, "FAILURE: unw_eh_elf_prepare_local failed\n");
+      exit (-1);
+    }
+
+  /* A deadlock in the handler shows up as the default SIGALRM action. */
+  alarm (WATCHDOG_SECS);
+
+  memset (&act, 0, sizeof (act));
+  act.sa_handler = sighandler;
+  act.sa_flags = SA_RESTART;
+  sigaction (SIGPROF, &act, NULL);
+
+  setitimer (ITIMER_PROF, &interval, NULL);
+
+  if (pthread_create (&thread, NULL, preparer, NULL) != 0)
+    {
+      fprintf (stderr, "FAILURE: pthread_create failed\n");
+      exit (-1);
+    }
+  while (sigcount < NSIGNALS)
+    churn (i++ % 32);
+  pthread_join (thread, NULL);
+
+  memset (&interval, 0, sizeof (interval));
+  setitimer (ITIMER_PROF, &interval, NULL);
+
+  if (verbose)
+    printf ("%d signals, %d errors, %d allocations, %d fallbacks"
+	    " in handler\n", (int) sigcount, (int) nerrors, (int) nallocs,
+	    (int) nfallbacks);
+
+  if (nerrors || nallocs || nfallbacks)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors, %d allocations,"
+	       " %d fallbacks\n", (int) nerrors, (int) nallocs,
+	       (int) nfallbacks);
+      exit (-1);
+    }
+  if (verbose)
+    printf ("SUCCESS.\n");
+  return 0;
+}
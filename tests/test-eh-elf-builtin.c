@@ -0,0 +1,240 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Sample the program with SIGPROF while it keeps calling clock_gettime(),
+   whose fast path runs in the vDSO.  For the samples taken there, both
+   the signal frame and the vDSO frame must be unwound by eh_elf, not
+   left to DWARF, and so must they by unw_eh_elf_backtrace().  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "compiler.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/time.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#if defined __x86_64__ && defined HAVE_GETAUXVAL
+
+#include <elf.h>
+#include <sys/auxv.h>
+
+#define NSAMPLES	20
+#define MAX_SECS	10
+
+struct itimerval interval =
+  {
+    .it_interval = { .tv_sec = 0, .tv_usec = 1000 },
+    .it_value    = { .tv_sec = 0, .tv_usec = 1000 }
+  };
+
+int verbose;
+volatile sig_atomic_t nerrors;
+volatile sig_atomic_t nsamples;
+unw_word_t vdso_start, vdso_end;
+
+static void
+check_frames (unw_word_t pc)
+{
+  unw_eh_elf_stats_t before, after;
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_word_t ip, prev_ip = 0;
+  void *buffer[32];
+  int i, n, found = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    {
+      ++nerrors;
+      return;
+    }
+
+  for (i = 0; i < 16 && found < 2; ++i)
+    {
+      unw_eh_elf_get_stats (&before);
+      if (unw_step (&cursor) <= 0)
+	break;
+      unw_eh_elf_get_stats (&after);
+      unw_get_reg (&cursor, UNW_REG_IP, &ip);
+
+      if (ip == pc)
+	{
+	  /* Stepped out of the signal trampoline */
+	  found = 1;
+	  if (after.fallbacks != before.fallbacks)
+	    {
+	      if (verbose)
+		printf ("the signal frame was left to DWARF\n");
+	      ++nerrors;
+	    }
+	  if (unw_is_signal_frame (&cursor) <= 0)
+	    {
+	      if (verbose)
+		printf ("the signal frame is not flagged as such\n");
+	      ++nerrors;
+	    }
+	}
+      else if (found && prev_ip == pc)
+	{
+	  /* Stepped out of the vDSO */
+	  found = 2;
+	  if (after.fallbacks != before.fallbacks)
+	    {
+	      if (verbose)
+		printf ("the vDSO frame at %lx was left to DWARF\n", (long) pc);
+	      ++nerrors;
+	    }
+	  if (ip >= vdso_start && ip < vdso_end)
+	    {
+	      if (verbose)
+		printf ("the vDSO frame returns into the vDSO\n");
+	      ++nerrors;
+	    }
+	}
+      prev_ip = ip;
+    }
+  if (found < 2)
+    {
+      if (verbose)
+	printf ("failed to unwind out of the vDSO (found=%d)\n", found);
+      ++nerrors;
+    }
+
+  unw_getcontext (&uc);
+  n = unw_eh_elf_backtrace (&uc, buffer, 32);
+  for (i = 0; i < n - 1; ++i)
+    if ((unw_word_t) buffer[i] == pc)
+      break;
+  if (i == n - 1
+      || ((unw_word_t) buffer[i + 1] >= vdso_start
+	  && (unw_word_t) buffer[i + 1] < vdso_end))
+    {
+      if (verbose)
+	printf ("unw_eh_elf_backtrace() did not go through the vDSO\n");
+      ++nerrors;
+    }
+}
+
+static void
+sighandler (int signal UNUSED, siginfo_t *si UNUSED, void *arg)
+{
+  ucontext_t *uc = arg;
+  unw_word_t pc = uc->uc_mcontext.gregs[REG_RIP];
+
+  if (pc < vdso_start || pc >= vdso_end || nsamples >= NSAMPLES)
+    return;
+  ++nsamples;
+  check_frames (pc);
+}
+
+/* Find the range of the vDSO from its program headers.  */
+static int
+find_vdso (void)
+{
+  const Elf64_Ehdr *ehdr;
+  const Elf64_Phdr *phdr;
+  int i;
+
+  ehdr = (const Elf64_Ehdr *) getauxval (AT_SYSINFO_EHDR);
+  if (!ehdr)
+    return -1;
+  phdr = (const Elf64_Phdr *) ((const char *) ehdr + ehdr->e_phoff);
+  for (i = 0; i < ehdr->e_phnum; ++i)
+    if (phdr[i].p_type == PT_LOAD && (phdr[i].p_flags & PF_X))
+      {
+	vdso_start = (unw_word_t) ehdr + phdr[i].p_offset;
+	vdso_end = vdso_start + phdr[i].p_memsz;
+	return 0;
+      }
+  return -1;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  struct sigaction act;
+  struct timespec ts;
+  time_t deadline;
+
+  if (argc > 1)
+    verbose = 1;
+
+  if (find_vdso () < 0)
+    {
+      if (verbose)
+	printf ("no vDSO, skipping\n");
+      return 77;
+    }
+  if (unw_eh_elf_prepare_local () < 0)
+    {
+      fprintf (stderr, "unw_eh_elf_prepare_local() failed\n");
+      exit (-1);
+    }
+
+  memset (&act, 0, sizeof (act));
+  act.sa_sigaction = sighandler;
+  act.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigaction (SIGPROF, &act, NULL);
+  setitimer (ITIMER_PROF, &interval, NULL);
+
+  deadline = time (NULL) + MAX_SECS;
+  while (nsamples < NSAMPLES && !nerrors && time (NULL) < deadline)
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  memset (&interval, 0, sizeof (interval));
+  setitimer (ITIMER_PROF, &interval, NULL);
+
+  if (nerrors)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", (int) nerrors);
+      exit (-1);
+    }
+  if (nsamples == 0)
+    {
+      if (verbose)
+	printf ("no sample in the vDSO, skipping\n");
+      return 77;
+    }
+  if (verbose)
+    printf ("SUCCESS: %d samples in the vDSO\n", (int) nsamples);
+  return 0;
+}
+
+#else /* !__x86_64__ || !HAVE_GETAUXVAL */
+
+int
+main (void)
+{
+  /* eh_elf only supports x86_64 */
+  return 0;
+}
+
+#endif /* !__x86_64__ || !HAVE_GETAUXVAL */
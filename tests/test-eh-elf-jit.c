@@ -0,0 +1,212 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Unwind through code generated at runtime in anonymous memory, whose
+   unwind rules are registered with unw_eh_elf_register_jit(), while
+   another thread keeps registering and cancelling other regions.  The
+   JIT frame must be unwound by eh_elf, not left to DWARF.  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "compiler.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#define NITERATIONS	10000
+
+#define panic(args...)				\
+	{ fprintf (stderr, args); exit (-1); }
+
+#ifdef __x86_64__
+
+/* void jit (void (*callback) (void))  */
+static const unsigned char jit_code[] =
+  {
+    0x55,		/* 0: push %rbp */
+    0x48, 0x89, 0xe5,	/* 1: mov %rsp,%rbp */
+    0xff, 0xd7,		/* 4: call *%rdi */
+    0x5d,		/* 6: pop %rbp */
+    0xc3		/* 7: ret */
+  };
+
+static const unw_eh_elf_jit_rule_t jit_rules[] =
+  {
+    { .offset = 0, .cfa_reg = UNW_TDEP_SP, .cfa_offset = 8, .ra_offset = -8 },
+    { .offset = 1, .cfa_reg = UNW_TDEP_SP, .cfa_offset = 16, .ra_offset = -8,
+      .bp_offset = -16 },
+    { .offset = 4, .cfa_reg = UNW_TDEP_BP, .cfa_offset = 16, .ra_offset = -8,
+      .bp_offset = -16 },
+    { .offset = 7, .cfa_reg = UNW_TDEP_SP, .cfa_offset = 8, .ra_offset = -8 },
+  };
+
+int verbose;
+int nerrors;
+unw_word_t jit_start, jit_end;
+volatile int done;
+
+static void
+check_frames (void)
+{
+  unw_eh_elf_stats_t before, after;
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_word_t ip, off;
+  char name[64];
+  void *buffer[16];
+  int n;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0 || unw_step (&cursor) <= 0)
+    panic ("failed to step out of check_frames()\n");
+
+  unw_get_reg (&cursor, UNW_REG_IP, &ip);
+  if (ip < jit_start || ip >= jit_end)
+    {
+      if (verbose)
+	printf ("ip %lx not in the JIT region\n", (long) ip);
+      ++nerrors;
+      return;
+    }
+
+  unw_eh_elf_get_stats (&before);
+  if (unw_step (&cursor) <= 0)
+    {
+      if (verbose)
+	printf ("failed to step out of the JIT region\n");
+      ++nerrors;
+      return;
+    }
+  unw_eh_elf_get_stats (&after);
+  if (after.fallbacks != before.fallbacks)
+    {
+      if (verbose)
+	printf ("the JIT frame was left to DWARF\n");
+      ++nerrors;
+    }
+
+  if (unw_get_proc_name (&cursor, name, sizeof (name), &off) < 0
+      || strcmp (name, "run_jit") != 0)
+    {
+      if (verbose)
+	printf ("JIT code returns to %s instead of run_jit\n", name);
+      ++nerrors;
+    }
+
+  unw_getcontext (&uc);
+  n = unw_eh_elf_backtrace (&uc, buffer, 16);
+  if (n < 4 || (unw_word_t) buffer[1] < jit_start
+      || (unw_word_t) buffer[1] >= jit_end)
+    {
+      if (verbose)
+	printf ("unw_eh_elf_backtrace() did not go through the JIT region\n");
+      ++nerrors;
+    }
+}
+
+static void NOINLINE
+run_jit (void (*jit) (void (*) (void)))
+{
+  jit (check_frames);
+  /* defeat sibcall optimization */
+  asm volatile ("" ::: "memory");
+}
+
+static void *
+churn (void *arg UNUSED)
+{
+  unw_word_t start = jit_end + 4096;
+
+  /* Replace the snapshot of the registered regions over and over.  */
+  while (!done)
+    {
+      if (unw_eh_elf_register_jit (start, start + 16, jit_rules, 4) < 0)
+	panic ("failed to register a region\n");
+      if (unw_eh_elf_cancel_jit (start) < 0)
+	panic ("failed to cancel a region\n");
+    }
+  return NULL;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  void (*jit) (void (*) (void));
+  pthread_t thread;
+  void *mem;
+  int i;
+
+  if (argc > 1)
+    verbose = 1;
+
+  mem = mmap (NULL, 4096, PROT_READ | PROT_WRITE | PROT_EXEC,
+	      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    panic ("mmap failed\n");
+  memcpy (mem, jit_code, sizeof (jit_code));
+  jit = (void (*) (void (*) (void))) mem;
+  jit_start = (unw_word_t) mem;
+  jit_end = jit_start + sizeof (jit_code);
+
+  if (unw_eh_elf_register_jit (jit_start, jit_end, jit_rules, 4) < 0)
+    panic ("failed to register the JIT region\n");
+  if (unw_eh_elf_register_jit (jit_start + 2, jit_end + 2, jit_rules, 4) >= 0)
+    panic ("registered an overlapping region\n");
+
+  pthread_create (&thread, NULL, churn, NULL);
+  for (i = 0; i < NITERATIONS && !nerrors; ++i)
+    run_jit (jit);
+  done = 1;
+  pthread_join (thread, NULL);
+
+  if (unw_eh_elf_cancel_jit (jit_start) < 0
+      || unw_eh_elf_cancel_jit (jit_start) >= 0)
+    panic ("failed to cancel the JIT region\n");
+
+  if (nerrors)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", nerrors);
+      exit (-1);
+    }
+  if (verbose)
+    printf ("SUCCESS.\n");
+  return 0;
+}
+
+#else /* !__x86_64__ */
+
+int
+main (void)
+{
+  /* eh_elf only supports x86_64 */
+  return 0;
+}
+
+#endif /* !__x86_64__ */
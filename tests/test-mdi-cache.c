@@ -0,0 +1,223 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Look up names in the MiniDebugInfo of several stripped binaries in
+   turn, as set up by run-mdi-cache: each argument triple is a binary,
+   the address of a function in it and the name of that function.  Each
+   binary is looked up as mapped from its file, as mapped from its file
+   without its build-id, and copied to the same anonymous memory as the
+   binaries before it, the way a core file segment would be.  The
+   decompressed MiniDebugInfo is cached, and no lookup may find the
+   symbols of another binary there.  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libunwind.h>
+
+#define MAX_BINARIES	4
+#define BUILD_ID_MAX	32
+#define AREA_SIZE	(64 * 1024 * 1024)
+
+/* libunwind's struct elf_image and ELF symbol lookup */
+struct elf_image
+  {
+    void *image;
+    size_t size;
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+  };
+
+extern size_t _Uelf64_get_build_id (struct elf_image *, uint8_t *, size_t);
+extern int _Uelf64_get_proc_name_in_image (unw_addr_space_t,
+                                           struct elf_image *,
+                                           unsigned long, unsigned long,
+                                           unw_word_t, char *, size_t,
+                                           unw_word_t *);
+
+struct binary
+  {
+    const char *path;
+    unw_word_t addr;
+    const char *name;
+    uint8_t build_id[BUILD_ID_MAX];
+    size_t build_id_len;
+  };
+
+int errors;
+int verbose;
+void *area;
+
+#define check(cond, args...)				\
+	if (!(cond))					\
+	  {						\
+	    ++errors;					\
+	    fprintf (stderr, args);			\
+	  }
+
+/* Map B as libunwind's elf_map_image() would, privately so that the
+   build-id can be hidden.  */
+static void
+map_file (struct binary *b, struct elf_image *ei)
+{
+  struct stat st;
+  int fd;
+
+  if ((fd = open (b->path, O_RDONLY)) < 0 || fstat (fd, &st) < 0)
+    {
+      perror (b->path);
+      exit (-1);
+    }
+  ei->size = st.st_size;
+  ei->dev = st.st_dev;
+  ei->ino = st.st_ino;
+  ei->mtime = st.st_mtime;
+  ei->image = mmap (NULL, ei->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  close (fd);
+  if (ei->image == MAP_FAILED)
+    {
+      perror ("mmap");
+      exit (-1);
+    }
+}
+
+static void
+hide_build_id (struct elf_image *ei)
+{
+  Elf64_Ehdr *ehdr = ei->image;
+  Elf64_Phdr *phdr = (Elf64_Phdr *) ((char *) ei->image + ehdr->e_phoff);
+  int i;
+
+  for (i = 0; i < ehdr->e_phnum; ++i)
+    if (phdr[i].p_type == PT_NOTE)
+      phdr[i].p_type = PT_NULL;
+}
+
+static void
+lookup (struct binary *b, struct elf_image *ei, const char *how)
+{
+  unw_word_t off = ~(unw_word_t) 0;
+  char name[256];
+  int ret;
+
+  name[0] = '\0';
+  ret = _Uelf64_get_proc_name_in_image (NULL, ei, 0, ~0UL, b->addr,
+                                        name, sizeof (name), &off);
+  if (verbose)
+    printf ("%s, %s: 0x%lx is %s+0x%lx (%d)\n", b->path, how,
+            (long) b->addr, name, (long) off, ret);
+
+  check (ret == 0 && strcmp (name, b->name) == 0 && off == 0,
+         "%s, %s: 0x%lx is %s+0x%lx (%d), expected %s\n", b->path, how,
+         (long) b->addr, name, (long) off, ret, b->name);
+}
+
+static void
+test_binary (struct binary *b)
+{
+  struct elf_image ei;
+  uint8_t id[BUILD_ID_MAX];
+
+  /* By its build-id */
+  map_file (b, &ei);
+  b->build_id_len = _Uelf64_get_build_id (&ei, b->build_id,
+                                          sizeof (b->build_id));
+  check (b->build_id_len > 0, "%s: no build-id\n", b->path);
+  lookup (b, &ei, "build-id");
+
+  /* By the identity of its file */
+  hide_build_id (&ei);
+  check (_Uelf64_get_build_id (&ei, id, sizeof (id)) == 0,
+         "%s: build-id found after hiding it\n", b->path);
+  lookup (b, &ei, "file");
+
+  /* Not at all */
+  check (ei.size <= AREA_SIZE, "%s: too large\n", b->path);
+  memcpy (area, ei.image, ei.size);
+  munmap (ei.image, ei.size);
+  ei.image = area;
+  ei.dev = ei.ino = ei.mtime = 0;
+  lookup (b, &ei, "anonymous");
+}
+
+int
+main (int argc, char **argv)
+{
+  struct binary binaries[MAX_BINARIES];
+  int i, j, n = 0, pass;
+
+  verbose = (getenv ("VERBOSE") != NULL);
+
+  for (i = 1; i + 2 < argc && n < MAX_BINARIES; i += 3, ++n)
+    {
+      binaries[n].path = argv[i];
+      binaries[n].addr = strtoul (argv[i + 1], NULL, 16);
+      binaries[n].name = argv[i + 2];
+    }
+  if (n < 2 || i != argc)
+    {
+      fprintf (stderr, "usage: %s (binary address name)...\n", argv[0]);
+      return -1;
+    }
+
+  area = mmap (NULL, AREA_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED)
+    {
+      perror ("mmap");
+      return -1;
+    }
+
+  /* Once to fill the cache, then again from it.  */
+  for (pass = 0; pass < 2; ++pass)
+    for (i = 0; i < n; ++i)
+      test_binary (&binaries[i]);
+
+  for (i = 0; i < n; ++i)
+    for (j = 0; j < i; ++j)
+      check (binaries[i].build_id_len != binaries[j].build_id_len
+             || memcmp (binaries[i].build_id, binaries[j].build_id,
+                        binaries[i].build_id_len) != 0,
+             "%s and %s have the same build-id\n",
+             binaries[i].path, binaries[j].path);
+
+  if (errors)
+    {
+      fprintf (stderr, "FAILURE: detected %d errors\n", errors);
+      return -1;
+    }
+  if (verbose)
+    printf ("SUCCESS\n");
+  return 0;
+}
@@ -76,15 +76,17 @@ void
 do_backtrace (void)
 {
   unw_word_t ip, sp, start_ip = 0, off;
-  int n = 0, ret;
+  int n = 0, m, i, ret;
   unw_proc_info_t pi;
-  unw_cursor_t c;
+  unw_cursor_t c, c0;
+  void *addresses[2][128];
   char buf[512];
   size_t len;
 
   ret = unw_init_remote (&c, as, ui);
   if (ret < 0)
     panic ("unw_init_remote() failed: ret=%d\n", ret);
+  c0 = c;
 
   do
     {
@@ -94,6 +96,7 @@ do_backtrace (void)
 
       if (n == 0)
 	start_ip = ip;
+      addresses[0][n] = (void *) (uintptr_t) ip;
 
       buf[0] = '\0';
       if (print_names)
@@ -156,6 +159,20 @@ do_backtrace (void)
 
   if (ret < 0)
     panic ("unwind failed with ret=%d\n", ret);
+  else if (ret == 0)
+    {
+      m = unw_backtrace_remote (&c0, addresses[1], 128);
+      if (m != n)
+	panic ("FAILURE: unw_step() loop and unw_backtrace_remote() depths "
+	       "differ: %d vs. %d (start ip=%lx)\n", n, m, (long) start_ip);
+      else
+	for (i = 1; i < n; ++i)
+	  /* Allow one in difference, trace returns adjusted addresses. */
+	  if (labs ((long) addresses[0][i] - (long) addresses[1][i]) > 1)
+	    panic ("FAILURE: unw_step() loop and unw_backtrace_remote() "
+		   "addresses differ at %d: %p vs. %p\n", i,
+		   addresses[0][i], addresses[1][i]);
+    }
 
   if (verbose)
     printf ("================\n\n");